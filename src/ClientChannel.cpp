@@ -0,0 +1,847 @@
+#include "ClientChannel.h"
+#include "ThreadTopology.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "ClientChannel"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string.h>
+
+
+// clients that don't repeat their request within this time are removed
+#define CLIENT_TIMEOUT_S   30
+// size of the batch datagram header: message ID, size, frame count, encoding
+#define BATCH_HEADER_SIZE  8
+// maximum number of frames or milliseconds per batch
+#define BATCH_MAX_FRAMES   1000
+#define BATCH_MAX_INTERVAL 10000
+// interval between two probes to a client
+#define PROBE_INTERVAL_NS  1000000000ll
+// size of a probe datagram: message ID, size, sequence number, server time
+#define PROBE_SIZE         16
+// weight of a new round trip time in the moving average
+#define RTT_AVG_WEIGHT     0.125f
+// maximum number of history requests that are served at the same time
+#define HISTORY_MAX_JOBS   4
+// pause between two datagrams of a history request
+#define HISTORY_INTERVAL   std::chrono::milliseconds(1)
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+static uint64_t getAddressKey(const sockaddr_in& refAddress)
+{
+	return ((uint64_t) ntohl(refAddress.sin_addr.s_addr) << 16) | ntohs(refAddress.sin_port);
+}
+
+
+static int64_t getTimeNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/******************************************************************************
+ * sLinkStatistics structure
+ */
+
+float sLinkStatistics::getLossRate() const
+{
+	unsigned long total = framesEchoed + framesLost;
+	return (total > 0) ? ((float) framesLost / total) : 0;
+}
+
+
+/******************************************************************************
+ * ClientChannel class
+ */
+
+ClientChannel::ClientChannel(const std::string& strName) :
+	name(strName),
+	channelSocket(INVALID_SOCKET),
+	maxDatagramSize(0),
+	pTransmitPacer(nullptr),
+	kernelPacing(false),
+	pWireCapture(nullptr),
+	pFrameHistory(nullptr),
+	running(false),
+	framesOversize(0)
+{
+	for (sStatsSlot& slot : arrStats)
+	{
+		slot.key = 0;
+	}
+	for (auto& sentFrame : arrSentFrames)
+	{
+		sentFrame = -1;
+	}
+}
+
+
+ClientChannel::~ClientChannel()
+{
+	stop();
+}
+
+
+void ClientChannel::setTransmitPacer(TransmitPacer* pPacer)
+{
+	pTransmitPacer = pPacer;
+}
+
+
+void ClientChannel::setWireCapture(WireCapture* pCapture)
+{
+	pWireCapture = pCapture;
+}
+
+
+void ClientChannel::setFrameHistory(FrameHistory* pHistory)
+{
+	pFrameHistory = pHistory;
+}
+
+
+bool ClientChannel::start(const std::string& strAddress, int port, int maxDatagramSize)
+{
+	if (running) return true;
+
+	sockaddr_in address;
+	if (!networkResolveAddress(strAddress, port, address))
+	{
+		LOG_ERROR("Invalid client channel address '" << strAddress << "'");
+		return false;
+	}
+
+	if (!networkInitialise()) return false;
+
+	channelSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if ((channelSocket == INVALID_SOCKET) ||
+	    (bind(channelSocket, (sockaddr*) &address, sizeof(address)) == SOCKET_ERROR))
+	{
+		LOG_ERROR("Could not open client channel on " << networkAddressToString(address));
+		if (channelSocket != INVALID_SOCKET)
+		{
+			closesocket(channelSocket);
+			channelSocket = INVALID_SOCKET;
+		}
+		networkDeinitialise();
+		return false;
+	}
+
+	this->maxDatagramSize = std::max(256, std::min(maxDatagramSize, 65000));
+	kernelPacing = (pTransmitPacer != nullptr) && pTransmitPacer->enableKernelPacing(channelSocket);
+	frameBuffer.resize(0xFFFF);
+
+	running = true;
+	thread  = std::thread(&ClientChannel::receiverThread, this);
+	LOG_INFO("Client channel of '" << name << "' listening on " << networkAddressToString(address));
+	return true;
+}
+
+
+void ClientChannel::stop()
+{
+	if (running)
+	{
+		running = false;
+		if (pTransmitPacer)
+		{
+			// paced datagrams still refer to the socket
+			pTransmitPacer->flush();
+		}
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+		for (auto& pJob : arrHistoryJobs)
+		{
+			pJob->thread.join();
+		}
+		arrHistoryJobs.clear();
+		closesocket(channelSocket);
+		channelSocket = INVALID_SOCKET;
+		networkDeinitialise();
+
+		std::lock_guard<std::mutex> lock(mtxClients);
+		arrClients.clear();
+		LOG_INFO("Client channel of '" << name << "' closed");
+	}
+}
+
+
+void ClientChannel::sendFrame(const sFrameOfMocapData& refFrame, uint32_t descriptionGeneration, CompactEncoder& refEncoder)
+{
+	std::lock_guard<std::mutex> lock(mtxClients);
+	if (arrClients.empty()) return;
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	// forget clients that didn't renew their subscription
+	for (auto iter = arrClients.begin(); iter != arrClients.end(); )
+	{
+		if (now - iter->lastRequest > std::chrono::seconds(CLIENT_TIMEOUT_S))
+		{
+			LOG_INFO("Client " << networkAddressToString(iter->address) << " of '" << name << "' timed out");
+			assignStatsSlot(iter->address, false);
+			iter = arrClients.erase(iter);
+		}
+		else
+		{
+			iter++;
+		}
+	}
+
+	// remember the frame number for the loss statistics
+	arrSentFrames[(uint32_t) refFrame.iFrame % 1024] = refFrame.iFrame;
+
+	// encode once for all clients
+	const int frameSize = refEncoder.encode(refFrame, descriptionGeneration, frameBuffer.data(), (int) frameBuffer.size());
+	if (frameSize == 0) return;
+	if (BATCH_HEADER_SIZE + 2 + frameSize > maxDatagramSize)
+	{
+		// doesn't fit into a datagram on its own > can't be sent
+		if (framesOversize++ == 0)
+		{
+			LOG_WARNING("Frame of " << frameSize << " bytes doesn't fit into a datagram of the client channel of '" << name
+			            << "' (max. " << maxDatagramSize << " bytes), frames this large are not sent to clients");
+		}
+		return;
+	}
+
+	for (sClient& client : arrClients)
+	{
+		if (!client.frames) continue;
+
+		// frame doesn't fit into the current datagram anymore?
+		if ((client.framesInBatch > 0) && ((int) client.batch.size() + 2 + frameSize > maxDatagramSize))
+		{
+			flushBatch(client, true);
+		}
+
+		if (client.framesInBatch == 0)
+		{
+			client.batchStart = now;
+		}
+		const uint16_t size = (uint16_t) frameSize;
+		client.batch.insert(client.batch.end(), (const uint8_t*) &size, (const uint8_t*) &size + sizeof(size));
+		client.batch.insert(client.batch.end(), frameBuffer.data(), frameBuffer.data() + frameSize);
+		client.framesInBatch++;
+
+		if (((client.batchFrames   > 0) && (client.framesInBatch >= client.batchFrames)) ||
+		    ((client.batchInterval.count() > 0) && (now - client.batchStart >= client.batchInterval)))
+		{
+			flushBatch(client, true);
+		}
+	}
+}
+
+
+void ClientChannel::sendEvents(const sFrameOfMocapData& refFrame, const std::vector<sZoneEvent>& arrEvents)
+{
+	std::lock_guard<std::mutex> lock(mtxClients);
+	if (arrClients.empty() || arrEvents.empty()) return;
+
+	// as many events per datagram as fit
+	const size_t maxEvents = (maxDatagramSize - sizeof(sZoneEventHeader)) / sizeof(sZoneEvent);
+	for (size_t first = 0; first < arrEvents.size(); first += maxEvents)
+	{
+		const size_t count = std::min(maxEvents, arrEvents.size() - first);
+		sZoneEventHeader header;
+		header.iMessage   = NAT_ZONE_EVENTS;
+		header.nDataBytes = (uint16_t) (sizeof(header) - 4 + count * sizeof(sZoneEvent));
+		header.iFrame     = refFrame.iFrame;
+		header.fTimestamp = refFrame.fTimestamp;
+		header.eventCount = (uint16_t) count;
+		header.reserved   = 0;
+		memcpy(frameBuffer.data(), &header, sizeof(header));
+		memcpy(frameBuffer.data() + sizeof(header), &arrEvents[first], count * sizeof(sZoneEvent));
+		const int size = (int) (sizeof(header) + count * sizeof(sZoneEvent));
+
+		for (sClient& client : arrClients)
+		{
+			if (!client.events) continue;
+
+			sendto(channelSocket, (const char*) frameBuffer.data(), size, 0, (const sockaddr*) &client.address, sizeof(client.address));
+			if (pWireCapture)
+			{
+				pWireCapture->record(frameBuffer.data(), size, client.address);
+			}
+			client.eventsSent += count;
+		}
+	}
+}
+
+
+std::string ClientChannel::getStatus() const
+{
+	std::lock_guard<std::mutex> lock(mtxClients);
+	std::stringstream strm;
+	strm << "Client channel '" << name << "': " << arrClients.size() << " client(s)";
+	if (framesOversize > 0)
+	{
+		strm << ", " << framesOversize << " frame(s) too large for a datagram";
+	}
+	for (const sClient& client : arrClients)
+	{
+		strm << std::endl << "  " << networkAddressToString(client.address) << ": ";
+		if (!client.frames)
+		{
+			strm << "no frames";
+		}
+		else if (client.batchFrames > 0)
+		{
+			strm << "batches of " << client.batchFrames << " frame(s)";
+		}
+		else
+		{
+			strm << "batches of " << client.batchInterval.count() << "ms";
+		}
+		strm << ", " << client.framesSent << " frames in " << client.datagramsSent << " datagrams";
+		if (client.events)
+		{
+			strm << ", " << client.eventsSent << " events";
+		}
+	}
+	return strm.str();
+}
+
+
+std::vector<sLinkStatistics> ClientChannel::getLinkStatistics() const
+{
+	std::vector<sLinkStatistics> arrLinkStatistics;
+	for (const sStatsSlot& slot : arrStats)
+	{
+		if (slot.key != 0)
+		{
+			arrLinkStatistics.push_back(getLinkStatistics(slot));
+		}
+	}
+	return arrLinkStatistics;
+}
+
+
+std::string ClientChannel::getLinkStatus() const
+{
+	std::vector<sLinkStatistics> arrLinkStatistics = getLinkStatistics();
+	std::stringstream strm;
+	strm << "Client channel '" << name << "': " << arrLinkStatistics.size() << " client(s)";
+	for (const sLinkStatistics& stats : arrLinkStatistics)
+	{
+		strm << std::endl << "  " << networkAddressToString(stats.address) << ": " << std::fixed << std::setprecision(2);
+		if (stats.probesAnswered > 0)
+		{
+			strm << "RTT " << stats.rttLast << "ms (avg " << stats.rttAverage << "ms, min " << stats.rttMin << "ms, max " << stats.rttMax << "ms)";
+		}
+		else
+		{
+			strm << "RTT unknown";
+		}
+		strm << ", probes " << stats.probesAnswered << "/" << stats.probesSent;
+		if (stats.framesEchoed > 0)
+		{
+			strm << ", frames " << stats.framesEchoed << " (lost " << std::setprecision(1) << (stats.getLossRate() * 100)
+			     << "%, reordered " << stats.framesReordered << ")";
+		}
+	}
+	return strm.str();
+}
+
+
+void ClientChannel::receiverThread()
+{
+	ThreadMetrics& refMetrics = ThreadTopology::applyToCurrentThread("clients", true);
+
+	char buf[2048];
+	while (running)
+	{
+		sendProbes();
+
+		// interval batches are completed by time, even when the source doesn't deliver frames
+		const std::chrono::steady_clock::duration wait = flushDueBatches(std::chrono::milliseconds(100));
+		const long waitUs = (long) std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+
+		// wake up regularly to check the running flag
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(channelSocket, &readSet);
+		timeval timeout = { 0, std::max(1000L, waitUs) };
+		const std::chrono::steady_clock::time_point tWakeup = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout.tv_usec);
+		const int ready = select((int) channelSocket + 1, &readSet, nullptr, nullptr, &timeout);
+		if (ready == 0)
+		{
+			refMetrics.recordWakeup(std::chrono::steady_clock::now() - tWakeup);
+		}
+		if (ready <= 0) continue;
+
+		sockaddr_in clientAddress;
+		socklen_t   addressLength = sizeof(clientAddress);
+		int received = recvfrom(channelSocket, buf, sizeof(buf) - 1, 0, (sockaddr*) &clientAddress, &addressLength);
+		if (received <= 0) continue;
+
+		// binary feedback or text request?
+		uint16_t iMessage = 0;
+		if (received >= 4) memcpy(&iMessage, buf, sizeof(iMessage));
+		if ((iMessage == NAT_PROBE) || (iMessage == NAT_FRAME_ECHO))
+		{
+			handleFeedback(clientAddress, (const uint8_t*) buf, received);
+			continue;
+		}
+
+		std::string strRequest(buf, received);
+		while (!strRequest.empty() && ((strRequest.back() == '\n') || (strRequest.back() == '\r') || (strRequest.back() == '\0')))
+		{
+			strRequest.pop_back();
+		}
+
+		std::string strResponse = handleRequest(clientAddress, strRequest);
+		sendto(channelSocket, strResponse.c_str(), (int) strResponse.size(), 0, (sockaddr*) &clientAddress, sizeof(clientAddress));
+		if (pWireCapture)
+		{
+			pWireCapture->record(strResponse.c_str(), (int) strResponse.size(), clientAddress);
+		}
+	}
+}
+
+
+std::string ClientChannel::handleRequest(const sockaddr_in& refAddress, const std::string& strRequest)
+{
+	std::string strRequestL;
+	std::transform(strRequest.begin(), strRequest.end(), std::back_inserter(strRequestL), ::tolower);
+	std::istringstream strmRequest(strRequestL);
+	std::string strCommand, strParameter;
+	strmRequest >> strCommand >> strParameter;
+
+	int                       batchFrames = 0;
+	std::chrono::milliseconds batchInterval(0);
+	bool                      events = false;
+
+	if (strCommand == "unsubscribe")
+	{
+		std::lock_guard<std::mutex> lock(mtxClients);
+		auto iter = findClient(refAddress);
+		if (iter != arrClients.end())
+		{
+			LOG_INFO("Client " << networkAddressToString(refAddress) << " of '" << name << "' unsubscribed");
+			assignStatsSlot(refAddress, false);
+			arrClients.erase(iter);
+		}
+		return "OK";
+	}
+	else if (strCommand == "stats")
+	{
+		const sStatsSlot* pSlot = findStatsSlot(refAddress);
+		if (pSlot == nullptr) return "ERROR Not subscribed";
+		sLinkStatistics stats = getLinkStatistics(*pSlot);
+		std::stringstream strm;
+		strm << "OK rtt=" << stats.rttAverage << " rttmin=" << stats.rttMin << " rttmax=" << stats.rttMax
+		     << " probes=" << stats.probesAnswered << "/" << stats.probesSent
+		     << " frames=" << stats.framesEchoed << " lost=" << stats.framesLost << " reordered=" << stats.framesReordered;
+		return strm.str();
+	}
+	else if (strCommand == "history")
+	{
+		return handleHistoryRequest(refAddress, strRequest);
+	}
+	else if (strCommand == "subscribe")
+	{
+		batchFrames = 1;
+	}
+	else if (strCommand == "events")
+	{
+		events = true;
+	}
+	else if ((strCommand == "batch") && !strParameter.empty())
+	{
+		int value = atoi(strParameter.c_str());
+		if ((strParameter.size() > 2) && (strParameter.compare(strParameter.size() - 2, 2, "ms") == 0))
+		{
+			batchInterval = std::chrono::milliseconds(std::max(1, std::min(value, BATCH_MAX_INTERVAL)));
+		}
+		else
+		{
+			batchFrames = std::max(1, std::min(value, BATCH_MAX_FRAMES));
+		}
+	}
+	else
+	{
+		return "ERROR Unknown request '" + strRequest + "'";
+	}
+
+	std::lock_guard<std::mutex> lock(mtxClients);
+	auto iter = findClient(refAddress);
+	if (iter == arrClients.end())
+	{
+		sClient client;
+		client.address       = refAddress;
+		client.frames        = false;
+		client.events        = false;
+		client.batchFrames   = 0;
+		client.batchInterval = std::chrono::milliseconds(0);
+		client.framesInBatch = 0;
+		client.framesSent    = 0;
+		client.datagramsSent = 0;
+		client.eventsSent    = 0;
+		client.batch.reserve(maxDatagramSize);
+		client.batch.resize(BATCH_HEADER_SIZE);
+		arrClients.push_back(client);
+		iter = arrClients.end() - 1;
+		assignStatsSlot(refAddress, true);
+		LOG_INFO("Client " << networkAddressToString(refAddress) << " of '" << name << "' subscribed (" << strRequest << ")");
+	}
+	if (events)
+	{
+		// frame subscription stays as it is
+		iter->events = true;
+	}
+	else
+	{
+		iter->frames        = true;
+		iter->batchFrames   = batchFrames;
+		iter->batchInterval = batchInterval;
+	}
+	iter->lastRequest = std::chrono::steady_clock::now();
+	return "OK";
+}
+
+
+std::chrono::steady_clock::duration ClientChannel::flushDueBatches(std::chrono::steady_clock::duration maxWait)
+{
+	std::lock_guard<std::mutex> lock(mtxClients);
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::chrono::steady_clock::duration wait = maxWait;
+	for (sClient& client : arrClients)
+	{
+		if ((client.framesInBatch == 0) || (client.batchInterval.count() == 0)) continue;
+
+		const std::chrono::steady_clock::time_point tDue = client.batchStart + client.batchInterval;
+		if (now >= tDue)
+		{
+			// outside of a frame > nothing to pace
+			flushBatch(client, false);
+		}
+		else
+		{
+			wait = std::min(wait, std::chrono::steady_clock::duration(tDue - now));
+		}
+	}
+	return wait;
+}
+
+
+void ClientChannel::flushBatch(sClient& refClient, bool paced)
+{
+	// fill in the header
+	uint16_t header[4] = {
+		NAT_FRAMEOFDATA_BATCH,
+		(uint16_t) (refClient.batch.size() - 4),
+		(uint16_t) refClient.framesInBatch,
+		BATCH_ENCODING_COMPACT };
+	memcpy(refClient.batch.data(), header, sizeof(header));
+
+	if (paced && pTransmitPacer)
+	{
+		// paced datagrams are recorded when they actually leave
+		pTransmitPacer->sendTo(channelSocket, (const char*) refClient.batch.data(), (int) refClient.batch.size(),
+			refClient.address, kernelPacing, pWireCapture);
+	}
+	else if ((sendto(channelSocket, (const char*) refClient.batch.data(), (int) refClient.batch.size(), 0,
+		(const sockaddr*) &refClient.address, sizeof(refClient.address)) >= 0) && pWireCapture)
+	{
+		pWireCapture->record(refClient.batch.data(), (int) refClient.batch.size(), refClient.address);
+	}
+
+	refClient.framesSent += refClient.framesInBatch;
+	refClient.datagramsSent++;
+	refClient.framesInBatch = 0;
+	refClient.batch.resize(BATCH_HEADER_SIZE);
+}
+
+
+std::vector<ClientChannel::sClient>::iterator ClientChannel::findClient(const sockaddr_in& refAddress)
+{
+	return std::find_if(arrClients.begin(), arrClients.end(), [&](const sClient& client)
+	{
+		return (client.address.sin_addr.s_addr == refAddress.sin_addr.s_addr) &&
+		       (client.address.sin_port        == refAddress.sin_port);
+	});
+}
+
+
+void ClientChannel::handleFeedback(const sockaddr_in& refAddress, const uint8_t* pData, int size)
+{
+	sStatsSlot* pSlot = findStatsSlot(refAddress);
+	if (pSlot == nullptr) return; // not subscribed
+
+	uint16_t iMessage;
+	memcpy(&iMessage, pData, sizeof(iMessage));
+	if ((iMessage == NAT_PROBE) && (size >= PROBE_SIZE))
+	{
+		int64_t tSent;
+		memcpy(&tSent, pData + 8, sizeof(tSent));
+		const int64_t rtt = (getTimeNs() - tSent) / 1000;
+		if ((rtt < 0) || (rtt > 60000000)) return; // not one of our probes
+
+		const uint32_t rttUs = (uint32_t) rtt;
+		if (pSlot->probesAnswered == 0)
+		{
+			pSlot->rttAverage = rttUs;
+			pSlot->rttMin     = rttUs;
+			pSlot->rttMax     = rttUs;
+		}
+		else
+		{
+			pSlot->rttAverage = (uint32_t) (pSlot->rttAverage * (1 - RTT_AVG_WEIGHT) + rttUs * RTT_AVG_WEIGHT);
+			pSlot->rttMin     = std::min(pSlot->rttMin.load(), rttUs);
+			pSlot->rttMax     = std::max(pSlot->rttMax.load(), rttUs);
+		}
+		pSlot->rttLast = rttUs;
+		pSlot->probesAnswered++;
+	}
+	else if (iMessage == NAT_FRAME_ECHO)
+	{
+		for (int offset = 4; offset + 4 <= size; offset += 4)
+		{
+			int32_t iFrame;
+			memcpy(&iFrame, pData + offset, sizeof(iFrame));
+			const int32_t highest = pSlot->highestFrame;
+			if (pSlot->framesEchoed++ == 0)
+			{
+				pSlot->highestFrame = iFrame;
+			}
+			else if (iFrame > highest)
+			{
+				// frames in between that were actually sent are missing (so far)
+				for (int32_t iMissing = highest + 1; (iMissing < iFrame) && (iMissing - highest <= 1024); iMissing++)
+				{
+					if (arrSentFrames[(uint32_t) iMissing % 1024] == iMissing) pSlot->framesLost++;
+				}
+				pSlot->highestFrame = iFrame;
+			}
+			else if (iFrame < highest)
+			{
+				// late, but not lost
+				pSlot->framesReordered++;
+				if (pSlot->framesLost > 0) pSlot->framesLost--;
+			}
+		}
+	}
+}
+
+
+void ClientChannel::sendProbes()
+{
+	const int64_t now = getTimeNs();
+	for (sStatsSlot& slot : arrStats)
+	{
+		const uint64_t key = slot.key;
+		if ((key == 0) || (now - slot.lastProbe < PROBE_INTERVAL_NS)) continue;
+
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family      = AF_INET;
+		address.sin_addr.s_addr = htonl((uint32_t) (key >> 16));
+		address.sin_port        = htons((uint16_t) (key & 0xFFFF));
+
+		uint8_t  probe[PROBE_SIZE];
+		uint16_t header[2] = { NAT_PROBE, PROBE_SIZE - 4 };
+		uint32_t sequence  = slot.probesSent;
+		memcpy(probe,     header,    sizeof(header));
+		memcpy(probe + 4, &sequence, sizeof(sequence));
+		memcpy(probe + 8, &now,      sizeof(now));
+		sendto(channelSocket, (const char*) probe, sizeof(probe), 0, (const sockaddr*) &address, sizeof(address));
+		if (pWireCapture)
+		{
+			pWireCapture->record(probe, sizeof(probe), address);
+		}
+
+		slot.lastProbe = now;
+		slot.probesSent++;
+	}
+}
+
+
+void ClientChannel::assignStatsSlot(const sockaddr_in& refAddress, bool use)
+{
+	sStatsSlot* pSlot = findStatsSlot(refAddress);
+	if (!use)
+	{
+		if (pSlot) pSlot->key = 0;
+		return;
+	}
+	if (pSlot) return; // already assigned
+
+	for (sStatsSlot& slot : arrStats)
+	{
+		if (slot.key == 0)
+		{
+			slot.lastProbe       = 0;
+			slot.probesSent      = 0;
+			slot.probesAnswered  = 0;
+			slot.rttLast         = 0;
+			slot.rttAverage      = 0;
+			slot.rttMin          = 0;
+			slot.rttMax          = 0;
+			slot.framesEchoed    = 0;
+			slot.framesLost      = 0;
+			slot.framesReordered = 0;
+			slot.highestFrame    = 0;
+			slot.key             = getAddressKey(refAddress); // makes the slot visible
+			return;
+		}
+	}
+	LOG_WARNING("No link statistics for client " << networkAddressToString(refAddress) << " (more than " << CLIENT_MAX_STATS << " clients)");
+}
+
+
+ClientChannel::sStatsSlot* ClientChannel::findStatsSlot(const sockaddr_in& refAddress)
+{
+	const uint64_t key = getAddressKey(refAddress);
+	for (sStatsSlot& slot : arrStats)
+	{
+		if (slot.key == key) return &slot;
+	}
+	return nullptr;
+}
+
+
+const ClientChannel::sStatsSlot* ClientChannel::findStatsSlot(const sockaddr_in& refAddress) const
+{
+	return const_cast<ClientChannel*>(this)->findStatsSlot(refAddress);
+}
+
+
+sLinkStatistics ClientChannel::getLinkStatistics(const sStatsSlot& refSlot) const
+{
+	sLinkStatistics stats;
+	const uint64_t key = refSlot.key;
+	memset(&stats.address, 0, sizeof(stats.address));
+	stats.address.sin_family      = AF_INET;
+	stats.address.sin_addr.s_addr = htonl((uint32_t) (key >> 16));
+	stats.address.sin_port        = htons((uint16_t) (key & 0xFFFF));
+	stats.rttLast         = refSlot.rttLast    / 1000.0f;
+	stats.rttAverage      = refSlot.rttAverage / 1000.0f;
+	stats.rttMin          = refSlot.rttMin     / 1000.0f;
+	stats.rttMax          = refSlot.rttMax     / 1000.0f;
+	stats.probesSent      = refSlot.probesSent;
+	stats.probesAnswered  = refSlot.probesAnswered;
+	stats.framesEchoed    = refSlot.framesEchoed;
+	stats.framesLost      = refSlot.framesLost;
+	stats.framesReordered = refSlot.framesReordered;
+	return stats;
+}
+
+
+std::string ClientChannel::handleHistoryRequest(const sockaddr_in& refAddress, const std::string& strRequest)
+{
+	if ((pFrameHistory == nullptr) || !pFrameHistory->isEnabled()) return "ERROR No frame history";
+
+	std::istringstream strmRequest(strRequest);
+	std::string strCommand, strFilter;
+	double      fromTime, toTime;
+	if (!(strmRequest >> strCommand >> fromTime >> toTime))
+	{
+		return "ERROR Usage: history <from> <to> [filter]";
+	}
+	strmRequest >> strFilter;
+
+	// times <= 0 are relative to the newest frame
+	const double newest = pFrameHistory->getNewestTimestamp();
+	if (fromTime <= 0) fromTime += newest;
+	if (toTime   <= 0) toTime   += newest;
+
+	// forget finished requests
+	for (auto iter = arrHistoryJobs.begin(); iter != arrHistoryJobs.end(); )
+	{
+		if ((*iter)->done)
+		{
+			(*iter)->thread.join();
+			iter = arrHistoryJobs.erase(iter);
+		}
+		else
+		{
+			iter++;
+		}
+	}
+	if (arrHistoryJobs.size() >= HISTORY_MAX_JOBS) return "ERROR Too many history requests";
+
+	// copy the frames now, they might be overwritten while they are sent
+	std::vector<std::vector<uint8_t>> arrFrames;
+	const int count = pFrameHistory->query(fromTime, toTime, arrFrames);
+
+	std::unique_ptr<sHistoryJob> pJob(new sHistoryJob);
+	pJob->done   = false;
+	pJob->thread = std::thread(&ClientChannel::historyThread, this, pJob.get(), refAddress, std::move(arrFrames), pFrameHistory->select(strFilter));
+	arrHistoryJobs.push_back(std::move(pJob));
+
+	LOG_INFO("Sending " << count << " history frames to " << networkAddressToString(refAddress) << " (" << strRequest << ")");
+	return "OK " + std::to_string(count) + " frames";
+}
+
+
+void ClientChannel::historyThread(sHistoryJob* pJob, sockaddr_in address, std::vector<std::vector<uint8_t>> arrFrames, sHistorySelection selection)
+{
+	// separate socket, so the history doesn't queue up behind or in front of the live data
+	SOCKET historySocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (historySocket == INVALID_SOCKET)
+	{
+		LOG_ERROR("Could not create history socket");
+		pJob->done = true;
+		return;
+	}
+
+	CompactEncoder       encoder;
+	std::vector<uint8_t> datagram;
+	int                  framesInDatagram = 0;
+	datagram.reserve(maxDatagramSize);
+	datagram.resize(BATCH_HEADER_SIZE);
+
+	auto sendDatagram = [&]()
+	{
+		uint16_t header[4] = {
+			NAT_FRAMEOFDATA_HISTORY,
+			(uint16_t) (datagram.size() - 4),
+			(uint16_t) framesInDatagram,
+			BATCH_ENCODING_COMPACT };
+		memcpy(datagram.data(), header, sizeof(header));
+		sendto(historySocket, (const char*) datagram.data(), (int) datagram.size(), 0, (const sockaddr*) &address, sizeof(address));
+		if (pWireCapture)
+		{
+			pWireCapture->record(datagram.data(), (int) datagram.size(), address);
+		}
+		datagram.resize(BATCH_HEADER_SIZE);
+		framesInDatagram = 0;
+		std::this_thread::sleep_for(HISTORY_INTERVAL);
+	};
+
+	for (auto& frame : arrFrames)
+	{
+		if (!running) break;
+		if (!FrameHistory::filterFrame(frame, selection, encoder)) continue;
+		if ((int) (BATCH_HEADER_SIZE + 2 + frame.size()) > maxDatagramSize) continue; // can't be sent
+
+		if ((framesInDatagram > 0) && ((int) (datagram.size() + 2 + frame.size()) > maxDatagramSize))
+		{
+			sendDatagram();
+		}
+		const uint16_t size = (uint16_t) frame.size();
+		datagram.insert(datagram.end(), (const uint8_t*) &size, (const uint8_t*) &size + sizeof(size));
+		datagram.insert(datagram.end(), frame.begin(), frame.end());
+		framesInDatagram++;
+	}
+	if (framesInDatagram > 0)
+	{
+		sendDatagram();
+	}
+	sendDatagram(); // end marker
+
+	closesocket(historySocket);
+	pJob->done = true;
+}
@@ -0,0 +1,330 @@
+/**
+ * UDP channel of an output endpoint for clients with individual requirements.
+ *
+ * Clients send text requests to the channel port and receive a text response:
+ *   "subscribe"      receive every frame in its own datagram (same as "batch 1")
+ *   "batch <N>"      receive N consecutive frames per datagram
+ *   "batch <ms>ms"   receive all frames of a time window per datagram (sent when the window is over, even without new frames)
+ *   "events"         receive zone and proximity events (see ZoneEngine.h), in addition to or instead of frames
+ *   "unsubscribe"    stop receiving frames and events
+ *   "stats"          get the link statistics of this client
+ *   "history <from> <to> [filter]"
+ *                    get the frames of a time range from the frame history (see below)
+ * Clients have to repeat their request at least every 30s to stay subscribed.
+ *
+ * The frames are sent in the compact encoding, packed into datagrams with message ID NAT_FRAMEOFDATA_BATCH:
+ *   uint16  message ID, uint16 number of following bytes,
+ *   uint16  number of frames, uint16 encoding (1: compact),
+ *   per frame: uint16 size, followed by a compact frame (see CompactEncoding.h)
+ * Frames that don't fit into a datagram on their own are not sent.
+ *
+ * Link statistics of subscribed clients:
+ *   The server sends a probe datagram every second with message ID NAT_PROBE:
+ *     uint16 message ID, uint16 number of following bytes (12), uint32 sequence number, uint64 server time
+ *   Clients send it back unchanged, which gives the round trip time.
+ *   Optionally, clients can echo the numbers of the received frames with message ID NAT_FRAME_ECHO:
+ *     uint16 message ID, uint16 number of following bytes, int32 frame numbers in the order of reception
+ *   which gives the loss and reordering of frames (including the loss of echo datagrams).
+ *
+ * History requests:
+ *   <from> and <to> are frame timestamps in s, values <= 0 are relative to the newest frame (e.g., "history -5 0").
+ *   The optional filter contains name patterns of rigid bodies and skeletons with '*' and '?', separated by ';'.
+ *   The response "OK <N> frames" is accompanied by datagrams from a separate port with message ID NAT_FRAMEOFDATA_HISTORY,
+ *   with the same layout as batches. They are sent at a limited rate, so the live stream isn't affected.
+ *   A datagram without frames marks the end.
+ */
+
+#pragma once
+
+#include "Network.h"
+#include "CompactEncoding.h"
+#include "TransmitPacer.h"
+#include "WireCapture.h"
+#include "FrameHistory.h"
+#include "ZoneEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// message IDs of batched frames and link statistics (outside of the range used by NatNet)
+#define NAT_FRAMEOFDATA_BATCH 202
+#define NAT_PROBE             205
+#define NAT_FRAME_ECHO        206
+#define NAT_FRAMEOFDATA_HISTORY 207
+
+// maximum number of clients with link statistics per channel
+#define CLIENT_MAX_STATS      64
+
+// encoding of the frames in a batch
+#define BATCH_ENCODING_COMPACT 1
+
+
+/**
+ * Link statistics of a client.
+ */
+struct sLinkStatistics
+{
+	sockaddr_in   address;
+	float         rttLast;         ///< last round trip time in ms
+	float         rttAverage;      ///< moving average of the round trip time in ms
+	float         rttMin, rttMax;  ///< minimum and maximum round trip time in ms
+	unsigned long probesSent;
+	unsigned long probesAnswered;
+	unsigned long framesEchoed;    ///< frames the client reported as received
+	unsigned long framesLost;      ///< frames that were sent, but not reported
+	unsigned long framesReordered; ///< frames that were reported after a later frame
+
+	/**
+	 * Gets the rate of lost frames.
+	 *
+	 * @return the loss rate (0...1)
+	 */
+	float getLossRate() const;
+};
+
+
+/**
+ * Class for the client channel of an endpoint.
+ */
+class ClientChannel
+{
+public:
+
+	/**
+	 * Creates a client channel.
+	 *
+	 * @param strName  the name of the endpoint (for logging)
+	 */
+	ClientChannel(const std::string& strName);
+
+	/**
+	 * Stops and destroys the client channel.
+	 */
+	~ClientChannel();
+
+	/**
+	 * Sets the pacer for the frame datagrams. Must be called before start().
+	 *
+	 * @param pPacer  the pacer to use (<code>nullptr</code>: no pacing)
+	 */
+	void setTransmitPacer(TransmitPacer* pPacer);
+
+	/**
+	 * Sets the capture that records all outgoing datagrams.
+	 *
+	 * @param pCapture  the capture to use (<code>nullptr</code>: no recording)
+	 */
+	void setWireCapture(WireCapture* pCapture);
+
+	/**
+	 * Sets the frame history for history requests.
+	 *
+	 * @param pHistory  the frame history (<code>nullptr</code>: no history requests)
+	 */
+	void setFrameHistory(FrameHistory* pHistory);
+
+	/**
+	 * Opens the channel and starts receiving requests.
+	 *
+	 * @param strAddress       the local address to bind to
+	 * @param port             the port to listen on
+	 * @param maxDatagramSize  the maximum size of a datagram with frame data
+	 *
+	 * @return <code>true</code> if the channel was opened
+	 */
+	bool start(const std::string& strAddress, int port, int maxDatagramSize);
+
+	/**
+	 * Closes the channel.
+	 */
+	void stop();
+
+	/**
+	 * Adds a frame to the batches of all subscribed clients and sends the batches that are complete.
+	 *
+	 * @param refFrame               the frame to send
+	 * @param descriptionGeneration  the generation of the scene description
+	 * @param refEncoder             the encoder to use
+	 */
+	void sendFrame(const sFrameOfMocapData& refFrame, uint32_t descriptionGeneration, CompactEncoder& refEncoder);
+
+	/**
+	 * Sends zone and proximity events to all clients that requested them.
+	 *
+	 * @param refFrame   the frame the events belong to
+	 * @param arrEvents  the events to send
+	 */
+	void sendEvents(const sFrameOfMocapData& refFrame, const std::vector<sZoneEvent>& arrEvents);
+
+	/**
+	 * Gets a printable summary of the subscribed clients.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+	/**
+	 * Gets the link statistics of all subscribed clients.
+	 * This function doesn't block the sending or receiving of data.
+	 *
+	 * @return the statistics per client
+	 */
+	std::vector<sLinkStatistics> getLinkStatistics() const;
+
+	/**
+	 * Gets a printable summary of the link statistics of all subscribed clients.
+	 *
+	 * @return the summary text
+	 */
+	std::string getLinkStatus() const;
+
+private:
+
+	/**
+	 * Information about a subscribed client.
+	 */
+	struct sClient
+	{
+		sockaddr_in                           address;
+		bool                                  frames;        // client requested frames
+		bool                                  events;        // client requested zone events
+		int                                   batchFrames;   // frames per batch (0: use the interval)
+		std::chrono::milliseconds             batchInterval; // duration of a batch (0: use the frame count)
+		std::chrono::steady_clock::time_point lastRequest;
+		std::chrono::steady_clock::time_point batchStart;
+		std::vector<uint8_t>                  batch;
+		int                                   framesInBatch;
+		unsigned long                         framesSent;
+		unsigned long                         datagramsSent;
+		unsigned long                         eventsSent;
+	};
+
+	/**
+	 * Link statistics of a client that can be updated and read without locking.
+	 * Each field is only written by one thread.
+	 */
+	struct sStatsSlot
+	{
+		std::atomic<uint64_t> key;              // address and port of the client (0: free slot)
+		std::atomic<int64_t>  lastProbe;        // time of the last probe in ns
+		std::atomic<uint32_t> probesSent, probesAnswered;
+		std::atomic<uint32_t> rttLast, rttAverage, rttMin, rttMax; // in us
+		std::atomic<uint32_t> framesEchoed, framesLost, framesReordered;
+		std::atomic<int32_t>  highestFrame;     // highest echoed frame number
+	};
+
+	/**
+	 * Thread that sends the result of a history request.
+	 */
+	struct sHistoryJob
+	{
+		std::thread       thread;
+		std::atomic<bool> done;
+	};
+
+	void receiverThread();
+
+	/**
+	 * Handles a request from a client.
+	 *
+	 * @param refAddress  the address of the client
+	 * @param strRequest  the request text
+	 *
+	 * @return the response text
+	 */
+	std::string handleRequest(const sockaddr_in& refAddress, const std::string& strRequest);
+
+	/**
+	 * Sends the batch of a client and starts a new one.
+	 *
+	 * @param refClient  the client
+	 * @param paced      <code>true</code> if the batch is sent as part of a frame and is to be paced
+	 */
+	void flushBatch(sClient& refClient, bool paced);
+
+	/**
+	 * Sends the interval batches whose time is up.
+	 *
+	 * @param maxWait  the longest time to return
+	 *
+	 * @return the time until the next interval batch is due, at most maxWait
+	 */
+	std::chrono::steady_clock::duration flushDueBatches(std::chrono::steady_clock::duration maxWait);
+
+	std::vector<sClient>::iterator findClient(const sockaddr_in& refAddress);
+
+	/**
+	 * Handles a probe reply or a frame echo from a client.
+	 *
+	 * @param refAddress  the address of the client
+	 * @param pData       the received datagram
+	 * @param size        the size of the datagram
+	 */
+	void handleFeedback(const sockaddr_in& refAddress, const uint8_t* pData, int size);
+
+	/**
+	 * Sends probes to the clients that are due.
+	 */
+	void sendProbes();
+
+	/**
+	 * Assigns or releases the statistics slot of a client.
+	 *
+	 * @param refAddress  the address of the client
+	 * @param use         <code>true</code> to assign a slot, <code>false</code> to release it
+	 */
+	void assignStatsSlot(const sockaddr_in& refAddress, bool use);
+
+	sStatsSlot* findStatsSlot(const sockaddr_in& refAddress);
+	const sStatsSlot* findStatsSlot(const sockaddr_in& refAddress) const;
+
+	sLinkStatistics getLinkStatistics(const sStatsSlot& refSlot) const;
+
+	/**
+	 * Handles a history request.
+	 *
+	 * @param refAddress  the address of the client
+	 * @param strRequest  the request text
+	 *
+	 * @return the response text
+	 */
+	std::string handleHistoryRequest(const sockaddr_in& refAddress, const std::string& strRequest);
+
+	/**
+	 * Sends frames from the history to a client at a limited rate.
+	 *
+	 * @param pJob        the job of this thread
+	 * @param address     the address of the client
+	 * @param arrFrames   the compact frames to send
+	 * @param selection   the entities to send
+	 */
+	void historyThread(sHistoryJob* pJob, sockaddr_in address, std::vector<std::vector<uint8_t>> arrFrames, sHistorySelection selection);
+
+private:
+
+	std::string           name;
+	SOCKET                channelSocket;
+	int                   maxDatagramSize;
+	TransmitPacer*        pTransmitPacer;
+	bool                  kernelPacing;    // launch times are enabled on the socket
+	WireCapture*          pWireCapture;
+	FrameHistory*         pFrameHistory;
+	std::vector<std::unique_ptr<sHistoryJob>> arrHistoryJobs;
+	std::thread           thread;
+	std::atomic<bool>     running;
+
+	mutable std::mutex    mtxClients;
+	std::vector<sClient>  arrClients;
+	std::vector<uint8_t>  frameBuffer; // encoded frame, shared by all clients
+	unsigned long         framesOversize; // frames too large for a datagram
+
+	sStatsSlot            arrStats[CLIENT_MAX_STATS];
+	std::atomic<int32_t>  arrSentFrames[1024]; // numbers of the recently sent frames, by number modulo size
+};
@@ -0,0 +1,322 @@
+#include "ClockService.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "ClockService"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#ifndef WIN32
+	#include <fcntl.h>
+	#include <time.h>
+	#include <unistd.h>
+#endif
+
+
+// how often the reference clock is read (in s)
+#define DISCIPLINE_INTERVAL  1.0
+// offsets larger than this are corrected in one step instead of slewing (in s)
+#define DISCIPLINE_STEP      0.5
+// gains of the PI controller for offset and frequency
+#define DISCIPLINE_KP        0.1
+#define DISCIPLINE_KI        0.01
+// maximum frequency correction (relative)
+#define DISCIPLINE_MAX_FREQ  500e-6
+
+
+/******************************************************************************
+ * Reference clocks
+ */
+
+/**
+ * Host wall clock as reference, e.g., when the host is synchronised via NTP or phc2sys.
+ */
+class SystemClockReference : public ClockReference
+{
+public:
+
+	virtual std::string getName() const
+	{
+		return "system";
+	}
+
+	virtual bool getTime(double& refSeconds)
+	{
+		refSeconds = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+		return true;
+	}
+};
+
+
+#ifndef WIN32
+
+/**
+ * PTP hardware clock of a network interface (Linux only).
+ */
+class PtpClockReference : public ClockReference
+{
+public:
+
+	PtpClockReference(const std::string& strDevice, double taiOffset) :
+		strDevice(strDevice),
+		taiOffset(taiOffset)
+	{
+		fd = open(strDevice.c_str(), O_RDONLY);
+	}
+
+	virtual ~PtpClockReference()
+	{
+		if (fd >= 0) close(fd);
+	}
+
+	bool isOpen() const
+	{
+		return (fd >= 0);
+	}
+
+	virtual std::string getName() const
+	{
+		return "ptp:" + strDevice;
+	}
+
+	virtual bool getTime(double& refSeconds)
+	{
+		// dynamic clock ID of the device (see FD_TO_CLOCKID in the kernel documentation)
+		clockid_t clockId = ((~(clockid_t) fd) << 3) | 3;
+		timespec  ts;
+		if (clock_gettime(clockId, &ts) != 0) return false;
+		// PTP clocks run on TAI, which is ahead of UTC by the leap seconds
+		refSeconds = ts.tv_sec + ts.tv_nsec * 1e-9 - taiOffset;
+		return true;
+	}
+
+private:
+
+	std::string strDevice;
+	double      taiOffset;  // in s
+	int         fd;
+};
+
+#endif
+
+
+
+/******************************************************************************
+ * ClockService class
+ */
+
+ClockService::ClockService() :
+	pReference(nullptr),
+	timecodeRate(30)
+{
+	reset();
+}
+
+
+ClockService::~ClockService()
+{
+	delete pReference;
+}
+
+
+bool ClockService::setReference(const std::string& strReference, double taiOffset)
+{
+	ClockReference* pNewReference = nullptr;
+
+	if (strReference == "none")
+	{
+		// free running
+	}
+	else if (strReference == "system")
+	{
+		pNewReference = new SystemClockReference();
+	}
+	else if (strReference.compare(0, 3, "ptp") == 0)
+	{
+#ifdef WIN32
+		LOG_ERROR("PTP hardware clocks are not supported on this platform");
+		return false;
+#else
+		std::string strDevice = (strReference.size() > 4) ? strReference.substr(4) : "/dev/ptp0";
+		PtpClockReference* pPtp = new PtpClockReference(strDevice, taiOffset);
+		if (!pPtp->isOpen())
+		{
+			LOG_ERROR("Could not open PTP clock '" << strDevice << "'");
+			delete pPtp;
+			return false;
+		}
+		pNewReference = pPtp;
+		LOG_INFO("TAI offset of the PTP clock: " << taiOffset << "s");
+#endif
+	}
+	else
+	{
+		LOG_ERROR("Invalid clock reference '" << strReference << "'");
+		return false;
+	}
+
+	delete pReference;
+	pReference   = pNewReference;
+	synchronised = false;
+	if (pReference)
+	{
+		LOG_INFO("Clock reference: " << pReference->getName());
+	}
+	return true;
+}
+
+
+void ClockService::setTimecodeRate(int rate)
+{
+	timecodeRate = std::max(1, std::min(rate, 255));
+}
+
+
+void ClockService::reset()
+{
+	tEpoch       = tClock::now();
+	monoBase     = 0;
+	wallBase     = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	frequency    = 0;
+	tLastSample  = tEpoch;
+	synchronised = false;
+	lastError    = 0;
+	samples      = 0;
+	steps        = 0;
+}
+
+
+void ClockService::stampFrame(sFrameOfMocapData& refFrame, float frameRate)
+{
+	// capture time: the source reports how long ago the frame was captured
+	tClock::time_point tCapture = tClock::now();
+	if (refFrame.fLatency > 0)
+	{
+		tCapture -= std::chrono::duration_cast<tClock::duration>(std::chrono::duration<double>(refFrame.fLatency));
+	}
+	stampFrame(refFrame, tCapture, frameRate);
+}
+
+
+void ClockService::stampFrame(sFrameOfMocapData& refFrame, tClock::time_point tCapture, float frameRate)
+{
+	const tClock::time_point now = tClock::now();
+
+	if (pReference && (!synchronised || (std::chrono::duration<double>(now - tLastSample).count() >= DISCIPLINE_INTERVAL)))
+	{
+		discipline(now);
+	}
+
+	const double captureTime = std::chrono::duration<double>(tCapture - tEpoch).count();
+	refFrame.fTimestamp = captureTime;
+
+	// SMPTE timecode from the local time of day of the capture
+	double     wallTime = toWallClock(captureTime);
+	time_t     seconds  = (time_t) floor(wallTime);
+	double     fraction = wallTime - (double) seconds;
+	struct tm  timeOfDay;
+#ifdef WIN32
+	localtime_s(&timeOfDay, &seconds);
+#else
+	localtime_r(&seconds, &timeOfDay);
+#endif
+	const int tcFrame = std::min((int) (fraction * timecodeRate), timecodeRate - 1);
+
+	refFrame.Timecode =
+		((timeOfDay.tm_hour & 0xFF) << 24) |
+		((timeOfDay.tm_min  & 0xFF) << 16) |
+		((timeOfDay.tm_sec  & 0xFF) <<  8) |
+		(tcFrame & 0xFF);
+
+	// subframe: index of the MoCap frame within the timecode frame
+	const double subframesPerFrame = std::max(1.0, (double) frameRate / timecodeRate);
+	const double tcFraction        = fraction * timecodeRate - tcFrame;
+	refFrame.TimecodeSubframe = (unsigned int) std::min(tcFraction * subframesPerFrame, subframesPerFrame - 1);
+}
+
+
+double ClockService::getMonotonicTime() const
+{
+	return std::chrono::duration<double>(tClock::now() - tEpoch).count();
+}
+
+
+double ClockService::toWallClock(double monotonicTime) const
+{
+	return wallBase + (monotonicTime - monoBase) * (1.0 + frequency);
+}
+
+
+std::string ClockService::getStatus() const
+{
+	double monotonicTime = getMonotonicTime();
+	double wallTime      = toWallClock(monotonicTime);
+
+	std::stringstream strm;
+	strm << std::fixed
+	     << "Monotonic time : " << std::setprecision(6) << monotonicTime << "s" << std::endl
+	     << "Wall clock     : " << std::setprecision(6) << wallTime << "s since 1970-01-01" << std::endl
+	     << "Timecode rate  : " << timecodeRate << "fps" << std::endl
+	     << "Reference      : " << (pReference ? pReference->getName() : "none (free running)");
+	if (pReference)
+	{
+		strm << std::endl
+		     << "Synchronised   : " << (synchronised ? "yes" : "no") << std::endl
+		     << "Last offset    : " << std::setprecision(3) << (lastError * 1e6) << "us" << std::endl
+		     << "Frequency      : " << std::setprecision(3) << (frequency * 1e6) << "ppm" << std::endl
+		     << "Samples/steps  : " << samples << "/" << steps;
+	}
+	return strm.str();
+}
+
+
+std::string ClockService::timecodeToString(unsigned int timecode, unsigned int subframe)
+{
+	std::stringstream strm;
+	strm << std::setfill('0')
+	     << std::setw(2) << ((timecode >> 24) & 0xFF) << ":"
+	     << std::setw(2) << ((timecode >> 16) & 0xFF) << ":"
+	     << std::setw(2) << ((timecode >>  8) & 0xFF) << ":"
+	     << std::setw(2) << ( timecode        & 0xFF) << "."
+	     << subframe;
+	return strm.str();
+}
+
+
+void ClockService::discipline(tClock::time_point now)
+{
+	double referenceTime;
+	if (!pReference->getTime(referenceTime)) return;
+
+	const double monotonicTime = std::chrono::duration<double>(now - tEpoch).count();
+	const double interval      = std::chrono::duration<double>(now - tLastSample).count();
+	const double currentTime   = toWallClock(monotonicTime);
+	const double error         = referenceTime - currentTime;
+
+	if (!synchronised || (fabs(error) > DISCIPLINE_STEP))
+	{
+		// first sample or too far off > step the mapping
+		wallBase = referenceTime;
+		if (synchronised)
+		{
+			LOG_WARNING("Clock stepped by " << (int) (error * 1000) << "ms to reference " << pReference->getName());
+		}
+		synchronised = true;
+		steps++;
+	}
+	else
+	{
+		// slew: correct part of the offset now and adjust the rate for the future
+		wallBase   = currentTime + DISCIPLINE_KP * error;
+		frequency += DISCIPLINE_KI * error / std::max(interval, DISCIPLINE_INTERVAL);
+		frequency  = std::max(-DISCIPLINE_MAX_FREQ, std::min(frequency, DISCIPLINE_MAX_FREQ));
+	}
+	monoBase    = monotonicTime;
+	tLastSample = now;
+	lastError   = error;
+	samples++;
+}
@@ -0,0 +1,150 @@
+/**
+ * Central clock that stamps each frame with a monotonic capture time and an SMPTE timecode.
+ * The mapping of the monotonic time to the wall clock can be disciplined against a reference clock.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <chrono>
+#include <string>
+
+
+/**
+ * Interface for reference clocks to discipline the wall clock mapping against.
+ */
+class ClockReference
+{
+public:
+
+	virtual ~ClockReference() {}
+
+	/**
+	 * Gets the name of the reference clock.
+	 *
+	 * @return the name of the reference
+	 */
+	virtual std::string getName() const = 0;
+
+	/**
+	 * Reads the reference clock.
+	 *
+	 * @param refSeconds  the reference time in seconds since the Unix epoch
+	 *
+	 * @return <code>true</code> if the clock could be read
+	 */
+	virtual bool getTime(double& refSeconds) = 0;
+};
+
+
+/**
+ * Class for generating frame timestamps and timecodes.
+ */
+class ClockService
+{
+public:
+
+	typedef std::chrono::steady_clock tClock;
+
+	ClockService();
+
+	~ClockService();
+
+	/**
+	 * Selects the reference clock for disciplining the wall clock mapping.
+	 *
+	 * @param strReference  "none" (free running), "system" (host wall clock, e.g., synchronised via NTP or phc2sys),
+	 *                      or "ptp[:device]" (PTP hardware clock, Linux only, default device /dev/ptp0)
+	 * @param taiOffset     offset of TAI to UTC in s for PTP clocks (37s since 2017)
+	 *
+	 * @return <code>true</code> if the reference is valid
+	 */
+	bool setReference(const std::string& strReference, double taiOffset);
+
+	/**
+	 * Sets the frame rate of the generated SMPTE timecode.
+	 *
+	 * @param rate  the timecode rate in frames per second (e.g., 24, 25, 30)
+	 */
+	void setTimecodeRate(int rate);
+
+	/**
+	 * Starts a new epoch for the monotonic timestamps and resets the wall clock mapping.
+	 */
+	void reset();
+
+	/**
+	 * Fills in the timestamp and timecode of a frame.
+	 * The capture time is the current time minus the latency reported by the source.
+	 *
+	 * @param refFrame   the frame to stamp
+	 * @param frameRate  the frame rate of the source (for the timecode subframe)
+	 */
+	void stampFrame(sFrameOfMocapData& refFrame, float frameRate);
+
+	/**
+	 * Fills in the timestamp and timecode of a frame with a capture time given by the source.
+	 *
+	 * @param refFrame   the frame to stamp
+	 * @param tCapture   the time the frame was captured
+	 * @param frameRate  the frame rate of the source (for the timecode subframe)
+	 */
+	void stampFrame(sFrameOfMocapData& refFrame, tClock::time_point tCapture, float frameRate);
+
+	/**
+	 * Gets the current monotonic time.
+	 *
+	 * @return the time in seconds since the start of the epoch
+	 */
+	double getMonotonicTime() const;
+
+	/**
+	 * Converts a monotonic time into wall clock time.
+	 *
+	 * @param monotonicTime  the time in seconds since the start of the epoch
+	 *
+	 * @return the wall clock time in seconds since the Unix epoch
+	 */
+	double toWallClock(double monotonicTime) const;
+
+	/**
+	 * Gets a printable summary of the clock state.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+	/**
+	 * Converts a timecode of a frame into a printable "hh:mm:ss:ff.sub" string.
+	 *
+	 * @param timecode  the packed timecode
+	 * @param subframe  the timecode subframe
+	 *
+	 * @return the timecode string
+	 */
+	static std::string timecodeToString(unsigned int timecode, unsigned int subframe);
+
+private:
+
+	void discipline(tClock::time_point now);
+
+private:
+
+	ClockReference*    pReference;
+	int                timecodeRate;
+
+	tClock::time_point tEpoch;           // start of the monotonic timestamps
+
+	// wall clock mapping: wall = wallBase + (monotonic - monoBase) * (1 + frequency)
+	double             monoBase;
+	double             wallBase;
+	double             frequency;        // correction of the rate of the monotonic clock (relative)
+
+	// discipline state
+	tClock::time_point tLastSample;
+	bool               synchronised;
+	double             lastError;        // in s
+	unsigned long      samples;
+	unsigned long      steps;
+};
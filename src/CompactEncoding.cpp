@@ -0,0 +1,303 @@
+#include "CompactEncoding.h"
+#include "MoCapData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+
+// size of the fixed part of the header
+#define COMPACT_HEADER_SIZE (1 + 1 + 2 + 2 + 2 + 4 + 8 + 4 + 4 + 4 + 4)
+
+// range of the quaternion components that are transmitted (the omitted one is the largest)
+#define QUAT_COMPONENT_MAX  0.70710678f
+#define QUAT_COMPONENT_BITS 10
+#define QUAT_COMPONENT_MASK ((1 << QUAT_COMPONENT_BITS) - 1)
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+template<typename T> static void writeValue(uint8_t*& pBuffer, T value)
+{
+	memcpy(pBuffer, &value, sizeof(T));
+	pBuffer += sizeof(T);
+}
+
+
+template<typename T> static T readValue(const uint8_t*& pBuffer)
+{
+	T value;
+	memcpy(&value, pBuffer, sizeof(T));
+	pBuffer += sizeof(T);
+	return value;
+}
+
+
+
+/******************************************************************************
+ * CompactEncoder class
+ */
+
+CompactEncoder::CompactEncoder(float resolution, int positionBits) :
+	resolution(resolution > 0 ? resolution : 0.0001f),
+	positionBits((positionBits == 16) ? 16 : 32)
+{
+	// nothing else to do
+}
+
+
+int CompactEncoder::getEncodedSize(int nSkeletons, int nEntities, int positionBits)
+{
+	return COMPACT_HEADER_SIZE
+		+ nSkeletons * (4 + 2)
+		+ nEntities  * (4 + 3 * (positionBits / 8) + 4)
+		+ (nEntities + 7) / 8;
+}
+
+
+int CompactEncoder::encode(const sFrameOfMocapData& refFrame, uint32_t descriptionGeneration, uint8_t* pBuffer, int bufferSize)
+{
+	gatherEntities(refFrame);
+	quantiseEntities();
+
+	const int nEntities = (int) arrId.size();
+	const int size      = getEncodedSize(refFrame.nSkeletons, nEntities, positionBits);
+	if (size > bufferSize) return 0;
+
+	uint8_t* pWrite = pBuffer;
+	writeValue<uint8_t>( pWrite, COMPACT_ENCODING_VERSION);
+	writeValue<uint8_t>( pWrite, (uint8_t) positionBits);
+	writeValue<uint16_t>(pWrite, (uint16_t) refFrame.nRigidBodies);
+	writeValue<uint16_t>(pWrite, (uint16_t) refFrame.nSkeletons);
+	writeValue<uint16_t>(pWrite, (uint16_t) nEntities);
+	writeValue<int32_t>( pWrite, refFrame.iFrame);
+	writeValue<double>(  pWrite, refFrame.fTimestamp);
+	writeValue<uint32_t>(pWrite, refFrame.Timecode);
+	writeValue<uint32_t>(pWrite, refFrame.TimecodeSubframe);
+	writeValue<uint32_t>(pWrite, descriptionGeneration);
+	writeValue<float>(   pWrite, resolution);
+
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		writeValue<int32_t>( pWrite, refFrame.Skeletons[skIdx].skeletonID);
+		writeValue<uint16_t>(pWrite, (uint16_t) refFrame.Skeletons[skIdx].nRigidBodies);
+	}
+
+	memcpy(pWrite, arrId.data(), nEntities * sizeof(int32_t));
+	pWrite += nEntities * sizeof(int32_t);
+
+	const std::vector<int32_t>* arrPositions[] = { &arrPosX, &arrPosY, &arrPosZ };
+	for (auto pPositions : arrPositions)
+	{
+		if (positionBits == 16)
+		{
+			for (int idx = 0; idx < nEntities; idx++) { writeValue<int16_t>(pWrite, (int16_t) (*pPositions)[idx]); }
+		}
+		else
+		{
+			memcpy(pWrite, pPositions->data(), nEntities * sizeof(int32_t));
+			pWrite += nEntities * sizeof(int32_t);
+		}
+	}
+
+	memcpy(pWrite, arrQuat.data(), nEntities * sizeof(uint32_t));
+	pWrite += nEntities * sizeof(uint32_t);
+
+	// tracking flags: 8 entities per byte
+	memset(pWrite, 0, (nEntities + 7) / 8);
+	for (int idx = 0; idx < nEntities; idx++)
+	{
+		pWrite[idx >> 3] |= (arrTracked[idx] << (idx & 7));
+	}
+	pWrite += (nEntities + 7) / 8;
+
+	return (int) (pWrite - pBuffer);
+}
+
+
+bool CompactEncoder::decode(const uint8_t* pBuffer, int size, sCompactFrame& refFrame)
+{
+	if (size < COMPACT_HEADER_SIZE) return false;
+
+	const uint8_t* pRead = pBuffer;
+	if (readValue<uint8_t>(pRead) != COMPACT_ENCODING_VERSION) return false;
+	const int bits = readValue<uint8_t>(pRead);
+	if ((bits != 16) && (bits != 32)) return false;
+
+	refFrame.nRigidBodies          = readValue<uint16_t>(pRead);
+	const int nSkeletons           = readValue<uint16_t>(pRead);
+	const int nEntities            = readValue<uint16_t>(pRead);
+	refFrame.iFrame                = readValue<int32_t>(pRead);
+	refFrame.timestamp             = readValue<double>(pRead);
+	refFrame.timecode              = readValue<uint32_t>(pRead);
+	refFrame.timecodeSubframe      = readValue<uint32_t>(pRead);
+	refFrame.descriptionGeneration = readValue<uint32_t>(pRead);
+	const float res                = readValue<float>(pRead);
+
+	if (size < getEncodedSize(nSkeletons, nEntities, bits)) return false;
+
+	refFrame.arrSkeletonId.resize(nSkeletons);
+	refFrame.arrSkeletonBones.resize(nSkeletons);
+	for (int skIdx = 0; skIdx < nSkeletons; skIdx++)
+	{
+		refFrame.arrSkeletonId[skIdx]    = readValue<int32_t>(pRead);
+		refFrame.arrSkeletonBones[skIdx] = readValue<uint16_t>(pRead);
+	}
+
+	refFrame.arrId.resize(nEntities);
+	memcpy(refFrame.arrId.data(), pRead, nEntities * sizeof(int32_t));
+	pRead += nEntities * sizeof(int32_t);
+
+	std::vector<float>* arrPositions[] = { &refFrame.arrX, &refFrame.arrY, &refFrame.arrZ };
+	for (auto pPositions : arrPositions)
+	{
+		pPositions->resize(nEntities);
+		float* pPos = pPositions->data();
+		if (bits == 16)
+		{
+			for (int idx = 0; idx < nEntities; idx++) { pPos[idx] = readValue<int16_t>(pRead) * res; }
+		}
+		else
+		{
+			for (int idx = 0; idx < nEntities; idx++) { pPos[idx] = readValue<int32_t>(pRead) * res; }
+		}
+	}
+
+	refFrame.arrQX.resize(nEntities);
+	refFrame.arrQY.resize(nEntities);
+	refFrame.arrQZ.resize(nEntities);
+	refFrame.arrQW.resize(nEntities);
+	const float scale = 2 * QUAT_COMPONENT_MAX / QUAT_COMPONENT_MASK;
+	for (int idx = 0; idx < nEntities; idx++)
+	{
+		const uint32_t packed  = readValue<uint32_t>(pRead);
+		const int      largest = packed >> 30;
+		float q[4];
+		float sum = 0;
+		for (int cIdx = 0, shift = 20; cIdx < 4; cIdx++)
+		{
+			if (cIdx == largest) continue;
+			q[cIdx] = ((packed >> shift) & QUAT_COMPONENT_MASK) * scale - QUAT_COMPONENT_MAX;
+			sum    += q[cIdx] * q[cIdx];
+			shift  -= QUAT_COMPONENT_BITS;
+		}
+		q[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+
+		refFrame.arrQX[idx] = q[0];
+		refFrame.arrQY[idx] = q[1];
+		refFrame.arrQZ[idx] = q[2];
+		refFrame.arrQW[idx] = q[3];
+	}
+
+	refFrame.arrTracked.resize(nEntities);
+	for (int idx = 0; idx < nEntities; idx++)
+	{
+		refFrame.arrTracked[idx] = (pRead[idx >> 3] >> (idx & 7)) & 1;
+	}
+
+	return true;
+}
+
+
+void CompactEncoder::gatherEntities(const sFrameOfMocapData& refFrame)
+{
+	int nEntities = refFrame.nRigidBodies;
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		nEntities += refFrame.Skeletons[skIdx].nRigidBodies;
+	}
+
+	arrId.resize(nEntities);
+	arrX.resize(nEntities);  arrY.resize(nEntities);  arrZ.resize(nEntities);
+	arrQX.resize(nEntities); arrQY.resize(nEntities); arrQZ.resize(nEntities); arrQW.resize(nEntities);
+	arrTracked.resize(nEntities);
+
+	// rigid bodies first, then the bones of all skeletons
+	int eIdx = 0;
+	auto gather = [&](const sRigidBodyData& rb)
+	{
+		arrId[eIdx]      = rb.ID;
+		arrX[eIdx]       = rb.x;  arrY[eIdx]  = rb.y;  arrZ[eIdx]  = rb.z;
+		arrQX[eIdx]      = rb.qx; arrQY[eIdx] = rb.qy; arrQZ[eIdx] = rb.qz; arrQW[eIdx] = rb.qw;
+		arrTracked[eIdx] = ((rb.params & STATUS_TRACKED) != 0) ? 1 : 0;
+		eIdx++;
+	};
+
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		gather(refFrame.RigidBodies[rbIdx]);
+	}
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		const sSkeletonData& skeleton = refFrame.Skeletons[skIdx];
+		for (int bIdx = 0; bIdx < skeleton.nRigidBodies; bIdx++)
+		{
+			gather(skeleton.RigidBodyData[bIdx]);
+		}
+	}
+}
+
+
+void CompactEncoder::quantiseEntities()
+{
+	const int   nEntities = (int) arrId.size();
+	const float scale     = 1.0f / resolution;
+	const float limit     = (positionBits == 16) ? 32767.0f : 2147483520.0f; // largest float below 2^31
+
+	arrPosX.resize(nEntities);
+	arrPosY.resize(nEntities);
+	arrPosZ.resize(nEntities);
+	arrQuat.resize(nEntities);
+
+	// positions: scale, round, and clamp (branch free loops)
+	const float*   arrIn[]  = { arrX.data(),    arrY.data(),    arrZ.data()    };
+	int32_t*       arrOut[] = { arrPosX.data(), arrPosY.data(), arrPosZ.data() };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float* pIn  = arrIn[axis];
+		int32_t*     pOut = arrOut[axis];
+		for (int idx = 0; idx < nEntities; idx++)
+		{
+			float value = pIn[idx] * scale;
+			value = std::min(std::max(value, -limit), limit);
+			pOut[idx] = (int32_t) (value + ((value >= 0) ? 0.5f : -0.5f));
+		}
+	}
+
+	// orientations: smallest three
+	const float* pQX = arrQX.data();
+	const float* pQY = arrQY.data();
+	const float* pQZ = arrQZ.data();
+	const float* pQW = arrQW.data();
+	uint32_t*    pQuat = arrQuat.data();
+	const float  quatScale = QUAT_COMPONENT_MASK / (2 * QUAT_COMPONENT_MAX);
+	for (int idx = 0; idx < nEntities; idx++)
+	{
+		float q[4] = { pQX[idx], pQY[idx], pQZ[idx], pQW[idx] };
+
+		// normalise (also catches invalid all-zero quaternions of lost bodies)
+		float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		if (length < 1e-6f) { q[0] = q[1] = q[2] = 0; q[3] = 1; length = 1; }
+		const float invLength = 1.0f / length;
+
+		// find the largest component and make it positive (q and -q are the same rotation)
+		int largest = 0;
+		for (int cIdx = 1; cIdx < 4; cIdx++)
+		{
+			if (fabsf(q[cIdx]) > fabsf(q[largest])) largest = cIdx;
+		}
+		const float sign = ((q[largest] < 0) ? -1.0f : 1.0f) * invLength;
+
+		uint32_t packed = ((uint32_t) largest) << 30;
+		for (int cIdx = 0, shift = 20; cIdx < 4; cIdx++)
+		{
+			if (cIdx == largest) continue;
+			float value = std::min(std::max(q[cIdx] * sign, -QUAT_COMPONENT_MAX), QUAT_COMPONENT_MAX);
+			packed |= ((uint32_t) ((value + QUAT_COMPONENT_MAX) * quatScale + 0.5f)) << shift;
+			shift  -= QUAT_COMPONENT_BITS;
+		}
+		pQuat[idx] = packed;
+	}
+}
@@ -0,0 +1,134 @@
+/**
+ * Compact wire encoding for rigid body and skeleton poses.
+ *
+ * Positions are quantised to fixed-point numbers (16 or 32 bit) at a configurable resolution,
+ * orientations are packed into 32 bit with the "smallest three" method,
+ * and the tracking flags are packed into a bit field.
+ * Marker data is not part of the compact encoding.
+ *
+ * Layout of a packet with message ID NAT_FRAMEOFDATA_COMPACT (little endian, no padding):
+ *   uint8   version
+ *   uint8   position bits (16 or 32)
+ *   uint16  number of rigid bodies
+ *   uint16  number of skeletons
+ *   uint16  number of entities (rigid bodies, followed by the bones of all skeletons)
+ *   int32   frame number
+ *   double  timestamp
+ *   uint32  timecode, uint32 timecode subframe
+ *   uint32  description generation
+ *   float   position resolution in units per step
+ *   per skeleton:  int32 ID, uint16 number of bones
+ *   per entity:    int32 ID
+ *   per entity:    int16/int32 X, then all Y, then all Z
+ *   per entity:    uint32 orientation (bits 31-30: index of the omitted component, 3x10 bits: other components)
+ *   per entity:    1 bit tracking flag (LSB first)
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// message ID of compact frames (outside of the range used by NatNet)
+#define NAT_FRAMEOFDATA_COMPACT 201
+
+// version of the compact encoding
+#define COMPACT_ENCODING_VERSION 1
+
+
+/**
+ * Decoded compact frame with all entities in separate arrays.
+ */
+struct sCompactFrame
+{
+	int32_t  iFrame;
+	double   timestamp;
+	uint32_t timecode;
+	uint32_t timecodeSubframe;
+	uint32_t descriptionGeneration;
+
+	int                   nRigidBodies; ///< the first entities are rigid bodies, the rest are skeleton bones
+	std::vector<int32_t>  arrSkeletonId;
+	std::vector<int>      arrSkeletonBones;
+
+	std::vector<int32_t>  arrId;
+	std::vector<float>    arrX, arrY, arrZ;
+	std::vector<float>    arrQX, arrQY, arrQZ, arrQW;
+	std::vector<uint8_t>  arrTracked;
+};
+
+
+/**
+ * Class for encoding frames in the compact format.
+ * The entities are gathered into separate arrays first, so the quantisation runs in simple loops
+ * that the compiler can vectorise.
+ */
+class CompactEncoder
+{
+public:
+
+	/**
+	 * Creates an encoder.
+	 *
+	 * @param resolution    the position resolution in units per step (e.g., 0.0001 for 0.1mm)
+	 * @param positionBits  16 or 32 bits per position component
+	 */
+	CompactEncoder(float resolution = 0.0001f, int positionBits = 32);
+
+	/**
+	 * Encodes the rigid bodies and skeletons of a frame.
+	 *
+	 * @param refFrame               the frame to encode
+	 * @param descriptionGeneration  the generation of the scene description
+	 * @param pBuffer                the buffer to encode into
+	 * @param bufferSize             the size of the buffer
+	 *
+	 * @return the number of bytes written or 0 if the buffer is too small
+	 */
+	int encode(const sFrameOfMocapData& refFrame, uint32_t descriptionGeneration, uint8_t* pBuffer, int bufferSize);
+
+	/**
+	 * Decodes a compact frame.
+	 *
+	 * @param pBuffer   the encoded data
+	 * @param size      the size of the encoded data
+	 * @param refFrame  the frame to decode into
+	 *
+	 * @return <code>true</code> if the data was valid
+	 */
+	static bool decode(const uint8_t* pBuffer, int size, sCompactFrame& refFrame);
+
+	/**
+	 * Calculates the size of an encoded frame.
+	 *
+	 * @param nSkeletons    the number of skeletons
+	 * @param nEntities     the number of rigid bodies and bones
+	 * @param positionBits  16 or 32 bits per position component
+	 *
+	 * @return the size in bytes
+	 */
+	static int getEncodedSize(int nSkeletons, int nEntities, int positionBits);
+
+private:
+
+	void gatherEntities(const sFrameOfMocapData& refFrame);
+	void quantiseEntities();
+
+private:
+
+	float                 resolution;
+	int                   positionBits;
+
+	// gathered entities
+	std::vector<int32_t>  arrId;
+	std::vector<float>    arrX, arrY, arrZ;
+	std::vector<float>    arrQX, arrQY, arrQZ, arrQW;
+	std::vector<uint8_t>  arrTracked;
+
+	// quantised entities
+	std::vector<int32_t>  arrPosX, arrPosY, arrPosZ;
+	std::vector<uint32_t> arrQuat;
+};
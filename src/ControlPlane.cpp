@@ -0,0 +1,311 @@
+#include "ControlPlane.h"
+#include "ThreadTopology.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "ControlPlane"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+
+// how long the network and console threads wait for a command to be executed
+#define COMMAND_TIMEOUT_MS 2000
+
+
+/******************************************************************************
+ * CommandQueue class
+ */
+
+CommandQueue::CommandQueue() :
+	commandsPending(false)
+{
+	// nothing else to do
+}
+
+
+std::future<sCommandResult> CommandQueue::submit(const std::string& strCommand)
+{
+	std::lock_guard<std::mutex> lock(mtxQueue);
+	queue.emplace_back();
+	queue.back().command = strCommand;
+	std::future<sCommandResult> result = queue.back().result.get_future();
+	commandsPending = true;
+	return result;
+}
+
+
+bool CommandQueue::execute(const std::string& strCommand, std::chrono::milliseconds timeout, sCommandResult& refResult)
+{
+	std::future<sCommandResult> result = submit(strCommand);
+	if (result.wait_for(timeout) == std::future_status::ready)
+	{
+		refResult = result.get();
+		return true;
+	}
+	refResult.success  = false;
+	refResult.response = "Command timed out";
+	return false;
+}
+
+
+int CommandQueue::processCommands(const tCommandExecutor& executor)
+{
+	if (!commandsPending) return 0;
+
+	// take all commands out of the queue so submitters are not blocked while executing
+	std::deque<sQueuedCommand> commands;
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		commands.swap(queue);
+		commandsPending = false;
+	}
+
+	for (auto& command : commands)
+	{
+		command.result.set_value(executor(command.command));
+	}
+	return (int) commands.size();
+}
+
+
+
+/******************************************************************************
+ * ConsoleCommandReader class
+ */
+
+ConsoleCommandReader::ConsoleCommandReader(CommandQueue& refQueue) :
+	queue(refQueue),
+	running(false)
+{
+	// nothing else to do
+}
+
+
+void ConsoleCommandReader::start()
+{
+	if (!running)
+	{
+		running = true;
+		thread  = std::thread(&ConsoleCommandReader::readerThread, this);
+	}
+}
+
+
+void ConsoleCommandReader::stop()
+{
+	running = false;
+	if (thread.joinable())
+	{
+		// std::getline can't be interrupted > let the thread end with the process
+		thread.detach();
+	}
+}
+
+
+void ConsoleCommandReader::readerThread()
+{
+	ThreadTopology::applyToCurrentThread("console", false);
+
+	std::string strCommand;
+	while (running)
+	{
+		LOG_INFO("Enter command:");
+		if (!std::getline(std::cin, strCommand))
+		{
+			LOG_INFO("Console input closed");
+			break;
+		}
+		if (!running || strCommand.empty()) continue;
+
+		// wait for the command to be executed, so the response appears before the next prompt
+		std::future<sCommandResult> future = queue.submit(strCommand);
+		while (running && (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)) { }
+		if (!running) break;
+
+		sCommandResult result = future.get();
+		if (!result.success)
+		{
+			LOG_ERROR("Unknown command: '" << strCommand << "'");
+		}
+		else if (!result.response.empty())
+		{
+			std::cout << result.response << std::endl;
+		}
+	}
+	running = false;
+}
+
+
+
+/******************************************************************************
+ * CommandServer class
+ */
+
+CommandServer::CommandServer(CommandQueue& refQueue) :
+	queue(refQueue),
+	listenSocket(INVALID_SOCKET),
+	running(false)
+{
+	// nothing else to do
+}
+
+
+CommandServer::~CommandServer()
+{
+	stop();
+}
+
+
+bool CommandServer::start(const std::string& strAddress, int port)
+{
+	if (running) return true;
+
+	sockaddr_in address;
+	if (!networkResolveAddress(strAddress, port, address))
+	{
+		LOG_ERROR("Invalid command server address '" << strAddress << "'");
+		return false;
+	}
+
+	if (!networkInitialise()) return false;
+
+	listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if ((listenSocket == INVALID_SOCKET) ||
+	    (bind(listenSocket, (sockaddr*) &address, sizeof(address)) == SOCKET_ERROR) ||
+	    (listen(listenSocket, 4) == SOCKET_ERROR))
+	{
+		LOG_ERROR("Could not open command server on " << networkAddressToString(address));
+		if (listenSocket != INVALID_SOCKET)
+		{
+			closesocket(listenSocket);
+			listenSocket = INVALID_SOCKET;
+		}
+		networkDeinitialise();
+		return false;
+	}
+
+	running = true;
+	thread  = std::thread(&CommandServer::serverThread, this);
+	LOG_INFO("Command server listening on " << networkAddressToString(address));
+	return true;
+}
+
+
+void CommandServer::stop()
+{
+	if (running)
+	{
+		running = false;
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+		closesocket(listenSocket);
+		listenSocket = INVALID_SOCKET;
+		networkDeinitialise();
+		LOG_INFO("Command server stopped");
+	}
+}
+
+
+void CommandServer::serverThread()
+{
+	ThreadMetrics& refMetrics = ThreadTopology::applyToCurrentThread("control", true);
+
+	// connected clients and their partially received lines
+	std::map<SOCKET, std::string> clients;
+
+	while (running)
+	{
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(listenSocket, &readSet);
+		SOCKET maxSocket = listenSocket;
+		for (auto& client : clients)
+		{
+			FD_SET(client.first, &readSet);
+			maxSocket = std::max(maxSocket, client.first);
+		}
+
+		// wake up regularly to check the running flag
+		timeval timeout = { 0, 100000 };
+		const std::chrono::steady_clock::time_point tWakeup = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout.tv_usec);
+		int ready = select((int) maxSocket + 1, &readSet, nullptr, nullptr, &timeout);
+		if (ready == 0)
+		{
+			refMetrics.recordWakeup(std::chrono::steady_clock::now() - tWakeup);
+		}
+		if (ready <= 0) continue;
+
+		if (FD_ISSET(listenSocket, &readSet))
+		{
+			sockaddr_in clientAddress;
+			socklen_t   addressLength = sizeof(clientAddress);
+			SOCKET client = accept(listenSocket, (sockaddr*) &clientAddress, &addressLength);
+			if (client != INVALID_SOCKET)
+			{
+				LOG_INFO("Command client connected from " << networkAddressToString(clientAddress));
+				clients[client] = "";
+			}
+		}
+
+		for (auto iter = clients.begin(); iter != clients.end(); )
+		{
+			if (FD_ISSET(iter->first, &readSet) && !handleClient(iter->first, iter->second))
+			{
+				LOG_INFO("Command client disconnected");
+				closesocket(iter->first);
+				iter = clients.erase(iter);
+			}
+			else
+			{
+				iter++;
+			}
+		}
+	}
+
+	for (auto& client : clients)
+	{
+		closesocket(client.first);
+	}
+}
+
+
+bool CommandServer::handleClient(SOCKET client, std::string& refBuffer)
+{
+	char buf[1024];
+	int received = recv(client, buf, sizeof(buf), 0);
+	if (received <= 0) return false;
+
+	refBuffer.append(buf, received);
+
+	// execute all complete lines
+	size_t posNewline;
+	while ((posNewline = refBuffer.find('\n')) != std::string::npos)
+	{
+		std::string strCommand = refBuffer.substr(0, posNewline);
+		refBuffer.erase(0, posNewline + 1);
+		if (!strCommand.empty() && (strCommand.back() == '\r')) strCommand.pop_back();
+		if (strCommand.empty()) continue;
+
+		sCommandResult result;
+		queue.execute(strCommand, std::chrono::milliseconds(COMMAND_TIMEOUT_MS), result);
+
+		// response: status line, optional response text, empty line
+		std::string strResponse = result.success ? "OK\n" : "ERROR\n";
+		if (!result.response.empty())
+		{
+			strResponse += result.response;
+			if (strResponse.back() != '\n') strResponse += '\n';
+		}
+		strResponse += '\n';
+		send(client, strResponse.c_str(), (int) strResponse.size(), 0);
+	}
+
+	// protect against clients that never send a newline
+	if (refBuffer.size() > 4096) return false;
+
+	return true;
+}
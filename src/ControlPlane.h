@@ -0,0 +1,179 @@
+/**
+ * Classes for receiving server commands from the console and the network
+ * and for executing them on the streaming thread in between frames.
+ */
+
+#pragma once
+
+#include "Network.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Result of an executed command.
+ */
+struct sCommandResult
+{
+	bool        success;  ///< <code>true</code> if the command was recognised and executed
+	std::string response; ///< response text (can be empty)
+};
+
+
+/**
+ * Thread-safe queue for commands from several sources.
+ * Commands are only executed when the owner of the queue calls processCommands(),
+ * so they never interfere with a frame that is being processed.
+ */
+class CommandQueue
+{
+public:
+
+	/**
+	 * Signature of the function that actually executes a command.
+	 */
+	typedef std::function<sCommandResult(const std::string&)> tCommandExecutor;
+
+	CommandQueue();
+
+	/**
+	 * Adds a command to the queue.
+	 *
+	 * @param strCommand  the command to execute
+	 *
+	 * @return the future result of the command
+	 */
+	std::future<sCommandResult> submit(const std::string& strCommand);
+
+	/**
+	 * Adds a command to the queue and waits for the result.
+	 *
+	 * @param strCommand  the command to execute
+	 * @param timeout     the maximum time to wait for the execution
+	 * @param refResult   the result of the command
+	 *
+	 * @return <code>true</code> if the command was executed in time
+	 */
+	bool execute(const std::string& strCommand, std::chrono::milliseconds timeout, sCommandResult& refResult);
+
+	/**
+	 * Executes all queued commands.
+	 *
+	 * @param executor  the function that executes a single command
+	 *
+	 * @return the number of executed commands
+	 */
+	int processCommands(const tCommandExecutor& executor);
+
+private:
+
+	struct sQueuedCommand
+	{
+		std::string                   command;
+		std::promise<sCommandResult>  result;
+	};
+
+	std::mutex                 mtxQueue;
+	std::deque<sQueuedCommand> queue;
+	std::atomic<bool>          commandsPending; // avoids locking when the queue is empty
+};
+
+
+/**
+ * Thread that reads commands from the console.
+ * When the standard input is closed (e.g., when running as a service), the thread simply ends.
+ */
+class ConsoleCommandReader
+{
+public:
+
+	/**
+	 * Creates a console reader that passes commands to a queue.
+	 *
+	 * @param refQueue  the command queue
+	 */
+	ConsoleCommandReader(CommandQueue& refQueue);
+
+	/**
+	 * Starts reading commands in the background.
+	 */
+	void start();
+
+	/**
+	 * Releases the reader thread.
+	 * The thread might still be blocked by the console input, so it is not joined.
+	 */
+	void stop();
+
+private:
+
+	void readerThread();
+
+private:
+
+	CommandQueue&     queue;
+	std::thread       thread;
+	std::atomic<bool> running;
+};
+
+
+/**
+ * Local TCP server for receiving commands line by line and sending back their responses.
+ */
+class CommandServer
+{
+public:
+
+	/**
+	 * Creates a command server that passes commands to a queue.
+	 *
+	 * @param refQueue  the command queue
+	 */
+	CommandServer(CommandQueue& refQueue);
+
+	/**
+	 * Stops and destroys the command server.
+	 */
+	~CommandServer();
+
+	/**
+	 * Starts listening for connections.
+	 *
+	 * @param strAddress  the local address to bind to (e.g., 127.0.0.1)
+	 * @param port        the port to listen on
+	 *
+	 * @return <code>true</code> if the server is listening
+	 */
+	bool start(const std::string& strAddress, int port);
+
+	/**
+	 * Closes all connections and stops the server thread.
+	 */
+	void stop();
+
+private:
+
+	void serverThread();
+
+	/**
+	 * Receives data from a client and executes all complete command lines.
+	 *
+	 * @return <code>false</code> if the connection was closed
+	 */
+	bool handleClient(SOCKET client, std::string& refBuffer);
+
+private:
+
+	CommandQueue&     queue;
+	SOCKET            listenSocket;
+	std::thread       thread;
+	std::atomic<bool> running;
+};
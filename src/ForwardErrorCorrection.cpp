@@ -0,0 +1,406 @@
+#include "ForwardErrorCorrection.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+// groups that are this much older than the newest one are given up by the decoder
+#define FEC_DECODER_HISTORY 16
+
+// size of the message ID and size fields in front of each packet
+#define PACKET_HEADER_SIZE 4
+
+
+/******************************************************************************
+ * GaloisField class
+ */
+
+/**
+ * Logarithm and exponential tables for GF(256) with the polynomial x^8+x^4+x^3+x^2+1.
+ */
+struct sGaloisTables
+{
+	uint8_t arrExp[512]; // doubled, so the sum of two logarithms doesn't need a modulo
+	uint8_t arrLog[256];
+
+	sGaloisTables()
+	{
+		int value = 1;
+		for (int idx = 0; idx < 255; idx++)
+		{
+			arrExp[idx]   = (uint8_t) value;
+			arrLog[value] = (uint8_t) idx;
+			value <<= 1;
+			if (value & 0x100) value ^= 0x11D;
+		}
+		for (int idx = 255; idx < 512; idx++)
+		{
+			arrExp[idx] = arrExp[idx - 255];
+		}
+		arrLog[0] = 0; // undefined, never used
+	}
+};
+
+
+static const sGaloisTables& getGaloisTables()
+{
+	static const sGaloisTables tables; // thread safe initialisation
+	return tables;
+}
+
+
+uint8_t GaloisField::multiply(uint8_t a, uint8_t b)
+{
+	if ((a == 0) || (b == 0)) return 0;
+	const sGaloisTables& tables = getGaloisTables();
+	return tables.arrExp[tables.arrLog[a] + tables.arrLog[b]];
+}
+
+
+uint8_t GaloisField::inverse(uint8_t a)
+{
+	const sGaloisTables& tables = getGaloisTables();
+	return tables.arrExp[255 - tables.arrLog[a]];
+}
+
+
+uint8_t GaloisField::getCoefficient(int parityIdx, int dataIdx, int dataCount, int parityCount)
+{
+	if (parityCount == 1)
+	{
+		// single parity packet: simple XOR
+		return 1;
+	}
+	// Cauchy matrix: every square submatrix is invertible,
+	// so any K of the K+M packets are enough to reconstruct the data
+	return inverse((uint8_t) ((dataCount + parityIdx) ^ dataIdx));
+}
+
+
+
+/******************************************************************************
+ * FecEncoder class
+ */
+
+FecEncoder::FecEncoder(int dataCount, int parityCount) :
+	dataCount(std::max(1, std::min(dataCount, FEC_MAX_DATA_PACKETS))),
+	parityCount(std::max(1, std::min(parityCount, FEC_MAX_PARITY_PACKETS))),
+	groupId(0),
+	dataIdx(0),
+	parityReady(false),
+	paritySize(0)
+{
+	pPacketData = new sPacket;
+	for (int pIdx = 0; pIdx < this->parityCount; pIdx++)
+	{
+		arrPacketParity.push_back(new sPacket);
+	}
+
+	// precompute the multiplication by each coefficient
+	arrTables.resize(this->parityCount * this->dataCount * 256);
+	for (int pIdx = 0; pIdx < this->parityCount; pIdx++)
+	{
+		for (int dIdx = 0; dIdx < this->dataCount; dIdx++)
+		{
+			uint8_t  coefficient = GaloisField::getCoefficient(pIdx, dIdx, this->dataCount, this->parityCount);
+			uint8_t* pTable      = &arrTables[(pIdx * this->dataCount + dIdx) * 256];
+			for (int value = 0; value < 256; value++)
+			{
+				pTable[value] = GaloisField::multiply(coefficient, (uint8_t) value);
+			}
+		}
+	}
+}
+
+
+FecEncoder::~FecEncoder()
+{
+	for (auto pPacket : arrPacketParity)
+	{
+		delete pPacket;
+	}
+	delete pPacketData;
+}
+
+
+const sPacket* FecEncoder::encode(const sPacket* pPacket)
+{
+	parityReady = false;
+
+	const int symbolSize = PACKET_HEADER_SIZE + pPacket->nDataBytes;
+	if (sizeof(sFecHeader) + symbolSize > 0xFFFF)
+	{
+		// too big to wrap > send unprotected
+		return pPacket;
+	}
+
+	// wrap the data packet
+	sFecHeader header;
+	header.groupId     = groupId;
+	header.index       = (uint8_t) dataIdx;
+	header.dataCount   = (uint8_t) dataCount;
+	header.parityCount = (uint8_t) parityCount;
+	header.reserved    = 0;
+	pPacketData->iMessage   = NAT_FEC_DATA;
+	pPacketData->nDataBytes = (unsigned short) (sizeof(header) + symbolSize);
+	uint8_t* pSymbol = (uint8_t*) pPacketData->Data.cData + sizeof(header);
+	memcpy(pPacketData->Data.cData, &header, sizeof(header));
+	memcpy(pSymbol,     &pPacket->iMessage,   sizeof(pPacket->iMessage));
+	memcpy(pSymbol + 2, &pPacket->nDataBytes, sizeof(pPacket->nDataBytes));
+	memcpy(pSymbol + PACKET_HEADER_SIZE, pPacket->Data.cData, pPacket->nDataBytes);
+
+	if (dataIdx == 0)
+	{
+		paritySize = 0;
+	}
+
+	// accumulate the parity (spreads the work over the packets of the group)
+	for (int pIdx = 0; pIdx < parityCount; pIdx++)
+	{
+		uint8_t*       pParity = (uint8_t*) arrPacketParity[pIdx]->Data.cData + sizeof(sFecHeader);
+		const uint8_t* pTable  = &arrTables[(pIdx * dataCount + dataIdx) * 256];
+		if (symbolSize > paritySize)
+		{
+			memset(pParity + paritySize, 0, symbolSize - paritySize);
+		}
+		for (int bIdx = 0; bIdx < symbolSize; bIdx++)
+		{
+			pParity[bIdx] ^= pTable[pSymbol[bIdx]];
+		}
+	}
+	paritySize = std::max(paritySize, symbolSize);
+
+	dataIdx++;
+	if (dataIdx == dataCount)
+	{
+		// group complete > parity packets can be sent
+		for (int pIdx = 0; pIdx < parityCount; pIdx++)
+		{
+			header.index = (uint8_t) (dataCount + pIdx);
+			sPacket* pParity = arrPacketParity[pIdx];
+			pParity->iMessage   = NAT_FEC_PARITY;
+			pParity->nDataBytes = (unsigned short) (sizeof(header) + paritySize);
+			memcpy(pParity->Data.cData, &header, sizeof(header));
+		}
+		parityReady = true;
+		dataIdx     = 0;
+		groupId++;
+	}
+
+	return pPacketData;
+}
+
+
+int FecEncoder::getParityPacketCount() const
+{
+	return parityReady ? parityCount : 0;
+}
+
+
+const sPacket* FecEncoder::getParityPacket(int idx) const
+{
+	return arrPacketParity[idx];
+}
+
+
+
+/******************************************************************************
+ * FecDecoder class
+ */
+
+FecDecoder::FecDecoder(const tPacketHandler& handler) :
+	handler(handler),
+	newestGroup(0),
+	recovered(0)
+{
+	// nothing else to do
+}
+
+
+void FecDecoder::receive(const uint8_t* pPacket, int size)
+{
+	if (size < PACKET_HEADER_SIZE) return;
+
+	uint16_t iMessage;
+	memcpy(&iMessage, pPacket, sizeof(iMessage));
+	if ((iMessage != NAT_FEC_DATA) && (iMessage != NAT_FEC_PARITY))
+	{
+		// not protected
+		handler(pPacket, size);
+		return;
+	}
+	if (size < PACKET_HEADER_SIZE + (int) sizeof(sFecHeader)) return;
+
+	sFecHeader header;
+	memcpy(&header, pPacket + PACKET_HEADER_SIZE, sizeof(header));
+	const uint8_t* pSymbol    = pPacket + PACKET_HEADER_SIZE + sizeof(header);
+	const int      symbolSize = size - PACKET_HEADER_SIZE - (int) sizeof(header);
+
+	if ((header.dataCount == 0) || (header.index >= header.dataCount + header.parityCount)) return;
+
+	// forget old groups
+	if ((int32_t) (header.groupId - newestGroup) > 0)
+	{
+		newestGroup = header.groupId;
+	}
+	for (auto iter = mapGroups.begin(); iter != mapGroups.end(); )
+	{
+		if ((int32_t) (newestGroup - iter->first) > FEC_DECODER_HISTORY)
+		{
+			iter = mapGroups.erase(iter);
+		}
+		else
+		{
+			iter++;
+		}
+	}
+	if ((int32_t) (newestGroup - header.groupId) > FEC_DECODER_HISTORY) return; // too late
+
+	auto iterGroup = mapGroups.find(header.groupId);
+	if (iterGroup == mapGroups.end())
+	{
+		sGroup group;
+		group.dataCount   = header.dataCount;
+		group.parityCount = header.parityCount;
+		group.complete    = false;
+		iterGroup = mapGroups.insert(std::make_pair(header.groupId, group)).first;
+	}
+	sGroup& group = iterGroup->second;
+	if (group.complete || (group.mapSymbols.count(header.index) > 0)) return;
+
+	group.mapSymbols[header.index].assign(pSymbol, pSymbol + symbolSize);
+
+	if (header.index < group.dataCount)
+	{
+		// original data > pass on immediately
+		handler(pSymbol, symbolSize);
+	}
+
+	int nData = 0;
+	for (auto& symbol : group.mapSymbols)
+	{
+		if (symbol.first < group.dataCount) nData++;
+	}
+	if (nData == group.dataCount)
+	{
+		group.complete = true;
+	}
+	else if ((int) group.mapSymbols.size() >= group.dataCount)
+	{
+		reconstruct(group);
+	}
+}
+
+
+unsigned long FecDecoder::getRecoveredCount() const
+{
+	return recovered;
+}
+
+
+void FecDecoder::reconstruct(sGroup& refGroup)
+{
+	const int K = refGroup.dataCount;
+	const int M = refGroup.parityCount;
+
+	std::vector<int> arrMissing, arrParity;
+	size_t symbolSize = 0;
+	for (int idx = 0; idx < K; idx++)
+	{
+		if (refGroup.mapSymbols.count(idx) == 0) arrMissing.push_back(idx);
+	}
+	for (auto& symbol : refGroup.mapSymbols)
+	{
+		if ((symbol.first >= K) && (arrParity.size() < arrMissing.size())) arrParity.push_back(symbol.first - K);
+		symbolSize = std::max(symbolSize, symbol.second.size());
+	}
+	const int nMissing = (int) arrMissing.size();
+	if ((int) arrParity.size() < nMissing) return;
+
+	// right hand side: parity minus the contribution of the received data
+	std::vector<std::vector<uint8_t>> arrRhs(nMissing);
+	for (int row = 0; row < nMissing; row++)
+	{
+		std::vector<uint8_t>& rhs = arrRhs[row];
+		rhs = refGroup.mapSymbols[K + arrParity[row]];
+		rhs.resize(symbolSize, 0);
+		for (int dIdx = 0; dIdx < K; dIdx++)
+		{
+			auto iter = refGroup.mapSymbols.find(dIdx);
+			if (iter == refGroup.mapSymbols.end()) continue;
+			uint8_t coefficient = GaloisField::getCoefficient(arrParity[row], dIdx, K, M);
+			for (size_t bIdx = 0; bIdx < iter->second.size(); bIdx++)
+			{
+				rhs[bIdx] ^= GaloisField::multiply(coefficient, iter->second[bIdx]);
+			}
+		}
+	}
+
+	// invert the coefficient matrix of the missing packets (Gauss-Jordan)
+	std::vector<uint8_t> matrix(nMissing * nMissing), inverse(nMissing * nMissing, 0);
+	for (int row = 0; row < nMissing; row++)
+	{
+		for (int col = 0; col < nMissing; col++)
+		{
+			matrix[row * nMissing + col] = GaloisField::getCoefficient(arrParity[row], arrMissing[col], K, M);
+		}
+		inverse[row * nMissing + row] = 1;
+	}
+	for (int col = 0; col < nMissing; col++)
+	{
+		int pivot = col;
+		while ((pivot < nMissing) && (matrix[pivot * nMissing + col] == 0)) pivot++;
+		if (pivot == nMissing) return; // singular (can't happen with a Cauchy matrix)
+		if (pivot != col)
+		{
+			for (int c = 0; c < nMissing; c++)
+			{
+				std::swap(matrix[pivot * nMissing + c],  matrix[col * nMissing + c]);
+				std::swap(inverse[pivot * nMissing + c], inverse[col * nMissing + c]);
+			}
+		}
+		uint8_t factor = GaloisField::inverse(matrix[col * nMissing + col]);
+		for (int c = 0; c < nMissing; c++)
+		{
+			matrix[col * nMissing + c]  = GaloisField::multiply(matrix[col * nMissing + c],  factor);
+			inverse[col * nMissing + c] = GaloisField::multiply(inverse[col * nMissing + c], factor);
+		}
+		for (int row = 0; row < nMissing; row++)
+		{
+			uint8_t value = matrix[row * nMissing + col];
+			if ((row == col) || (value == 0)) continue;
+			for (int c = 0; c < nMissing; c++)
+			{
+				matrix[row * nMissing + c]  ^= GaloisField::multiply(value, matrix[col * nMissing + c]);
+				inverse[row * nMissing + c] ^= GaloisField::multiply(value, inverse[col * nMissing + c]);
+			}
+		}
+	}
+
+	// missing data = inverse * right hand side
+	for (int mIdx = 0; mIdx < nMissing; mIdx++)
+	{
+		std::vector<uint8_t> symbol(symbolSize, 0);
+		for (int row = 0; row < nMissing; row++)
+		{
+			uint8_t coefficient = inverse[mIdx * nMissing + row];
+			if (coefficient == 0) continue;
+			for (size_t bIdx = 0; bIdx < symbolSize; bIdx++)
+			{
+				symbol[bIdx] ^= GaloisField::multiply(coefficient, arrRhs[row][bIdx]);
+			}
+		}
+
+		// the original packet header tells the actual size
+		uint16_t nDataBytes;
+		memcpy(&nDataBytes, symbol.data() + 2, sizeof(nDataBytes));
+		size_t packetSize = PACKET_HEADER_SIZE + nDataBytes;
+		if (packetSize <= symbolSize)
+		{
+			refGroup.mapSymbols[arrMissing[mIdx]].assign(symbol.begin(), symbol.begin() + packetSize);
+			handler(symbol.data(), (int) packetSize);
+			recovered++;
+		}
+	}
+	refGroup.complete = true;
+}
@@ -0,0 +1,200 @@
+/**
+ * Forward error correction for streaming over lossy networks.
+ *
+ * Packets are sent in groups of K data packets, followed by M parity packets.
+ * Any K of the K+M packets of a group are enough to reconstruct all data packets.
+ * With M=1, the parity is a simple XOR, otherwise a Reed-Solomon code over GF(256) (Cauchy matrix) is used.
+ *
+ * Each packet is wrapped into a packet with message ID NAT_FEC_DATA or NAT_FEC_PARITY:
+ *   uint16  message ID, uint16 number of following bytes,
+ *   sFecHeader,
+ *   symbol: for data packets the complete original packet (message ID, size, data),
+ *           for parity packets the parity of the zero padded symbols of the group
+ *
+ * The decoder works on the raw bytes of the received packets and doesn't need the NatNet libraries,
+ * so clients can use it as it is.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+
+// message IDs of FEC packets (outside of the range used by NatNet)
+#define NAT_FEC_DATA   203
+#define NAT_FEC_PARITY 204
+
+// limits of the group size
+#define FEC_MAX_DATA_PACKETS   32
+#define FEC_MAX_PARITY_PACKETS 8
+
+
+#pragma pack(push, 1)
+/**
+ * Header of FEC packets.
+ */
+struct sFecHeader
+{
+	uint32_t groupId;     ///< number of the group
+	uint8_t  index;       ///< index of the packet within the group (data: 0..K-1, parity: K..K+M-1)
+	uint8_t  dataCount;   ///< number of data packets per group (K)
+	uint8_t  parityCount; ///< number of parity packets per group (M)
+	uint8_t  reserved;
+};
+#pragma pack(pop)
+
+
+/**
+ * Class for the arithmetic in GF(256) with precomputed tables.
+ */
+class GaloisField
+{
+public:
+
+	/**
+	 * Multiplies two elements.
+	 *
+	 * @return the product
+	 */
+	static uint8_t multiply(uint8_t a, uint8_t b);
+
+	/**
+	 * Calculates the multiplicative inverse of an element.
+	 *
+	 * @param a  the element (must not be 0)
+	 *
+	 * @return the inverse
+	 */
+	static uint8_t inverse(uint8_t a);
+
+	/**
+	 * Gets the coefficient of a data packet for a parity packet.
+	 *
+	 * @param parityIdx    the index of the parity packet (0..M-1)
+	 * @param dataIdx      the index of the data packet (0..K-1)
+	 * @param dataCount    the number of data packets (K)
+	 * @param parityCount  the number of parity packets (M)
+	 *
+	 * @return the coefficient
+	 */
+	static uint8_t getCoefficient(int parityIdx, int dataIdx, int dataCount, int parityCount);
+};
+
+
+/**
+ * Class for adding FEC to a stream of packets (sender side).
+ */
+class FecEncoder
+{
+public:
+
+	/**
+	 * Creates an encoder.
+	 *
+	 * @param dataCount    the number of data packets per group (K)
+	 * @param parityCount  the number of parity packets per group (M)
+	 */
+	FecEncoder(int dataCount, int parityCount);
+
+	~FecEncoder();
+
+	/**
+	 * Wraps a packet for sending and adds it to the parity of the current group.
+	 *
+	 * @param pPacket  the packet to send
+	 *
+	 * @return the wrapped packet to send instead
+	 */
+	const sPacket* encode(const sPacket* pPacket);
+
+	/**
+	 * Gets the number of parity packets that are ready to be sent after the last call of encode().
+	 *
+	 * @return the number of parity packets (0 or M)
+	 */
+	int getParityPacketCount() const;
+
+	/**
+	 * Gets a parity packet to send.
+	 *
+	 * @param idx  the index of the parity packet
+	 *
+	 * @return the parity packet
+	 */
+	const sPacket* getParityPacket(int idx) const;
+
+private:
+
+	int                   dataCount, parityCount;
+	uint32_t              groupId;
+	int                   dataIdx;
+	bool                  parityReady;
+
+	sPacket*              pPacketData;
+	std::vector<sPacket*> arrPacketParity;
+	int                   paritySize; // largest symbol of the current group
+
+	// multiplication tables per parity and data packet: arrTables[(p * K + d) * 256 + value]
+	std::vector<uint8_t>  arrTables;
+};
+
+
+/**
+ * Class for reconstructing lost packets (receiver side).
+ */
+class FecDecoder
+{
+public:
+
+	/**
+	 * Function that receives the original packets (message ID, size, data).
+	 */
+	typedef std::function<void(const uint8_t* pPacket, int size)> tPacketHandler;
+
+	/**
+	 * Creates a decoder.
+	 *
+	 * @param handler  the function that receives the original packets
+	 */
+	FecDecoder(const tPacketHandler& handler);
+
+	/**
+	 * Processes a received packet.
+	 * Original data packets are passed on immediately, lost ones as soon as they can be reconstructed.
+	 * Packets without FEC are passed on unchanged.
+	 *
+	 * @param pPacket  the received packet
+	 * @param size     the size of the packet
+	 */
+	void receive(const uint8_t* pPacket, int size);
+
+	/**
+	 * Gets the number of reconstructed packets.
+	 *
+	 * @return the number of reconstructed packets
+	 */
+	unsigned long getRecoveredCount() const;
+
+private:
+
+	struct sGroup
+	{
+		int                                dataCount, parityCount;
+		std::map<int, std::vector<uint8_t>> mapSymbols;  // by index
+		bool                               complete;
+	};
+
+	void reconstruct(sGroup& refGroup);
+
+private:
+
+	tPacketHandler                handler;
+	std::map<uint32_t, sGroup>    mapGroups;
+	uint32_t                      newestGroup;
+	unsigned long                 recovered;
+};
@@ -0,0 +1,264 @@
+#include "FrameHistory.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FrameHistory"
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+
+
+/******************************************************************************
+ * FrameHistory class
+ */
+
+FrameHistory::FrameHistory() :
+	depth(0),
+	arrSlots(),
+	framesWritten(0),
+	framesTooBig(0),
+	encoder(),
+	descriptionGeneration(0)
+{
+	// nothing else to do
+}
+
+
+void FrameHistory::setDepth(int newDepth)
+{
+	std::lock_guard<std::mutex> lock(mtxSlots);
+	newDepth = std::max(0, newDepth);
+	if (newDepth != depth)
+	{
+		arrSlots.reset((newDepth > 0) ? new sSlot[newDepth] : nullptr);
+		depth = newDepth;
+		if (depth > 0)
+		{
+			LOG_INFO("Keeping the last " << depth << " frames (" << ((size_t) depth * sizeof(sSlot) / (1024 * 1024)) << "MB)");
+		}
+	}
+	for (int idx = 0; idx < depth; idx++)
+	{
+		arrSlots[idx].sequence = 0;
+		arrSlots[idx].index    = UINT64_MAX;
+	}
+	framesWritten = 0;
+	framesTooBig  = 0;
+}
+
+
+bool FrameHistory::isEnabled() const
+{
+	return depth > 0;
+}
+
+
+void FrameHistory::addFrame(const MoCapData& refData)
+{
+	if (depth == 0) return;
+
+	// keep the names for resolving filters
+	if (refData.descriptionGeneration != descriptionGeneration)
+	{
+		std::lock_guard<std::mutex> lock(mtxNames);
+		arrRigidBodyNames.clear();
+		arrSkeletonNames.clear();
+		for (int dIdx = 0; dIdx < refData.description.nDataDescriptions; dIdx++)
+		{
+			const sDataDescription& descr = refData.description.arrDataDescriptions[dIdx];
+			if (descr.type == Descriptor_RigidBody)
+			{
+				arrRigidBodyNames.push_back(std::make_pair(descr.Data.RigidBodyDescription->szName, descr.Data.RigidBodyDescription->ID));
+			}
+			else if (descr.type == Descriptor_Skeleton)
+			{
+				arrSkeletonNames.push_back(std::make_pair(descr.Data.SkeletonDescription->szName, descr.Data.SkeletonDescription->skeletonID));
+			}
+		}
+		descriptionGeneration = refData.descriptionGeneration;
+	}
+
+	const uint64_t index = framesWritten;
+	sSlot& slot = arrSlots[index % depth];
+
+	// odd sequence number > readers know the slot is being written
+	slot.sequence.fetch_add(1, std::memory_order_acq_rel);
+	slot.index     = index;
+	slot.timestamp = refData.frame.fTimestamp;
+	slot.size      = encoder.encode(refData.frame, refData.descriptionGeneration, slot.data, sizeof(slot.data));
+	slot.sequence.fetch_add(1, std::memory_order_release);
+
+	if (slot.size == 0)
+	{
+		framesTooBig++;
+	}
+	framesWritten.store(index + 1, std::memory_order_release);
+}
+
+
+double FrameHistory::getNewestTimestamp() const
+{
+	std::lock_guard<std::mutex> lock(mtxSlots);
+	const uint64_t newest = framesWritten;
+	double               timestamp = 0;
+	std::vector<uint8_t> data;
+	if ((newest > 0) && readSlot(newest - 1, timestamp, data))
+	{
+		return timestamp;
+	}
+	return 0;
+}
+
+
+sHistorySelection FrameHistory::select(const std::string& strFilter) const
+{
+	sHistorySelection selection;
+	selection.all = strFilter.empty();
+	if (selection.all) return selection;
+
+	std::lock_guard<std::mutex> lock(mtxNames);
+	std::istringstream strmFilter(strFilter);
+	std::string strPattern;
+	while (std::getline(strmFilter, strPattern, ';'))
+	{
+		for (const auto& name : arrRigidBodyNames)
+		{
+			if (matchesPattern(strPattern.c_str(), name.first.c_str())) selection.rigidBodies.insert(name.second);
+		}
+		for (const auto& name : arrSkeletonNames)
+		{
+			if (matchesPattern(strPattern.c_str(), name.first.c_str())) selection.skeletons.insert(name.second);
+		}
+	}
+	return selection;
+}
+
+
+int FrameHistory::query(double fromTime, double toTime, std::vector<std::vector<uint8_t>>& arrFrames) const
+{
+	std::lock_guard<std::mutex> lock(mtxSlots);
+	if (depth == 0) return 0;
+
+	const uint64_t newest = framesWritten.load(std::memory_order_acquire);
+	const uint64_t oldest = (newest > (uint64_t) depth) ? (newest - depth) : 0;
+
+	int count = 0;
+	double               timestamp;
+	std::vector<uint8_t> data;
+	for (uint64_t index = oldest; index < newest; index++)
+	{
+		// slots that were overwritten in the meantime are simply skipped
+		if (readSlot(index, timestamp, data) && (timestamp >= fromTime) && (timestamp <= toTime))
+		{
+			arrFrames.push_back(data);
+			count++;
+		}
+	}
+	return count;
+}
+
+
+bool FrameHistory::filterFrame(std::vector<uint8_t>& refFrame, const sHistorySelection& refSelection, CompactEncoder& refEncoder)
+{
+	if (refSelection.all) return true;
+
+	sCompactFrame compact;
+	if (!CompactEncoder::decode(refFrame.data(), (int) refFrame.size(), compact)) return false;
+
+	// the frame structure is big > only allocate once per thread
+	thread_local std::unique_ptr<sFrameOfMocapData> pFrame(new sFrameOfMocapData);
+	thread_local std::vector<sRigidBodyData>        arrBones;
+	sFrameOfMocapData& frame = *pFrame;
+	memset(&frame, 0, sizeof(frame));
+	frame.iFrame           = compact.iFrame;
+	frame.fTimestamp       = compact.timestamp;
+	frame.Timecode         = compact.timecode;
+	frame.TimecodeSubframe = compact.timecodeSubframe;
+
+	auto copyEntity = [&compact](int eIdx, sRigidBodyData& refRigidBody)
+	{
+		memset(&refRigidBody, 0, sizeof(refRigidBody));
+		refRigidBody.ID     = compact.arrId[eIdx];
+		refRigidBody.x      = compact.arrX[eIdx];
+		refRigidBody.y      = compact.arrY[eIdx];
+		refRigidBody.z      = compact.arrZ[eIdx];
+		refRigidBody.qx     = compact.arrQX[eIdx];
+		refRigidBody.qy     = compact.arrQY[eIdx];
+		refRigidBody.qz     = compact.arrQZ[eIdx];
+		refRigidBody.qw     = compact.arrQW[eIdx];
+		refRigidBody.params = compact.arrTracked[eIdx] ? STATUS_TRACKED : STATUS_NOT_TRACKED;
+	};
+
+	for (int eIdx = 0; eIdx < compact.nRigidBodies; eIdx++)
+	{
+		if (refSelection.rigidBodies.count(compact.arrId[eIdx]) > 0)
+		{
+			copyEntity(eIdx, frame.RigidBodies[frame.nRigidBodies++]);
+		}
+	}
+
+	// reserve first, so the bone pointers stay valid
+	arrBones.resize(compact.arrId.size());
+	int eIdx = compact.nRigidBodies;
+	int bIdx = 0;
+	for (size_t skIdx = 0; skIdx < compact.arrSkeletonId.size(); skIdx++)
+	{
+		const int nBones = compact.arrSkeletonBones[skIdx];
+		if (refSelection.skeletons.count(compact.arrSkeletonId[skIdx]) > 0)
+		{
+			sSkeletonData& skeleton = frame.Skeletons[frame.nSkeletons++];
+			skeleton.skeletonID    = compact.arrSkeletonId[skIdx];
+			skeleton.nRigidBodies  = nBones;
+			skeleton.RigidBodyData = arrBones.data() + bIdx;
+			for (int boneIdx = 0; boneIdx < nBones; boneIdx++)
+			{
+				copyEntity(eIdx + boneIdx, arrBones[bIdx++]);
+			}
+		}
+		eIdx += nBones;
+	}
+
+	refFrame.resize(FRAME_HISTORY_SLOT_SIZE);
+	const int size = refEncoder.encode(frame, compact.descriptionGeneration, refFrame.data(), (int) refFrame.size());
+	refFrame.resize(size);
+	return size > 0;
+}
+
+
+std::string FrameHistory::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "History: disabled";
+	}
+	else
+	{
+		const uint64_t written = framesWritten;
+		strm << "History: " << std::min<uint64_t>(written, depth) << "/" << depth << " frames";
+		if (framesTooBig > 0)
+		{
+			strm << ", " << framesTooBig << " frames too big";
+		}
+	}
+	return strm.str();
+}
+
+
+bool FrameHistory::readSlot(uint64_t index, double& refTimestamp, std::vector<uint8_t>& refData) const
+{
+	const sSlot& slot = arrSlots[index % depth];
+
+	const uint32_t sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+	if (sequenceBefore & 1) return false; // being written
+
+	const uint64_t slotIndex = slot.index;
+	const int      size      = std::min(slot.size, FRAME_HISTORY_SLOT_SIZE);
+	refTimestamp = slot.timestamp;
+	refData.assign(slot.data, slot.data + size);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint32_t sequenceAfter = slot.sequence.load(std::memory_order_relaxed);
+	return (sequenceBefore == sequenceAfter) && (slotIndex == index) && (size > 0);
+}
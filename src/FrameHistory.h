@@ -0,0 +1,146 @@
+/**
+ * In-memory history of the most recent frames, e.g., for clients that join late or lost their connection.
+ *
+ * The frames are kept in the compact encoding in a ring of fixed size slots.
+ * The streaming thread writes without locking, readers detect slots that were overwritten
+ * while they were copying them by a sequence number per slot.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+#include "CompactEncoding.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+
+// maximum size of a compact frame in the history
+#define FRAME_HISTORY_SLOT_SIZE 8192
+
+
+/**
+ * Selection of rigid bodies and skeletons for a history query.
+ */
+struct sHistorySelection
+{
+	bool              all;         ///< no filter
+	std::set<int32_t> rigidBodies; ///< IDs of the selected rigid bodies
+	std::set<int32_t> skeletons;   ///< IDs of the selected skeletons
+};
+
+
+/**
+ * Class for the frame history.
+ */
+class FrameHistory
+{
+public:
+
+	FrameHistory();
+
+	/**
+	 * Sets the number of frames to keep and clears the history.
+	 * Must not be called while frames are added, but can be called while the history is queried.
+	 *
+	 * @param newDepth  the number of frames (0: history disabled)
+	 */
+	void setDepth(int newDepth);
+
+	/**
+	 * Checks if the history is enabled.
+	 *
+	 * @return <code>true</code> if frames are kept
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Adds a frame to the history, overwriting the oldest one.
+	 * Must only be called from one thread.
+	 *
+	 * @param refData  the MoCap data with the frame to add
+	 */
+	void addFrame(const MoCapData& refData);
+
+	/**
+	 * Gets the timestamp of the newest frame.
+	 *
+	 * @return the timestamp in s
+	 */
+	double getNewestTimestamp() const;
+
+	/**
+	 * Resolves entity name patterns to the IDs of the rigid bodies and skeletons of the current description.
+	 *
+	 * @param strFilter  name patterns with '*' and '?', separated by ';' (empty: all entities)
+	 *
+	 * @return the selected entities
+	 */
+	sHistorySelection select(const std::string& strFilter) const;
+
+	/**
+	 * Copies the frames of a time range out of the history.
+	 *
+	 * @param fromTime   the start of the range (timestamp in s)
+	 * @param toTime     the end of the range (timestamp in s)
+	 * @param arrFrames  the list to append the compact frames to, in chronological order
+	 *
+	 * @return the number of frames found
+	 */
+	int query(double fromTime, double toTime, std::vector<std::vector<uint8_t>>& arrFrames) const;
+
+	/**
+	 * Reduces a compact frame to the selected rigid bodies and skeletons.
+	 *
+	 * @param refFrame      the compact frame to reduce (in place)
+	 * @param refSelection  the selected entities
+	 * @param refEncoder    the encoder for the reduced frame
+	 *
+	 * @return <code>true</code> if the frame could be reduced
+	 */
+	static bool filterFrame(std::vector<uint8_t>& refFrame, const sHistorySelection& refSelection, CompactEncoder& refEncoder);
+
+	/**
+	 * Gets a printable summary of the history.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	struct sSlot
+	{
+		std::atomic<uint32_t> sequence;  // odd while the slot is written
+		uint64_t              index;     // number of the frame since the history was cleared
+		double                timestamp;
+		int                   size;
+		uint8_t               data[FRAME_HISTORY_SLOT_SIZE];
+	};
+
+	/**
+	 * Copies a slot, if it isn't overwritten during the copy.
+	 *
+	 * @return <code>true</code> if the copy is consistent and contains the expected frame
+	 */
+	bool readSlot(uint64_t index, double& refTimestamp, std::vector<uint8_t>& refData) const;
+
+private:
+
+	mutable std::mutex       mtxSlots; // only protects against resizing while reading
+	int                      depth;
+	std::unique_ptr<sSlot[]> arrSlots;
+	std::atomic<uint64_t>    framesWritten;
+	unsigned long            framesTooBig;
+	CompactEncoder           encoder;
+
+	// names of the current description for resolving filters
+	mutable std::mutex       mtxNames;
+	unsigned int             descriptionGeneration;
+	std::vector<std::pair<std::string, int32_t>> arrRigidBodyNames, arrSkeletonNames;
+};
@@ -0,0 +1,193 @@
+#include "FramePacer.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FramePacer"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+
+// weight of a new measurement in the moving averages
+#define PACING_AVG_WEIGHT   0.05f
+// load above which the output is degraded further
+#define PACING_LOAD_HIGH    0.8f
+// load below which the output is restored step by step
+#define PACING_LOAD_LOW     0.4f
+// minimum time in s to stay on a level before degrading further (recovery takes 4x as long)
+#define PACING_HOLD_TIME    0.5f
+// frames waiting for the pipeline before they are dropped, regardless of the level
+#define PACING_MAX_WAITING  3
+
+
+FramePacer::FramePacer() :
+	framesWaiting(0)
+{
+	reset();
+}
+
+
+void FramePacer::reset()
+{
+	level         = PACING_NORMAL;
+	framesAtLevel = 0;
+	frameCounter  = 0;
+	firstFrame    = true;
+	firstCost     = true;
+	tLastArrival  = tClock::time_point();
+	avgInterval   = 0;
+	avgCost       = 0;
+	avgSend       = 0;
+	load          = 0;
+	framesDropped = 0;
+	levelChanges  = 0;
+}
+
+
+FramePacer::tClock::time_point FramePacer::frameArrived()
+{
+	framesWaiting++;
+	return tClock::now();
+}
+
+
+void FramePacer::frameDiscarded()
+{
+	framesWaiting--;
+}
+
+
+bool FramePacer::startFrame()
+{
+	int waitingBehind = --framesWaiting;
+	frameCounter++;
+
+	bool process = true;
+	if (waitingBehind >= PACING_MAX_WAITING)
+	{
+		// too many frames queued up > this one is stale anyway
+		process = false;
+	}
+	else if (level == PACING_DROP_FRAMES)
+	{
+		// drop frames when a newer one is already waiting, and every second frame
+		process = (waitingBehind == 0) && ((frameCounter & 1) == 0);
+	}
+
+	if (!process)
+	{
+		framesDropped++;
+	}
+	return process;
+}
+
+
+void FramePacer::frameCompleted(tClock::time_point tArrival, tDuration sendDuration, bool streamed)
+{
+	const tClock::time_point now = tClock::now();
+
+	// the interval is measured across all frames of the source, including the dropped ones
+	const bool  hasInterval = !firstFrame;
+	const float interval    = std::chrono::duration<float>(tArrival - tLastArrival).count();
+	tLastArrival = tArrival;
+	firstFrame   = false;
+
+	if (hasInterval)
+	{
+		avgInterval = (avgInterval > 0) ? (avgInterval + PACING_AVG_WEIGHT * (interval - avgInterval)) : interval;
+	}
+
+	// dropped frames cost next to nothing and would hide the load
+	if (!streamed) return;
+
+	const float cost = std::chrono::duration<float>(now - tArrival).count();
+	const float send = std::chrono::duration<float>(sendDuration).count();
+	if (firstCost)
+	{
+		avgCost   = cost;
+		avgSend   = send;
+		firstCost = false;
+	}
+	else
+	{
+		avgCost += PACING_AVG_WEIGHT * (cost - avgCost);
+		avgSend += PACING_AVG_WEIGHT * (send - avgSend);
+	}
+
+	if (avgInterval <= 0) return;
+
+	load = avgCost / avgInterval;
+	framesAtLevel++;
+
+	const int holdFrames = std::max(10, (int) (PACING_HOLD_TIME / avgInterval));
+	if ((load > PACING_LOAD_HIGH) && (level < PACING_DROP_FRAMES) && (framesAtLevel >= holdFrames))
+	{
+		changeLevel((ePacingLevel) (level + 1), load);
+	}
+	else if ((load < PACING_LOAD_LOW) && (level > PACING_NORMAL) && (framesAtLevel >= 4 * holdFrames))
+	{
+		changeLevel((ePacingLevel) (level - 1), load);
+	}
+}
+
+
+ePacingLevel FramePacer::getLevel() const
+{
+	return level;
+}
+
+
+bool FramePacer::isSkippingMarkerSets() const
+{
+	return (level >= PACING_SKIP_MARKERSETS);
+}
+
+
+bool FramePacer::isDecimating() const
+{
+	return (level >= PACING_DECIMATE);
+}
+
+
+std::string FramePacer::getStatus() const
+{
+	std::stringstream strm;
+	strm << std::fixed << std::setprecision(2)
+	     << "Pacing level   : " << getLevelName(level) << std::endl
+	     << "Frame interval : " << (avgInterval * 1000) << "ms" << std::endl
+	     << "Pipeline cost  : " << (avgCost * 1000) << "ms (sending: " << (avgSend * 1000) << "ms)" << std::endl
+	     << "Load           : " << std::setprecision(0) << (load * 100) << "%" << std::endl
+	     << "Dropped frames : " << framesDropped << std::endl
+	     << "Level changes  : " << levelChanges;
+	return strm.str();
+}
+
+
+const char* FramePacer::getLevelName(ePacingLevel level)
+{
+	switch (level)
+	{
+		case PACING_NORMAL:          return "normal";
+		case PACING_SKIP_MARKERSETS: return "skipping marker sets";
+		case PACING_DECIMATE:        return "decimating low priority outputs";
+		case PACING_DROP_FRAMES:     return "dropping frames";
+	}
+	return "unknown";
+}
+
+
+void FramePacer::changeLevel(ePacingLevel newLevel, float currentLoad)
+{
+	if (newLevel > level)
+	{
+		LOG_WARNING("Frame pipeline overloaded (load " << (int) (currentLoad * 100) << "%) > " << getLevelName(newLevel));
+	}
+	else
+	{
+		LOG_INFO("Frame pipeline recovering (load " << (int) (currentLoad * 100) << "%) > " << getLevelName(newLevel));
+	}
+	level         = newLevel;
+	framesAtLevel = 0;
+	levelChanges++;
+}
@@ -0,0 +1,142 @@
+/**
+ * Controller that watches the cost of the frame pipeline and
+ * degrades the output step by step when frames can't be processed in time.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+
+/**
+ * Degradation levels of the output, from normal operation to dropping whole frames.
+ */
+enum ePacingLevel
+{
+	PACING_NORMAL = 0,      ///< all data is streamed
+	PACING_SKIP_MARKERSETS, ///< marker sets and unidentified markers are not streamed
+	PACING_DECIMATE,        ///< additionally, low priority endpoints only get every second frame
+	PACING_DROP_FRAMES      ///< additionally, frames are dropped to keep up with the source
+};
+
+
+/**
+ * Class for measuring the frame pipeline and deciding on the pacing level.
+ *
+ * Usage in the frame handler:
+ *   frameArrived() > lock pipeline > startFrame() > process/send > frameCompleted() > unlock pipeline
+ *   or frameArrived() > lock pipeline > frameDiscarded() > unlock pipeline for frames that are not streamed
+ * Frames generated by the server itself (repeated poses, keepalive frames) bypass the pacer completely,
+ * so they don't distort the measured frame interval and cost of the source, and are never dropped.
+ */
+class FramePacer
+{
+public:
+
+	typedef std::chrono::steady_clock           tClock;
+	typedef std::chrono::steady_clock::duration tDuration;
+
+	FramePacer();
+
+	/**
+	 * Resets the measurements and returns to normal operation.
+	 */
+	void reset();
+
+	/**
+	 * Registers a new frame that is waiting for the pipeline.
+	 * This function can be called without holding the pipeline lock.
+	 *
+	 * @return the arrival time of the frame
+	 */
+	tClock::time_point frameArrived();
+
+	/**
+	 * Withdraws a frame registered with frameArrived() that doesn't enter the pipeline after all,
+	 * e.g., because there was no new data or the frame belongs to a system that isn't streamed.
+	 * This function can be called without holding the pipeline lock.
+	 */
+	void frameDiscarded();
+
+	/**
+	 * Decides if the frame is to be processed.
+	 * Must be called with the pipeline lock held.
+	 *
+	 * @return <code>true</code> if the frame is to be processed,
+	 *         <code>false</code> if it is to be dropped
+	 */
+	bool startFrame();
+
+	/**
+	 * Registers the completion of a frame from the source and adapts the pacing level.
+	 * Dropped frames only advance the frame interval, they don't count towards the cost.
+	 * Must be called with the pipeline lock held.
+	 *
+	 * @param tArrival      the arrival time of the frame as returned by frameArrived()
+	 * @param sendDuration  the time it took to send the frame through all endpoints
+	 * @param streamed      <code>true</code> if the frame was processed and streamed,
+	 *                      <code>false</code> if it was dropped
+	 */
+	void frameCompleted(tClock::time_point tArrival, tDuration sendDuration, bool streamed);
+
+	/**
+	 * Gets the current pacing level.
+	 *
+	 * @return the pacing level
+	 */
+	ePacingLevel getLevel() const;
+
+	/**
+	 * Checks if marker sets are to be left out of the streamed frames.
+	 *
+	 * @return <code>true</code> if marker sets are to be skipped
+	 */
+	bool isSkippingMarkerSets() const;
+
+	/**
+	 * Checks if low priority endpoints are to be decimated.
+	 *
+	 * @return <code>true</code> if low priority endpoints are to be decimated
+	 */
+	bool isDecimating() const;
+
+	/**
+	 * Gets a printable summary of the measurements.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+	/**
+	 * Gets a printable name of a pacing level.
+	 *
+	 * @param level  the pacing level
+	 *
+	 * @return the name of the level
+	 */
+	static const char* getLevelName(ePacingLevel level);
+
+private:
+
+	void changeLevel(ePacingLevel newLevel, float currentLoad);
+
+private:
+
+	std::atomic<int>   framesWaiting;    // frames waiting for the pipeline
+	ePacingLevel       level;
+	int                framesAtLevel;    // frames processed since the last level change
+	int                frameCounter;     // for dropping every second frame
+
+	bool               firstFrame;
+	bool               firstCost;
+	tClock::time_point tLastArrival;
+	float              avgInterval;      // moving average of the frame interval in s
+	float              avgCost;          // moving average of the pipeline cost (including waiting) in s
+	float              avgSend;          // moving average of the sending time in s
+	float              load;             // ratio of pipeline cost and frame interval
+
+	unsigned long      framesDropped;
+	unsigned long      levelChanges;
+};
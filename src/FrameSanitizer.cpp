@@ -0,0 +1,463 @@
+#include "FrameSanitizer.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FrameSanitizer"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+
+// flags for the problems of a body
+#define SANITIZE_NON_FINITE     0x01
+#define SANITIZE_ZERO_ROTATION  0x02
+#define SANITIZE_RENORMALISED   0x04
+#define SANITIZE_FLIPPED        0x08
+#define SANITIZE_OUT_OF_VOLUME  0x10
+// problems that make a sample unusable
+#define SANITIZE_REJECT         (SANITIZE_NON_FINITE | SANITIZE_ZERO_ROTATION | SANITIZE_OUT_OF_VOLUME)
+
+// squared quaternion length below which the rotation is considered missing
+#define SANITIZE_MIN_LENGTH2    1e-12f
+// deviation of the squared quaternion length from 1 that counts as denormalised (rounding errors are always renormalised)
+#define SANITIZE_TOLERANCE      1e-3f
+
+// non-aliasing pointers for the vectorised loops
+#ifdef _MSC_VER
+#define SANITIZE_RESTRICT __restrict
+#else
+#define SANITIZE_RESTRICT __restrict__
+#endif
+
+
+/**
+ * Checks a float for NaN and Inf through its exponent bits, which, unlike std::isfinite(), vectorises.
+ *
+ * @return 1 if the value is finite, 0 if not
+ */
+static inline uint32_t isFinite(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return ((bits & 0x7F800000u) != 0x7F800000u) ? 1u : 0u;
+}
+
+
+/******************************************************************************
+ * FrameSanitizer class
+ */
+
+FrameSanitizer::FrameSanitizer() :
+	useVolume(false),
+	descriptionGeneration(0),
+	framesChecked(0),
+	framesRepaired(0)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		arrMin[axis] = 0;
+		arrMax[axis] = 0;
+	}
+	otherMarkerCounters = sCounters();
+	otherMarkerCounters.name = "Unidentified markers";
+}
+
+
+bool FrameSanitizer::configure(const std::string& strVolume)
+{
+	bool success = true;
+	useVolume = false;
+
+	if (!strVolume.empty())
+	{
+		// "minX,minY,minZ,maxX,maxY,maxZ"
+		std::string strValues(strVolume);
+		std::replace(strValues.begin(), strValues.end(), ',', ' ');
+		std::istringstream strm(strValues);
+		float arrValues[6];
+		for (int idx = 0; idx < 6; idx++)
+		{
+			strm >> arrValues[idx];
+		}
+		if (strm.fail())
+		{
+			LOG_ERROR("Invalid capture volume '" << strVolume << "'");
+			success = false;
+		}
+		else
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				arrMin[axis] = std::min(arrValues[axis], arrValues[axis + 3]);
+				arrMax[axis] = std::max(arrValues[axis], arrValues[axis + 3]);
+			}
+			useVolume = true;
+			LOG_INFO("Rejecting samples outside of ("
+				<< arrMin[0] << ", " << arrMin[1] << ", " << arrMin[2] << ") - ("
+				<< arrMax[0] << ", " << arrMax[1] << ", " << arrMax[2] << ")");
+		}
+	}
+
+	// start counting again
+	descriptionGeneration = 0;
+	arrBodyCounters.clear();
+	arrMarkerSetCounters.clear();
+	otherMarkerCounters = sCounters();
+	otherMarkerCounters.name = "Unidentified markers";
+	framesChecked  = 0;
+	framesRepaired = 0;
+	return success;
+}
+
+
+void FrameSanitizer::reset(const MoCapData& refData)
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+
+	// names of the entities for the counters
+	arrBodyCounters.clear();
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		sCounters counters = sCounters();
+		const sRigidBodyDescription* pDescription = refData.findRigidBodyDescription(refFrame.RigidBodies[rbIdx]);
+		counters.name = pDescription ? pDescription->szName : ("Rigid body " + std::to_string(refFrame.RigidBodies[rbIdx].ID));
+		arrBodyCounters.push_back(counters);
+	}
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		const sSkeletonData&        refSkeleton  = refFrame.Skeletons[sIdx];
+		const sSkeletonDescription* pDescription = refData.findSkeletonDescription(refSkeleton);
+		const std::string strSkeleton = pDescription ? pDescription->szName : ("Skeleton " + std::to_string(refSkeleton.skeletonID));
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			sCounters counters = sCounters();
+			counters.name = strSkeleton + "/" + ((pDescription && (bIdx < pDescription->nRigidBodies)) ?
+				std::string(pDescription->RigidBodies[bIdx].szName) : std::to_string(refSkeleton.RigidBodyData[bIdx].ID));
+			arrBodyCounters.push_back(counters);
+		}
+	}
+	arrMarkerSetCounters.clear();
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		sCounters counters = sCounters();
+		counters.name = refFrame.MocapData[msIdx].szName;
+		arrMarkerSetCounters.push_back(counters);
+	}
+
+	// no previous orientations
+	const size_t bodyCount = arrBodyCounters.size();
+	arrPrevQX.assign(bodyCount, 0);
+	arrPrevQY.assign(bodyCount, 0);
+	arrPrevQZ.assign(bodyCount, 0);
+	arrPrevQW.assign(bodyCount, 1);
+	arrHasPrev.assign(bodyCount, 0);
+
+	descriptionGeneration = refData.descriptionGeneration;
+}
+
+
+void FrameSanitizer::process(MoCapData& refData, const sTransform& refTransform)
+{
+	sFrameOfMocapData& refFrame = refData.frame;
+	volumeTransform = refTransform;
+
+	size_t bodyCount = refFrame.nRigidBodies;
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		bodyCount += std::max(0, refFrame.Skeletons[sIdx].nRigidBodies);
+	}
+	if ((refData.descriptionGeneration != descriptionGeneration) ||
+	    (bodyCount != arrBodyCounters.size()) ||
+	    ((size_t) refFrame.nMarkerSets != arrMarkerSetCounters.size()))
+	{
+		reset(refData);
+	}
+	framesChecked++;
+
+	// entity counts the clients can't handle
+	bool repaired = false;
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		sMarkerSetData& refMarkerSet = refFrame.MocapData[msIdx];
+		if (refMarkerSet.nMarkers > MAX_MARKERS)
+		{
+			// only once, the status shows how often
+			if (arrMarkerSetCounters[msIdx].overruns == 0) LOG_WARNING("Marker set '" << refMarkerSet.szName << "' has " << refMarkerSet.nMarkers << " markers, truncating to " << MAX_MARKERS);
+			refMarkerSet.nMarkers = MAX_MARKERS;
+			arrMarkerSetCounters[msIdx].overruns++;
+			repaired = true;
+		}
+	}
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		sRigidBodyData& refRigidBody = refFrame.RigidBodies[rbIdx];
+		if (refRigidBody.nMarkers > MAX_RBMARKERS)
+		{
+			refRigidBody.nMarkers = MAX_RBMARKERS;
+			arrBodyCounters[rbIdx].overruns++;
+			repaired = true;
+		}
+	}
+	if (refFrame.nOtherMarkers > MAX_UNLABELED_MARKERS)
+	{
+		refFrame.nOtherMarkers = MAX_UNLABELED_MARKERS;
+		otherMarkerCounters.overruns++;
+		repaired = true;
+	}
+
+	gather(refFrame);
+	checkBodies();
+	for (size_t idx = 0; idx < arrFlags.size(); idx++)
+	{
+		repaired |= ((arrFlags[idx] != 0) && ((arrBodies[idx]->params & STATUS_TRACKED) != 0));
+	}
+	scatter();
+
+	unsigned long markerProblems = 0;
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		sCounters& refCounters = arrMarkerSetCounters[msIdx];
+		const unsigned long before = refCounters.nonFinite + refCounters.outOfVolume;
+		checkMarkers(refFrame.MocapData[msIdx].Markers, refFrame.MocapData[msIdx].nMarkers, refCounters);
+		markerProblems += refCounters.nonFinite + refCounters.outOfVolume - before;
+	}
+	const unsigned long before = otherMarkerCounters.nonFinite + otherMarkerCounters.outOfVolume;
+	checkMarkers(refFrame.OtherMarkers, refFrame.nOtherMarkers, otherMarkerCounters);
+	markerProblems += otherMarkerCounters.nonFinite + otherMarkerCounters.outOfVolume - before;
+
+	if (repaired || (markerProblems > 0))
+	{
+		framesRepaired++;
+	}
+}
+
+
+void FrameSanitizer::gather(sFrameOfMocapData& refFrame)
+{
+	arrBodies.clear();
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		arrBodies.push_back(&refFrame.RigidBodies[rbIdx]);
+	}
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		sSkeletonData& refSkeleton = refFrame.Skeletons[sIdx];
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			arrBodies.push_back(&refSkeleton.RigidBodyData[bIdx]);
+		}
+	}
+
+	const size_t bodyCount = arrBodies.size();
+	arrX.resize(bodyCount);  arrY.resize(bodyCount);  arrZ.resize(bodyCount);
+	arrQX.resize(bodyCount); arrQY.resize(bodyCount); arrQZ.resize(bodyCount); arrQW.resize(bodyCount);
+	arrFlags.resize(bodyCount);
+	for (size_t idx = 0; idx < bodyCount; idx++)
+	{
+		const sRigidBodyData& rb = *arrBodies[idx];
+		arrX[idx]  = rb.x;  arrY[idx]  = rb.y;  arrZ[idx]  = rb.z;
+		arrQX[idx] = rb.qx; arrQY[idx] = rb.qy; arrQZ[idx] = rb.qz; arrQW[idx] = rb.qw;
+	}
+}
+
+
+void FrameSanitizer::checkBodies()
+{
+	// the loops only use selects and masks, so they vectorise (non-aliasing pointers, no branches)
+	const int bodyCount = (int) arrBodies.size();
+	float*   SANITIZE_RESTRICT x  = arrX.data();
+	float*   SANITIZE_RESTRICT y  = arrY.data();
+	float*   SANITIZE_RESTRICT z  = arrZ.data();
+	float*   SANITIZE_RESTRICT qx = arrQX.data();
+	float*   SANITIZE_RESTRICT qy = arrQY.data();
+	float*   SANITIZE_RESTRICT qz = arrQZ.data();
+	float*   SANITIZE_RESTRICT qw = arrQW.data();
+	uint8_t* SANITIZE_RESTRICT flags = arrFlags.data();
+	const float* SANITIZE_RESTRICT pqx = arrPrevQX.data();
+	const float* SANITIZE_RESTRICT pqy = arrPrevQY.data();
+	const float* SANITIZE_RESTRICT pqz = arrPrevQZ.data();
+	const float* SANITIZE_RESTRICT pqw = arrPrevQW.data();
+	const float* SANITIZE_RESTRICT hasPrev = arrHasPrev.data();
+
+	// non-finite values > origin and identity
+	for (int idx = 0; idx < bodyCount; idx++)
+	{
+		const float vx  = x[idx],  vy  = y[idx],  vz  = z[idx];
+		const float vqx = qx[idx], vqy = qy[idx], vqz = qz[idx], vqw = qw[idx];
+		const bool  finite = (isFinite(vx) & isFinite(vy) & isFinite(vz) &
+		                      isFinite(vqx) & isFinite(vqy) & isFinite(vqz) & isFinite(vqw)) != 0;
+		flags[idx] = (uint8_t) (finite ? 0 : SANITIZE_NON_FINITE);
+		x[idx]  = finite ? vx  : 0.0f;
+		y[idx]  = finite ? vy  : 0.0f;
+		z[idx]  = finite ? vz  : 0.0f;
+		qx[idx] = finite ? vqx : 0.0f;
+		qy[idx] = finite ? vqy : 0.0f;
+		qz[idx] = finite ? vqz : 0.0f;
+		qw[idx] = finite ? vqw : 1.0f;
+	}
+
+	// unit quaternions, identity for missing rotations
+	for (int idx = 0; idx < bodyCount; idx++)
+	{
+		const float vqx = qx[idx], vqy = qy[idx], vqz = qz[idx], vqw = qw[idx];
+		const float len2  = vqx * vqx + vqy * vqy + vqz * vqz + vqw * vqw;
+		const float inv   = 1.0f / sqrtf(len2 + 1e-30f); // the values are finite, so this is finite as well
+		const int   valid = len2 > SANITIZE_MIN_LENGTH2;
+		const float mask  = (float) valid;
+		const float dev   = len2 - 1.0f;
+		const int   denormalised = valid & ((dev * dev) > (SANITIZE_TOLERANCE * SANITIZE_TOLERANCE));
+		qx[idx] = vqx * inv * mask;
+		qy[idx] = vqy * inv * mask;
+		qz[idx] = vqz * inv * mask;
+		qw[idx] = vqw * inv * mask + (1.0f - mask);
+		flags[idx] = (uint8_t) (flags[idx] | ((1 - valid) * SANITIZE_ZERO_ROTATION) | (denormalised * SANITIZE_RENORMALISED));
+	}
+
+	// same hemisphere as in the previous frame, so clients interpolating the components don't spin around
+	for (int idx = 0; idx < bodyCount; idx++)
+	{
+		const float vqx = qx[idx], vqy = qy[idx], vqz = qz[idx], vqw = qw[idx];
+		const float dot  = vqx * pqx[idx] + vqy * pqy[idx] + vqz * pqz[idx] + vqw * pqw[idx];
+		const int   flip = (hasPrev[idx] * dot) < 0;
+		const float sign = 1.0f - 2.0f * (float) flip;
+		qx[idx] = vqx * sign;
+		qy[idx] = vqy * sign;
+		qz[idx] = vqz * sign;
+		qw[idx] = vqw * sign;
+		flags[idx] = (uint8_t) (flags[idx] | (flip * SANITIZE_FLIPPED));
+	}
+
+	if (useVolume)
+	{
+		const float minX = arrMin[0], minY = arrMin[1], minZ = arrMin[2];
+		const float maxX = arrMax[0], maxY = arrMax[1], maxZ = arrMax[2];
+		const float (&m)[3][4] = volumeTransform.matrix;
+		for (int idx = 0; idx < bodyCount; idx++)
+		{
+			// position in the stream
+			const float vx = m[0][0] * x[idx] + m[0][1] * y[idx] + m[0][2] * z[idx] + m[0][3];
+			const float vy = m[1][0] * x[idx] + m[1][1] * y[idx] + m[1][2] * z[idx] + m[1][3];
+			const float vz = m[2][0] * x[idx] + m[2][1] * y[idx] + m[2][2] * z[idx] + m[2][3];
+			const int inside =
+				(vx >= minX) & (vx <= maxX) &
+				(vy >= minY) & (vy <= maxY) &
+				(vz >= minZ) & (vz <= maxZ);
+			flags[idx] = (uint8_t) (flags[idx] | ((1 - inside) * SANITIZE_OUT_OF_VOLUME));
+		}
+	}
+}
+
+
+void FrameSanitizer::scatter()
+{
+	const size_t bodyCount = arrBodies.size();
+	for (size_t idx = 0; idx < bodyCount; idx++)
+	{
+		sRigidBodyData& rb = *arrBodies[idx];
+		rb.x  = arrX[idx];  rb.y  = arrY[idx];  rb.z  = arrZ[idx];
+		rb.qx = arrQX[idx]; rb.qy = arrQY[idx]; rb.qz = arrQZ[idx]; rb.qw = arrQW[idx];
+
+		// untracked bodies are only repaired, e.g., the zero rotation some systems send for them
+		if ((rb.params & STATUS_TRACKED) == 0) continue;
+
+		const uint8_t flags = arrFlags[idx];
+		if (flags != 0)
+		{
+			sCounters& refCounters = arrBodyCounters[idx];
+			if (flags & SANITIZE_NON_FINITE)    refCounters.nonFinite++;
+			if (flags & SANITIZE_ZERO_ROTATION) refCounters.zeroRotation++;
+			if (flags & SANITIZE_RENORMALISED)  refCounters.renormalised++;
+			if (flags & SANITIZE_FLIPPED)       refCounters.flipped++;
+			if (flags & SANITIZE_OUT_OF_VOLUME) refCounters.outOfVolume++;
+		}
+
+		if ((flags & SANITIZE_REJECT) != 0)
+		{
+			rb.params &= (short) ~STATUS_TRACKED;
+		}
+		else
+		{
+			arrPrevQX[idx]  = arrQX[idx];
+			arrPrevQY[idx]  = arrQY[idx];
+			arrPrevQZ[idx]  = arrQZ[idx];
+			arrPrevQW[idx]  = arrQW[idx];
+			arrHasPrev[idx] = 1;
+		}
+	}
+}
+
+
+void FrameSanitizer::checkMarkers(MarkerData* arrMarkers, int count, sCounters& refCounters)
+{
+	if ((arrMarkers == nullptr) || (count <= 0)) return;
+
+	const float minX = useVolume ? arrMin[0] : -INFINITY, maxX = useVolume ? arrMax[0] : INFINITY;
+	const float minY = useVolume ? arrMin[1] : -INFINITY, maxY = useVolume ? arrMax[1] : INFINITY;
+	const float minZ = useVolume ? arrMin[2] : -INFINITY, maxZ = useVolume ? arrMax[2] : INFINITY;
+	const float (&t)[3][4] = volumeTransform.matrix;
+
+	uint32_t nonFinite = 0, outside = 0;
+	for (int idx = 0; idx < count; idx++)
+	{
+		float* m = arrMarkers[idx];
+		const uint32_t finite = isFinite(m[0]) & isFinite(m[1]) & isFinite(m[2]);
+		// (0, 0, 0) marks missing markers and is kept, even outside the volume
+		const bool zero   = (m[0] == 0) & (m[1] == 0) & (m[2] == 0);
+		// position in the stream
+		const float sx = t[0][0] * m[0] + t[0][1] * m[1] + t[0][2] * m[2] + t[0][3];
+		const float sy = t[1][0] * m[0] + t[1][1] * m[1] + t[1][2] * m[2] + t[1][3];
+		const float sz = t[2][0] * m[0] + t[2][1] * m[1] + t[2][2] * m[2] + t[2][3];
+		const bool inside =
+			(sx >= minX) & (sx <= maxX) &
+			(sy >= minY) & (sy <= maxY) &
+			(sz >= minZ) & (sz <= maxZ);
+		const bool keep = finite && (inside || zero);
+		nonFinite += finite ? 0 : 1;
+		outside   += (finite && !keep) ? 1 : 0;
+		m[0] = keep ? m[0] : 0;
+		m[1] = keep ? m[1] : 0;
+		m[2] = keep ? m[2] : 0;
+	}
+	refCounters.nonFinite   += nonFinite;
+	refCounters.outOfVolume += outside;
+}
+
+
+std::string FrameSanitizer::getStatus() const
+{
+	std::stringstream strm;
+	strm << "Checked frames : " << framesChecked << " (" << framesRepaired << " repaired)" << std::endl
+	     << "Capture volume : ";
+	if (useVolume)
+	{
+		strm << "(" << arrMin[0] << ", " << arrMin[1] << ", " << arrMin[2] << ") - ("
+		     << arrMax[0] << ", " << arrMax[1] << ", " << arrMax[2] << ")";
+	}
+	else
+	{
+		strm << "not limited";
+	}
+
+	// only list the entities that had problems
+	auto printCounters = [&strm](const sCounters& refCounters)
+	{
+		if (refCounters.nonFinite + refCounters.zeroRotation + refCounters.renormalised +
+		    refCounters.flipped + refCounters.outOfVolume + refCounters.overruns == 0) return;
+
+		strm << std::endl << refCounters.name << ":";
+		if (refCounters.nonFinite)    strm << " " << refCounters.nonFinite    << " non-finite";
+		if (refCounters.zeroRotation) strm << " " << refCounters.zeroRotation << " zero rotation";
+		if (refCounters.renormalised) strm << " " << refCounters.renormalised << " renormalised";
+		if (refCounters.flipped)      strm << " " << refCounters.flipped      << " flipped";
+		if (refCounters.outOfVolume)  strm << " " << refCounters.outOfVolume  << " out of volume";
+		if (refCounters.overruns)     strm << " " << refCounters.overruns     << " too many markers";
+	};
+	for (const sCounters& refCounters : arrBodyCounters)      printCounters(refCounters);
+	for (const sCounters& refCounters : arrMarkerSetCounters) printCounters(refCounters);
+	printCounters(otherMarkerCounters);
+
+	return strm.str();
+}
@@ -0,0 +1,95 @@
+/**
+ * Validation of frames before they are processed and sent, so broken source data doesn't crash clients.
+ *
+ * Rigid bodies and skeleton bones are gathered into one array per value and checked in branch-free passes
+ * that the compiler can vectorise: non-finite values, zero-length and denormalised quaternions,
+ * quaternion sign flips against the previous frame, and positions outside the capture volume.
+ * Frames are checked in the coordinates of their source, before the source transforms are applied,
+ * so the positions are mapped through the transform of the source for the volume test,
+ * and the volume is given in the units of the stream, like the zones.
+ * Rejected bodies are marked as not tracked (so the gap filler can bridge them), rejected markers are zeroed.
+ * Entity counts above the NatNet limits are truncated.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Class for the frame sanitizer.
+ */
+class FrameSanitizer
+{
+public:
+
+	FrameSanitizer();
+
+	/**
+	 * Sets the capture volume and clears the counters.
+	 *
+	 * @param strVolume  the volume as "minX,minY,minZ,maxX,maxY,maxZ" in the units of the stream (empty: no limits)
+	 *
+	 * @return <code>true</code> if the volume could be parsed
+	 */
+	bool configure(const std::string& strVolume);
+
+	/**
+	 * Checks and repairs a frame in place.
+	 *
+	 * @param refData       the MoCap data with the frame to check
+	 * @param refTransform  the transform from the coordinates of the source into the stream, for the volume test
+	 */
+	void process(MoCapData& refData, const sTransform& refTransform);
+
+	/**
+	 * Gets a printable summary of the counters, with all entities that had problems.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	struct sCounters
+	{
+		std::string   name;
+		unsigned long nonFinite;    // NaN or Inf values
+		unsigned long zeroRotation; // zero-length quaternions
+		unsigned long renormalised; // quaternions that weren't unit length
+		unsigned long flipped;      // quaternions flipped to the hemisphere of the previous frame
+		unsigned long outOfVolume;  // samples outside the capture volume
+		unsigned long overruns;     // entity counts above the NatNet limits
+	};
+
+	void reset(const MoCapData& refData);
+	void gather(sFrameOfMocapData& refFrame);
+	void checkBodies();
+	void scatter();
+	void checkMarkers(MarkerData* arrMarkers, int count, sCounters& refCounters);
+
+private:
+
+	bool         useVolume;
+	float        arrMin[3], arrMax[3];
+	sTransform   volumeTransform;        // source to stream coordinates of the current frame
+
+	unsigned int descriptionGeneration;  // the state is reset when the description changes
+
+	// bodies of the current frame (rigid bodies first, then the bones of all skeletons)
+	std::vector<sRigidBodyData*> arrBodies;
+	std::vector<float>   arrX, arrY, arrZ, arrQX, arrQY, arrQZ, arrQW;
+	std::vector<uint8_t> arrFlags;       // problems found in the current frame
+	std::vector<float>   arrPrevQX, arrPrevQY, arrPrevQZ, arrPrevQW;
+	std::vector<float>   arrHasPrev;     // 1 if there is a previous orientation
+
+	std::vector<sCounters> arrBodyCounters, arrMarkerSetCounters;
+	sCounters              otherMarkerCounters;
+
+	unsigned long framesChecked;
+	unsigned long framesRepaired;
+};
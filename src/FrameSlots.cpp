@@ -0,0 +1,116 @@
+#include "FrameSlots.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FrameSlots"
+
+#include <algorithm>
+
+
+FrameSlots::FrameSlots(MoCapSystem& refSystem, tCommitHandler handler) :
+	refSystem(refSystem),
+	handler(handler),
+	front(0),
+	generation(0)
+{
+	for (int idx = 0; idx < FRAME_SLOT_COUNT; idx++)
+	{
+		arrSlotGeneration[idx] = arrSlots[idx].descriptionGeneration;
+		arrStale[idx]          = false;
+	}
+}
+
+
+bool FrameSlots::prepare()
+{
+	bool success = true;
+	for (int idx = 0; idx < FRAME_SLOT_COUNT; idx++)
+	{
+		success &= refSystem.getSceneDescription(arrSlots[idx]);
+		generation = std::max(generation, arrSlots[idx].descriptionGeneration);
+	}
+	// all slots start with the same generation
+	for (int idx = 0; idx < FRAME_SLOT_COUNT; idx++)
+	{
+		arrSlots[idx].descriptionGeneration = generation;
+		arrSlotGeneration[idx]              = generation;
+		arrStale[idx]                       = false;
+	}
+	return success;
+}
+
+
+MoCapData& FrameSlots::getSlot(int idx)
+{
+	return arrSlots[idx];
+}
+
+
+MoCapSystem& FrameSlots::getSystem()
+{
+	return refSystem;
+}
+
+
+MoCapData& FrameSlots::acquireFrame()
+{
+	const int back = (front + 1) % FRAME_SLOT_COUNT;
+
+	// the system fills in its own rigid bodies and skeletons only
+	arrSlots[back].removeDerivedRigidBodies();
+	arrSlots[back].removeDerivedSkeletons();
+
+	if (arrStale[back])
+	{
+		// the other slot has a new description > catch up before the system fills in a frame
+		LOG_INFO("Updating scene description of frame slot " << back);
+		refSystem.getSceneDescription(arrSlots[back]);
+		arrSlots[back].descriptionGeneration = arrSlotGeneration[back];
+		arrStale[back] = false;
+	}
+	return arrSlots[back];
+}
+
+
+void FrameSlots::commitFrame(tClock::time_point tCapture)
+{
+	handler(*this, tCapture);
+}
+
+
+MoCapData& FrameSlots::swap()
+{
+	front = (front + 1) % FRAME_SLOT_COUNT;
+
+	MoCapData& refFront = arrSlots[front];
+	if (refFront.descriptionGeneration != arrSlotGeneration[front])
+	{
+		// the system changed the description while filling in the frame > the other slots are outdated
+		generation = std::max(generation + 1, refFront.descriptionGeneration);
+		for (int idx = 0; idx < FRAME_SLOT_COUNT; idx++)
+		{
+			arrStale[idx]          = (idx != front);
+			arrSlotGeneration[idx] = generation;
+		}
+		refFront.descriptionGeneration = generation;
+	}
+	return refFront;
+}
+
+
+MoCapData& FrameSlots::getFront()
+{
+	return arrSlots[front];
+}
+
+
+void FrameSlots::advanceGeneration(unsigned int minGeneration)
+{
+	generation = std::max(generation, minGeneration) + 1;
+	for (int idx = 0; idx < FRAME_SLOT_COUNT; idx++)
+	{
+		// the back slot might be being filled in, but the system only touches the generation when it changes the description
+		arrSlots[idx].descriptionGeneration = generation;
+		arrSlotGeneration[idx]              = generation;
+	}
+}
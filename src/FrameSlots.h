@@ -0,0 +1,108 @@
+/**
+ * Frame slots through which a MoCap system pushes its frames into the server.
+ *
+ * Each MoCap system gets two slots: the front slot holds the last committed frame
+ * and is only accessed by the server with the MoCap data locked,
+ * the back slot belongs to the MoCap system, which fills it in without any lock.
+ * Committing swaps the slots.
+ *
+ * Both slots need their own scene description, because the NatNet frame structures are allocated according to it.
+ * When the MoCap system changes the description of one slot (e.g., Cortex scene update),
+ * the other slot is updated through MoCapSystem::getSceneDescription() before it is acquired the next time.
+ */
+
+#pragma once
+
+#include "MoCapSystem.h"
+
+#include <functional>
+
+
+// number of slots per MoCap system
+#define FRAME_SLOT_COUNT 2
+
+
+/**
+ * Class for the frame slots of one MoCap system.
+ */
+class FrameSlots : public FrameSink
+{
+public:
+
+	/**
+	 * Signature of the function that processes committed frames.
+	 * It is called on the thread of the MoCap system and has to call swap() with the MoCap data locked.
+	 */
+	typedef std::function<void(FrameSlots&, tClock::time_point)> tCommitHandler;
+
+	/**
+	 * Creates the frame slots for a MoCap system.
+	 *
+	 * @param refSystem  the MoCap system
+	 * @param handler    the function that processes committed frames
+	 */
+	FrameSlots(MoCapSystem& refSystem, tCommitHandler handler);
+
+	/**
+	 * Fills both slots with the scene description of the MoCap system.
+	 *
+	 * @return <code>true</code> if the description could be retrieved
+	 */
+	bool prepare();
+
+	/**
+	 * Gets one of the slots, e.g., to add descriptions of other systems to all slots before the frames start.
+	 *
+	 * @param idx  the slot index (0 ... FRAME_SLOT_COUNT - 1)
+	 *
+	 * @return the data of the slot
+	 */
+	MoCapData& getSlot(int idx);
+
+	/**
+	 * Gets the MoCap system of the slots.
+	 *
+	 * @return the MoCap system
+	 */
+	MoCapSystem& getSystem();
+
+	virtual MoCapData& acquireFrame();
+
+	virtual void commitFrame(tClock::time_point tCapture);
+
+	/**
+	 * Makes the committed frame the front frame.
+	 * Must be called by the commit handler, with the MoCap data locked.
+	 *
+	 * @return the front frame
+	 */
+	MoCapData& swap();
+
+	/**
+	 * Gets the last committed frame.
+	 * Must only be called with the MoCap data locked.
+	 *
+	 * @return the front frame
+	 */
+	MoCapData& getFront();
+
+	/**
+	 * Moves the description generation of all slots past a given generation without changing the description,
+	 * e.g., so clients notice the change when the server switches between MoCap systems.
+	 * Must only be called with the MoCap data locked.
+	 *
+	 * @param minGeneration  the generation to move past
+	 */
+	void advanceGeneration(unsigned int minGeneration);
+
+private:
+
+	MoCapSystem&   refSystem;
+	tCommitHandler handler;
+
+	MoCapData      arrSlots[FRAME_SLOT_COUNT];
+	unsigned int   arrSlotGeneration[FRAME_SLOT_COUNT]; // description generation the slot was published with
+	bool           arrStale[FRAME_SLOT_COUNT];          // the slot has an outdated description
+	int            front;
+	unsigned int   generation;                          // generation of the description of the front slot
+};
@@ -0,0 +1,234 @@
+#include "GapFiller.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "GapFiller"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+
+// time constant in s with which the velocity decays during a gap (the extrapolation ends after about 3x this time)
+#define GAPFILL_VELOCITY_DECAY  0.1f
+// weight of a new velocity measurement
+#define GAPFILL_VELOCITY_WEIGHT 0.5f
+// frame intervals above this time in s are treated as a restart of the stream
+#define GAPFILL_MAX_INTERVAL    1.0
+
+
+GapFiller::GapFiller() :
+	maxGap(0),
+	blendTime(0),
+	descriptionGeneration(0),
+	lastTime(0),
+	framesFilled(0),
+	bodiesFilled(0),
+	gapsFilled(0),
+	gapsExpired(0),
+	currentGaps(0)
+{
+	// nothing else to do
+}
+
+
+void GapFiller::configure(float maxGap, float blendTime)
+{
+	this->maxGap    = std::max(0.0f, maxGap);
+	this->blendTime = std::max(0.0f, blendTime);
+	resize(0);
+
+	if (isEnabled())
+	{
+		LOG_INFO("Filling tracking gaps of up to " << this->maxGap << "s (blending back over " << this->blendTime << "s)");
+	}
+}
+
+
+bool GapFiller::isEnabled() const
+{
+	return maxGap > 0;
+}
+
+
+void GapFiller::resize(size_t bodyCount)
+{
+	arrState.assign(bodyCount, BODY_UNKNOWN);
+	for (std::vector<float>* pArray : {
+		&arrPosX, &arrPosY, &arrPosZ, &arrRotX, &arrRotY, &arrRotZ, &arrRotW,
+		&arrVelX, &arrVelY, &arrVelZ, &arrGapTime, &arrOffX, &arrOffY, &arrOffZ,
+		&arrBlendX, &arrBlendY, &arrBlendZ, &arrBlendW, &arrBlendLeft })
+	{
+		pArray->assign(bodyCount, 0.0f);
+	}
+	currentGaps = 0;
+}
+
+
+void GapFiller::process(MoCapData& refData, double time)
+{
+	if (!isEnabled()) return;
+
+	sFrameOfMocapData& refFrame = refData.frame;
+
+	// gather the bodies in a fixed order: rigid bodies, then the bones of all skeletons
+	arrBodies.clear();
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		arrBodies.push_back(&refFrame.RigidBodies[rbIdx]);
+	}
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		sSkeletonData& refSkeleton = refFrame.Skeletons[sIdx];
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			arrBodies.push_back(&refSkeleton.RigidBodyData[bIdx]);
+		}
+	}
+
+	// new description > the order of the bodies might have changed
+	const size_t bodyCount = arrBodies.size();
+	if ((refData.descriptionGeneration != descriptionGeneration) || (bodyCount != arrState.size()))
+	{
+		resize(bodyCount);
+		descriptionGeneration = refData.descriptionGeneration;
+		lastTime = time;
+	}
+
+	const double interval = time - lastTime;
+	const float  dt = ((interval > 0) && (interval < GAPFILL_MAX_INTERVAL)) ? (float) interval : 0.0f;
+	lastTime = time;
+
+	bool filled = false;
+	for (size_t idx = 0; idx < bodyCount; idx++)
+	{
+		sRigidBodyData& rb = *arrBodies[idx];
+		rb.params &= (short) ~STATUS_FILLED;
+
+		if ((rb.params & STATUS_TRACKED) != 0)
+		{
+			if (arrState[idx] == BODY_FILLING)
+			{
+				// gap bridged > blend from the last filled pose to the measured one
+				const float decay = GAPFILL_VELOCITY_DECAY * (1 - expf(-arrGapTime[idx] / GAPFILL_VELOCITY_DECAY));
+				arrOffX[idx]   = arrPosX[idx] + arrVelX[idx] * decay - rb.x;
+				arrOffY[idx]   = arrPosY[idx] + arrVelY[idx] * decay - rb.y;
+				arrOffZ[idx]   = arrPosZ[idx] + arrVelZ[idx] * decay - rb.z;
+				arrBlendX[idx] = arrRotX[idx];
+				arrBlendY[idx] = arrRotY[idx];
+				arrBlendZ[idx] = arrRotZ[idx];
+				arrBlendW[idx] = arrRotW[idx];
+				arrBlendLeft[idx] = blendTime;
+				arrVelX[idx] = arrVelY[idx] = arrVelZ[idx] = 0;
+				gapsFilled++;
+				currentGaps--;
+			}
+			else if ((arrState[idx] == BODY_TRACKED) && (dt > 0))
+			{
+				arrVelX[idx] += GAPFILL_VELOCITY_WEIGHT * ((rb.x - arrPosX[idx]) / dt - arrVelX[idx]);
+				arrVelY[idx] += GAPFILL_VELOCITY_WEIGHT * ((rb.y - arrPosY[idx]) / dt - arrVelY[idx]);
+				arrVelZ[idx] += GAPFILL_VELOCITY_WEIGHT * ((rb.z - arrPosZ[idx]) / dt - arrVelZ[idx]);
+			}
+			else if (arrState[idx] == BODY_UNKNOWN)
+			{
+				arrVelX[idx] = arrVelY[idx] = arrVelZ[idx] = 0;
+			}
+
+			arrState[idx] = BODY_TRACKED;
+			arrPosX[idx] = rb.x;  arrPosY[idx] = rb.y;  arrPosZ[idx] = rb.z;
+			arrRotX[idx] = rb.qx; arrRotY[idx] = rb.qy; arrRotZ[idx] = rb.qz; arrRotW[idx] = rb.qw;
+
+			if (arrBlendLeft[idx] > 0)
+			{
+				// weight of the filled pose, falling linearly to 0
+				const float w = arrBlendLeft[idx] / blendTime;
+				rb.x += arrOffX[idx] * w;
+				rb.y += arrOffY[idx] * w;
+				rb.z += arrOffZ[idx] * w;
+
+				// normalised lerp on the shorter arc
+				const float dot  = rb.qx * arrBlendX[idx] + rb.qy * arrBlendY[idx] + rb.qz * arrBlendZ[idx] + rb.qw * arrBlendW[idx];
+				const float wb   = (dot < 0) ? -w : w;
+				const float qx   = rb.qx * (1 - w) + arrBlendX[idx] * wb;
+				const float qy   = rb.qy * (1 - w) + arrBlendY[idx] * wb;
+				const float qz   = rb.qz * (1 - w) + arrBlendZ[idx] * wb;
+				const float qw   = rb.qw * (1 - w) + arrBlendW[idx] * wb;
+				const float len  = sqrtf(qx * qx + qy * qy + qz * qz + qw * qw);
+				if (len > 0)
+				{
+					rb.qx = qx / len; rb.qy = qy / len; rb.qz = qz / len; rb.qw = qw / len;
+				}
+
+				rb.params |= STATUS_FILLED;
+				filled = true;
+				arrBlendLeft[idx] -= dt;
+			}
+		}
+		else
+		{
+			if (arrState[idx] == BODY_TRACKED)
+			{
+				arrState[idx]   = BODY_FILLING;
+				arrGapTime[idx] = 0;
+				currentGaps++;
+			}
+			else if (arrState[idx] == BODY_FILLING)
+			{
+				arrGapTime[idx] += dt;
+				if (arrGapTime[idx] > maxGap)
+				{
+					// too long to guess > pass through what the source sends
+					arrState[idx] = BODY_UNKNOWN;
+					gapsExpired++;
+					currentGaps--;
+				}
+			}
+			arrBlendLeft[idx] = 0;
+
+			if (arrState[idx] == BODY_FILLING)
+			{
+				// hold the last pose, extrapolating the position with a decaying velocity
+				const float decay = GAPFILL_VELOCITY_DECAY * (1 - expf(-arrGapTime[idx] / GAPFILL_VELOCITY_DECAY));
+				rb.x  = arrPosX[idx] + arrVelX[idx] * decay;
+				rb.y  = arrPosY[idx] + arrVelY[idx] * decay;
+				rb.z  = arrPosZ[idx] + arrVelZ[idx] * decay;
+				rb.qx = arrRotX[idx];
+				rb.qy = arrRotY[idx];
+				rb.qz = arrRotZ[idx];
+				rb.qw = arrRotW[idx];
+				rb.params |= STATUS_TRACKED | STATUS_FILLED;
+				bodiesFilled++;
+				filled = true;
+			}
+		}
+	}
+
+	if (filled)
+	{
+		refFrame.params |= FRAME_GAP_FILLED;
+		framesFilled++;
+	}
+	else
+	{
+		refFrame.params &= (short) ~FRAME_GAP_FILLED;
+	}
+}
+
+
+std::string GapFiller::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "Gap filling: disabled";
+		return strm.str();
+	}
+
+	strm << std::fixed << std::setprecision(3)
+	     << "Maximum gap    : " << maxGap << "s (blending back over " << blendTime << "s)" << std::endl
+	     << "Bodies         : " << arrState.size() << " (" << currentGaps << " currently filled)" << std::endl
+	     << "Filled frames  : " << framesFilled << " (" << bodiesFilled << " filled poses)" << std::endl
+	     << "Gaps           : " << gapsFilled << " bridged, " << gapsExpired << " longer than the maximum";
+	return strm.str();
+}
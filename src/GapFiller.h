@@ -0,0 +1,98 @@
+/**
+ * Fills short tracking gaps of rigid bodies and skeleton bones, so clients don't see objects jump to the origin
+ * when markers are occluded for a moment.
+ *
+ * While a body is not tracked, its last good pose is held, with the position extrapolated by a velocity
+ * that decays over the gap. When tracking resumes, the output blends from the filled pose back to the measured one.
+ * Bodies that stay untracked for longer than the maximum gap duration are passed through unchanged.
+ *
+ * The state of all bodies is kept in separate arrays per value (structure of arrays),
+ * so one frame costs a few microseconds even for hundreds of bodies.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Class for the gap filler.
+ */
+class GapFiller
+{
+public:
+
+	GapFiller();
+
+	/**
+	 * Configures the gap filler and clears the state of all bodies.
+	 *
+	 * @param maxGap     the longest gap in s to fill (0: disabled)
+	 * @param blendTime  the time in s for blending back to the measured pose after a gap
+	 */
+	void configure(float maxGap, float blendTime);
+
+	/**
+	 * Checks if the gap filler is enabled.
+	 *
+	 * @return <code>true</code> if gaps are filled
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Fills the gaps of the rigid bodies and skeleton bones of a frame in place.
+	 * Filled bodies are marked with STATUS_FILLED, the frame with FRAME_GAP_FILLED.
+	 *
+	 * @param refData  the MoCap data with the frame to process
+	 * @param time     the capture time of the frame in s
+	 */
+	void process(MoCapData& refData, double time);
+
+	/**
+	 * Gets a printable summary of the gap filler.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	enum eBodyState : uint8_t
+	{
+		BODY_UNKNOWN = 0, // not tracked since the last reset or for longer than the maximum gap
+		BODY_TRACKED,
+		BODY_FILLING
+	};
+
+	void resize(size_t bodyCount);
+
+private:
+
+	float        maxGap, blendTime;
+
+	unsigned int descriptionGeneration; // the state is reset when the description changes
+	double       lastTime;
+
+	// state per body (rigid bodies first, then the bones of all skeletons)
+	std::vector<uint8_t> arrState;
+	std::vector<float>   arrPosX, arrPosY, arrPosZ;               // last good position
+	std::vector<float>   arrRotX, arrRotY, arrRotZ, arrRotW;      // last good orientation
+	std::vector<float>   arrVelX, arrVelY, arrVelZ;               // smoothed velocity in units/s
+	std::vector<float>   arrGapTime;                              // duration of the current gap in s
+	std::vector<float>   arrOffX, arrOffY, arrOffZ;               // offset of the filled position when tracking resumed
+	std::vector<float>   arrBlendX, arrBlendY, arrBlendZ, arrBlendW; // filled orientation when tracking resumed
+	std::vector<float>   arrBlendLeft;                            // remaining blend time in s
+
+	// gathered bodies of the current frame
+	std::vector<sRigidBodyData*> arrBodies;
+
+	unsigned long framesFilled;
+	unsigned long bodiesFilled;  // number of filled body samples
+	unsigned long gapsFilled;    // gaps that were bridged completely
+	unsigned long gapsExpired;   // gaps that lasted longer than the maximum
+	int           currentGaps;
+};
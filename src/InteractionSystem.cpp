@@ -1,4 +1,5 @@
 #include "InteractionSystem.h"
+#include "ThreadTopology.h"
 
 #include "Logging.h"
 #undef   LOG_CLASS
@@ -266,6 +267,7 @@ bool InteractionSystem::deinitialise()
 
 void InteractionSystem::receiverThread()
 {
+	ThreadTopology::applyToCurrentThread("interaction", false);
 	LOG_INFO("Receiver Thread started");
 	while (isActive())
 	{
@@ -1,5 +1,6 @@
 #include "Logging.h"
 #include "MoCapData.h"
+#include "ClockService.h"
 
 #include <ios>
 #include <iomanip>
@@ -132,6 +133,7 @@ void printFrameOfData(std::ostream& refOutput, sFrameOfMocapData& refData)
 	refOutput << "Frame Data ("
 		<< "Frame# " << refData.iFrame 
 		<< ", Timestamp: " << (((int)(refData.fTimestamp * 1000)) / 1000.0f) << "s"
+		<< ", Timecode: " << ClockService::timecodeToString(refData.Timecode, refData.TimecodeSubframe)
 		<< ", Latency: " << (((int)(refData.fLatency * 1000)) / 1000.0f) << "s"
 		<< ")" << std::endl;
 
@@ -6,6 +6,7 @@
 #undef   LOG_CLASS
 #define  LOG_CLASS "MoCapCortex"
 
+#include "ThreadTopology.h"
 #include "VectorMath.h"
 
 #include <algorithm>
@@ -16,6 +17,9 @@
 #define MAX_UNKNOWN_MARKERS 256 // maximum number of unknown markers
 
 
+// the Cortex SDK only supports one connection, so the data handler can only serve one instance
+static std::atomic<MoCapCortex*> pCortexInstance(nullptr);
+
 
 /******************************************************************************
  * MoCapCortexConfiguration class
@@ -81,8 +85,19 @@ void __cdecl callbackMoCapCortexMessageHandler(int iMessageType, char* czMessage
  */
 void __cdecl callbackMoCapCortexDataHandler(sFrameOfData* pFrameOfData)
 {
-	// process data
-	// merely signal new frame, the main system will pick up the data through getFrameData(...)
+	// the SDK creates its own thread > configure it on the first frame
+	static thread_local bool threadConfigured = false;
+	if (!threadConfigured)
+	{
+		ThreadTopology::applyToCurrentThread("cortex", false);
+		threadConfigured = true;
+	}
+
+	// push the frame directly
+	MoCapCortex* pCortex = pCortexInstance;
+	if ((pCortex != nullptr) && pCortex->pushFrame(*pFrameOfData)) return;
+
+	// no frame sink > merely signal new frame, the main system will pick up the data through getFrameData(...)
 	// which uses Cortex_GetCurrentFrame() 
 	// which hopefully will have this frame data
 	signalNewFrame();
@@ -100,7 +115,9 @@ MoCapCortex::MoCapCortex(MoCapCortexConfiguration configuration) :
 	pCortexInfo(nullptr),
 	unitScaleFactor(1.0f),
 	updateRate(100.0f),
-	handleUnknownMarkers(false)
+	handleUnknownMarkers(false),
+	lastFrame(-1),
+	pSink(nullptr)
 {
 	// nothing else to do
 }
@@ -229,6 +246,40 @@ bool MoCapCortex::update()
 }
 
 
+bool MoCapCortex::setFrameSink(FrameSink* pSink)
+{
+	this->pSink = pSink;
+	pCortexInstance = (pSink != nullptr) ? this : nullptr;
+	return true;
+}
+
+
+bool MoCapCortex::pushFrame(sFrameOfData& refFrame)
+{
+	FrameSink* pFrameSink = pSink;
+	if (pFrameSink == nullptr) return false;
+
+	// Cortex reports how long ago the frame was captured
+	const FrameSink::tClock::time_point tCapture = FrameSink::tClock::now() -
+		std::chrono::duration_cast<FrameSink::tClock::duration>(std::chrono::duration<double>(std::max(0.0f, refFrame.fDelay)));
+
+	if (initialised && (refFrame.iFrame != lastFrame))
+	{
+		MoCapData& refData = pFrameSink->acquireFrame();
+		if (!convertCortexFrameToNatNet(refFrame, refData.frame))
+		{
+			// conversion failed - scene was updated?
+			getSceneDescription(refData);
+			// now try converting the frame again
+			convertCortexFrameToNatNet(refFrame, refData.frame);
+		}
+		lastFrame = refFrame.iFrame;
+		pFrameSink->commitFrame(tCapture);
+	}
+	return true;
+}
+
+
 bool MoCapCortex::getSceneDescription(MoCapData& refData)
 {
 	bool success = false;
@@ -241,6 +292,7 @@ bool MoCapCortex::getSceneDescription(MoCapData& refData)
 		{
 			convertCortexDescriptionToNatNet(*pBodyDefs, refData.description, refData.frame);
 			Cortex_FreeBodyDefs(pBodyDefs);
+			refData.descriptionChanged();
 			success = true;
 		}
 		else
@@ -253,9 +305,10 @@ bool MoCapCortex::getSceneDescription(MoCapData& refData)
 }
 
 
-bool MoCapCortex::getFrameData(MoCapData& refData)
+bool MoCapCortex::getFrameData(MoCapData& refData, bool& refNewFrame)
 {
 	bool success = false;
+	refNewFrame  = false;
 
 	if (initialised)
 	{
@@ -264,12 +317,18 @@ bool MoCapCortex::getFrameData(MoCapData& refData)
 
 		if (pFrame != nullptr)
 		{
-			if (!convertCortexFrameToNatNet(*pFrame, refData.frame))
+			// Cortex keeps returning the last frame when it doesn't receive any new data
+			if (pFrame->iFrame != lastFrame)
 			{
-				// conversion failed - scene was updated?
-				getSceneDescription(refData);
-				// now try converting the frame again
-				convertCortexFrameToNatNet(*pFrame, refData.frame);
+				if (!convertCortexFrameToNatNet(*pFrame, refData.frame))
+				{
+					// conversion failed - scene was updated?
+					getSceneDescription(refData);
+					// now try converting the frame again
+					convertCortexFrameToNatNet(*pFrame, refData.frame);
+				}
+				lastFrame   = pFrame->iFrame;
+				refNewFrame = true;
 			}
 			Cortex_FreeFrame(pFrame);
 			success = true;
@@ -325,6 +384,7 @@ bool MoCapCortex::deinitialise()
 	if (initialised)
 	{
 		Cortex_SetDataHandlerFunc(nullptr);
+		setFrameSink(nullptr);
 
 		delete pCortexInfo;
 		pCortexInfo = nullptr;
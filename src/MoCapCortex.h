@@ -14,6 +14,8 @@
 #include "Configuration.h"
 #include "Cortex.h"
 
+#include <atomic>
+
 
 class MoCapCortexConfiguration : public Configuration
 {
@@ -44,8 +46,9 @@ public:
 	virtual bool  isRunning();
 	virtual void  setRunning(bool running);
 	virtual bool  update();
+	virtual bool  setFrameSink(FrameSink* pSink);
 	virtual bool  getSceneDescription(MoCapData& refData);
-	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  getFrameData(MoCapData& refData, bool& refNewFrame);
 	virtual bool  processCommand(const std::string& strCommand);
 	virtual bool  deinitialise();
 
@@ -63,6 +66,16 @@ public:
 	 */
 	void  setHandleUnknownMarkers(bool enable);
 
+	/**
+	 * Pushes a frame from the Cortex data handler into the frame sink.
+	 *
+	 * @param refFrame  the frame received from Cortex
+	 *
+	 * @return <code>true</code> if the frame was pushed,
+	 *         <code>false</code> if there is no frame sink
+	 */
+	bool  pushFrame(sFrameOfData& refFrame);
+
 
 private:
 
@@ -92,6 +105,9 @@ private:
 	float      unitScaleFactor;
 	float      updateRate;
 	bool       handleUnknownMarkers;
+	int        lastFrame; // number of the last converted frame
+
+	std::atomic<FrameSink*> pSink;
 
 };
 
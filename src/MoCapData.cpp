@@ -1,15 +1,87 @@
 #include "MoCapData.h"
 
+#include <algorithm>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <memory.h>
 
 
+/******************************************************************************
+ * Helper functions
+ */
+
+/**
+ * Case insensitive wildcard match of a name against a pattern with '*' and '?'.
+ */
+bool matchesPattern(const char* czPattern, const char* czName)
+{
+	while (*czPattern != '\0')
+	{
+		if (*czPattern == '*')
+		{
+			// skip multiple stars, then try to match the rest at every position
+			while (*czPattern == '*') { czPattern++; }
+			if (*czPattern == '\0') return true;
+			for (; *czName != '\0'; czName++)
+			{
+				if (matchesPattern(czPattern, czName)) return true;
+			}
+			return false;
+		}
+		if (*czName == '\0') return false;
+		if ((*czPattern != '?') && (::tolower(*czPattern) != ::tolower(*czName))) return false;
+		czPattern++;
+		czName++;
+	}
+	return (*czName == '\0');
+}
+
+
+/**
+ * Transforms a marker position, markers at the origin are invalid and stay there.
+ */
+static inline void transformMarker(const float m[3][4], float& x, float& y, float& z)
+{
+	if ((x == 0) && (y == 0) && (z == 0)) return;
+	const float tx = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+	const float ty = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+	const float tz = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+	x = tx; y = ty; z = tz;
+}
+
+
+/**
+ * Transforms the position and optionally the orientation of a rigid body or bone.
+ */
+static inline void transformBody(const sTransform& t, sRigidBodyData& body, bool rotate)
+{
+	const float (&m)[3][4] = t.matrix;
+	const float x = body.x, y = body.y, z = body.z;
+	body.x = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+	body.y = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+	body.z = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+	body.MeanError *= t.scale; // "abused" for bone length
+
+	if (rotate)
+	{
+		const float qx = body.qx, qy = body.qy, qz = body.qz, qw = body.qw;
+		body.qx = t.qw * qx + t.qx * qw + t.qy * qz - t.qz * qy;
+		body.qy = t.qw * qy - t.qx * qz + t.qy * qw + t.qz * qx;
+		body.qz = t.qw * qz + t.qx * qy - t.qy * qx + t.qz * qw;
+		body.qw = t.qw * qw - t.qx * qx - t.qy * qy - t.qz * qz;
+	}
+}
+
+
 /******************************************************************************
  * MoCapData class
  */
 
-MoCapData::MoCapData()
+MoCapData::MoCapData() :
+	descriptionGeneration(0),
+	derivedRigidBodies(0),
+	derivedSkeletons(0)
 {
 	reset();
 }
@@ -27,44 +99,148 @@ void MoCapData::reset()
 	// reset data structure
 	memset(&description, 0, sizeof(description));
 	memset(&frame, 0, sizeof(frame));
+	derivedRigidBodies = 0;
+	derivedSkeletons   = 0;
+	descriptionChanged();
 }
 
 
-void MoCapData::applyScale(float scale)
+void MoCapData::descriptionChanged()
 {
+	descriptionGeneration++;
+}
+
+
+void MoCapData::removeDescriptions(int type)
+{
+	// release the descriptions of the type and move the others to the front
+	int keepIdx = 0;
+	for (int dataBlockIdx = 0; dataBlockIdx < description.nDataDescriptions; dataBlockIdx++)
+	{
+		sDataDescription& descr = description.arrDataDescriptions[dataBlockIdx];
+		if (descr.type != type)
+		{
+			description.arrDataDescriptions[keepIdx++] = descr;
+			continue;
+		}
+
+		switch (type)
+		{
+			case Descriptor_MarkerSet:  freeNatNetMarkerSetDescription( descr.Data.MarkerSetDescription);  break;
+			case Descriptor_RigidBody:  freeNatNetRigidBodyDescription( descr.Data.RigidBodyDescription);  break;
+			case Descriptor_Skeleton:   freeNatNetSkeletonDescription(  descr.Data.SkeletonDescription);   break;
+			case Descriptor_ForcePlate: freeNatNetForcePlateDescription(descr.Data.ForcePlateDescription); break;
+			default: break;
+		}
+	}
+	for (int dataBlockIdx = keepIdx; dataBlockIdx < description.nDataDescriptions; dataBlockIdx++)
+	{
+		memset(&description.arrDataDescriptions[dataBlockIdx], 0, sizeof(sDataDescription));
+	}
+	description.nDataDescriptions = keepIdx;
+
+	// release the corresponding frame data
+	switch (type)
+	{
+		case Descriptor_MarkerSet:
+			for (int msIdx = 0; msIdx < frame.nMarkerSets; msIdx++) freeNatNetMarkerSetData(frame.MocapData[msIdx]);
+			frame.nMarkerSets = 0;
+			break;
+
+		case Descriptor_RigidBody:
+			for (int rbIdx = 0; rbIdx < frame.nRigidBodies; rbIdx++) freeNatNetRigidBodySetData(frame.RigidBodies[rbIdx]);
+			frame.nRigidBodies = 0;
+			derivedRigidBodies = 0;
+			break;
+
+		case Descriptor_Skeleton:
+			removeDerivedSkeletons();
+			for (int sIdx = 0; sIdx < frame.nSkeletons; sIdx++) freeNatNetSkeletonData(frame.Skeletons[sIdx]);
+			frame.nSkeletons = 0;
+			break;
+
+		case Descriptor_ForcePlate:
+			for (int fpIdx = 0; fpIdx < frame.nForcePlates; fpIdx++) freeNatNetForcePlateData(frame.ForcePlates[fpIdx]);
+			frame.nForcePlates = 0;
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+void MoCapData::removeDerivedRigidBodies()
+{
+	// the derived bodies have no marker data, so only the count changes
+	frame.nRigidBodies = std::max(0, frame.nRigidBodies - derivedRigidBodies);
+	derivedRigidBodies = 0;
+}
+
+
+void MoCapData::removeDerivedSkeletons()
+{
+	// the bone data is not released here
+	const int count = std::min(derivedSkeletons, frame.nSkeletons);
+	for (int sIdx = frame.nSkeletons - count; sIdx < frame.nSkeletons; sIdx++)
+	{
+		frame.Skeletons[sIdx].RigidBodyData = nullptr;
+		frame.Skeletons[sIdx].nRigidBodies  = 0;
+	}
+	frame.nSkeletons -= count;
+	derivedSkeletons  = 0;
+}
+
+
+void MoCapData::applyTransform(const sTransform& refTransform)
+{
+	const float (&m)[3][4] = refTransform.matrix;
+	const bool rotate = (refTransform.qx != 0) || (refTransform.qy != 0) || (refTransform.qz != 0);
+
 	for (int msIdx = 0; msIdx < frame.nMarkerSets; msIdx++)
 	{
 		sMarkerSetData& markerset = frame.MocapData[msIdx];
 		for (int mIdx = 0; mIdx < markerset.nMarkers; mIdx++)
 		{
 			MarkerData& marker = markerset.Markers[mIdx];
-			marker[0] *= scale;
-			marker[1] *= scale;
-			marker[2] *= scale;
+			transformMarker(m, marker[0], marker[1], marker[2]);
 		}
 	}
 
 	for (int rbIdx = 0; rbIdx < frame.nRigidBodies; rbIdx++)
 	{
 		sRigidBodyData& rigidBody = frame.RigidBodies[rbIdx];
-		rigidBody.x *= scale;
-		rigidBody.y *= scale;
-		rigidBody.z *= scale;
-		rigidBody.MeanError *= scale; // "abused" for bone length
+		transformBody(refTransform, rigidBody, rotate);
+		for (int mIdx = 0; (mIdx < rigidBody.nMarkers) && (rigidBody.Markers != nullptr); mIdx++)
+		{
+			MarkerData& marker = rigidBody.Markers[mIdx];
+			transformMarker(m, marker[0], marker[1], marker[2]);
+		}
 	}
 
 	for (int sIdx = 0; sIdx < frame.nSkeletons; sIdx++)
 	{
 		sSkeletonData& skeleton = frame.Skeletons[sIdx];
-		for (int bIdx = 0; bIdx < frame.Skeletons[sIdx].nRigidBodies; bIdx++)
+		const sSkeletonDescription* pDescription = rotate ? findSkeletonDescription(skeleton) : nullptr;
+		for (int bIdx = 0; bIdx < skeleton.nRigidBodies; bIdx++)
 		{
-			sRigidBodyData& bone = skeleton.RigidBodyData[bIdx];
-			bone.x *= scale;
-			bone.y *= scale;
-			bone.z *= scale;
-			bone.MeanError *= scale; // "abused" for bone length
+			const bool root = (pDescription == nullptr) || (bIdx >= pDescription->nRigidBodies) || (pDescription->RigidBodies[bIdx].parentID < 0);
+			transformBody(refTransform, skeleton.RigidBodyData[bIdx], rotate && root);
 		}
 	}
+
+	for (int mIdx = 0; mIdx < frame.nLabeledMarkers; mIdx++)
+	{
+		sMarker& marker = frame.LabeledMarkers[mIdx];
+		transformMarker(m, marker.x, marker.y, marker.z);
+		marker.size *= refTransform.scale;
+	}
+
+	for (int mIdx = 0; (mIdx < frame.nOtherMarkers) && (frame.OtherMarkers != nullptr); mIdx++)
+	{
+		MarkerData& marker = frame.OtherMarkers[mIdx];
+		transformMarker(m, marker[0], marker[1], marker[2]);
+	}
 }
 
 
@@ -275,6 +451,7 @@ void MoCapData::freeNatNetFrameData()
 	frame.nRigidBodies = 0;
 
 	// delete skeleton data
+	removeDerivedSkeletons();
 	for (int iSkeletonIdx = 0; iSkeletonIdx < frame.nSkeletons; iSkeletonIdx++)
 	{
 		freeNatNetSkeletonData(frame.Skeletons[iSkeletonIdx]);
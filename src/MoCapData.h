@@ -10,6 +10,34 @@
 // constants for the RigidBody.param field
 #define STATUS_NOT_TRACKED ((short) 0x00)
 #define STATUS_TRACKED     ((short) 0x01)
+#define STATUS_FILLED      ((short) 0x02) // pose was filled in by the server during a tracking gap
+
+// constants for the sFrameOfMocapData.params field (the lower bits are used by NatNet)
+#define FRAME_STANDBY_SOURCE  ((short) 0x10) // frame comes from the standby source
+#define FRAME_SOURCE_SWITCHED ((short) 0x20) // first frame after switching between the primary and the standby source
+#define FRAME_GAP_FILLED      ((short) 0x40) // frame contains poses that were filled in by the server
+
+
+/**
+ * Case insensitive wildcard match of a name against a pattern with '*' and '?'.
+ *
+ * @param czPattern  the pattern
+ * @param czName     the name to check
+ *
+ * @return <code>true</code> if the name matches the pattern
+ */
+bool matchesPattern(const char* czPattern, const char* czName);
+
+
+/**
+ * Similarity transform of positions and orientations: p' = matrix * (x, y, z, 1), q' = rotation * q.
+ */
+struct sTransform
+{
+	float matrix[3][4];       // rotation multiplied by the scale, and translation
+	float qx, qy, qz, qw;     // rotation
+	float scale;              // scale for lengths
+};
 
 
 class MoCapData
@@ -20,7 +48,20 @@ public:
 
 	void reset();
 
-	void applyScale(float scale);
+	// transforms all positions and orientations, bone rotations are relative to the parent, so only root bones are rotated
+	void applyTransform(const sTransform& refTransform);
+
+	// to be called whenever the description has changed, so structures derived from it can be rebuilt
+	void descriptionChanged();
+
+	// releases all descriptions and frame data of one type (e.g., Descriptor_Skeleton), keeping the other types
+	void removeDescriptions(int type);
+
+	// removes the rigid bodies the server appended to the frame, before the MoCap system fills in the next frame
+	void removeDerivedRigidBodies();
+
+	// removes the skeletons the server appended to the frame, their bone data belongs to the server stage that created them
+	void removeDerivedSkeletons();
 
 public:
 	sMarkerSetDescription*  findMarkerSetDescription( const sMarkerSetData&  refMarkerSetData) const;
@@ -49,6 +90,9 @@ private:
 public:
 	sDataDescriptions description;
 	sFrameOfMocapData frame;
+	unsigned int      descriptionGeneration; // incremented with every change of the description
+	int               derivedRigidBodies;    // rigid bodies at the end of the frame that were appended by the server
+	int               derivedSkeletons;      // skeletons at the end of the frame that were appended by the server
 
 };
 
@@ -24,9 +24,6 @@
 #define TAG_SKELETON    "S"
 #define TAG_FORCEPLATE  "F"
 
-#define limitArrayIdx(x, y) ((x > (y-1)) ? (y-1) : (x))
-
-
 /******************************************************************************
  * MoCapFileWriter class
  */
@@ -629,7 +626,8 @@ MoCapFileReader::MoCapFileReader(MoCapFileReaderConfiguration configuration) :
 	bufSize(65536), // should be a good start for a buffer size...
 	running(true),
 	looping(true),
-	playbackSpeed(1.0f)
+	playbackSpeed(1.0f),
+	pSink(NULL)
 {
 	pBuf  = new char[bufSize];
 	pRead = pBuf;
@@ -688,12 +686,33 @@ bool MoCapFileReader::update()
 {
 	if (fileOK && headerOK)
 	{
-		signalNewFrame();
+		if (pSink)
+		{
+			MoCapData& refData  = pSink->acquireFrame();
+			bool       newFrame = false;
+			if (getFrameData(refData, newFrame) && newFrame)
+			{
+				// the recorded latency is part of the capture time
+				pSink->commitFrame(FrameSink::tClock::now() -
+					std::chrono::duration_cast<FrameSink::tClock::duration>(std::chrono::duration<double>(std::max(0.0f, refData.frame.fLatency))));
+			}
+		}
+		else
+		{
+			signalNewFrame();
+		}
 	}
 	return true;
 }
 
 
+bool MoCapFileReader::setFrameSink(FrameSink* pSink)
+{
+	this->pSink = pSink;
+	return true;
+}
+
+
 bool MoCapFileReader::getSceneDescription(MoCapData& refData)
 {
 	bool success = false;
@@ -781,9 +800,10 @@ bool MoCapFileReader::getSceneDescription(MoCapData& refData)
 }
 
 
-bool MoCapFileReader::getFrameData(MoCapData& refData)
+bool MoCapFileReader::getFrameData(MoCapData& refData, bool& refNewFrame)
 {
 	bool success = fileOK;
+	refNewFrame  = false;
 
 	// have we found the frame block begin?
 	if (posFrames < 0)
@@ -831,13 +851,15 @@ bool MoCapFileReader::getFrameData(MoCapData& refData)
 		}
 		else
 		{
-			// get "stuck" on that current line
-			rewindLine();
+			// paused > the current line has already been delivered
+			return success;
 		}
 	}
 
 	if (success && input.good())
 	{
+		refNewFrame = true;
+
 		sFrameOfMocapData& frame = refData.frame;
 
 		// frame number
@@ -1086,8 +1108,13 @@ void MoCapFileReader::readMarkerSetData(sMarkerSetData& data)
 	}
 	for (int mIdx = 0; mIdx < nMarkers; mIdx++)
 	{
-		MarkerData& m = data.Markers[limitArrayIdx(mIdx, data.nMarkers)];
-		m[0] = readFloat(); m[1] = readFloat(); m[2] = readFloat(); // XYZ coordinate of marker
+		// XYZ coordinate of marker, surplus markers are read but discarded
+		const float x = readFloat(), y = readFloat(), z = readFloat();
+		if (mIdx < data.nMarkers)
+		{
+			MarkerData& m = data.Markers[mIdx];
+			m[0] = x; m[1] = y; m[2] = z;
+		}
 	}
 }
 
@@ -1118,9 +1145,19 @@ void MoCapFileReader::readSkeletonData(sSkeletonData& data)
 	{
 		LOG_WARNING("Rigid Body count mismatch in frame data (" << nRigidBodies << " != " << data.nRigidBodies << ")");
 	}
-	for (int rIdx = 0; rIdx < data.nRigidBodies; rIdx++)
+	sRigidBodyData surplus;
+	for (int rIdx = 0; rIdx < nRigidBodies; rIdx++)
 	{
-		readRigidBodyData(data.RigidBodyData[limitArrayIdx(rIdx, data.nRigidBodies)]);
+		// surplus bones are read but discarded
+		if (rIdx < data.nRigidBodies)
+		{
+			readRigidBodyData(data.RigidBodyData[rIdx]);
+		}
+		else
+		{
+			surplus.ID = -1;
+			readRigidBodyData(surplus);
+		}
 	}
 }
 
@@ -1139,9 +1176,14 @@ void MoCapFileReader::readForcePlateData(sForcePlateData& data)
 	}
 	for (int cIdx = 0; cIdx < nChannels; cIdx++)
 	{
-		sAnalogChannelData& refChannel = data.ChannelData[limitArrayIdx(cIdx, data.nChannels)];
-		refChannel.nFrames = 1; // file stores only one sample per tick
-		refChannel.Values[0] = readFloat();
+		// surplus channels are read but discarded
+		const float value = readFloat();
+		if (cIdx < data.nChannels)
+		{
+			sAnalogChannelData& refChannel = data.ChannelData[cIdx];
+			refChannel.nFrames = 1; // file stores only one sample per tick
+			refChannel.Values[0] = value;
+		}
 	}
 }
 
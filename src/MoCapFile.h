@@ -174,8 +174,9 @@ public:
 	virtual bool  isRunning();
 	virtual void  setRunning(bool running);
 	virtual bool  update();
+	virtual bool  setFrameSink(FrameSink* pSink);
 	virtual bool  getSceneDescription(MoCapData& refData);
-	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  getFrameData(MoCapData& refData, bool& refNewFrame);
 	virtual bool  processCommand(const std::string& strCommand);
 	virtual bool  deinitialise();
 
@@ -239,5 +240,7 @@ private:
 
 	bool           running, looping;
 	float          playbackSpeed;
+
+	FrameSink*     pSink;
 };
 
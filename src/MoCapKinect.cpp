@@ -64,10 +64,12 @@ const int SKELETON_DATA_COUNT = sizeof(SKELETON_DATA) / sizeof(SKELETON_DATA[0])
 MoCapKinectConfiguration::MoCapKinectConfiguration() :
 	Configuration("Kinect"),
 	useKinect(false),
-	seatedMode(false)
+	seatedMode(false),
+	trackedUsersOnly(false)
 {
-	addOption("-useKinect",  "Search for and use a Kinect sensor if connected");
-	addOption("-seatedMode", "Do not track the legs and feet");
+	addOption("-useKinect",        "Search for and use a Kinect sensor if connected");
+	addOption("-seatedMode",       "Do not track the legs and feet");
+	addOption("-trackedUsersOnly", "Only stream the marker sets and skeletons of tracked users");
 }
 
 
@@ -84,6 +86,10 @@ bool MoCapKinectConfiguration::handleArgument(unsigned int _idx, const std::stri
 			seatedMode = true;
 			break;
 
+		case 2:
+			trackedUsersOnly = true;
+			break;
+
 		default:
 			success = false;
 			break;
@@ -107,6 +113,11 @@ MoCapKinect::MoCapKinect(MoCapKinectConfiguration configuration) :
 	for (int userIdx = 0; userIdx < MAX_USERS; userIdx++)
 	{
 		userSkeletonIdx.push_back(USER_NOT_TRACKED);
+		// without sparse output, all users are streamed all the time
+		if (!configuration.trackedUsersOnly)
+		{
+			arrOutputUsers.push_back(userIdx);
+		}
 	}
 }
 
@@ -174,15 +185,19 @@ float MoCapKinect::getUpdateRate()
 }
 
 
-bool MoCapKinect::getFrameData(MoCapData& refData)
+bool MoCapKinect::getFrameData(MoCapData& refData, bool& refNewFrame)
 {
-	// update marker data
+	refNewFrame = false;
+
+	// update marker data (the wait times out when the sensor has no new skeleton frame)
 	if (running && (WAIT_OBJECT_0 == WaitForSingleObject(kinectHandle, 0)))
 	{
 		NUI_SKELETON_FRAME skeletonFrame = { 0 };
 
 		if (SUCCEEDED(pNuiSensor->NuiSkeletonGetNextFrame(0, &skeletonFrame)))
 		{
+			refNewFrame = true;
+
 			// get the frame number and timestamp
 			refData.frame.iFrame     = (int) skeletonFrame.dwFrameNumber;
 			refData.frame.fTimestamp = skeletonFrame.liTimeStamp.LowPart / 1000.0f; // convert milliseconds to seconds
@@ -198,13 +213,20 @@ bool MoCapKinect::getFrameData(MoCapData& refData)
 
 bool MoCapKinect::getSceneDescription(MoCapData& refData)
 {
-	int descrIdx = 0;
+	// replace the users of a previous description, but keep the descriptions of other systems (e.g., force plates)
+	refData.removeDescriptions(Descriptor_MarkerSet);
+	refData.removeDescriptions(Descriptor_Skeleton);
 
-	for (int userIdx = 0; userIdx < MAX_USERS; userIdx++)
+	int       descrIdx  = refData.description.nDataDescriptions;
+	const int userCount = (int) arrOutputUsers.size();
+
+	for (int outIdx = 0; outIdx < userCount; outIdx++)
 	{
+		const int userIdx = arrOutputUsers[outIdx];
+
 		// create markerset description and frame
 		sMarkerSetDescription* pMarkerDesc = new sMarkerSetDescription();
-		sMarkerSetData&        msData = refData.frame.MocapData[userIdx];
+		sMarkerSetData&        msData = refData.frame.MocapData[outIdx];
 
 		// name of marker set
 		sprintf_s(pMarkerDesc->szName, sizeof(pMarkerDesc->szName), "User%d", userIdx + 1);
@@ -229,13 +251,16 @@ bool MoCapKinect::getSceneDescription(MoCapData& refData)
 		descrIdx++;
 	}
 
-	for (int nRigid = 0; nRigid < MAX_USERS; nRigid++){
+	for (int outIdx = 0; outIdx < userCount; outIdx++){
+		const int userIdx = arrOutputUsers[outIdx];
+
 		sSkeletonDescription* pSkeletonDesc = new sSkeletonDescription();
-		sSkeletonData& skData = refData.frame.Skeletons[nRigid];
+		sSkeletonData& skData = refData.frame.Skeletons[outIdx];
 
-		sprintf_s(pSkeletonDesc->szName, sizeof(pSkeletonDesc->szName), "User%d Rigid", nRigid + 1);
+		sprintf_s(pSkeletonDesc->szName, sizeof(pSkeletonDesc->szName), "User%d Rigid", userIdx + 1);
 		
-		pSkeletonDesc->skeletonID = nRigid;
+		// the ID stays the same while the user is tracked, regardless of the position in the frame
+		pSkeletonDesc->skeletonID = userIdx;
 		skData.skeletonID = pSkeletonDesc->skeletonID;
 
 		pSkeletonDesc->nRigidBodies = SKELETON_DATA_COUNT;
@@ -256,9 +281,10 @@ bool MoCapKinect::getSceneDescription(MoCapData& refData)
 	refData.description.nDataDescriptions = descrIdx;
 
 	// pre-fill in frame data
-	refData.frame.nMarkerSets = MAX_USERS;
-	refData.frame.nSkeletons = MAX_USERS;
+	refData.frame.nMarkerSets = userCount;
+	refData.frame.nSkeletons  = userCount;
 
+	refData.descriptionChanged();
 	return true;
 }
 
@@ -312,9 +338,26 @@ void MoCapKinect::handleSkeletonData(const NUI_SKELETON_FRAME& refSkeletonFrame,
 	checkUserLost(refSkeletonFrame);
 	checkUserFound(refSkeletonFrame);
 
+	if (configuration.trackedUsersOnly)
+	{
+		// only stream the tracked users > new description when users appear or vanish
+		std::vector<int> arrTrackedUsers;
+		for (int userIdx = 0; userIdx < MAX_USERS; userIdx++)
+		{
+			if (userSkeletonIdx[userIdx] != USER_NOT_TRACKED) arrTrackedUsers.push_back(userIdx);
+		}
+		if (arrTrackedUsers != arrOutputUsers)
+		{
+			LOG_INFO("Streaming " << arrTrackedUsers.size() << " tracked user(s)");
+			arrOutputUsers = arrTrackedUsers;
+			getSceneDescription(refData);
+		}
+	}
+
 	// transfer data to MoCap data structure
-	for (int userIdx = 0; userIdx < MAX_USERS; userIdx++)
+	for (int outIdx = 0; outIdx < (int) arrOutputUsers.size(); outIdx++)
 	{
+		const int userIdx = arrOutputUsers[outIdx];
 		if (userSkeletonIdx[userIdx] != USER_NOT_TRACKED)
 		{
 			// TODO: Do a proper transformation using the clip plane coefficients
@@ -326,8 +369,8 @@ void MoCapKinect::handleSkeletonData(const NUI_SKELETON_FRAME& refSkeletonFrame,
 			NUI_SKELETON_BONE_ORIENTATION boneOrientations[NUI_SKELETON_POSITION_COUNT];
 			NuiSkeletonCalculateBoneOrientations(&skeleton, boneOrientations);
 
-			sMarkerSetData&          msData   = refData.frame.MocapData[userIdx];
-			sSkeletonData&          skeleData = refData.frame.Skeletons[userIdx];
+			sMarkerSetData&          msData   = refData.frame.MocapData[outIdx];
+			sSkeletonData&          skeleData = refData.frame.Skeletons[outIdx];
 
 			//LOG_INFO_START("Kinect skeleton " << firstUser <<
 			//	"\tx:" << skeleton.Position.x << "\ty:" << skeleton.Position.y << "\tz:" << skeleton.Position.z << "\t");
@@ -379,7 +422,7 @@ void MoCapKinect::handleSkeletonData(const NUI_SKELETON_FRAME& refSkeletonFrame,
 		else
 		{
 			// user not tracked at all > zero out all the data
-			sMarkerSetData& msData = refData.frame.MocapData[userIdx];
+			sMarkerSetData& msData = refData.frame.MocapData[outIdx];
 
 			for (int mIdx = 0; mIdx < msData.nMarkers; mIdx++)
 			{
@@ -389,7 +432,7 @@ void MoCapKinect::handleSkeletonData(const NUI_SKELETON_FRAME& refSkeletonFrame,
 				msMarker[2] = 0;
 			}
 
-			sSkeletonData& skeleData = refData.frame.Skeletons[userIdx];
+			sSkeletonData& skeleData = refData.frame.Skeletons[outIdx];
 			for (int rIdx = 0; rIdx < skeleData.nRigidBodies; rIdx++)
 			{
 				sRigidBodyData& rigidData = skeleData.RigidBodyData[rIdx];
@@ -417,6 +460,7 @@ void MoCapKinect::checkUserLost(const NUI_SKELETON_FRAME& refSkeletonFrame)
 			if (skeleton.eTrackingState == NUI_SKELETON_NOT_TRACKED)
 			{
 				userSkeletonIdx[userIdx] = USER_NOT_TRACKED;
+				LOG_INFO("User " << (userIdx + 1) << " lost");
 			}
 		}
 	}
@@ -429,16 +473,15 @@ void MoCapKinect::checkUserFound(const NUI_SKELETON_FRAME& refSkeletonFrame)
 	{
 		const NUI_SKELETON_DATA& skeleton = refSkeletonFrame.SkeletonData[skeletonIdx];
 		// only check for fully tracked users, not POSITION_ONLY
-		if (skeleton.eTrackingState == NUI_SKELETON_TRACKED)
+		if ((skeleton.eTrackingState == NUI_SKELETON_TRACKED) &&
+		    (std::find(userSkeletonIdx.begin(), userSkeletonIdx.end(), skeletonIdx) == userSkeletonIdx.end()))
 		{
-			// TODO: Hardcoded for a maximum of two users. What if there are more possible...?
-			if (userSkeletonIdx[0] < 0 && skeletonIdx != userSkeletonIdx[1])
-			{
-				userSkeletonIdx[0] = skeletonIdx;
-			}
-			else if (userSkeletonIdx[1] < 0 && skeletonIdx != userSkeletonIdx[0])
+			// new user > first free user number, which it keeps until it is lost
+			std::vector<int>::iterator iterFree = std::find(userSkeletonIdx.begin(), userSkeletonIdx.end(), USER_NOT_TRACKED);
+			if (iterFree != userSkeletonIdx.end())
 			{
-				userSkeletonIdx[1] = skeletonIdx;
+				*iterFree = skeletonIdx;
+				LOG_INFO("User " << (iterFree - userSkeletonIdx.begin() + 1) << " found");
 			}
 		}
 	}
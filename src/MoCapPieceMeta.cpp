@@ -466,9 +466,10 @@ bool MoCapPieceMeta::getSceneDescription(MoCapData& refData)
 }
 
 
-bool MoCapPieceMeta::getFrameData(MoCapData& refData)
+bool MoCapPieceMeta::getFrameData(MoCapData& refData, bool& refNewFrame)
 {
 	bool success = false;
+	refNewFrame  = false;
 
 	if (initialised)
 	{
@@ -492,7 +493,8 @@ bool MoCapPieceMeta::getFrameData(MoCapData& refData)
 
 		currentFrame = (currentFrame + 1) % maxFrame;
 
-		success = true;
+		success     = true;
+		refNewFrame = true;
 	}
 
 	return success;
@@ -50,7 +50,7 @@ public:
 	virtual void  setRunning(bool running);
 	virtual bool  update();
 	virtual bool  getSceneDescription(MoCapData& refData);
-	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  getFrameData(MoCapData& refData, bool& refNewFrame);
 	virtual bool  processCommand(const std::string& strCommand);
 	virtual bool  deinitialise();
 
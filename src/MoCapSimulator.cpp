@@ -52,7 +52,10 @@ const int SKELETON_COUNT   = 0;
 
 MoCapSimulator::MoCapSimulator() :
 	initialised(false),
-	running(true)
+	running(true),
+	pSink(nullptr),
+	iFrame(0),
+	lastFrame(-1)
 {
 	// nothing else to do
 }
@@ -161,12 +164,32 @@ bool MoCapSimulator::update()
 		*/
 	}
 
-	signalNewFrame();
+	if (pSink)
+	{
+		MoCapData& refData  = pSink->acquireFrame();
+		bool       newFrame = false;
+		if (getFrameData(refData, newFrame) && newFrame)
+		{
+			// simulate 10ms latency
+			pSink->commitFrame(FrameSink::tClock::now() - std::chrono::milliseconds(10));
+		}
+	}
+	else
+	{
+		signalNewFrame();
+	}
 
 	return true;
 }
 
 
+bool MoCapSimulator::setFrameSink(FrameSink* pSink)
+{
+	this->pSink = pSink;
+	return true;
+}
+
+
 bool MoCapSimulator::getSceneDescription(MoCapData& refData)
 {
 	LOG_INFO("Requesting scene description")
@@ -244,8 +267,13 @@ bool MoCapSimulator::getSceneDescription(MoCapData& refData)
 }
 
 
-bool MoCapSimulator::getFrameData(MoCapData& refData)
+bool MoCapSimulator::getFrameData(MoCapData& refData, bool& refNewFrame)
 {
+	// paused > no new positions
+	refNewFrame = (iFrame != lastFrame);
+	if (!refNewFrame) return true;
+
+	lastFrame            = iFrame;
 	refData.frame.iFrame = iFrame;
 
 	for (int b = 0; b < RIGID_BODY_COUNT; b++)
@@ -23,15 +23,18 @@ public:
 	virtual bool  isRunning();
 	virtual void  setRunning(bool running);
 	virtual bool  update();
+	virtual bool  setFrameSink(FrameSink* pSink);
 	virtual bool  getSceneDescription(MoCapData& refData);
-	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  getFrameData(MoCapData& refData, bool& refNewFrame);
 	virtual bool  processCommand(const std::string& strCommand);
 	virtual bool  deinitialise();
 
 private:
 	bool                    initialised;
 	bool                    running;
+	FrameSink*              pSink;
 	int                     iFrame;
+	int                     lastFrame; // last frame returned by getFrameData()
 	float                   fTime;
 	std::vector<Vector3D>   arrPos;
 	std::vector<Quaternion> arrRot;
@@ -5,12 +5,49 @@
 #pragma once
 
 #include "MoCapData.h"
+#include <chrono>
 #include <string>
 
 
-// this function can be used by the class to stream frames
+// this function can be used by systems that don't push their frames,
+// the server then pulls the frame through getFrameData()
 extern void signalNewFrame();
 
+
+/**
+ * Interface through which MoCap systems push their frames into the server.
+ *
+ * Usage by the MoCap system for every new frame:
+ *   acquireFrame() > fill in the frame > commitFrame()
+ * The system can fill in the frame without any lock, because the slot belongs to it until it is committed.
+ * Frames without new data are simply not committed.
+ */
+class FrameSink
+{
+public:
+
+	typedef std::chrono::steady_clock tClock;
+
+	/**
+	 * Acquires the slot for the next frame.
+	 * The slot contains the scene description and the frame structures, but not necessarily the data of the previous frame.
+	 * Acquiring again without committing returns the same slot.
+	 *
+	 * @return the data structure to fill in
+	 */
+	virtual MoCapData& acquireFrame() = 0;
+
+	/**
+	 * Hands the acquired slot over to the server for processing and streaming.
+	 *
+	 * @param tCapture  the time the frame was captured
+	 */
+	virtual void commitFrame(tClock::time_point tCapture) = 0;
+
+
+	virtual ~FrameSink() { };
+};
+
 /**
  * Pure virtual base class for the minimum MoCap system methods.
  */
@@ -62,6 +99,16 @@ public:
 	*/
 	virtual bool update() = 0;
 
+	/**
+	 * Sets the sink that the MoCap system pushes its frames into.
+	 * Systems that don't support this keep calling signalNewFrame().
+	 *
+	 * @param pSink  the frame sink (<code>nullptr</code>: stop pushing frames)
+	 *
+	 * @return <code>true</code> if the system pushes its frames into the sink
+	 */
+	virtual bool setFrameSink(FrameSink* /*pSink*/) { return false; }
+
 	/**
 	 * Gets a scene description for the NatNet data structure.
 	 *
@@ -73,12 +120,15 @@ public:
 
 	/**
 	 * Gets the data for a single frame as a NatNet data structure.
+	 * When the system has no new data since the last call, the data structure is left unchanged.
 	 *
-	 * @param refData  reference to the data structure to fill in
+	 * @param refData      reference to the data structure to fill in
+	 * @param refNewFrame  set to <code>true</code> if a new frame was filled in,
+	 *                     <code>false</code> if there is no new data since the last call
 	 *
 	 * @return <code>true</code> when the method completed successfully
 	 */
-	virtual bool getFrameData(MoCapData& refData) = 0;
+	virtual bool getFrameData(MoCapData& refData, bool& refNewFrame) = 0;
 
 	/**
 	 * Processes a custom string command.
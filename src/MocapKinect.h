@@ -25,6 +25,7 @@ public:
 
 	bool  useKinect;
 	bool  seatedMode;
+	bool  trackedUsersOnly;
 };
 
 
@@ -42,7 +43,7 @@ public:
 	virtual void  setRunning(bool running);
 	virtual bool  update();
 	virtual bool  getSceneDescription(MoCapData& refData);
-	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  getFrameData(MoCapData& refData, bool& refNewFrame);
 	virtual bool  processCommand(const std::string& strCommand);
 	virtual bool  deinitialise();
 
@@ -64,6 +65,7 @@ private:
 	HANDLE           kinectHandle;
 
 	std::vector<int> userSkeletonIdx;
+	std::vector<int> arrOutputUsers;  // users in the order of the marker sets and skeletons of the frame
 };
 
 #endif
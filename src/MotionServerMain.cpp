@@ -36,15 +36,35 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include <tchar.h>
 
 
 #pragma comment(lib, "NatNetLib.lib")
+#include "ControlPlane.h"       // includes WinSock, so needs to come before any Windows.h
 #include "NatNetTypes.h"
 #include "NatNetServer.h"
+#include "NatNetEndpoint.h"
 #include "MoCapData.h"
 #include "Configuration.h"
+#include "ClockService.h"
+#include "FrameHistory.h"
+#include "FramePacer.h"
+#include "FrameSlots.h"
+#include "GapFiller.h"
+#include "FrameSanitizer.h"
+#include "QualityMonitor.h"
+#include "ZoneEngine.h"
+#include "VirtualBodies.h"
+#include "Retargeter.h"
+#include "SourceTransforms.h"
+#include "SourceWatchdog.h"
+#include "ThreadTopology.h"
+#include "TimerWheel.h"
+#include "TransmitPacer.h"
+#include "WireCapture.h"
 #include "Version.h"
 
 #include "Logging.h"
@@ -68,6 +88,18 @@
 #include "InteractionSystem.h"
 
 
+// rate in Hz with which pending commands are executed by the streaming thread
+#define COMMAND_RATE 30
+
+// maximum time in ms a client request waits for a status command (blocks the request thread of the SDK)
+#define REQUEST_COMMAND_TIMEOUT 100
+
+// read-only status commands that NatNet clients may request, all other commands are only accepted from the console and the control port
+const char* REQUEST_STATUS_COMMANDS[] = {
+	"d", "f", "pacing", "clients", "getstats", "history", "failover", "gaps", "sanitize",
+	"quality", "zones", "virtual", "retarget", "clock", "timers", "threads" };
+
+
 /******************************************************************************
  * Configuration classes and variables
  */
@@ -89,7 +121,27 @@ public:
 		dataPort(1509),
 		interactionControllerPort(0),
 		writeData(false),
-		globalScale(1.0f)
+		globalScale(1.0f),
+		controlAddress("127.0.0.1"),
+		controlPort(0),
+		lockMemory(false),
+		timecodeRate(30),
+		clockReference("none"),
+		taiOffset(37),
+		transmitWindow(0),
+		captureFile(""),
+		replayFile(""),
+		replayTarget("127.0.0.1"),
+		replaySpeed(1.0f),
+		replayFrom(0),
+		historyDuration(0),
+		standbySource(""),
+		stallFrames(10),
+		keepaliveInterval(1.0f),
+		maxGap(0),
+		gapBlendTime(0.2f),
+		captureVolume(""),
+		qualityThresholds("0.9")
 	{
 		addOption(   "-h",                                       "Print Help");
 		addParameter("-serverName",                 "<name>",    "Name of MoCap Server (default: '" + serverName + "')");
@@ -98,6 +150,33 @@ public:
 		addParameter("-interactionControllerPort",  "<number>",  "COM port of XBee interaction controller (-1: scan)");
 		addOption(   "-writeFile",                               "Write MoCap data into timestamped files");
 		addParameter("-scale",                      "<scale>",   "Global scale for position data (default: 1.0)");
+		addParameter("-output",                     "<spec>",    "Additional output endpoint, e.g., 'name=vr,cmd=1520,data=1521,multicast=239.255.42.99,filter=Oculus*,rate=60' (this option can be used multiple times)");
+		addParameter("-controlPort",                "<number>",  "TCP port for receiving commands over the network (default: 0=disabled)");
+		addParameter("-controlAddr",                "<address>", "IP Address of the network command interface (default: " + controlAddress + ")");
+		addParameter("-thread",                     "<spec>",    "Thread configuration, e.g., 'name=streaming,cpus=2;3,policy=fifo,prio=80' (this option can be used multiple times)");
+		addOption(   "-lockMemory",                              "Lock the process memory to avoid paging");
+		addParameter("-timecodeRate",               "<fps>",     "Frame rate of the generated SMPTE timecode (default: 30)");
+		addParameter("-clockRef",                   "<ref>",     "Reference for the wall clock mapping: none, system, ptp[:device] (default: none)");
+		addParameter("-txPacing",                   "<percent>", "Spread the packets of each frame over this portion of the frame period (default: 0=disabled)");
+		addParameter("-capture",                    "<file>",    "Record all outgoing datagrams into a capture file");
+		addParameter("-replay",                     "<file>",    "Replay a capture file instead of running the server");
+		addParameter("-replayTarget",               "<address>", "Address and optional port to replay to, e.g., '127.0.0.1:1509' (default: " + replayTarget + ", original ports)");
+		addParameter("-replaySpeed",                "<factor>",  "Speed factor of the replay (default: 1=original timing, 0=as fast as possible)");
+		addParameter("-replayFrom",                 "<seconds>", "Start time of the replay within the capture (default: 0)");
+		addParameter("-history",                    "<seconds>", "Keep the frames of this duration for history requests of clients (default: 0=disabled)");
+		addParameter("-standby",                    "<source>",  "Standby source when the MoCap system stalls: hold, simulator (default: none)");
+		addParameter("-stallFrames",                "<number>",  "Frame periods without new frames before switching to the standby source (default: 10)");
+		addParameter("-keepalive",                  "<seconds>", "Interval for resending frames while the MoCap system has no new data (default: 1, 0=never)");
+		addParameter("-gapFill",                    "<seconds>", "Fill tracking gaps of rigid bodies and bones up to this duration (default: 0=disabled)");
+		addParameter("-gapBlend",                   "<seconds>", "Time for blending back to the tracked pose after a filled gap (default: 0.2)");
+		addParameter("-volume",                     "<minX,minY,minZ,maxX,maxY,maxZ>", "Reject rigid bodies, bones and markers outside this volume (default: no limits)");
+		addParameter("-quality",                    "<minTracked[,maxJitter[,maxError]]>", "Tracking quality alert thresholds (default: 0.9, 0=no alert)");
+		addParameter("-zone",                       "<spec>",    "Zone or proximity rule for events, e.g., 'name=stage,box=0:0:0:2:2:2,bodies=Visitor*' or 'name=meet,near=0.5' (this option can be used multiple times)");
+		addParameter("-virtual",                    "<name=expression>", "Virtual rigid body, e.g., 'Hands=midpoint(Skeleton1/LeftHand,Skeleton1/RightHand)' (this option can be used multiple times)");
+		addParameter("-retarget",                   "<patterns>", "Retarget the matching skeletons to the canonical humanoid layout, e.g., 'User*;Actor1' (default: none)");
+		addParameter("-retargetMap",                "<bone=source[:qx:qy:qz:qw]>", "Bone mapping with optional rest-pose correction for retargeting, e.g., 'Chest=Spine3' (this option can be used multiple times)");
+		addParameter("-transform",                  "<source=x,y,z[,qx,qy,qz,qw[,scale]]>", "Calibration transform of the primary or standby source, applied before the global scale (this option can be used multiple times)");
+		addParameter("-taiOffset",                  "<seconds>", "Offset of TAI (PTP clocks) to UTC (default: 37)");
 	}
 
 
@@ -136,6 +215,115 @@ public:
 				strmValue >> globalScale;
 				break;
 
+			case 7: // additional output endpoint
+				outputSpecs.push_back(_value);
+				break;
+
+			case 8: // command server port
+				strmValue >> controlPort;
+				break;
+
+			case 9: // command server address
+				controlAddress = _value;
+				break;
+
+			case 10: // thread configuration
+				threadSpecs.push_back(_value);
+				break;
+
+			case 11: // lock memory
+				lockMemory = true;
+				break;
+
+			case 12: // timecode rate
+				strmValue >> timecodeRate;
+				break;
+
+			case 13: // clock reference
+				clockReference = _value;
+				break;
+
+			case 14: // transmit pacing window
+				strmValue >> transmitWindow;
+				transmitWindow /= 100;
+				break;
+
+			case 15: // wire capture
+				captureFile = _value;
+				break;
+
+			case 16: // replay file
+				replayFile = _value;
+				break;
+
+			case 17: // replay target
+				replayTarget = _value;
+				break;
+
+			case 18: // replay speed
+				strmValue >> replaySpeed;
+				break;
+
+			case 19: // replay start time
+				strmValue >> replayFrom;
+				break;
+
+			case 20: // frame history duration
+				strmValue >> historyDuration;
+				break;
+
+			case 21: // standby source
+				standbySource = _value;
+				break;
+
+			case 22: // stall timeout in frames
+				strmValue >> stallFrames;
+				break;
+
+			case 23: // keepalive interval for unchanged frames
+				strmValue >> keepaliveInterval;
+				break;
+
+			case 24: // maximum duration of filled tracking gaps
+				strmValue >> maxGap;
+				break;
+
+			case 25: // blend time after filled gaps
+				strmValue >> gapBlendTime;
+				break;
+
+			case 26: // capture volume for the frame sanitizer
+				captureVolume = _value;
+				break;
+
+			case 27: // tracking quality alert thresholds
+				qualityThresholds = _value;
+				break;
+
+			case 28: // zone or proximity rule
+				zoneSpecs.push_back(_value);
+				break;
+
+			case 29: // virtual rigid body
+				virtualSpecs.push_back(_value);
+				break;
+
+			case 30: // skeletons to retarget
+				retargetSkeletons = _value;
+				break;
+
+			case 31: // bone mapping for retargeting
+				retargetMappings.push_back(_value);
+				break;
+
+			case 32: // calibration transform of a source
+				transformSpecs.push_back(_value);
+				break;
+
+			case 33: // TAI-UTC offset of PTP clocks
+				strmValue >> taiOffset;
+				break;
+
 			default:
 				success = false;
 				break;
@@ -155,11 +343,52 @@ public:
 	int         commandPort;
 	int         dataPort;
 
+	std::vector<std::string> outputSpecs;
+
 	bool        writeData;
 
 	int         interactionControllerPort;
 
 	float       globalScale;
+
+	std::string controlAddress;
+	int         controlPort;
+
+	std::vector<std::string> threadSpecs;
+	bool        lockMemory;
+
+	int         timecodeRate;
+	std::string clockReference;
+	double      taiOffset;
+
+	float       transmitWindow;
+
+	std::string captureFile;
+	std::string replayFile;
+	std::string replayTarget;
+	float       replaySpeed;
+	float       replayFrom;
+
+	float       historyDuration;
+
+	std::string standbySource;
+	int         stallFrames;
+
+	float       keepaliveInterval;
+
+	float       maxGap;
+	float       gapBlendTime;
+
+	std::string captureVolume;
+	std::string qualityThresholds;
+
+	std::vector<std::string> zoneSpecs;
+	std::vector<std::string> virtualSpecs;
+
+	std::string              retargetSkeletons;
+	std::vector<std::string> retargetMappings;
+
+	std::vector<std::string> transformSpecs;
 };
 
 
@@ -215,24 +444,56 @@ struct sConfiguration
  */
 
 // Server variables
-NatNetServer* pServer          = nullptr;
+std::vector<NatNetEndpoint*> arrEndpoints;
+unsigned int                 serverDescriptionGeneration = 0; // description the endpoints were prepared for
+FramePacer                   framePacer;   // degrades the output when frames can't be sent in time
+ClockService                 clockService; // timestamps and timecodes for all frames
+TransmitPacer                transmitPacer; // spreads the packets of a frame over the frame period
+WireCapture                  wireCapture;   // records the outgoing datagrams
+FrameHistory                 frameHistory;  // the most recent frames for history requests
+GapFiller                    gapFiller;     // bridges short tracking gaps of rigid bodies and bones
+FrameSanitizer               frameSanitizer; // repairs or rejects invalid source data
+QualityMonitor               qualityMonitor; // tracking quality statistics and alerts per body
+ZoneEngine                   zoneEngine;     // zone and proximity events of rigid bodies
+VirtualBodies                virtualBodies;  // rigid bodies derived from expressions
+Retargeter                   retargeter;     // skeletons in the canonical humanoid layout
+SourceTransforms             sourceTransforms; // calibration transforms of the sources and the global scale
+TimerWheel                   timerWheel;    // runs all periodic work on the streaming thread
+int                          sourceTask = -1; // timer wheel task polling the MoCap system
 std::mutex    mtxServer;
-bool          serverStarting   = true;
-bool          serverRunning    = false;
-bool          serverRestarting = false;
-uint8_t       arrServerNatNetVersion[4]; // filled in later
+std::atomic<bool>       serverStarting(true);
+std::atomic<bool>       serverRunning(false);
+std::atomic<bool>       serverRestarting(false);
+std::mutex              mtxRunning;
+std::condition_variable cvRunning;   // signalled when the server is stopped or restarted
 
 // MoCap system variables
 MoCapSystem*  pMoCapSystem;
-std::mutex    mtxMoCap;
-MoCapData*    pMocapData;
-sPacket       packetOut;
+FrameSlots*   pPrimarySlots;  // frames of the MoCap system
+std::mutex    mtxMoCap;       // protects the front frames
+MoCapData*    pMocapData;     // front frame of the streamed system
+
+// Standby source variables
+MoCapSystem*   pStandbySystem; // nullptr: hold the last pose of the primary
+FrameSlots*    pStandbySlots;
+FrameSlots*    pActiveSlots;   // slots of the streamed system
+SourceWatchdog sourceWatchdog;
+bool           lastFrameOnStandby = false;
+
+// Keepalive (the last frame is sent again while the MoCap system has no new data)
+FramePacer::tClock::time_point tLastFrameSent;
+unsigned long                  keepaliveFrames = 0;
 
 MoCapFileWriter* pMoCapFileWriter;
 
 // Interaction system variables
 InteractionSystem* pInteractionSystem;
 
+// Command variables (commands are executed by the streaming thread in between frames)
+CommandQueue         commandQueue;
+ConsoleCommandReader consoleReader(commandQueue);
+CommandServer        commandServer(commandQueue);
+
 // Miscellaneous
 // 
       int  frameCallbackCounter   = 0;  // counter for MoCap frame callbacks
@@ -249,6 +510,8 @@ void parseCommandLine(const std::vector<std::string>& arguments);
 bool createServer();
 bool isServerRunning();
 void signalNewFrame();
+void commitFrame(FrameSlots& refSlots, FrameSink::tClock::time_point tCapture);
+void updateServerDescription();
 bool destroyServer();
 
 
@@ -256,7 +519,6 @@ bool destroyServer();
  * Callback/Thread prototypes
  */
 
-void __cdecl callbackNatNetServerMessageHandler(int iMessageType, char* czMessage);
 int  __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPacketOut, void* pUserData);
 
 void mocapTimerThread();
@@ -439,6 +701,63 @@ MoCapSystem* detectMoCapSystem()
 }
 
 
+/**
+ * Creates and initialises the standby source that replaces the MoCap system when it stalls.
+ */
+void createStandbySource()
+{
+	std::string strSource;
+	std::transform(config.pMain->standbySource.begin(), config.pMain->standbySource.end(), std::back_inserter(strSource), ::tolower);
+	if (strSource.empty()) return;
+
+	if (strSource == "simulator")
+	{
+		// pre-initialise, so the switch doesn't have to wait for the scene description
+		pStandbySystem = new MoCapSimulator();
+		if (!pStandbySystem->initialise())
+		{
+			LOG_WARNING("Could not initialise the standby simulator");
+			pStandbySystem->deinitialise();
+			delete pStandbySystem;
+			pStandbySystem = nullptr;
+			return;
+		}
+		pStandbySlots = new FrameSlots(*pStandbySystem, commitFrame);
+		pStandbySlots->prepare();
+		pStandbySystem->setFrameSink(pStandbySlots);
+	}
+	else if (strSource != "hold")
+	{
+		LOG_WARNING("Unknown standby source '" << config.pMain->standbySource << "'");
+		return;
+	}
+
+	lastFrameOnStandby = false;
+	sourceWatchdog.start(config.pMain->stallFrames, strSource);
+}
+
+
+/**
+ * Deinitialises the standby source.
+ */
+void destroyStandbySource()
+{
+	sourceWatchdog.stop();
+	if (pStandbySystem)
+	{
+		pStandbySystem->setFrameSink(nullptr);
+		pStandbySystem->deinitialise();
+		delete pStandbySystem;
+		pStandbySystem = nullptr;
+	}
+	if (pStandbySlots)
+	{
+		delete pStandbySlots;
+		pStandbySlots = nullptr;
+	}
+}
+
+
 /**
  * Detects the XBee interaction system controller.
  *
@@ -500,9 +819,9 @@ InteractionSystem* detectInteractionSystem()
 
 
 /**
- * Creates the NatNet server instance.
+ * Creates the NatNet server instances for the main endpoint and all additional output endpoints.
  *
- * @return <code>true</code> when server was created, 
+ * @return <code>true</code> when all servers were created, 
  *         <code>false</code> when not.
  */
 bool createServer()
@@ -513,132 +832,348 @@ bool createServer()
 		destroyServer(); 
 	}
 
-	// create new NatNet server
-	mtxServer.lock();
-	LOG_INFO("Creating server instance");
-
-	const int iConnectionType = config.pMain->useMulticast ? ConnectionType_Multicast : ConnectionType_Unicast;
-	pServer = new NatNetServer(iConnectionType);
-
-	// print version info
-	pServer->NatNetVersion(arrServerNatNetVersion);
-	LOG_INFO("NatNet Server version v"
-	         << (int) arrServerNatNetVersion[0] << "."
-	         << (int) arrServerNatNetVersion[1] << "."
-	         << (int) arrServerNatNetVersion[2] << "."
-	         << (int) arrServerNatNetVersion[3]);
-
-	// set callbacks
-	pServer->SetVerbosityLevel(Verbosity_Info);
-	pServer->SetErrorMessageCallback(callbackNatNetServerMessageHandler);
-
-	if (iConnectionType == ConnectionType_Multicast)
-	{
-		pServer->SetMulticastAddress((char*) config.pMain->serverMulticastAddress.c_str());
-	}
-
-	int retCode = pServer->Initialize(
-		(char*) config.pMain->serverAddress.c_str(),
-		config.pMain->commandPort,
-		config.pMain->dataPort);
-
-	if (retCode == ErrorCode_OK)
-	{
-		LOG_INFO(((iConnectionType == ConnectionType_Multicast) ? "Multicast" : "Unicast") << " server initialised");
-		// print address/port info
-		char szDataIP_Address[256]      = ""; int iDataPort      = 0;
-		char szCommandIP_Address[256]   = ""; int iCommandPort   = 0;
-		char szMulticastIP_Address[256] = ""; int iMulticastPort = 0;
-		pServer->GetSocketInfo(szDataIP_Address,      &iDataPort, 
-		                       szCommandIP_Address,   &iCommandPort, 
-		                       szMulticastIP_Address, &iMulticastPort);
-		LOG_INFO("Command adress   : " << szCommandIP_Address << ":" << iCommandPort);
-		LOG_INFO("Data adress      : " << szDataIP_Address    << ":" << iDataPort);
-		if (iConnectionType == ConnectionType_Multicast)
+	// main endpoint, configured through the generic command line options
+	std::vector<sNatNetEndpointSettings> arrSettings;
+	sNatNetEndpointSettings mainSettings;
+	mainSettings.name             = config.pMain->serverName;
+	mainSettings.useMulticast     = config.pMain->useMulticast;
+	mainSettings.serverAddress    = config.pMain->serverAddress;
+	mainSettings.multicastAddress = config.pMain->serverMulticastAddress;
+	mainSettings.commandPort      = config.pMain->commandPort;
+	mainSettings.dataPort         = config.pMain->dataPort;
+	arrSettings.push_back(mainSettings);
+
+	// additional endpoints: default to the next free pair of ports
+	bool success = true;
+	for (size_t idx = 0; idx < config.pMain->outputSpecs.size(); idx++)
+	{
+		sNatNetEndpointSettings settings;
+		settings.name          = "output" + std::to_string(idx + 1);
+		settings.serverAddress = mainSettings.serverAddress;
+		settings.commandPort   = mainSettings.commandPort + 2 * (int) (idx + 1);
+		settings.dataPort      = mainSettings.dataPort    + 2 * (int) (idx + 1);
+		if (settings.parse(config.pMain->outputSpecs[idx]))
+		{
+			arrSettings.push_back(settings);
+		}
+		else
 		{
-			LOG_INFO("Multicast address: " << szMulticastIP_Address << ":" << iMulticastPort);
+			LOG_ERROR("Invalid output endpoint specification '" << config.pMain->outputSpecs[idx] << "'");
+			success = false;
 		}
 	}
-	else
+
+	// create all NatNet servers
+	mtxServer.lock();
+	for (auto iter = arrSettings.cbegin(); success && (iter != arrSettings.cend()); iter++)
 	{
-		LOG_ERROR("Could not initialise server");
-		mtxServer.unlock();
-		destroyServer();
+		NatNetEndpoint* pEndpoint = new NatNetEndpoint(*iter);
+		arrEndpoints.push_back(pEndpoint);
+		pEndpoint->setTransmitPacer(&transmitPacer);
+		pEndpoint->setWireCapture(&wireCapture);
+		pEndpoint->setFrameHistory(&frameHistory);
+		success = pEndpoint->initialise();
 	}
-
 	mtxServer.unlock();
 
+	if (!success)
+	{
+		destroyServer();
+	}
+
 	return isServerRunning();
 }
 
 
 /**
- * Checks if the NatNet server is running.
+ * Checks if the NatNet servers are running.
  *
  * @return <code>true</code> if server is running, <code>false</code> if not
  */
 bool isServerRunning()
 {
-	return (pServer != nullptr);
+	return !arrEndpoints.empty();
 }
 
 
 /**
- * Called from MoCap subsystems when they actively provide a new frame.
+ * Kinds of streamed frames.
+ */
+enum eFrameType
+{
+	FRAME_NEW,       // new data from a MoCap system
+	FRAME_REPEATED,  // the last pose of a stalled MoCap system with a new frame number
+	FRAME_KEEPALIVE  // the last frame again, while the MoCap system has no new data
+};
+
+
+/**
+ * Processes and streams the front frame of the streamed MoCap system.
+ * Must be called with the MoCap data locked.
  *
- * @return <code>true</code> if server is streaming, <code>false</code> if not
+ * @param type      the kind of frame
+ * @param tCapture  the capture time of the frame
+ * @param tArrival  the time the frame arrived in the pipeline (only used for new frames)
  */
-void signalNewFrame()
+void streamFrame(eFrameType type, FrameSink::tClock::time_point tCapture, FramePacer::tClock::time_point tArrival)
 {
-	mtxMoCap.lock();
-	if (pMoCapSystem && pMoCapSystem->isActive() && pMocapData)
+	FramePacer::tDuration sendDuration(0);
+	bool                  streamed = false;
+
+	// the pacing level reflects the load of new frames, it must not thin out the held pose during a stall
+	if ((type == FRAME_NEW) && !framePacer.startFrame())
 	{
-		if (pMoCapSystem->getFrameData(*pMocapData))
+		// overloaded > drop this frame (not to be mistaken for a frame the source skipped)
+		if (pMocapData && !sourceWatchdog.isOnStandby())
+		{
+			qualityMonitor.frameDropped(pMocapData->frame.iFrame);
+		}
+	}
+	else if (pMoCapSystem && pMoCapSystem->isActive() && pMocapData)
+	{
+		if (type != FRAME_KEEPALIVE)
+		{
+			const bool onStandby = sourceWatchdog.isOnStandby();
+			short& refParams = pMocapData->frame.params;
+			refParams &= (short) ~(FRAME_STANDBY_SOURCE | FRAME_SOURCE_SWITCHED);
+			if (onStandby)                       refParams |= FRAME_STANDBY_SOURCE;
+			if (onStandby != lastFrameOnStandby) refParams |= FRAME_SOURCE_SWITCHED;
+			lastFrameOnStandby = onStandby;
+
+			clockService.stampFrame(pMocapData->frame, tCapture, pMoCapSystem->getUpdateRate());
+		}
+
+		// repeated and keepalive frames have already been processed
+		if (type == FRAME_NEW)
 		{
 			if (pInteractionSystem)
 			{
 				pInteractionSystem->getFrameData(*pMocapData);
 			}
 
-			pMocapData->applyScale(config.pMain->globalScale);
-
-			mtxServer.lock();
-			if (pServer)
+			// the volume is given in the units of the stream, like the zones
+			const int source = (pActiveSlots == pStandbySlots) ? SOURCE_STANDBY : SOURCE_PRIMARY;
+			frameSanitizer.process(*pMocapData, sourceTransforms.getTransform(source));
+			if (!sourceWatchdog.isOnStandby())
 			{
-				pServer->PacketizeFrameOfMocapData(&(pMocapData->frame), &packetOut);
-				pServer->SendPacket(&packetOut);
+				qualityMonitor.process(*pMocapData);
 			}
-			mtxServer.unlock();
+			gapFiller.process(*pMocapData, std::chrono::duration<double>(tCapture.time_since_epoch()).count());
 
-			if (pMoCapFileWriter)
+			// calibration transform of the source and global scale in one pass
+			sourceTransforms.process(*pMocapData, source);
+
+			// retargeted skeletons are appended before the virtual bodies, so these can use the canonical bones
+			retargeter.process(*pMocapData);
+
+			// virtual bodies are appended before the zones, so they can trigger events as well
+			virtualBodies.process(*pMocapData);
+
+			// zones are given in the units of the stream
+			zoneEngine.process(*pMocapData);
+		}
+
+		// scene changed (e.g., Cortex scene update) > endpoints need to rebuild their filters and packet plans
+		if (pMocapData->descriptionGeneration != serverDescriptionGeneration)
+		{
+			updateServerDescription();
+		}
+
+		if (type != FRAME_KEEPALIVE)
+		{
+			frameHistory.addFrame(*pMocapData);
+		}
+
+		// the frame is converted once and then streamed through all endpoints
+		// (paced packets are only queued here, so the time slots don't count as pipeline cost)
+		const bool skipMarkerSets = framePacer.isSkippingMarkerSets();
+		const bool decimate       = framePacer.isDecimating();
+		FramePacer::tClock::time_point tSendStart = FramePacer::tClock::now();
+		mtxServer.lock();
+		const float updateRate = pMoCapSystem->getUpdateRate();
+		transmitPacer.beginFrame((updateRate > 0) ? (1.0f / updateRate) : 0);
+		for (auto pEndpoint : arrEndpoints)
+		{
+			pEndpoint->sendFrame(*pMocapData, skipMarkerSets, decimate);
+			if (type == FRAME_NEW)
 			{
-				pMoCapFileWriter->writeFrameData(*pMocapData);
+				pEndpoint->sendEvents(*pMocapData, zoneEngine.getEvents());
 			}
 		}
-		else
+		transmitPacer.endFrame();
+		mtxServer.unlock();
+		tLastFrameSent = FramePacer::tClock::now();
+		sendDuration   = tLastFrameSent - tSendStart;
+		streamed       = true;
+
+		// the file only contains the description of the primary system
+		if (pMoCapFileWriter && (pActiveSlots == pPrimarySlots) && (type != FRAME_KEEPALIVE))
 		{
-			LOG_ERROR("Could not retrieve signalled frame");
+			pMoCapFileWriter->writeFrameData(*pMocapData);
 		}
 
 		// display animated character
-		if (frameCallbackCounter == 0)
+		if (type == FRAME_NEW)
+		{
+			if (frameCallbackCounter == 0)
+			{
+				callbackAnimCounter = (callbackAnimCounter + 1) % (sizeof(arrCallbackAnimation) / sizeof(arrCallbackAnimation[0]));
+				std::cout << arrCallbackAnimation[callbackAnimCounter] << "\b" << std::flush;
+			}
+			frameCallbackCounter = (frameCallbackCounter + 1) % frameCallbackModulo;
+		}
+	}
+
+	// repeated and keepalive frames don't tell anything about the load of the source
+	if (type == FRAME_NEW)
+	{
+		framePacer.frameCompleted(tArrival, sendDuration, streamed);
+	}
+}
+
+
+/**
+ * Makes a committed frame the front frame of its MoCap system and streams it, if that system is streamed.
+ * Must be called with the MoCap data locked.
+ *
+ * @param refSlots  the frame slots the frame was committed to
+ * @param tCapture  the capture time of the frame
+ * @param tArrival  the time the frame arrived in the pipeline
+ */
+void handleCommittedFrame(FrameSlots& refSlots, FrameSink::tClock::time_point tCapture, FramePacer::tClock::time_point tArrival)
+{
+	MoCapData& refFront = refSlots.swap();
+
+	// a new frame of the primary ends a stall right away
+	if (&refSlots == pPrimarySlots)
+	{
+		sourceWatchdog.primaryFrameReceived();
+	}
+	else if (&refSlots == pStandbySlots)
+	{
+		sourceWatchdog.standbyFrameReceived();
+	}
+
+	FrameSlots* pSlots = (sourceWatchdog.isOnStandby() && pStandbySlots) ? pStandbySlots : pPrimarySlots;
+	if (&refSlots != pSlots)
+	{
+		// e.g., standby frame right after the primary recovered
+		framePacer.frameDiscarded();
+		return;
+	}
+
+	if (pActiveSlots != pSlots)
+	{
+		// generations have to keep increasing across both systems, so the endpoints and clients notice the change
+		pSlots->advanceGeneration(serverDescriptionGeneration);
+		pActiveSlots = pSlots;
+	}
+	pMocapData = &refFront;
+	streamFrame(FRAME_NEW, tCapture, tArrival);
+}
+
+
+/**
+ * Called by the frame slots when a MoCap system pushes a new frame.
+ *
+ * @param refSlots  the frame slots the frame was committed to
+ * @param tCapture  the capture time of the frame
+ */
+void commitFrame(FrameSlots& refSlots, FrameSink::tClock::time_point tCapture)
+{
+	FramePacer::tClock::time_point tArrival = framePacer.frameArrived();
+
+	mtxMoCap.lock();
+	// ignore frames that are pushed while the system is being shut down
+	if ((&refSlots == pPrimarySlots) || (&refSlots == pStandbySlots))
+	{
+		handleCommittedFrame(refSlots, tCapture, tArrival);
+	}
+	else
+	{
+		framePacer.frameDiscarded();
+	}
+	mtxMoCap.unlock();
+}
+
+
+/**
+ * Called from MoCap systems that don't push their frames when they provide a new frame.
+ * The frame is pulled into the frame slots of the system and then handled like a pushed frame.
+ */
+void signalNewFrame()
+{
+	FramePacer::tClock::time_point tArrival = framePacer.frameArrived();
+
+	mtxMoCap.lock();
+	bool newFrame = false;
+	if (pPrimarySlots && pMoCapSystem && pMoCapSystem->isActive())
+	{
+		MoCapData& refData = pPrimarySlots->acquireFrame();
+		if (!pMoCapSystem->getFrameData(refData, newFrame))
 		{
-			callbackAnimCounter = (callbackAnimCounter + 1) % (sizeof(arrCallbackAnimation) / sizeof(arrCallbackAnimation[0]));
-			std::cout << arrCallbackAnimation[callbackAnimCounter] << "\b" << std::flush;
+			LOG_ERROR("Could not retrieve signalled frame");
+			newFrame = false;
 		}
-		frameCallbackCounter = (frameCallbackCounter + 1) % frameCallbackModulo;
+		else if (newFrame)
+		{
+			// the system reports how long ago the frame was captured
+			FrameSink::tClock::time_point tCapture = FrameSink::tClock::now();
+			if (refData.frame.fLatency > 0)
+			{
+				tCapture -= std::chrono::duration_cast<FrameSink::tClock::duration>(std::chrono::duration<double>(refData.frame.fLatency));
+			}
+			handleCommittedFrame(*pPrimarySlots, tCapture, tArrival);
+		}
+	}
+	if (!newFrame)
+	{
+		// e.g., Kinect timeout without new data
+		framePacer.frameDiscarded();
 	}
 	mtxMoCap.unlock();
 }
 
 
+/**
+ * Looks after the stream in between frames: switches to the standby source when the MoCap system stalls,
+ * repeats the last pose when there is no standby system, and sends keepalive frames while there is no new data.
+ * Must be called with the MoCap data locked.
+ */
+void maintainStream()
+{
+	const bool onStandby = sourceWatchdog.check(pMoCapSystem->getUpdateRate(), pMoCapSystem->isRunning());
+	if (onStandby && pStandbySystem) return;
+
+	const FramePacer::tClock::time_point now = FramePacer::tClock::now();
+	if (onStandby)
+	{
+		// hold the last pose of the primary with advancing frame numbers
+		if (pMocapData)
+		{
+			pMocapData->frame.iFrame++;
+			sourceWatchdog.standbyFrameReceived();
+			streamFrame(FRAME_REPEATED, now, now);
+		}
+	}
+	else if ((config.pMain->keepaliveInterval > 0) &&
+	         (std::chrono::duration<float>(now - tLastFrameSent).count() >= config.pMain->keepaliveInterval))
+	{
+		keepaliveFrames++;
+		streamFrame(FRAME_KEEPALIVE, now, now);
+	}
+}
+
+
 /**
  * Stops the NatNet server thread.
  */
 void stopServer()
 {
+	std::lock_guard<std::mutex> lock(mtxRunning);
 	serverRunning    = false;
 	serverRestarting = false;
+	cvRunning.notify_all();
 }
 
 
@@ -647,15 +1182,204 @@ void stopServer()
  */
 void restartServer()
 {
+	std::lock_guard<std::mutex> lock(mtxRunning);
 	serverRunning    = false;
 	serverRestarting = true;
+	cvRunning.notify_all();
+}
+
+
+/**
+ * Executes a server command from the console, the network, or a client request.
+ * This function is called from the streaming thread in between frames with the MoCap data locked.
+ *
+ * @param strCommand  the command to execute
+ *
+ * @return the result of the command
+ */
+sCommandResult executeCommand(const std::string& strCommand)
+{
+	sCommandResult result = { true, "" };
+
+	// convert to lowercase
+	std::string strCmdLowerCase;
+	std::transform(strCommand.begin(), strCommand.end(), std::back_inserter(strCmdLowerCase), ::tolower);
+
+	if ((strCmdLowerCase == "q") ||
+	    (strCmdLowerCase == "quit"))
+	{
+		stopServer();
+	}
+	else if ((strCmdLowerCase == "r") ||
+	         (strCmdLowerCase == "restart"))
+	{
+		restartServer();
+	}
+	else if (strCmdLowerCase == "p")
+	{
+		// pause/unpause
+		bool running = pMoCapSystem->isRunning();
+		pMoCapSystem->setRunning(!running);
+		running = pMoCapSystem->isRunning();
+		LOG_INFO((running ? "Resumed playback" : "Paused"));
+	}
+	else if (strCmdLowerCase == "d")
+	{
+		// print definitions
+		std::stringstream strm;
+		printModelDefinitions(strm, pMocapData->description);
+		result.response = strm.str();
+	}
+	else if (strCmdLowerCase == "f")
+	{
+		// print frame
+		std::stringstream strm;
+		printFrameOfData(strm, pMocapData->frame);
+		result.response = strm.str();
+	}
+	else if (strCmdLowerCase == "pacing")
+	{
+		// print frame pipeline and transmit pacing measurements
+		std::stringstream strm;
+		strm << framePacer.getStatus() << std::endl
+		     << transmitPacer.getStatus() << std::endl
+		     << "Keepalive frames: " << keepaliveFrames;
+		result.response = strm.str();
+	}
+	else if (strCmdLowerCase == "clients")
+	{
+		// print clients of the client channels
+		std::stringstream strm;
+		mtxServer.lock();
+		for (auto pEndpoint : arrEndpoints)
+		{
+			std::string strStatus = pEndpoint->getClientStatus();
+			if (!strStatus.empty()) strm << strStatus << std::endl;
+		}
+		mtxServer.unlock();
+		result.response = strm.str();
+		if (result.response.empty()) result.response = "No client channels";
+	}
+	else if (strCmdLowerCase == "getstats")
+	{
+		// print round trip times and loss rates of the client channel clients
+		std::stringstream strm;
+		mtxServer.lock();
+		for (auto pEndpoint : arrEndpoints)
+		{
+			std::string strStatus = pEndpoint->getLinkStatus();
+			if (!strStatus.empty()) strm << strStatus << std::endl;
+		}
+		mtxServer.unlock();
+		if (strm.tellp() == 0) strm << "No client channels" << std::endl;
+		strm << qualityMonitor.getSummary();
+		result.response = strm.str();
+	}
+	else if ((strCmdLowerCase == "capture") || (strCmdLowerCase.compare(0, 8, "capture ") == 0))
+	{
+		// "capture": status, "capture stop": stop recording, "capture <file>": start recording
+		std::string strArgument = (strCommand.size() > 8) ? strCommand.substr(8) : "";
+		if (strArgument == "stop")
+		{
+			wireCapture.stop();
+		}
+		else if (!strArgument.empty())
+		{
+			result.success = wireCapture.start(strArgument);
+		}
+		result.response = wireCapture.getStatus();
+	}
+	else if (strCmdLowerCase == "history")
+	{
+		// print frame history state
+		result.response = frameHistory.getStatus();
+	}
+	else if (strCmdLowerCase == "failover")
+	{
+		// print standby source state
+		result.response = sourceWatchdog.getStatus();
+	}
+	else if (strCmdLowerCase == "gaps")
+	{
+		// print gap filler state
+		result.response = gapFiller.getStatus();
+	}
+	else if (strCmdLowerCase == "sanitize")
+	{
+		// print frame validation counters
+		result.response = frameSanitizer.getStatus();
+	}
+	else if (strCmdLowerCase == "quality")
+	{
+		// print tracking quality statistics
+		result.response = qualityMonitor.getStatus();
+	}
+	else if (strCmdLowerCase == "zones")
+	{
+		// print zones and proximity rules
+		result.response = zoneEngine.getStatus();
+	}
+	else if (strCmdLowerCase == "virtual")
+	{
+		// print virtual rigid bodies
+		result.response = virtualBodies.getStatus();
+	}
+	else if (strCmdLowerCase == "retarget")
+	{
+		// print skeleton retargeting
+		result.response = retargeter.getStatus();
+	}
+	else if ((strCmdLowerCase == "calibrate") || (strCmdLowerCase.compare(0, 10, "calibrate ") == 0))
+	{
+		// "calibrate": status, "calibrate reset": identity, "calibrate <body> [<seconds>]": calibrate the active source
+		std::istringstream strmArguments((strCommand.size() > 10) ? strCommand.substr(10) : "");
+		std::string strBody;
+		float       seconds = 3;
+		strmArguments >> strBody >> seconds;
+		const int source = (pActiveSlots == pStandbySlots) ? SOURCE_STANDBY : SOURCE_PRIMARY;
+		if (strBody == "reset")
+		{
+			sourceTransforms.resetTransform(source);
+		}
+		else if (!strBody.empty())
+		{
+			MoCapSystem* pSystem = (source == SOURCE_STANDBY) ? pStandbySystem : pMoCapSystem;
+			result.success = (pSystem != nullptr) && sourceTransforms.startCalibration(source, strBody, seconds, pSystem->getUpdateRate());
+		}
+		result.response = sourceTransforms.getStatus();
+	}
+	else if (strCmdLowerCase == "clock")
+	{
+		// print clock and timecode state
+		result.response = clockService.getStatus();
+	}
+	else if (strCmdLowerCase == "timers")
+	{
+		// print periodic task lateness
+		result.response = timerWheel.getStatus();
+	}
+	else if (strCmdLowerCase == "threads")
+	{
+		// print thread wake-up latencies
+		result.response = ThreadTopology::getStatus();
+	}
+	else if (pMoCapSystem && pMoCapSystem->processCommand(strCommand))
+	{
+		// MoCap susbsytem was able to handle command
+	}
+	else
+	{
+		result.success = false;
+	}
+
+	return result;
 }
 
 
 /**
- * Shuts down the server and destroys the server instance.
+ * Shuts down the servers and destroys the server instances.
  *
- * @return TRUE if server was shut down, FALSE if not
+ * @return TRUE if servers were shut down, FALSE if not
  */
 bool destroyServer()
 {
@@ -663,36 +1387,49 @@ bool destroyServer()
 	{
 		mtxServer.lock();
 		LOG_INFO("Shutting down server");
-		
-		pServer->SetMessageResponseCallback(nullptr);
-		pServer->Uninitialize();
-		pServer->SetErrorMessageCallback(nullptr);
-		
-		delete pServer;
-		pServer = nullptr;
+
+		for (auto pEndpoint : arrEndpoints)
+		{
+			pEndpoint->deinitialise();
+			delete pEndpoint;
+		}
+		arrEndpoints.clear();
 
 		LOG_INFO("Server shut down");
 		mtxServer.unlock();
 	}
-	return (pServer == nullptr);
+	return !isServerRunning();
+}
+
+
+/**
+ * Starts or stops responding to request packets on all endpoints.
+ *
+ * @param respond  <code>true</code> to start responding, <code>false</code> to stop
+ */
+void setServerResponding(bool respond)
+{
+	mtxServer.lock();
+	for (auto pEndpoint : arrEndpoints)
+	{
+		pEndpoint->setRequestHandler(respond ? callbackNatNetServerRequestHandler : nullptr);
+	}
+	mtxServer.unlock();
 }
 
 
 /**
- * Handler for messages from the NatNet server.
+ * Passes a changed scene description on to all endpoints.
  */
-void __cdecl callbackNatNetServerMessageHandler(int iMessageType, char* czMessage)
+void updateServerDescription()
 {
-	switch (iMessageType)
+	mtxServer.lock();
+	for (auto pEndpoint : arrEndpoints)
 	{
-	case Verbosity_Error:
-	case Verbosity_Warning:
-		LOG_ERROR(czMessage);
-		break;
-	default:
-		LOG_INFO(czMessage);
-		break;
+		pEndpoint->updateDescription(*pMocapData);
 	}
+	serverDescriptionGeneration = pMocapData->descriptionGeneration;
+	mtxServer.unlock();
 }
 
 
@@ -703,6 +1440,10 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 {
 	bool requestHandled = false;
 
+	// the endpoint that received the request
+	NatNetEndpoint* pEndpoint = (NatNetEndpoint*) pUserData;
+	if (pEndpoint == nullptr) return requestHandled;
+
 	switch (pPacketIn->iMessage)
 	{
 		case NAT_PING:
@@ -728,10 +1469,7 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 			pPacketOut->Data.Sender.Version[2] = MOTIONSERVER_VERSION_BUILD;
 			pPacketOut->Data.Sender.Version[3] = 0;
 	
-			for (int i = 0; i < 4; i++)
-			{
-				pPacketOut->Data.Sender.NatNetVersion[i] = arrServerNatNetVersion[i];
-			}
+			pEndpoint->getNatNetVersion(pPacketOut->Data.Sender.NatNetVersion);
 
 			requestHandled = true;
 			break;
@@ -739,13 +1477,15 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 
 		case NAT_REQUEST_MODELDEF:
 		{
-			LOG_INFO("Requested scene description");
-			mtxServer.lock();
-			if (pServer)
+			LOG_INFO("Requested scene description (" << pEndpoint->getSettings().name << ")");
+			// the streaming thread and the MoCap system change the front frame and the description
+			// (same lock order as when streaming: MoCap data, then endpoint)
+			mtxMoCap.lock();
+			if (pMocapData)
 			{
-				pServer->PacketizeDataDescriptions(&(pMocapData->description), pPacketOut);
+				pEndpoint->packetizeDescription(*pMocapData, pPacketOut);
 			}
-			mtxServer.unlock();
+			mtxMoCap.unlock();
 			requestHandled = true;
 			break;
 		}
@@ -758,12 +1498,12 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 			// This function does not call pMoCapSystem->getFrameData()
 			// because the streaming thread does that.
 			// Additional polling might mess up the timing
-			mtxServer.lock();
-			if (pServer && pMocapData)
+			mtxMoCap.lock();
+			if (pMocapData)
 			{
-				pServer->PacketizeFrameOfMocapData(&(pMocapData->frame), pPacketOut);
+				pEndpoint->packetizeFrame(*pMocapData, pPacketOut);
 			}
-			mtxServer.unlock();
+			mtxMoCap.unlock();
 			requestHandled = true;
 			break;
 		}
@@ -781,23 +1521,23 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 
 			if (strRequestL == "quit")
 			{
-				stopServer(); // TODO: Doesn't work yet due to std::cin waiting for Enter
+				stopServer();
 			}
 			else if (strRequestL == "restart")
 			{
-				restartServer(); // TODO: Doesn't work yet due to std::cin waiting for Enter
+				restartServer();
 			}
 			else if (strRequestL == "getframerate")
 			{
-				float rate = pMoCapSystem->getUpdateRate();
+				float rate = pEndpoint->getUpdateRate(pMoCapSystem->getUpdateRate());
 				sprintf_s(pPacketOut->Data.szData, "%.0f", rate);
 				pPacketOut->nDataBytes = (unsigned short)strlen(pPacketOut->Data.szData) + 1;
 			}
 			else if (strRequestL == "getdatastreamaddress")
 			{
-				if ( config.pMain->useMulticast )
+				if ( pEndpoint->getSettings().useMulticast )
 				{ 
-					strcpy_s(pPacketOut->Data.szData, config.pMain->serverMulticastAddress.c_str());
+					strcpy_s(pPacketOut->Data.szData, pEndpoint->getSettings().multicastAddress.c_str());
 				}
 				else
 				{
@@ -805,11 +1545,33 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 				}
 				pPacketOut->nDataBytes = (unsigned short) strlen(pPacketOut->Data.szData) + 1;
 			}
+			else if (std::find_if(std::begin(REQUEST_STATUS_COMMANDS), std::end(REQUEST_STATUS_COMMANDS),
+			                      [&strRequestL](const char* czCommand) { return strRequestL == czCommand; }) != std::end(REQUEST_STATUS_COMMANDS))
+			{
+				// status command (executed by the streaming thread in between frames)
+				sCommandResult result;
+				if (commandQueue.execute(strRequest, std::chrono::milliseconds(REQUEST_COMMAND_TIMEOUT), result) && result.success)
+				{ 
+					// success > return response text (if any)
+					if (!result.response.empty())
+					{
+						size_t length = std::min(result.response.size(), sizeof(pPacketOut->Data.szData) - 1);
+						memcpy(pPacketOut->Data.szData, result.response.c_str(), length);
+						pPacketOut->Data.szData[length] = '\0';
+						pPacketOut->nDataBytes = (unsigned short) (length + 1);
+					}
+				}
+				else
+				{
+					pPacketOut->iMessage = NAT_UNRECOGNIZED_REQUEST;
+					requestHandled = false;
+				}
+			}
 			else
 			{
 				// last resort: MoCap subsytem can handle this?
 				mtxMoCap.lock();
-				if (pMoCapSystem && pMoCapSystem->processCommand(strRequestL))
+				if (pMoCapSystem && pMoCapSystem->processCommand(strRequest))
 				{ 
 					// success
 				}
@@ -837,34 +1599,63 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 
 
 /**
- * Timer thread for regularly sending frames
- *
- * @param updateInterval  the interval with which to update the data (in milliseconds)
+ * Periodic task for the MoCap system: updates it and looks after the stream in between its frames.
  */
-void mocapTimerThread()
+void pollMoCapSystem()
 {
-	// create variables to keep track of timing
-	std::chrono::system_clock::time_point nextTick(std::chrono::system_clock::now() + std::chrono::milliseconds(100));
+	if (!serverRunning || !pMoCapSystem) return;
 
-	while (serverRunning)
-	{
-		// sleep for a while
-		std::this_thread::sleep_until(nextTick);
-		// immediately calculate next tick to compensate for time the update() functions takes
-		// read update rate from MoCap system in case it varies (e.g. file playback speed changed)
-		std::chrono::milliseconds intervalTime((int)(1000.0 / pMoCapSystem->getUpdateRate()));
-		nextTick += intervalTime;
+	// mtxMoCap.lock(); < this would collide with the lock in signalNewFrame/commitFrame that is probably being called
+	pMoCapSystem->update();
+	// mtxMoCap.unlock();
 
-		// mtxMoCap.lock(); < this would collide with the lock in signalNewFrame that is probably being called
-		if (serverRunning && pMoCapSystem)
-		{
-			pMoCapSystem->update();
-		}
-		// mtxMoCap.unlock();
+	// replace a stalled system within one frame period, keep the stream alive while there is no new data
+	mtxMoCap.lock();
+	maintainStream();
+	mtxMoCap.unlock();
+
+	// read update rate from MoCap system in case it varies (e.g. file playback speed changed)
+	timerWheel.setRate(sourceTask, pMoCapSystem->getUpdateRate());
+}
+
+
+/**
+ * Periodic task for the standby system: updates it while it replaces the MoCap system.
+ */
+void pollStandbySystem()
+{
+	mtxMoCap.lock();
+	const bool onStandby = serverRunning && pStandbySystem && sourceWatchdog.isOnStandby();
+	mtxMoCap.unlock();
+
+	if (onStandby)
+	{
+		pStandbySystem->update();
 	}
 }
 
 
+/**
+ * Periodic task for executing pending commands in between frames.
+ */
+void processCommands()
+{
+	mtxMoCap.lock();
+	commandQueue.processCommands(executeCommand);
+	mtxMoCap.unlock();
+}
+
+
+/**
+ * Streaming thread that runs all periodic tasks through the timer wheel.
+ */
+void mocapTimerThread()
+{
+	ThreadMetrics& refMetrics = ThreadTopology::applyToCurrentThread("streaming", true);
+	timerWheel.run(&refMetrics);
+}
+
+
 /**
  * Main program
  */
@@ -901,9 +1692,57 @@ int main(int nArguments, char* arrArguments[])
 		serverRestarting = false;
 		printUsage();
 	}
+	else if (!config.pMain->replayFile.empty())
+	{
+		// replay mode: re-send a capture instead of running the server
+		serverStarting   = false;
+		serverRestarting = false;
+		std::string strTarget = config.pMain->replayTarget;
+		int         port      = 0;
+		size_t      posColon  = strTarget.find(':');
+		if (posColon != std::string::npos)
+		{
+			port      = atoi(strTarget.substr(posColon + 1).c_str());
+			strTarget = strTarget.substr(0, posColon);
+		}
+		WireReplayer::replay(config.pMain->replayFile, strTarget, port, config.pMain->replaySpeed, config.pMain->replayFrom);
+	}
 
 	if (serverStarting)
 	{
+		// CPU affinity, priorities, and memory locking
+		if ((!config.pMain->threadSpecs.empty() || config.pMain->lockMemory) &&
+		    !ThreadTopology::configure(config.pMain->threadSpecs, config.pMain->lockMemory))
+		{
+			LOG_ERROR("Not starting the server with an invalid thread configuration");
+			return 1;
+		}
+		ThreadTopology::applyToCurrentThread("main", false);
+
+		// frame timestamps and timecode
+		clockService.setTimecodeRate(config.pMain->timecodeRate);
+		if (!clockService.setReference(config.pMain->clockReference, config.pMain->taiOffset))
+		{
+			LOG_ERROR("Not starting the server without a valid clock reference");
+			return 1;
+		}
+
+		// spacing of the packets of a frame
+		transmitPacer.setWindow(config.pMain->transmitWindow);
+
+		// recording of the outgoing datagrams
+		if (!config.pMain->captureFile.empty())
+		{
+			wireCapture.start(config.pMain->captureFile);
+		}
+
+		// commands from the console and the network
+		consoleReader.start();
+		if (config.pMain->controlPort > 0)
+		{
+			commandServer.start(config.pMain->controlAddress, config.pMain->controlPort);
+		}
+
 		do
 		{
 			LOG_INFO("Starting MotionServer '" << config.pMain->serverName << "' v"
@@ -911,9 +1750,6 @@ int main(int nArguments, char* arrArguments[])
 				<< MOTIONSERVER_VERSION_MINOR << "." 
 				<< MOTIONSERVER_VERSION_BUILD);
 
-			// create data object
-			pMocapData = new MoCapData();
-
 			// detect MoCap system?
 			pMoCapSystem = detectMoCapSystem();
 
@@ -930,6 +1766,9 @@ int main(int nArguments, char* arrArguments[])
 				pMoCapSystem->initialise();
 			}
 
+			// prepare the source that takes over when the MoCap system stalls
+			createStandbySource();
+
 			// are we supposed to write data into a file?
 			if (config.pMain->writeData)
 			{
@@ -945,17 +1784,18 @@ int main(int nArguments, char* arrArguments[])
 				serverRunning    = true;
 				serverRestarting = false;
 
-				// prepare scene description
-				if (pMoCapSystem)
-				{
-					pMoCapSystem->getSceneDescription(*pMocapData);
-				}
+				// prepare the frame slots of the MoCap system with the scene description
+				FrameSlots* pSlots = new FrameSlots(*pMoCapSystem, commitFrame);
+				pSlots->prepare();
 
 				if (pInteractionSystem)
 				{
-					if (pMocapData->frame.nForcePlates == 0)
+					if (pSlots->getFront().frame.nForcePlates == 0)
 					{
-						pInteractionSystem->getSceneDescription(*pMocapData);
+						for (int slotIdx = 0; slotIdx < FRAME_SLOT_COUNT; slotIdx++)
+						{
+							pInteractionSystem->getSceneDescription(pSlots->getSlot(slotIdx));
+						}
 					}
 					else
 					{
@@ -964,18 +1804,59 @@ int main(int nArguments, char* arrArguments[])
 					}
 				}
 
+				// retargeted skeletons and virtual rigid bodies are part of the published description
+				retargeter.configure(config.pMain->retargetSkeletons, config.pMain->retargetMappings);
+				virtualBodies.configure(config.pMain->virtualSpecs);
+				for (int slotIdx = 0; slotIdx < FRAME_SLOT_COUNT; slotIdx++)
+				{
+					retargeter.addDescriptions(pSlots->getSlot(slotIdx));
+					virtualBodies.addDescriptions(pSlots->getSlot(slotIdx));
+				}
+
 				// if enabled, write description to file
 				if (pMoCapFileWriter)
 				{
-					pMoCapFileWriter->writeSceneDescription(*pMocapData);
+					pMoCapFileWriter->writeSceneDescription(pSlots->getFront());
+				}
+
+				// the frame pipeline has to be set up before the first frame can arrive
+				framePacer.reset();
+				const float updateRate = pMoCapSystem->getUpdateRate();
+				frameCallbackModulo    = (int) updateRate;
+				frameHistory.setDepth((int) (config.pMain->historyDuration * updateRate));
+				gapFiller.configure(config.pMain->maxGap, config.pMain->gapBlendTime);
+				frameSanitizer.configure(config.pMain->captureVolume);
+				qualityMonitor.configure(config.pMain->qualityThresholds);
+				sourceTransforms.configure(config.pMain->transformSpecs, config.pMain->globalScale);
+				zoneEngine.configure(config.pMain->zoneSpecs);
+
+				// from now on, frames can be signalled
+				mtxMoCap.lock();
+				pPrimarySlots = pSlots;
+				pActiveSlots  = pSlots;
+				pMocapData    = &pSlots->getFront();
+				mtxMoCap.unlock();
+
+				// prepare filtered descriptions
+				pPrimarySlots->advanceGeneration(serverDescriptionGeneration);
+				updateServerDescription();
+
+				if (pMoCapSystem->setFrameSink(pPrimarySlots))
+				{
+					LOG_INFO("MoCap system pushes its frames");
 				}
 
 				// start responding to packets
-				pServer->SetMessageResponseCallback(callbackNatNetServerRequestHandler);
+				setServerResponding(true);
 
 				// start streaming thread
-				float updateRate    = pMoCapSystem->getUpdateRate();
-				frameCallbackModulo = (int) updateRate;
+				timerWheel.clear();
+				sourceTask = timerWheel.addTask("source", updateRate, pollMoCapSystem);
+				if (pStandbySystem)
+				{
+					timerWheel.addTask("standby", pStandbySystem->getUpdateRate(), pollStandbySystem);
+				}
+				timerWheel.addTask("commands", COMMAND_RATE, processCommands);
 				std::thread streamingThread(mocapTimerThread);
 				LOG_INFO("Streaming thread started (Update rate: " << updateRate << "Hz)");
 
@@ -995,69 +1876,38 @@ int main(int nArguments, char* arrArguments[])
 					<< std::endl << "\tr:Restart"
 					<< std::endl << "\tp:Pause/Unpause"
 					<< std::endl << "\td:Print Model Definitions"
-					<< std::endl << "\tf:Print Frame Data";
+					<< std::endl << "\tf:Print Frame Data"
+					<< std::endl << "\tpacing:Print Frame Pipeline Load and Packet Spacing"
+					<< std::endl << "\tclients:Print Client Channel Subscriptions"
+					<< std::endl << "\tgetstats:Print Client Link and Tracking Quality Statistics"
+					<< std::endl << "\tcapture [<file>|stop]:Start/Stop Recording Outgoing Datagrams"
+					<< std::endl << "\thistory:Print Frame History State"
+					<< std::endl << "\tfailover:Print Standby Source State"
+					<< std::endl << "\tgaps:Print Gap Filler State"
+					<< std::endl << "\tsanitize:Print Frame Validation Counters"
+					<< std::endl << "\tquality:Print Tracking Quality per Body"
+					<< std::endl << "\tzones:Print Zones and Proximity Rules"
+					<< std::endl << "\tvirtual:Print Virtual Rigid Bodies"
+					<< std::endl << "\tretarget:Print Skeleton Retargeting"
+					<< std::endl << "\tcalibrate [<body> [<seconds>]|reset]:Calibrate the Active Source with a Reference Body"
+					<< std::endl << "\tclock:Print Clock State"
+					<< std::endl << "\ttimers:Print Periodic Task Lateness"
+					<< std::endl << "\tthreads:Print Thread Wake-up Latencies";
 				LOG_INFO("Commands:" << commands.str())
 
-				do
+				// wait until the server is stopped or restarted through a command or a client request
 				{
-					LOG_INFO("Enter command:");
-					// read a line of stdin
-					char cmdBuf[256];
-					std::cin.getline(cmdBuf, sizeof(cmdBuf));
-					std::string strCommand(cmdBuf);
-
-					// convert to lowercase
-					std::string strCmdLowerCase;
-					std::transform(strCommand.begin(), strCommand.end(), std::back_inserter(strCmdLowerCase), ::tolower);
-
-					if ((strCmdLowerCase == "q") ||
-					    (strCmdLowerCase == "quit"))
-					{
-						stopServer();
-					}
-					else if ((strCmdLowerCase == "r") ||
-					         (strCmdLowerCase == "restart"))
-					{
-						restartServer();
-					}
-					else if (strCmdLowerCase == "p")
-					{
-						// pause/unpause
-						bool running = pMoCapSystem->isRunning();
-						pMoCapSystem->setRunning(!running);
-						running = pMoCapSystem->isRunning();
-						LOG_INFO((running ? "Resumed playback" : "Paused"));
-					}
-					else if (strCmdLowerCase == "d")
-					{
-						// print definitions
-						std::stringstream strm;
-						printModelDefinitions(strm, pMocapData->description);
-						std::cout << strm.str() << std::endl;
-					}
-					else if (strCmdLowerCase == "f")
-					{
-						// print frame
-						std::stringstream strm;
-						printFrameOfData(strm, pMocapData->frame);
-						std::cout << strm.str() << std::endl;
-					}
-					else if (pMoCapSystem->processCommand(strCommand) == true)
-					{
-						// MoCap susbsytem was able to handle command
-					}
-					else
-					{
-						LOG_ERROR("Unknown command: '" << strCommand << "'");
-					}
-				} while (serverRunning);
+					std::unique_lock<std::mutex> lock(mtxRunning);
+					cvRunning.wait(lock, [] { return !serverRunning; });
+				}
 
 				LOG_INFO("Stopping MotionServer");
 
 				// stop responding to packets
-				pServer->SetMessageResponseCallback(nullptr);
+				setServerResponding(false);
 
 				// wait for streaming thread
+				timerWheel.stop();
 				streamingThread.join();
 
 				LOG_INFO("Streaming thread stopped");
@@ -1080,18 +1930,23 @@ int main(int nArguments, char* arrArguments[])
 				pMoCapFileWriter = nullptr;
 			}
 
+			destroyStandbySource();
+
 			if (pMoCapSystem)
 			{
+				pMoCapSystem->setFrameSink(nullptr);
 				pMoCapSystem->deinitialise();
 				delete pMoCapSystem;
 				pMoCapSystem = nullptr;
 			}
 
-			if (pMocapData)
+			if (pPrimarySlots)
 			{
-				delete pMocapData;
-				pMocapData = nullptr;
+				delete pPrimarySlots;
+				pPrimarySlots = nullptr;
 			}
+			pActiveSlots = nullptr;
+			pMocapData   = nullptr;
 			mtxMoCap.unlock();
 
 			if (serverRestarting)
@@ -1100,6 +1955,10 @@ int main(int nArguments, char* arrArguments[])
 			}
 		} 
 		while (serverRestarting);
+
+		commandServer.stop();
+		consoleReader.stop();
+		wireCapture.stop();
 	}
 
 	return 0;
@@ -0,0 +1,970 @@
+#include "NatNetEndpoint.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "NatNetEndpoint"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+
+// estimated sizes of the NatNet 2.x frame packet elements (in bytes) for planning fragmented frames
+#define NATNET_SIZE_UDP_HEADER     28  // IP + UDP header
+#define NATNET_SIZE_PACKET_HEADER   4  // message ID + size
+#define NATNET_SIZE_FRAME_OVERHEAD 64  // frame number, entity counts, latency, timecode, timestamp, params, end marker
+#define NATNET_SIZE_MARKER         12  // x, y, z
+#define NATNET_SIZE_RIGIDBODY      42  // ID, position, orientation, marker count, mean error, params
+#define NATNET_SIZE_RB_MARKER      20  // position, ID, size
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+/**
+ * Handler for messages from the NatNet server instances.
+ */
+void __cdecl callbackNatNetEndpointMessageHandler(int iMessageType, char* czMessage)
+{
+	switch (iMessageType)
+	{
+	case Verbosity_Error:
+	case Verbosity_Warning:
+		LOG_ERROR(czMessage);
+		break;
+	default:
+		LOG_INFO(czMessage);
+		break;
+	}
+}
+
+
+/******************************************************************************
+ * sNatNetEndpointSettings structure
+ */
+
+sNatNetEndpointSettings::sNatNetEndpointSettings() :
+	name("main"),
+	useMulticast(false),
+	serverAddress("127.0.0.1"),
+	multicastAddress(""),
+	commandPort(1508),
+	dataPort(1509),
+	entityFilters(),
+	maxRate(0),
+	lowPriority(false),
+	mtu(0),
+	compactEncoding(false),
+	resolution(0.0001f),
+	positionBits(32),
+	clientPort(0),
+	fecDataPackets(0),
+	fecParityPackets(1)
+{
+	// nothing else to do
+}
+
+
+bool sNatNetEndpointSettings::parse(const std::string& strSpec)
+{
+	bool success = true;
+	std::istringstream strmSpec(strSpec);
+	std::string strPair;
+	while (std::getline(strmSpec, strPair, ','))
+	{
+		size_t posEquals = strPair.find('=');
+		if (posEquals == std::string::npos)
+		{
+			LOG_ERROR("Invalid endpoint parameter '" << strPair << "'");
+			success = false;
+			continue;
+		}
+
+		std::string strKey;
+		std::string strValue = strPair.substr(posEquals + 1);
+		std::transform(strPair.begin(), strPair.begin() + posEquals, std::back_inserter(strKey), ::tolower);
+
+		if (strKey == "name")
+		{
+			name = strValue;
+		}
+		else if (strKey == "addr")
+		{
+			serverAddress = strValue;
+		}
+		else if (strKey == "multicast")
+		{
+			multicastAddress = strValue;
+			useMulticast     = !strValue.empty();
+		}
+		else if (strKey == "cmd")
+		{
+			commandPort = atoi(strValue.c_str());
+		}
+		else if (strKey == "data")
+		{
+			dataPort = atoi(strValue.c_str());
+		}
+		else if (strKey == "filter")
+		{
+			// several patterns separated by semicolons
+			std::istringstream strmFilter(strValue);
+			std::string strPattern;
+			while (std::getline(strmFilter, strPattern, ';'))
+			{
+				if (!strPattern.empty()) entityFilters.push_back(strPattern);
+			}
+		}
+		else if (strKey == "rate")
+		{
+			maxRate = (float) atof(strValue.c_str());
+		}
+		else if (strKey == "mtu")
+		{
+			mtu = atoi(strValue.c_str());
+		}
+		else if (strKey == "clients")
+		{
+			clientPort = atoi(strValue.c_str());
+		}
+		else if (strKey == "fec")
+		{
+			// "K" (XOR parity) or "K:M" (K data and M parity packets), "0" disables it
+			size_t posColon      = strValue.find(':');
+			int    dataPackets   = atoi(strValue.substr(0, posColon).c_str());
+			int    parityPackets = (posColon != std::string::npos) ? atoi(strValue.substr(posColon + 1).c_str()) : 1;
+			if (strValue == "0")
+			{
+				fecDataPackets = 0;
+			}
+			else if ((dataPackets < 1) || (dataPackets > FEC_MAX_DATA_PACKETS) || (parityPackets < 1) || (parityPackets > FEC_MAX_PARITY_PACKETS))
+			{
+				LOG_ERROR("Invalid error correction '" << strValue << "' (1-" << FEC_MAX_DATA_PACKETS
+					<< " data packets, 1-" << FEC_MAX_PARITY_PACKETS << " parity packets)");
+				success = false;
+			}
+			else
+			{
+				fecDataPackets   = dataPackets;
+				fecParityPackets = parityPackets;
+			}
+		}
+		else if (strKey == "encoding")
+		{
+			if      (strValue == "compact") compactEncoding = true;
+			else if (strValue == "natnet")  compactEncoding = false;
+			else
+			{
+				LOG_ERROR("Invalid endpoint encoding '" << strValue << "'");
+				success = false;
+			}
+		}
+		else if (strKey == "resolution")
+		{
+			resolution = (float) atof(strValue.c_str());
+		}
+		else if (strKey == "posbits")
+		{
+			positionBits = atoi(strValue.c_str());
+			if ((positionBits != 16) && (positionBits != 32))
+			{
+				LOG_ERROR("Invalid number of position bits '" << strValue << "' (16 or 32)");
+				success = false;
+			}
+		}
+		else if (strKey == "prio")
+		{
+			std::string strPrio;
+			std::transform(strValue.begin(), strValue.end(), std::back_inserter(strPrio), ::tolower);
+			if      (strPrio == "low")    lowPriority = true;
+			else if (strPrio == "normal") lowPriority = false;
+			else
+			{
+				LOG_ERROR("Invalid endpoint priority '" << strValue << "'");
+				success = false;
+			}
+		}
+		else
+		{
+			LOG_ERROR("Unknown endpoint parameter '" << strKey << "'");
+			success = false;
+		}
+	}
+	return success;
+}
+
+
+/******************************************************************************
+ * NatNetEndpoint class
+ */
+
+NatNetEndpoint::NatNetEndpoint(const sNatNetEndpointSettings& settings) :
+	settings(settings),
+	pServer(nullptr),
+	filterActive(!settings.entityFilters.empty()),
+	sendInterval(std::chrono::steady_clock::duration::zero()),
+	nextSendTime(),
+	decimationCounter(0),
+	arrParts(),
+	planValid(false),
+	partBudget(0),
+	maxOtherMarkers(1),
+	pTransmitPacer(nullptr),
+	pWireCapture(nullptr)
+{
+	memset(arrNatNetVersion, 0, sizeof(arrNatNetVersion));
+	memset(filterCounts, -1, sizeof(filterCounts));
+	memset(&dataDestination, 0, sizeof(dataDestination));
+
+	pPacketOut  = new sPacket;
+	pPacketPart = new sPacket;
+
+	pCompactEncoder = settings.compactEncoding ? new CompactEncoder(settings.resolution, settings.positionBits) : nullptr;
+	pFecEncoder     = (settings.fecDataPackets > 0) ? new FecEncoder(settings.fecDataPackets, settings.fecParityPackets) : nullptr;
+
+	pClientChannel  = nullptr;
+	pBatchEncoder   = nullptr;
+	if (settings.clientPort > 0)
+	{
+		pClientChannel = new ClientChannel(settings.name);
+		pBatchEncoder  = new CompactEncoder(settings.resolution, settings.positionBits);
+	}
+
+	// the filtered structures are big > don't put them on the stack
+	pDescription = new sDataDescriptions;
+	memset(pDescription, 0, sizeof(*pDescription));
+	pFrame = new sFrameOfMocapData;
+	memset(pFrame, 0, sizeof(*pFrame));
+
+	if (settings.maxRate > 0)
+	{
+		sendInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / settings.maxRate));
+	}
+}
+
+
+NatNetEndpoint::~NatNetEndpoint()
+{
+	deinitialise();
+
+	// the filtered structures only reference the shared data > no deep cleanup necessary
+	delete pFrame;
+	delete pDescription;
+	delete pClientChannel;
+	delete pBatchEncoder;
+	delete pFecEncoder;
+	delete pCompactEncoder;
+	delete pPacketPart;
+	delete pPacketOut;
+}
+
+
+bool NatNetEndpoint::initialise()
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+
+	if (pServer == nullptr)
+	{
+		LOG_INFO("Creating server instance '" << settings.name << "'");
+
+		const int iConnectionType = settings.useMulticast ? ConnectionType_Multicast : ConnectionType_Unicast;
+		pServer = new NatNetServer(iConnectionType);
+
+		// print version info
+		pServer->NatNetVersion(arrNatNetVersion);
+		LOG_INFO("NatNet Server version v"
+			<< (int) arrNatNetVersion[0] << "."
+			<< (int) arrNatNetVersion[1] << "."
+			<< (int) arrNatNetVersion[2] << "."
+			<< (int) arrNatNetVersion[3]);
+
+		// set callbacks
+		pServer->SetVerbosityLevel(Verbosity_Info);
+		pServer->SetErrorMessageCallback(callbackNatNetEndpointMessageHandler);
+
+		if (iConnectionType == ConnectionType_Multicast)
+		{
+			pServer->SetMulticastAddress((char*) settings.multicastAddress.c_str());
+		}
+
+		int retCode = pServer->Initialize(
+			(char*) settings.serverAddress.c_str(),
+			settings.commandPort,
+			settings.dataPort);
+
+		if (retCode == ErrorCode_OK)
+		{
+			LOG_INFO(((iConnectionType == ConnectionType_Multicast) ? "Multicast" : "Unicast")
+				<< " server '" << settings.name << "' initialised");
+			networkResolveAddress(settings.useMulticast ? settings.multicastAddress : "", settings.dataPort, dataDestination);
+			// print address/port info
+			char szDataIP_Address[256]      = ""; int iDataPort      = 0;
+			char szCommandIP_Address[256]   = ""; int iCommandPort   = 0;
+			char szMulticastIP_Address[256] = ""; int iMulticastPort = 0;
+			pServer->GetSocketInfo(szDataIP_Address,      &iDataPort,
+			                       szCommandIP_Address,   &iCommandPort,
+			                       szMulticastIP_Address, &iMulticastPort);
+			LOG_INFO("Command adress   : " << szCommandIP_Address << ":" << iCommandPort);
+			LOG_INFO("Data adress      : " << szDataIP_Address    << ":" << iDataPort);
+			if (iConnectionType == ConnectionType_Multicast)
+			{
+				LOG_INFO("Multicast address: " << szMulticastIP_Address << ":" << iMulticastPort);
+			}
+			if (filterActive)
+			{
+				LOG_INFO("Entity filter    : " << settings.entityFilters.size() << " pattern(s)");
+			}
+			if (settings.maxRate > 0)
+			{
+				LOG_INFO("Rate limit       : " << settings.maxRate << "Hz");
+			}
+			if (settings.lowPriority)
+			{
+				LOG_INFO("Priority         : low");
+			}
+			if (settings.compactEncoding)
+			{
+				LOG_INFO("Encoding         : compact (" << settings.positionBits << " bit positions, resolution " << settings.resolution << ")");
+				if (settings.mtu > 0)
+				{
+					LOG_WARNING("Fragmentation is not used with the compact encoding");
+				}
+			}
+			else if (settings.mtu > 0)
+			{
+				LOG_INFO("Fragmentation    : " << settings.mtu << " bytes/packet");
+			}
+			if (pFecEncoder)
+			{
+				LOG_INFO("Error correction : " << settings.fecDataPackets << " data + " << settings.fecParityPackets << " parity packets"
+					<< ((settings.fecParityPackets == 1) ? " (XOR)" : " (Reed-Solomon)"));
+			}
+			if (pClientChannel)
+			{
+				pClientChannel->start(settings.serverAddress, settings.clientPort,
+					(settings.mtu > 0) ? (settings.mtu - NATNET_SIZE_UDP_HEADER) : 65000);
+			}
+		}
+		else
+		{
+			LOG_ERROR("Could not initialise server '" << settings.name << "'");
+			pServer->SetErrorMessageCallback(nullptr);
+			delete pServer;
+			pServer = nullptr;
+		}
+	}
+
+	return (pServer != nullptr);
+}
+
+
+bool NatNetEndpoint::isActive() const
+{
+	return (pServer != nullptr);
+}
+
+
+void NatNetEndpoint::setRequestHandler(int (__cdecl *pHandler)(sPacket*, sPacket*, void*))
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+	if (pServer)
+	{
+		pServer->SetMessageResponseCallback(pHandler, this);
+	}
+}
+
+
+void NatNetEndpoint::deinitialise()
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+	if (pServer != nullptr)
+	{
+		LOG_INFO("Shutting down server '" << settings.name << "'");
+
+		// packets still waiting for their time slot refer to the server
+		if (pTransmitPacer)
+		{
+			pTransmitPacer->flush();
+		}
+
+		if (pClientChannel)
+		{
+			pClientChannel->stop();
+		}
+
+		pServer->SetMessageResponseCallback(nullptr);
+		pServer->Uninitialize();
+		pServer->SetErrorMessageCallback(nullptr);
+
+		delete pServer;
+		pServer = nullptr;
+	}
+}
+
+
+const sNatNetEndpointSettings& NatNetEndpoint::getSettings() const
+{
+	return settings;
+}
+
+
+void NatNetEndpoint::getNatNetVersion(uint8_t arrVersion[4]) const
+{
+	memcpy(arrVersion, arrNatNetVersion, sizeof(arrNatNetVersion));
+}
+
+
+float NatNetEndpoint::getUpdateRate(float sourceRate) const
+{
+	return (settings.maxRate > 0) ? std::min(sourceRate, settings.maxRate) : sourceRate;
+}
+
+
+void NatNetEndpoint::updateDescription(const MoCapData& refData)
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+
+	if (!filterActive)
+	{
+		// unfiltered endpoints use the shared description directly
+		if ((settings.mtu > 0) && !settings.compactEncoding)
+		{
+			buildFrameFilter(refData);
+			buildFragmentPlan(refData);
+		}
+		return;
+	}
+
+	// copy the references to the selected descriptions
+	int nSelected = 0;
+	for (int dIdx = 0; dIdx < refData.description.nDataDescriptions; dIdx++)
+	{
+		const sDataDescription& descr = refData.description.arrDataDescriptions[dIdx];
+		const char* czName = "";
+		switch (descr.type)
+		{
+			case Descriptor_MarkerSet:  czName = descr.Data.MarkerSetDescription->szName;   break;
+			case Descriptor_RigidBody:  czName = descr.Data.RigidBodyDescription->szName;   break;
+			case Descriptor_Skeleton:   czName = descr.Data.SkeletonDescription->szName;    break;
+			case Descriptor_ForcePlate: czName = descr.Data.ForcePlateDescription->strSerialNo; break;
+		}
+		if (isSelected(czName))
+		{
+			pDescription->arrDataDescriptions[nSelected] = descr;
+			nSelected++;
+		}
+	}
+	pDescription->nDataDescriptions = nSelected;
+
+	buildFrameFilter(refData);
+	if ((settings.mtu > 0) && !settings.compactEncoding)
+	{
+		buildFragmentPlan(refData);
+	}
+
+	LOG_INFO("Server '" << settings.name << "' streams "
+		<< nSelected << " of " << refData.description.nDataDescriptions << " descriptions");
+}
+
+
+bool NatNetEndpoint::sendFrame(const MoCapData& refData, bool skipMarkerSets, bool decimate)
+{
+	bool sent = false;
+
+	// overload: low priority endpoints only get every second frame
+	if (decimate && settings.lowPriority)
+	{
+		decimationCounter++;
+		if ((decimationCounter & 1) != 0)
+		{
+			return false;
+		}
+	}
+
+	// rate cap: send when the next slot is reached (with some tolerance for jitter)
+	if (settings.maxRate > 0)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now < nextSendTime - sendInterval / 4)
+		{
+			return false;
+		}
+		nextSendTime += sendInterval;
+		if (nextSendTime < now)
+		{
+			// fell behind (e.g., source paused) > resynchronise
+			nextSendTime = now + sendInterval;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mtxServer);
+	if (pServer)
+	{
+		if (pCompactEncoder)
+		{
+			// marker data is not part of the compact encoding anyway
+			pPacketOut->iMessage   = NAT_FRAMEOFDATA_COMPACT;
+			pPacketOut->nDataBytes = (unsigned short) pCompactEncoder->encode(
+				*filterFrame(refData), refData.descriptionGeneration,
+				pPacketOut->Data.cData, std::min(MAX_PACKETSIZE, 0xFFFF));
+			if (pPacketOut->nDataBytes > 0)
+			{
+				transmit(pPacketOut);
+			}
+		}
+		else if (settings.mtu > 0)
+		{
+			sendFragmentedFrame(refData, skipMarkerSets);
+		}
+		else
+		{
+			pServer->PacketizeFrameOfMocapData(filterFrame(refData, skipMarkerSets), pPacketOut);
+			transmit(pPacketOut);
+		}
+
+		// clients of the client channel get the same frames, but in batches
+		if (pClientChannel)
+		{
+			pClientChannel->sendFrame(*filterFrame(refData), refData.descriptionGeneration, *pBatchEncoder);
+		}
+		sent = true;
+	}
+
+	return sent;
+}
+
+
+void NatNetEndpoint::sendEvents(const MoCapData& refData, const std::vector<sZoneEvent>& arrEvents)
+{
+	if (pClientChannel && !arrEvents.empty())
+	{
+		pClientChannel->sendEvents(refData.frame, arrEvents);
+	}
+}
+
+
+std::string NatNetEndpoint::getClientStatus() const
+{
+	return pClientChannel ? pClientChannel->getStatus() : "";
+}
+
+
+std::string NatNetEndpoint::getLinkStatus() const
+{
+	return pClientChannel ? pClientChannel->getLinkStatus() : "";
+}
+
+
+void NatNetEndpoint::setTransmitPacer(TransmitPacer* pPacer)
+{
+	pTransmitPacer = pPacer;
+	if (pClientChannel)
+	{
+		pClientChannel->setTransmitPacer(pPacer);
+	}
+}
+
+
+void NatNetEndpoint::setWireCapture(WireCapture* pCapture)
+{
+	pWireCapture = pCapture;
+	if (pClientChannel)
+	{
+		pClientChannel->setWireCapture(pCapture);
+	}
+}
+
+
+void NatNetEndpoint::setFrameHistory(FrameHistory* pHistory)
+{
+	if (pClientChannel)
+	{
+		pClientChannel->setFrameHistory(pHistory);
+	}
+}
+
+
+void NatNetEndpoint::packetizeDescription(const MoCapData& refData, sPacket* pPacketOut)
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+	if (pServer)
+	{
+		sDataDescriptions* pDescr = filterActive ? pDescription : const_cast<sDataDescriptions*>(&refData.description);
+		pServer->PacketizeDataDescriptions(pDescr, pPacketOut);
+	}
+}
+
+
+void NatNetEndpoint::packetizeFrame(const MoCapData& refData, sPacket* pPacketOut)
+{
+	std::lock_guard<std::mutex> lock(mtxServer);
+	if (pServer)
+	{
+		pServer->PacketizeFrameOfMocapData(filterFrame(refData), pPacketOut);
+	}
+}
+
+
+bool NatNetEndpoint::isSelected(const char* czName) const
+{
+	bool selected = !filterActive;
+	for (auto iter = settings.entityFilters.cbegin(); !selected && (iter != settings.entityFilters.cend()); iter++)
+	{
+		selected = matchesPattern(iter->c_str(), czName);
+	}
+	return selected;
+}
+
+
+void NatNetEndpoint::buildFrameFilter(const MoCapData& refData)
+{
+	const sFrameOfMocapData& frame = refData.frame;
+
+	arrMarkerSetIdx.clear();
+	for (int msIdx = 0; msIdx < frame.nMarkerSets; msIdx++)
+	{
+		if (isSelected(frame.MocapData[msIdx].szName)) arrMarkerSetIdx.push_back(msIdx);
+	}
+
+	arrRigidBodyIdx.clear();
+	for (int rbIdx = 0; rbIdx < frame.nRigidBodies; rbIdx++)
+	{
+		const sRigidBodyDescription* pDescr = refData.findRigidBodyDescription(frame.RigidBodies[rbIdx]);
+		if (pDescr && isSelected(pDescr->szName)) arrRigidBodyIdx.push_back(rbIdx);
+	}
+
+	arrSkeletonIdx.clear();
+	for (int skIdx = 0; skIdx < frame.nSkeletons; skIdx++)
+	{
+		const sSkeletonDescription* pDescr = refData.findSkeletonDescription(frame.Skeletons[skIdx]);
+		if (pDescr && isSelected(pDescr->szName)) arrSkeletonIdx.push_back(skIdx);
+	}
+
+	arrForcePlateIdx.clear();
+	for (int fpIdx = 0; fpIdx < frame.nForcePlates; fpIdx++)
+	{
+		const sForcePlateDescription* pDescr = refData.findForcePlateDescription(frame.ForcePlates[fpIdx]);
+		if (pDescr && isSelected(pDescr->strSerialNo)) arrForcePlateIdx.push_back(fpIdx);
+	}
+
+	// remember the structure the lists were built for
+	planValid       = false;
+	filterCounts[0] = frame.nMarkerSets;
+	filterCounts[1] = frame.nRigidBodies;
+	filterCounts[2] = frame.nSkeletons;
+	filterCounts[3] = frame.nForcePlates;
+}
+
+
+sFrameOfMocapData* NatNetEndpoint::filterFrame(const MoCapData& refData, bool skipMarkerSets)
+{
+	const sFrameOfMocapData& frame = refData.frame;
+
+	if (!filterActive && !skipMarkerSets)
+	{
+		// no filter > stream the shared frame as it is
+		// (otherwise, the index lists of an unfiltered endpoint simply select everything)
+		return const_cast<sFrameOfMocapData*>(&frame);
+	}
+
+	// frame structure changed since the lists were built? (e.g., interaction devices appearing)
+	if ((filterCounts[0] != frame.nMarkerSets)  || (filterCounts[1] != frame.nRigidBodies) ||
+	    (filterCounts[2] != frame.nSkeletons)   || (filterCounts[3] != frame.nForcePlates))
+	{
+		buildFrameFilter(refData);
+	}
+
+	// unidentified markers don't belong to any entity > not part of filtered streams
+	copyFrameHeader(frame);
+
+	// shallow copies: the marker/bone arrays are still owned by the shared frame
+	pFrame->nMarkerSets = skipMarkerSets ? 0 : (int) arrMarkerSetIdx.size();
+	for (int idx = 0; idx < pFrame->nMarkerSets; idx++)
+	{
+		pFrame->MocapData[idx] = frame.MocapData[arrMarkerSetIdx[idx]];
+	}
+
+	pFrame->nRigidBodies = (int) arrRigidBodyIdx.size();
+	for (int idx = 0; idx < pFrame->nRigidBodies; idx++)
+	{
+		pFrame->RigidBodies[idx] = frame.RigidBodies[arrRigidBodyIdx[idx]];
+	}
+
+	pFrame->nSkeletons = (int) arrSkeletonIdx.size();
+	for (int idx = 0; idx < pFrame->nSkeletons; idx++)
+	{
+		pFrame->Skeletons[idx] = frame.Skeletons[arrSkeletonIdx[idx]];
+	}
+
+	pFrame->nForcePlates = (int) arrForcePlateIdx.size();
+	for (int idx = 0; idx < pFrame->nForcePlates; idx++)
+	{
+		pFrame->ForcePlates[idx] = frame.ForcePlates[arrForcePlateIdx[idx]];
+	}
+
+	return pFrame;
+}
+
+
+void NatNetEndpoint::copyFrameHeader(const sFrameOfMocapData& refFrame)
+{
+	pFrame->iFrame           = refFrame.iFrame;
+	pFrame->fLatency         = refFrame.fLatency;
+	pFrame->Timecode         = refFrame.Timecode;
+	pFrame->TimecodeSubframe = refFrame.TimecodeSubframe;
+	pFrame->fTimestamp       = refFrame.fTimestamp;
+	pFrame->params           = refFrame.params;
+
+	pFrame->nMarkerSets     = 0;
+	pFrame->nOtherMarkers   = 0;
+	pFrame->OtherMarkers    = nullptr;
+	pFrame->nRigidBodies    = 0;
+	pFrame->nSkeletons      = 0;
+	pFrame->nLabeledMarkers = 0;
+	pFrame->nForcePlates    = 0;
+}
+
+
+int NatNetEndpoint::getEntitySize(const sFrameOfMocapData& refFrame, int type, int idx)
+{
+	switch (type)
+	{
+		case PART_RIGIDBODIES:
+			return NATNET_SIZE_RIGIDBODY + refFrame.RigidBodies[idx].nMarkers * NATNET_SIZE_RB_MARKER;
+
+		case PART_SKELETONS:
+		{
+			const sSkeletonData& skeleton = refFrame.Skeletons[idx];
+			int size = 8; // ID and bone count
+			for (int bIdx = 0; bIdx < skeleton.nRigidBodies; bIdx++)
+			{
+				size += NATNET_SIZE_RIGIDBODY + skeleton.RigidBodyData[bIdx].nMarkers * NATNET_SIZE_RB_MARKER;
+			}
+			return size;
+		}
+
+		case PART_MARKERSETS:
+		{
+			const sMarkerSetData& markerSet = refFrame.MocapData[idx];
+			return (int) strlen(markerSet.szName) + 1 + 4 + markerSet.nMarkers * NATNET_SIZE_MARKER;
+		}
+
+		case PART_FORCEPLATES:
+		{
+			const sForcePlateData& forcePlate = refFrame.ForcePlates[idx];
+			int size = 8; // ID and channel count
+			for (int cIdx = 0; cIdx < forcePlate.nChannels; cIdx++)
+			{
+				size += 4 + forcePlate.ChannelData[cIdx].nFrames * 4;
+			}
+			return size;
+		}
+	}
+	return 0;
+}
+
+
+void NatNetEndpoint::buildFragmentPlan(const MoCapData& refData)
+{
+	const sFrameOfMocapData& frame = refData.frame;
+
+	partBudget = settings.mtu - NATNET_SIZE_UDP_HEADER - NATNET_SIZE_PACKET_HEADER
+		- (int) sizeof(sFramePartHeader) - NATNET_SIZE_FRAME_OVERHEAD;
+	if (pFecEncoder)
+	{
+		// the packets are wrapped for the error correction
+		partBudget -= NATNET_SIZE_PACKET_HEADER + (int) sizeof(sFecHeader);
+	}
+	maxOtherMarkers = std::max(1, partBudget / NATNET_SIZE_MARKER);
+
+	const size_t previousParts = planValid ? arrParts.size() : 0;
+	arrParts.clear();
+	int partSize = 0;
+
+	// adds an entity to the current part of the same type or starts a new part when it is full
+	auto addEntity = [&](ePartType type, int idx)
+	{
+		const int size = getEntitySize(frame, type, idx);
+		if (arrParts.empty() || (arrParts.back().type != type) || (partSize + size > partBudget))
+		{
+			arrParts.push_back(sFramePart());
+			arrParts.back().type = type;
+			partSize = 0;
+		}
+		arrParts.back().arrIdx.push_back(idx);
+		partSize += size;
+	};
+
+	// order of the groups: most important first
+	for (int rbIdx : arrRigidBodyIdx)  addEntity(PART_RIGIDBODIES, rbIdx);
+	for (int skIdx : arrSkeletonIdx)   addEntity(PART_SKELETONS,   skIdx);
+	for (int msIdx : arrMarkerSetIdx)  addEntity(PART_MARKERSETS,  msIdx);
+	for (int fpIdx : arrForcePlateIdx) addEntity(PART_FORCEPLATES, fpIdx);
+
+	planValid = true;
+	if (arrParts.size() != previousParts)
+	{
+		LOG_INFO("Server '" << settings.name << "' splits frames into " << arrParts.size() << " part(s)");
+	}
+}
+
+
+bool NatNetEndpoint::fitsFragmentPlan(const sFrameOfMocapData& refFrame) const
+{
+	for (const sFramePart& part : arrParts)
+	{
+		// a single entity that is larger than the budget can't be split anyway
+		if (part.arrIdx.size() < 2) continue;
+
+		int partSize = 0;
+		for (int idx : part.arrIdx)
+		{
+			partSize += getEntitySize(refFrame, part.type, idx);
+		}
+		if (partSize > partBudget) return false;
+	}
+	return true;
+}
+
+
+void NatNetEndpoint::sendFragmentedFrame(const MoCapData& refData, bool skipMarkerSets)
+{
+	const sFrameOfMocapData& frame = refData.frame;
+
+	// frame structure changed since the plan was built?
+	if ((filterCounts[0] != frame.nMarkerSets)  || (filterCounts[1] != frame.nRigidBodies) ||
+	    (filterCounts[2] != frame.nSkeletons)   || (filterCounts[3] != frame.nForcePlates))
+	{
+		buildFrameFilter(refData);
+	}
+	if (!planValid || !fitsFragmentPlan(frame))
+	{
+		// the marker counts of the entities change from frame to frame > re-plan when a part outgrows the MTU
+		buildFragmentPlan(refData);
+	}
+
+	// unidentified markers vary from frame to frame > split on the fly
+	const int nOtherMarkers = (filterActive || skipMarkerSets) ? 0 : frame.nOtherMarkers;
+	const int nOtherParts   = (nOtherMarkers + maxOtherMarkers - 1) / maxOtherMarkers;
+
+	int nParts = nOtherParts;
+	for (const sFramePart& part : arrParts)
+	{
+		if (!skipMarkerSets || (part.type != PART_MARKERSETS)) nParts++;
+	}
+
+	sFramePartHeader header;
+	header.iFrame                = frame.iFrame;
+	header.partIndex             = 0;
+	header.partCount             = (uint16_t) std::max(nParts, 1);
+	header.descriptionGeneration = refData.descriptionGeneration;
+
+	if (nParts == 0)
+	{
+		// nothing selected > still let the clients know about the frame
+		copyFrameHeader(frame);
+		sendFramePart(header);
+		return;
+	}
+
+	for (const sFramePart& part : arrParts)
+	{
+		if (skipMarkerSets && (part.type == PART_MARKERSETS)) continue;
+
+		// shallow copies: the marker/bone arrays are still owned by the shared frame
+		copyFrameHeader(frame);
+		const int nEntities = (int) part.arrIdx.size();
+		switch (part.type)
+		{
+			case PART_RIGIDBODIES:
+				pFrame->nRigidBodies = nEntities;
+				for (int idx = 0; idx < nEntities; idx++) { pFrame->RigidBodies[idx] = frame.RigidBodies[part.arrIdx[idx]]; }
+				break;
+
+			case PART_SKELETONS:
+				pFrame->nSkeletons = nEntities;
+				for (int idx = 0; idx < nEntities; idx++) { pFrame->Skeletons[idx] = frame.Skeletons[part.arrIdx[idx]]; }
+				break;
+
+			case PART_MARKERSETS:
+				pFrame->nMarkerSets = nEntities;
+				for (int idx = 0; idx < nEntities; idx++) { pFrame->MocapData[idx] = frame.MocapData[part.arrIdx[idx]]; }
+				break;
+
+			case PART_FORCEPLATES:
+				pFrame->nForcePlates = nEntities;
+				for (int idx = 0; idx < nEntities; idx++) { pFrame->ForcePlates[idx] = frame.ForcePlates[part.arrIdx[idx]]; }
+				break;
+		}
+		sendFramePart(header);
+		header.partIndex++;
+	}
+
+	for (int mIdx = 0; mIdx < nOtherMarkers; mIdx += maxOtherMarkers)
+	{
+		copyFrameHeader(frame);
+		pFrame->nOtherMarkers = std::min(maxOtherMarkers, nOtherMarkers - mIdx);
+		pFrame->OtherMarkers  = frame.OtherMarkers + mIdx;
+		sendFramePart(header);
+		header.partIndex++;
+	}
+}
+
+
+void NatNetEndpoint::sendFramePart(const sFramePartHeader& header)
+{
+	pServer->PacketizeFrameOfMocapData(pFrame, pPacketPart);
+
+	pPacketOut->iMessage   = NAT_FRAMEOFDATA_PART;
+	pPacketOut->nDataBytes = (unsigned short) (sizeof(header) + pPacketPart->nDataBytes);
+	memcpy(pPacketOut->Data.cData, &header, sizeof(header));
+	memcpy(pPacketOut->Data.cData + sizeof(header), pPacketPart->Data.cData, pPacketPart->nDataBytes);
+
+	transmit(pPacketOut);
+}
+
+
+void NatNetEndpoint::transmit(sPacket* pPacket)
+{
+	if (pFecEncoder == nullptr)
+	{
+		sendPacket(pPacket);
+		return;
+	}
+
+	sendPacket(pFecEncoder->encode(pPacket));
+	for (int pIdx = 0; pIdx < pFecEncoder->getParityPacketCount(); pIdx++)
+	{
+		sendPacket(pFecEncoder->getParityPacket(pIdx));
+	}
+}
+
+
+void NatNetEndpoint::sendPacket(const sPacket* pPacket)
+{
+	const int size = NATNET_SIZE_PACKET_HEADER + pPacket->nDataBytes;
+	auto fnSend = [this](const char* pData, int dataSize)
+	{
+		// the SDK doesn't modify the packet, but its signature isn't const
+		const int retCode = pServer->SendPacket((sPacket*) pData);
+
+		// recorded when and only if the SDK actually sent the datagram
+		// (unicast: the SDK picks the client address and doesn't report it)
+		if ((retCode == ErrorCode_OK) && pWireCapture)
+		{
+			pWireCapture->record(pData, dataSize, dataDestination);
+		}
+	};
+
+	// the SDK sockets are not accessible > pacing by the sender thread
+	if (pTransmitPacer)
+	{
+		pTransmitPacer->send((const char*) pPacket, size, fnSend);
+	}
+	else
+	{
+		fnSend((const char*) pPacket, size);
+	}
+}
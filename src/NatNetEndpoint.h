@@ -0,0 +1,371 @@
+/**
+ * Output endpoint that streams MoCap data through its own NatNet server instance.
+ * Several endpoints can share the same MoCap data, each with its own ports,
+ * connection type, entity filter, and rate cap.
+ */
+
+#pragma once
+
+#include "ClientChannel.h"      // includes WinSock, so needs to come before any Windows.h
+#include "NatNetTypes.h"
+#include "NatNetServer.h"
+#include "MoCapData.h"
+#include "CompactEncoding.h"
+#include "ForwardErrorCorrection.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// message ID of frame parts in fragmented mode (outside of the range used by NatNet)
+#define NAT_FRAMEOFDATA_PART 200
+
+
+#pragma pack(push, 1)
+/**
+ * Header in front of each part of a fragmented frame.
+ * The header is followed by a regular NatNet frame packet that only contains the entities of this part.
+ */
+struct sFramePartHeader
+{
+	int32_t  iFrame;                ///< frame number
+	uint16_t partIndex;             ///< index of this part
+	uint16_t partCount;             ///< number of parts of the frame
+	uint32_t descriptionGeneration; ///< changes whenever the scene description changes
+};
+#pragma pack(pop)
+
+
+/**
+ * Settings for a single NatNet output endpoint.
+ */
+struct sNatNetEndpointSettings
+{
+	std::string              name;             ///< name of the endpoint (for logging)
+	bool                     useMulticast;     ///< stream via multicast instead of unicast
+	std::string              serverAddress;    ///< local IP address of the server
+	std::string              multicastAddress; ///< multicast IP address (only when useMulticast is set)
+	int                      commandPort;      ///< port for commands/requests
+	int                      dataPort;         ///< port for streaming data
+	std::vector<std::string> entityFilters;    ///< name patterns of entities to stream (empty: all)
+	float                    maxRate;          ///< maximum streaming rate in Hz (0: no limit)
+	bool                     lowPriority;      ///< endpoint is decimated first when the server is overloaded
+	int                      mtu;              ///< split frames into packets of this size (0: no fragmentation)
+	bool                     compactEncoding;  ///< stream poses in the compact encoding instead of NatNet frames
+	float                    resolution;       ///< position resolution of the compact encoding in units per step
+	int                      positionBits;     ///< bits per position component of the compact encoding (16 or 32)
+	int                      clientPort;       ///< UDP port for client requests, e.g., batching (0: disabled)
+	int                      fecDataPackets;   ///< data packets per FEC group (0: no error correction)
+	int                      fecParityPackets; ///< parity packets per FEC group
+
+	sNatNetEndpointSettings();
+
+	/**
+	 * Parses an endpoint specification of comma separated key=value pairs, e.g.,
+	 * "name=vr,addr=10.1.1.5,multicast=239.255.42.99,cmd=1520,data=1521,filter=Oculus*;Walk_*,rate=60,prio=low,mtu=1500" or
+	 * "name=hmd,encoding=compact,resolution=0.0002,posbits=16" or "name=log,clients=1530" or "name=wifi,fec=8:2".
+	 * Keys that are not specified keep their current value.
+	 *
+	 * @param strSpec  the specification to parse
+	 *
+	 * @return <code>true</code> if the specification was valid
+	 */
+	bool parse(const std::string& strSpec);
+};
+
+
+/**
+ * Class for a single NatNet server instance with filtered and rate limited output.
+ */
+class NatNetEndpoint
+{
+public:
+
+	/**
+	 * Creates an endpoint with the given settings.
+	 *
+	 * @param settings  the settings of the endpoint
+	 */
+	NatNetEndpoint(const sNatNetEndpointSettings& settings);
+
+	/**
+	 * Shuts down and destroys the endpoint.
+	 */
+	~NatNetEndpoint();
+
+	/**
+	 * Creates and initialises the NatNet server instance.
+	 *
+	 * @return <code>true</code> if the server was initialised
+	 */
+	bool initialise();
+
+	/**
+	 * Checks if the NatNet server of this endpoint is running.
+	 *
+	 * @return <code>true</code> if the server is running
+	 */
+	bool isActive() const;
+
+	/**
+	 * Starts or stops responding to client requests.
+	 *
+	 * @param pHandler  the request handler (the endpoint is passed as user data)
+	 *                  or <code>nullptr</code> to stop responding
+	 */
+	void setRequestHandler(int (__cdecl *pHandler)(sPacket*, sPacket*, void*));
+
+	/**
+	 * Shuts down the NatNet server instance.
+	 */
+	void deinitialise();
+
+	/**
+	 * Gets the settings of the endpoint.
+	 *
+	 * @return the endpoint settings
+	 */
+	const sNatNetEndpointSettings& getSettings() const;
+
+	/**
+	 * Gets the NatNet version of the server instance.
+	 *
+	 * @param arrVersion  the array to copy the version into
+	 */
+	void getNatNetVersion(uint8_t arrVersion[4]) const;
+
+	/**
+	 * Gets the effective update rate of this endpoint.
+	 *
+	 * @param sourceRate  the update rate of the MoCap source
+	 *
+	 * @return the update rate, limited by the rate cap
+	 */
+	float getUpdateRate(float sourceRate) const;
+
+	/**
+	 * Rebuilds the filtered scene description after the MoCap description has changed.
+	 *
+	 * @param refData  the MoCap data with the new description
+	 */
+	void updateDescription(const MoCapData& refData);
+
+	/**
+	 * Streams a frame of data, unless the rate cap or the decimation suppresses it.
+	 *
+	 * @param refData         the MoCap data to stream
+	 * @param skipMarkerSets  <code>true</code> to leave out marker sets and unidentified markers
+	 * @param decimate        <code>true</code> to only send every second frame if this is a low priority endpoint
+	 *
+	 * @return <code>true</code> if the frame was sent
+	 */
+	bool sendFrame(const MoCapData& refData, bool skipMarkerSets = false, bool decimate = false);
+
+	/**
+	 * Sends zone and proximity events to the clients of the client channel that requested them.
+	 * Events are not affected by the rate cap or the decimation.
+	 *
+	 * @param refData    the MoCap data with the frame the events belong to
+	 * @param arrEvents  the events to send
+	 */
+	void sendEvents(const MoCapData& refData, const std::vector<sZoneEvent>& arrEvents);
+
+	/**
+	 * Gets a printable summary of the clients of the client channel.
+	 *
+	 * @return the summary text (empty if the channel is disabled)
+	 */
+	std::string getClientStatus() const;
+
+	/**
+	 * Gets a printable summary of the link statistics of the clients of the client channel.
+	 *
+	 * @return the summary text (empty if the channel is disabled)
+	 */
+	std::string getLinkStatus() const;
+
+	/**
+	 * Sets the pacer for all packets of this endpoint. Must be called before initialise().
+	 *
+	 * @param pPacer  the pacer to use (<code>nullptr</code>: no pacing)
+	 */
+	void setTransmitPacer(TransmitPacer* pPacer);
+
+	/**
+	 * Sets the capture that records all outgoing packets of this endpoint.
+	 *
+	 * @param pCapture  the capture to use (<code>nullptr</code>: no recording)
+	 */
+	void setWireCapture(WireCapture* pCapture);
+
+	/**
+	 * Sets the frame history for history requests of the client channel.
+	 *
+	 * @param pHistory  the frame history (<code>nullptr</code>: no history requests)
+	 */
+	void setFrameHistory(FrameHistory* pHistory);
+
+	/**
+	 * Packetizes the filtered scene description, e.g., as a response to a client request.
+	 *
+	 * @param refData     the MoCap data with the description to packetize
+	 * @param pPacketOut  the packet to fill
+	 */
+	void packetizeDescription(const MoCapData& refData, sPacket* pPacketOut);
+
+	/**
+	 * Packetizes the filtered frame data, e.g., as a response to a client request.
+	 *
+	 * @param refData     the MoCap data to packetize
+	 * @param pPacketOut  the packet to fill
+	 */
+	void packetizeFrame(const MoCapData& refData, sPacket* pPacketOut);
+
+private:
+
+	/**
+	 * Checks if an entity name passes the entity filter.
+	 *
+	 * @param czName  the entity name
+	 *
+	 * @return <code>true</code> if the entity is to be streamed
+	 */
+	bool isSelected(const char* czName) const;
+
+	/**
+	 * Builds the frame index lists for the filtered output.
+	 *
+	 * @param refData  the MoCap data to build the lists for
+	 */
+	void buildFrameFilter(const MoCapData& refData);
+
+	/**
+	 * Fills the filtered frame from the shared frame data.
+	 * The filtered frame only references the marker arrays of the shared frame.
+	 *
+	 * @param refData         the MoCap data to filter
+	 * @param skipMarkerSets  <code>true</code> to leave out marker sets and unidentified markers
+	 *
+	 * @return the frame to packetize
+	 */
+	sFrameOfMocapData* filterFrame(const MoCapData& refData, bool skipMarkerSets = false);
+
+	/**
+	 * Copies the frame header fields into the output frame and clears all entity counts.
+	 *
+	 * @param refFrame  the frame to copy the header of
+	 */
+	void copyFrameHeader(const sFrameOfMocapData& refFrame);
+
+	/**
+	 * Groups the selected entities into parts that fit into the MTU.
+	 *
+	 * @param refData  the MoCap data to build the plan for
+	 */
+	void buildFragmentPlan(const MoCapData& refData);
+
+	/**
+	 * Checks if the parts of a frame still fit into the MTU with the current plan.
+	 *
+	 * @param refFrame  the frame to check
+	 *
+	 * @return <code>true</code> if no part with several entities is larger than the budget
+	 */
+	bool fitsFragmentPlan(const sFrameOfMocapData& refFrame) const;
+
+	/**
+	 * Calculates the size of an entity in a frame packet.
+	 *
+	 * @param refFrame  the frame with the entity
+	 * @param type      the part type of the entity (PART_...)
+	 * @param idx       the index of the entity in the frame
+	 *
+	 * @return the size in bytes
+	 */
+	static int getEntitySize(const sFrameOfMocapData& refFrame, int type, int idx);
+
+	/**
+	 * Sends a frame as several parts according to the fragment plan.
+	 *
+	 * @param refData         the MoCap data to stream
+	 * @param skipMarkerSets  <code>true</code> to leave out marker sets and unidentified markers
+	 */
+	void sendFragmentedFrame(const MoCapData& refData, bool skipMarkerSets);
+
+	/**
+	 * Packetizes the output frame as a part of a fragmented frame and sends it.
+	 *
+	 * @param header  the part header
+	 */
+	void sendFramePart(const sFramePartHeader& header);
+
+	/**
+	 * Sends a packet, wrapped and followed by parity packets if error correction is enabled.
+	 *
+	 * @param pPacket  the packet to send
+	 */
+	void transmit(sPacket* pPacket);
+
+	/**
+	 * Sends a single packet through the NatNet server instance.
+	 *
+	 * @param pPacket  the packet to send
+	 */
+	void sendPacket(const sPacket* pPacket);
+
+private:
+
+	sNatNetEndpointSettings settings;
+
+	NatNetServer*      pServer;
+	std::mutex         mtxServer;
+	uint8_t            arrNatNetVersion[4];
+	sPacket*           pPacketOut;
+
+	// filtered output (only references the shared data structures)
+	bool               filterActive;
+	sDataDescriptions* pDescription;
+	sFrameOfMocapData* pFrame;
+	std::vector<int>   arrMarkerSetIdx, arrRigidBodyIdx, arrSkeletonIdx, arrForcePlateIdx;
+	int                filterCounts[4];
+
+	// rate cap
+	std::chrono::steady_clock::duration   sendInterval;
+	std::chrono::steady_clock::time_point nextSendTime;
+
+	// decimation under overload
+	unsigned int       decimationCounter;
+
+	// fragmentation: parts of the selected entities, rebuilt when the description changes
+	enum ePartType { PART_RIGIDBODIES, PART_SKELETONS, PART_MARKERSETS, PART_FORCEPLATES };
+	struct sFramePart
+	{
+		ePartType        type;
+		std::vector<int> arrIdx;   // indices into the shared frame
+	};
+	std::vector<sFramePart> arrParts;
+	bool               planValid;
+	int                partBudget;      // bytes per part for the entities
+	int                maxOtherMarkers; // unidentified markers per part
+	sPacket*           pPacketPart;
+
+	// compact encoding
+	CompactEncoder*    pCompactEncoder;
+
+	// forward error correction
+	FecEncoder*        pFecEncoder;
+
+	// spreading the packets over the frame period
+	TransmitPacer*     pTransmitPacer;
+
+	// recording of the outgoing packets
+	WireCapture*       pWireCapture;
+	sockaddr_in        dataDestination; // multicast address or 0.0.0.0 for unicast
+
+	// clients with individual requests (e.g., batching)
+	ClientChannel*     pClientChannel;
+	CompactEncoder*    pBatchEncoder;
+};
@@ -0,0 +1,69 @@
+#include "Network.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "Network"
+
+#include <sstream>
+#include <string.h>
+
+
+bool networkInitialise()
+{
+#ifdef WIN32
+	WSADATA wsaData;
+	int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	if (result != 0)
+	{
+		LOG_ERROR("Could not initialise WinSock (Error " << result << ")");
+		return false;
+	}
+#endif
+	return true;
+}
+
+
+void networkDeinitialise()
+{
+#ifdef WIN32
+	WSACleanup();
+#endif
+}
+
+
+bool networkResolveAddress(const std::string& strAddress, int port, sockaddr_in& refAddress)
+{
+	memset(&refAddress, 0, sizeof(refAddress));
+	refAddress.sin_family = AF_INET;
+	refAddress.sin_port   = htons((unsigned short) port);
+	if (strAddress.empty())
+	{
+		refAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+		return true;
+	}
+	return (inet_pton(AF_INET, strAddress.c_str(), &refAddress.sin_addr) == 1);
+}
+
+
+std::string networkAddressToString(const sockaddr_in& refAddress)
+{
+	char czAddress[INET_ADDRSTRLEN] = "";
+	inet_ntop(AF_INET, (void*) &refAddress.sin_addr, czAddress, sizeof(czAddress));
+	std::stringstream strm;
+	strm << czAddress << ":" << ntohs(refAddress.sin_port);
+	return strm.str();
+}
+
+
+bool networkSetBlocking(SOCKET socket, bool blocking)
+{
+#ifdef WIN32
+	u_long mode = blocking ? 0 : 1;
+	return (ioctlsocket(socket, FIONBIO, &mode) == 0);
+#else
+	int flags = fcntl(socket, F_GETFL, 0);
+	if (flags < 0) return false;
+	flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+	return (fcntl(socket, F_SETFL, flags) == 0);
+#endif
+}
@@ -0,0 +1,76 @@
+/**
+ * Platform specific socket definitions and helper functions.
+ */
+
+#pragma once
+
+#ifdef WIN32
+	#pragma comment(lib, "ws2_32.lib")
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+
+	typedef int socklen_t;
+#else
+	#include <arpa/inet.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <netinet/in.h>
+	#include <sys/select.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+
+	typedef int SOCKET;
+	#define INVALID_SOCKET (-1)
+	#define SOCKET_ERROR   (-1)
+	#define closesocket    close
+#endif
+
+#include <string>
+
+
+/**
+ * Initialises the network stack (e.g., WinSock).
+ * Can be called several times, each call needs a matching call to networkDeinitialise().
+ *
+ * @return <code>true</code> if the network stack is available
+ */
+bool networkInitialise();
+
+
+/**
+ * Releases the network stack.
+ */
+void networkDeinitialise();
+
+
+/**
+ * Fills in a socket address structure from an IP address string and a port.
+ *
+ * @param strAddress  the IP address (empty for any local address)
+ * @param port        the port number
+ * @param refAddress  the structure to fill in
+ *
+ * @return <code>true</code> if the address was valid
+ */
+bool networkResolveAddress(const std::string& strAddress, int port, sockaddr_in& refAddress);
+
+
+/**
+ * Converts a socket address into a printable "address:port" string.
+ *
+ * @param refAddress  the address to convert
+ *
+ * @return the address string
+ */
+std::string networkAddressToString(const sockaddr_in& refAddress);
+
+
+/**
+ * Switches a socket between blocking and non-blocking mode.
+ *
+ * @param socket    the socket to change
+ * @param blocking  <code>true</code> for blocking mode
+ *
+ * @return <code>true</code> if the mode was changed
+ */
+bool networkSetBlocking(SOCKET socket, bool blocking);
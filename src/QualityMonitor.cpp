@@ -0,0 +1,450 @@
+#include "QualityMonitor.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "QualityMonitor"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+
+// number of frames in the long window (and the ring)
+#define QUALITY_WINDOW_LONG     256
+// number of frames in the short window, which is used for the alerts
+#define QUALITY_WINDOW_SHORT    32
+// frame number jumps above this are treated as a restart of the source (e.g., a looping file) instead of a gap
+#define QUALITY_MAX_FRAME_GAP   10000
+// fraction of the threshold distance that has to be recovered before an alert is cleared again
+#define QUALITY_HYSTERESIS      0.9f
+
+// alert flags per body
+#define ALERT_TRACKING  0x01
+#define ALERT_JITTER    0x02
+#define ALERT_ERROR     0x04
+
+
+QualityMonitor::QualityMonitor() :
+	minTracked(0),
+	maxJitter(0),
+	maxError(0),
+	descriptionGeneration(0),
+	lastFrame(0),
+	sampleCount(0),
+	head(0),
+	skippedShort(0),
+	skippedLong(0),
+	sourceAlert(false),
+	framesProcessed(0),
+	framesSkipped(0),
+	framesDropped(0),
+	alertsRaised(0)
+{
+	// nothing else to do
+}
+
+
+bool QualityMonitor::configure(const std::string& strThresholds)
+{
+	bool success = true;
+	minTracked = 0;
+	maxJitter  = 0;
+	maxError   = 0;
+
+	if (!strThresholds.empty())
+	{
+		// "minTracked,maxJitter,maxError", trailing values are optional
+		std::string strValues(strThresholds);
+		std::replace(strValues.begin(), strValues.end(), ',', ' ');
+		std::istringstream strm(strValues);
+		float arrValues[3] = { 0, 0, 0 };
+		int   count = 0;
+		while ((count < 3) && (strm >> arrValues[count]))
+		{
+			count++;
+		}
+		if ((count == 0) || !strm.eof())
+		{
+			LOG_ERROR("Invalid quality thresholds '" << strThresholds << "'");
+			success = false;
+		}
+		else
+		{
+			minTracked = std::min(1.0f, std::max(0.0f, arrValues[0]));
+			maxJitter  = std::max(0.0f, arrValues[1]);
+			maxError   = std::max(0.0f, arrValues[2]);
+		}
+	}
+
+	// start collecting again
+	descriptionGeneration = 0;
+	arrNames.clear();
+	arrRingSkipped.clear();
+	framesProcessed = 0;
+	framesSkipped   = 0;
+	framesDropped   = 0;
+	alertsRaised    = 0;
+	return success;
+}
+
+
+void QualityMonitor::reset(const MoCapData& refData)
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+
+	// names of the bodies for the table and the alerts
+	arrNames.clear();
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		const sRigidBodyDescription* pDescription = refData.findRigidBodyDescription(refFrame.RigidBodies[rbIdx]);
+		arrNames.push_back(pDescription ? pDescription->szName : ("Rigid body " + std::to_string(refFrame.RigidBodies[rbIdx].ID)));
+	}
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		const sSkeletonData&        refSkeleton  = refFrame.Skeletons[sIdx];
+		const sSkeletonDescription* pDescription = refData.findSkeletonDescription(refSkeleton);
+		const std::string strSkeleton = pDescription ? pDescription->szName : ("Skeleton " + std::to_string(refSkeleton.skeletonID));
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			arrNames.push_back(strSkeleton + "/" + ((pDescription && (bIdx < pDescription->nRigidBodies)) ?
+				std::string(pDescription->RigidBodies[bIdx].szName) : std::to_string(refSkeleton.RigidBodyData[bIdx].ID)));
+		}
+	}
+
+	const size_t bodyCount = arrNames.size();
+	arrRingTracked.assign(bodyCount * QUALITY_WINDOW_LONG, 0);
+	arrRingJitter.assign( bodyCount * QUALITY_WINDOW_LONG, -1.0f);
+	arrRingError.assign(  bodyCount * QUALITY_WINDOW_LONG, -1.0f);
+	arrShort.assign(bodyCount, sWindow());
+	arrLong.assign( bodyCount, sWindow());
+	for (std::vector<float>* pArray : { &arrPosX, &arrPosY, &arrPosZ, &arrVelX, &arrVelY, &arrVelZ })
+	{
+		pArray->assign(bodyCount, 0.0f);
+	}
+	arrHistory.assign(bodyCount, 0);
+	arrSeen.assign(bodyCount, 0);
+	arrAlert.assign(bodyCount, 0);
+
+	arrRingSkipped.assign(QUALITY_WINDOW_LONG, 0);
+	skippedShort = 0;
+	skippedLong  = 0;
+	sourceAlert  = false;
+	sampleCount  = 0;
+	head         = 0;
+
+	descriptionGeneration = refData.descriptionGeneration;
+}
+
+
+void QualityMonitor::process(const MoCapData& refData)
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+
+	size_t bodyCount = refFrame.nRigidBodies;
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		bodyCount += std::max(0, refFrame.Skeletons[sIdx].nRigidBodies);
+	}
+	if ((refData.descriptionGeneration != descriptionGeneration) || (bodyCount != arrNames.size()) || arrRingSkipped.empty())
+	{
+		reset(refData);
+	}
+	framesProcessed++;
+
+	// frames the source skipped since the previous one
+	int skipped = 0;
+	if (sampleCount > 0)
+	{
+		const int delta = refFrame.iFrame - lastFrame;
+		if ((delta > 1) && (delta <= QUALITY_MAX_FRAME_GAP))
+		{
+			skipped = delta - 1;
+			framesSkipped += skipped;
+		}
+		if ((delta > 1) || (delta < 0))
+		{
+			// velocities across gaps and restarts are meaningless
+			std::fill(arrHistory.begin(), arrHistory.end(), (uint8_t) 0);
+		}
+	}
+	lastFrame = refFrame.iFrame;
+
+	// advance the ring: the oldest sample leaves the long window, the sample one short window ago leaves the short window
+	head = (head + 1) % QUALITY_WINDOW_LONG;
+	const int  leavingShort = (head + QUALITY_WINDOW_LONG - QUALITY_WINDOW_SHORT) % QUALITY_WINDOW_LONG;
+	const bool removeLong   = (sampleCount >= QUALITY_WINDOW_LONG);
+	const bool removeShort  = (sampleCount >= QUALITY_WINDOW_SHORT);
+	if (removeLong)  skippedLong  -= arrRingSkipped[head];
+	if (removeShort) skippedShort -= arrRingSkipped[leavingShort];
+	arrRingSkipped[head] = (uint16_t) skipped;
+	skippedLong  += skipped;
+	skippedShort += skipped;
+
+	size_t bodyIdx = 0;
+	auto addBody = [&](const sRigidBodyData& rb)
+	{
+		const size_t ringBase = bodyIdx * QUALITY_WINDOW_LONG;
+		if (removeLong)  addSample(arrLong[bodyIdx],  ringBase + head, -1);
+		if (removeShort) addSample(arrShort[bodyIdx], ringBase + leavingShort, -1);
+
+		const bool tracked = (rb.params & STATUS_TRACKED) != 0;
+		float jitter = -1.0f;
+		float error  = -1.0f;
+		if (tracked)
+		{
+			const float vx = rb.x - arrPosX[bodyIdx];
+			const float vy = rb.y - arrPosY[bodyIdx];
+			const float vz = rb.z - arrPosZ[bodyIdx];
+			if (arrHistory[bodyIdx] >= 2)
+			{
+				// change of the velocity: constant motion doesn't count as jitter
+				const float ax = vx - arrVelX[bodyIdx];
+				const float ay = vy - arrVelY[bodyIdx];
+				const float az = vz - arrVelZ[bodyIdx];
+				jitter = sqrtf(ax * ax + ay * ay + az * az);
+			}
+			arrVelX[bodyIdx] = vx; arrVelY[bodyIdx] = vy; arrVelZ[bodyIdx] = vz;
+			arrPosX[bodyIdx] = rb.x; arrPosY[bodyIdx] = rb.y; arrPosZ[bodyIdx] = rb.z;
+			arrHistory[bodyIdx] = (uint8_t) std::min(2, arrHistory[bodyIdx] + 1);
+			arrSeen[bodyIdx]    = 1;
+			if (rb.MeanError >= 0) error = rb.MeanError;
+		}
+		else
+		{
+			arrHistory[bodyIdx] = 0;
+		}
+
+		arrRingTracked[ringBase + head] = tracked ? 1 : 0;
+		arrRingJitter[ ringBase + head] = jitter;
+		arrRingError[  ringBase + head] = error;
+		addSample(arrLong[bodyIdx],  ringBase + head, +1);
+		addSample(arrShort[bodyIdx], ringBase + head, +1);
+		bodyIdx++;
+	};
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		addBody(refFrame.RigidBodies[rbIdx]);
+	}
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		const sSkeletonData& refSkeleton = refFrame.Skeletons[sIdx];
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			addBody(refSkeleton.RigidBodyData[bIdx]);
+		}
+	}
+
+	sampleCount = std::min(sampleCount + 1, QUALITY_WINDOW_LONG);
+
+	// alerts need a full short window
+	if (sampleCount < QUALITY_WINDOW_SHORT) return;
+
+	for (size_t idx = 0; idx < bodyCount; idx++)
+	{
+		checkAlerts(idx);
+	}
+
+	if (minTracked > 0)
+	{
+		const float received = QUALITY_WINDOW_SHORT;
+		const float ratio    = received / (received + skippedShort);
+		if (!sourceAlert && (ratio < minTracked))
+		{
+			LOG_WARNING("Source skipped " << skippedShort << " of the last " << (QUALITY_WINDOW_SHORT + skippedShort) << " frames");
+			sourceAlert = true;
+			alertsRaised++;
+		}
+		else if (sourceAlert && (ratio >= 1 - (1 - minTracked) * QUALITY_HYSTERESIS))
+		{
+			LOG_INFO("Source frames recovered");
+			sourceAlert = false;
+		}
+	}
+}
+
+
+void QualityMonitor::addSample(sWindow& refWindow, size_t sampleIdx, int sign)
+{
+	refWindow.tracked += sign * arrRingTracked[sampleIdx];
+	const float jitter = arrRingJitter[sampleIdx];
+	if (jitter >= 0)
+	{
+		refWindow.jitterCount += sign;
+		refWindow.jitterSum   += sign * jitter;
+	}
+	const float error = arrRingError[sampleIdx];
+	if (error >= 0)
+	{
+		refWindow.errorCount += sign;
+		refWindow.errorSum   += sign * error;
+	}
+}
+
+
+void QualityMonitor::checkAlerts(size_t bodyIdx)
+{
+	// bodies that were never tracked (e.g., props outside the volume) aren't worth an alert
+	if (!arrSeen[bodyIdx]) return;
+
+	const sWindow& refWindow = arrShort[bodyIdx];
+	const float tracked = getTrackedRatio(refWindow, QUALITY_WINDOW_SHORT);
+	const float jitter  = getJitter(refWindow);
+	const float error   = getError(refWindow);
+
+	uint8_t& refAlert = arrAlert[bodyIdx];
+	const uint8_t before = refAlert;
+	if (minTracked > 0)
+	{
+		if      (tracked < minTracked)                                    refAlert |= ALERT_TRACKING;
+		else if (tracked >= 1 - (1 - minTracked) * QUALITY_HYSTERESIS)    refAlert &= ~ALERT_TRACKING;
+	}
+	if (maxJitter > 0)
+	{
+		if      (jitter > maxJitter)                                      refAlert |= ALERT_JITTER;
+		else if (jitter < maxJitter * QUALITY_HYSTERESIS)                 refAlert &= ~ALERT_JITTER;
+	}
+	if (maxError > 0)
+	{
+		if      (error > maxError)                                        refAlert |= ALERT_ERROR;
+		else if (error < maxError * QUALITY_HYSTERESIS)                   refAlert &= ~ALERT_ERROR;
+	}
+
+	const uint8_t raised = refAlert & ~before;
+	if (raised & ALERT_TRACKING)
+	{
+		LOG_WARNING("'" << arrNames[bodyIdx] << "' only tracked in " << std::fixed << std::setprecision(0) << (tracked * 100) << "% of the last " << QUALITY_WINDOW_SHORT << " frames");
+	}
+	if (raised & ALERT_JITTER)
+	{
+		LOG_WARNING("'" << arrNames[bodyIdx] << "' jitters by " << jitter);
+	}
+	if (raised & ALERT_ERROR)
+	{
+		LOG_WARNING("'" << arrNames[bodyIdx] << "' has a mean error of " << error);
+	}
+	if (raised != 0)
+	{
+		alertsRaised++;
+	}
+	else if ((before != 0) && (refAlert == 0))
+	{
+		LOG_INFO("'" << arrNames[bodyIdx] << "' recovered");
+	}
+}
+
+
+float QualityMonitor::getTrackedRatio(const sWindow& refWindow, int size) const
+{
+	const int samples = std::min(size, sampleCount);
+	return (samples > 0) ? (refWindow.tracked / (float) samples) : 0.0f;
+}
+
+
+float QualityMonitor::getJitter(const sWindow& refWindow) const
+{
+	return (refWindow.jitterCount > 0) ? (float) (refWindow.jitterSum / refWindow.jitterCount) : 0.0f;
+}
+
+
+float QualityMonitor::getError(const sWindow& refWindow) const
+{
+	return (refWindow.errorCount > 0) ? (float) (refWindow.errorSum / refWindow.errorCount) : 0.0f;
+}
+
+
+void QualityMonitor::frameDropped(int iFrame)
+{
+	if ((sampleCount == 0) || arrRingSkipped.empty()) return;
+
+	const int delta = iFrame - lastFrame;
+	if ((delta > 0) && (delta <= QUALITY_MAX_FRAME_GAP))
+	{
+		// frames the source skipped before the dropped one still count
+		const int skipped = delta - 1;
+		framesSkipped += skipped;
+		arrRingSkipped[head] = (uint16_t) std::min(65535, arrRingSkipped[head] + skipped);
+		skippedLong  += skipped;
+		skippedShort += skipped;
+	}
+	lastFrame = iFrame;
+	framesDropped++;
+
+	// velocities across the dropped frame are meaningless
+	std::fill(arrHistory.begin(), arrHistory.end(), (uint8_t) 0);
+}
+
+
+std::string QualityMonitor::getSummary() const
+{
+	std::stringstream strm;
+	int activeAlerts = 0;
+	std::string strAlerts;
+	for (size_t idx = 0; idx < arrAlert.size(); idx++)
+	{
+		if (arrAlert[idx] == 0) continue;
+		activeAlerts++;
+		strAlerts += (strAlerts.empty() ? "" : ", ") + arrNames[idx];
+	}
+
+	const unsigned long received = std::min(sampleCount, QUALITY_WINDOW_LONG);
+	strm << std::fixed << std::setprecision(1)
+	     << "Tracking quality: " << arrNames.size() << " bodies, "
+	     << "source skipped " << ((received + skippedLong > 0) ? (100.0 * skippedLong / (received + skippedLong)) : 0.0) << "% of the frames, "
+	     << activeAlerts << " alerts";
+	if (!strAlerts.empty()) strm << " (" << strAlerts << ")";
+	return strm.str();
+}
+
+
+std::string QualityMonitor::getStatus() const
+{
+	std::stringstream strm;
+	const unsigned long received = std::min(sampleCount, QUALITY_WINDOW_LONG);
+	strm << std::fixed << std::setprecision(1)
+	     << "Windows        : " << QUALITY_WINDOW_SHORT << " / " << QUALITY_WINDOW_LONG << " frames" << std::endl
+	     << "Frames         : " << framesProcessed << " (" << framesSkipped << " skipped by the source, " << framesDropped << " dropped by the server, "
+	     << ((received + skippedLong > 0) ? (100.0 * skippedLong / (received + skippedLong)) : 0.0) << "% in the long window)" << std::endl
+	     << "Thresholds     : tracked ";
+	if (minTracked > 0) strm << ">= " << (minTracked * 100) << "%"; else strm << "-";
+	strm << ", jitter ";
+	if (maxJitter  > 0) strm << "<= " << std::setprecision(4) << maxJitter; else strm << "-";
+	strm << ", error ";
+	if (maxError   > 0) strm << "<= " << std::setprecision(4) << maxError;  else strm << "-";
+	strm << std::endl
+	     << "Alerts         : " << alertsRaised << " raised" << (sourceAlert ? ", source skipping frames" : "");
+
+	if (arrNames.empty()) return strm.str();
+
+	size_t nameWidth = 4;
+	for (const std::string& strName : arrNames) nameWidth = std::max(nameWidth, strName.size());
+
+	// tracked ratio, jitter, and error of the short and the long window, the error trend compares the two
+	strm << std::endl << std::left << std::setw(nameWidth) << "Body" << std::right
+	     << "  Tracked (short/long)  Jitter (short/long)   Error (short/long)  Trend  Alerts";
+	for (size_t idx = 0; idx < arrNames.size(); idx++)
+	{
+		const sWindow& refShort = arrShort[idx];
+		const sWindow& refLong  = arrLong[idx];
+		const float errorShort = getError(refShort);
+		const float errorLong  = getError(refLong);
+		const uint8_t alert    = arrAlert[idx];
+
+		strm << std::endl << std::left << std::setw(nameWidth) << arrNames[idx] << std::right
+		     << std::setprecision(1)
+		     << std::setw(11) << (getTrackedRatio(refShort, QUALITY_WINDOW_SHORT) * 100) << "% /"
+		     << std::setw(6)  << (getTrackedRatio(refLong,  QUALITY_WINDOW_LONG)  * 100) << "%"
+		     << std::setprecision(4)
+		     << std::setw(12) << getJitter(refShort) << " /"
+		     << std::setw(7)  << getJitter(refLong)
+		     << std::setw(12) << errorShort << " /"
+		     << std::setw(7)  << errorLong
+		     << std::setprecision(0) << std::showpos
+		     << std::setw(6)  << ((errorLong > 0) ? (100 * (errorShort / errorLong - 1)) : 0.0f) << "%"
+		     << std::noshowpos << "  "
+		     << ((alert & ALERT_TRACKING) ? "T" : "-")
+		     << ((alert & ALERT_JITTER)   ? "J" : "-")
+		     << ((alert & ALERT_ERROR)    ? "E" : "-");
+	}
+	return strm.str();
+}
@@ -0,0 +1,124 @@
+/**
+ * Continuous monitor of the tracking quality of rigid bodies and skeleton bones,
+ * so problems like a marker falling off a prop show up before a user complains.
+ *
+ * For each body, the samples of the most recent frames are kept in a fixed-size ring
+ * and a short and a long window over the ring are updated incrementally per frame:
+ * the ratio of tracked frames, the jitter (change of the frame-to-frame velocity), and the mean error.
+ * Frames that the MoCap system skipped (gaps in the frame numbers) are counted as well.
+ * A warning is logged when a body or the source crosses a threshold, and again when it recovers.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Class for the tracking quality monitor.
+ */
+class QualityMonitor
+{
+public:
+
+	QualityMonitor();
+
+	/**
+	 * Sets the alert thresholds and clears all statistics.
+	 *
+	 * @param strThresholds  the thresholds as "minTracked,maxJitter,maxError"
+	 *                       (minimum tracked ratio 0...1, maximum jitter and mean error in the units of the MoCap system,
+	 *                       0 or missing values: no alert)
+	 *
+	 * @return <code>true</code> if the thresholds could be parsed
+	 */
+	bool configure(const std::string& strThresholds);
+
+	/**
+	 * Adds the samples of a new frame of the MoCap system.
+	 *
+	 * @param refData  the MoCap data with the frame
+	 */
+	void process(const MoCapData& refData);
+
+	/**
+	 * Notes a frame of the MoCap system that the server dropped under load,
+	 * so the gap to the next frame isn't counted as skipped by the source.
+	 *
+	 * @param iFrame  the frame number of the dropped frame
+	 */
+	void frameDropped(int iFrame);
+
+	/**
+	 * Gets a one line summary of the source and the bodies with alerts.
+	 *
+	 * @return the summary text
+	 */
+	std::string getSummary() const;
+
+	/**
+	 * Gets a printable table with the statistics of all bodies.
+	 *
+	 * @return the statistics text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	/**
+	 * Statistics of one window over the ring.
+	 */
+	struct sWindow
+	{
+		int    tracked;      // tracked samples
+		int    jitterCount;  // samples with a jitter value
+		double jitterSum;
+		int    errorCount;   // samples with a mean error
+		double errorSum;
+	};
+
+	void reset(const MoCapData& refData);
+	void addSample(sWindow& refWindow, size_t sampleIdx, int sign);
+	void checkAlerts(size_t bodyIdx);
+
+	float  getTrackedRatio(const sWindow& refWindow, int size) const;
+	float  getJitter(const sWindow& refWindow) const;
+	float  getError(const sWindow& refWindow) const;
+
+private:
+
+	float        minTracked, maxJitter, maxError;
+
+	unsigned int descriptionGeneration; // the statistics are reset when the description changes
+	int          lastFrame;             // frame number of the previous frame
+	int          sampleCount;           // samples in the ring (up to the long window size)
+	int          head;                  // ring index of the newest sample
+
+	// ring of samples per body (body index * window size + ring index)
+	std::vector<uint8_t> arrRingTracked;
+	std::vector<float>   arrRingJitter;   // < 0: no value
+	std::vector<float>   arrRingError;    // < 0: no value
+
+	// state per body (rigid bodies first, then the bones of all skeletons)
+	std::vector<std::string> arrNames;
+	std::vector<sWindow>     arrShort, arrLong;
+	std::vector<float>       arrPosX, arrPosY, arrPosZ;  // last tracked position
+	std::vector<float>       arrVelX, arrVelY, arrVelZ;  // last frame-to-frame velocity
+	std::vector<uint8_t>     arrHistory;                 // consecutive tracked frames before this one (up to 2)
+	std::vector<uint8_t>     arrSeen;                    // tracked at least once since the reset
+	std::vector<uint8_t>     arrAlert;                   // active alerts
+
+	// ring of skipped frames of the source
+	std::vector<uint16_t>    arrRingSkipped;
+	unsigned long            skippedShort, skippedLong;
+	bool                     sourceAlert;
+
+	unsigned long framesProcessed;
+	unsigned long framesSkipped;
+	unsigned long framesDropped;
+	unsigned long alertsRaised;
+};
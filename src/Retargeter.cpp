@@ -0,0 +1,609 @@
+#include "Retargeter.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "Retargeter"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string.h>
+
+
+/******************************************************************************
+ * Canonical layout and built-in name tables
+ */
+
+struct sCanonicalBone
+{
+	const char* czName;
+	int         parent;
+};
+
+// canonical humanoid layout, bone IDs are the indices
+const sCanonicalBone CANONICAL_BONES[]
+{
+	{ "Hips",          -1 }, //  0
+	{ "Spine",          0 }, //  1
+	{ "Chest",          1 }, //  2
+	{ "Neck",           2 }, //  3
+	{ "Head",           3 }, //  4
+	{ "LeftShoulder",   2 }, //  5
+	{ "LeftUpperArm",   5 }, //  6
+	{ "LeftLowerArm",   6 }, //  7
+	{ "LeftHand",       7 }, //  8
+	{ "RightShoulder",  2 }, //  9
+	{ "RightUpperArm",  9 }, // 10
+	{ "RightLowerArm", 10 }, // 11
+	{ "RightHand",     11 }, // 12
+	{ "LeftUpperLeg",   0 }, // 13
+	{ "LeftLowerLeg",  13 }, // 14
+	{ "LeftFoot",      14 }, // 15
+	{ "LeftToes",      15 }, // 16
+	{ "RightUpperLeg",  0 }, // 17
+	{ "RightLowerLeg", 17 }, // 18
+	{ "RightFoot",     18 }, // 19
+	{ "RightToes",     19 }, // 20
+};
+
+const int CANONICAL_BONE_COUNT = sizeof(CANONICAL_BONES) / sizeof(CANONICAL_BONES[0]);
+
+
+struct sBuiltinMapping
+{
+	int         bone;
+	const char* czPattern;
+};
+
+// a skeleton with this bone uses the Kinect joint names
+#define RETARGET_KINECT_ROOT "HipCentre"
+
+// Kinect joints, the orientation of a joint belongs to the bone ending there (e.g., ElbowLeft: upper arm).
+// HipLeft/HipRight only lead to the legs, their rotations are composed into the upper legs.
+const sBuiltinMapping KINECT_MAPPINGS[]
+{
+	{  0, "HipCentre"      },
+	{  1, "Spine"          },
+	{  2, "ShoulderCentre" },
+	{  3, "Head"           },
+	{  5, "ShoulderLeft"   },
+	{  6, "ElbowLeft"      },
+	{  7, "WristLeft"      },
+	{  8, "HandLeft"       },
+	{  9, "ShoulderRight"  },
+	{ 10, "ElbowRight"     },
+	{ 11, "WristRight"     },
+	{ 12, "HandRight"      },
+	{ 13, "KneeLeft"       },
+	{ 14, "AnkleLeft"      },
+	{ 15, "FootLeft"       },
+	{ 17, "KneeRight"      },
+	{ 18, "AnkleRight"     },
+	{ 19, "FootRight"      },
+};
+
+// common names of Cortex and BVH skeletons, the rotation of a joint belongs to the bone starting there
+const sBuiltinMapping BUILTIN_MAPPINGS[]
+{
+	{  0, "Pelvis"         }, {  0, "Root"         },
+	{  1, "LowerBack"      }, {  1, "Spine1"       }, { 1, "Abdomen" },
+	{  2, "UpperBack"      }, {  2, "Spine2"       }, { 2, "Thorax"  },
+	{  5, "LCollar"        }, {  5, "LClavicle"    }, {  5, "LeftCollar"   },
+	{  6, "LUpArm"         }, {  6, "LUpperArm"    }, {  6, "LeftArm"      }, {  6, "LShoulder" },
+	{  7, "LForearm"       }, {  7, "LLowArm"      }, {  7, "LeftForeArm"  }, {  7, "LElbow"    },
+	{  8, "LHand"          }, {  8, "LWrist"       },
+	{  9, "RCollar"        }, {  9, "RClavicle"    }, {  9, "RightCollar"  },
+	{ 10, "RUpArm"         }, { 10, "RUpperArm"    }, { 10, "RightArm"     }, { 10, "RShoulder" },
+	{ 11, "RForearm"       }, { 11, "RLowArm"      }, { 11, "RightForeArm" }, { 11, "RElbow"    },
+	{ 12, "RHand"          }, { 12, "RWrist"       },
+	{ 13, "LThigh"         }, { 13, "LUpLeg"       }, { 13, "LeftUpLeg"    }, { 13, "LHip"      },
+	{ 14, "LShin"          }, { 14, "LLowLeg"      }, { 14, "LeftLeg"      }, { 14, "LKnee"     },
+	{ 15, "LFoot"          }, { 15, "LAnkle"       },
+	{ 16, "LToe"           }, { 16, "LToes"        }, { 16, "LeftToeBase"  },
+	{ 17, "RThigh"         }, { 17, "RUpLeg"       }, { 17, "RightUpLeg"   }, { 17, "RHip"      },
+	{ 18, "RShin"          }, { 18, "RLowLeg"      }, { 18, "RightLeg"     }, { 18, "RKnee"     },
+	{ 19, "RFoot"          }, { 19, "RAnkle"       },
+	{ 20, "RToe"           }, { 20, "RToes"        }, { 20, "RightToeBase" },
+};
+
+
+/******************************************************************************
+ * Retargeter class
+ */
+
+Retargeter::Retargeter() :
+	compiledGeneration(0),
+	compiledSkeletons(-1),
+	compiled(false),
+	framesProcessed(0)
+{
+	// nothing else to do
+}
+
+
+bool Retargeter::configure(const std::string& strSkeletons, const std::vector<std::string>& arrUserMappings)
+{
+	bool success = true;
+
+	arrSkeletonPatterns.clear();
+	std::istringstream strmPatterns(strSkeletons);
+	std::string strPattern;
+	while (std::getline(strmPatterns, strPattern, ';'))
+	{
+		if (!strPattern.empty()) arrSkeletonPatterns.push_back(strPattern);
+	}
+
+	const sRotation identity = { 0, 0, 0, 1 };
+	arrMappings.clear();
+
+	// user mappings
+	for (const std::string& strSpec : arrUserMappings)
+	{
+		const size_t posEquals = strSpec.find('=');
+		const size_t posColon  = strSpec.find(':', posEquals);
+		const std::string strBone = strSpec.substr(0, posEquals);
+
+		sMapping mapping;
+		mapping.bone   = -1;
+		mapping.rest   = identity;
+		mapping.kinect = false;
+		std::vector<int> arrBones;
+		for (int bIdx = 0; bIdx < CANONICAL_BONE_COUNT; bIdx++)
+		{
+			if (matchesPattern(strBone.c_str(), CANONICAL_BONES[bIdx].czName)) arrBones.push_back(bIdx);
+		}
+		bool valid = !arrBones.empty() && (posEquals != std::string::npos);
+		if (valid)
+		{
+			mapping.pattern = strSpec.substr(posEquals + 1, (posColon == std::string::npos) ? std::string::npos : posColon - posEquals - 1);
+			valid = !mapping.pattern.empty();
+		}
+		if (valid && (posColon != std::string::npos))
+		{
+			sRotation& q = mapping.rest;
+			valid = (sscanf(strSpec.c_str() + posColon, ":%f:%f:%f:%f", &q.qx, &q.qy, &q.qz, &q.qw) == 4);
+			const float len = sqrtf(q.qx * q.qx + q.qy * q.qy + q.qz * q.qz + q.qw * q.qw);
+			if (valid && (len > 0))
+			{
+				q.qx /= len; q.qy /= len; q.qz /= len; q.qw /= len;
+			}
+			valid &= (len > 0);
+		}
+
+		if (!valid)
+		{
+			LOG_ERROR("Invalid bone mapping '" << strSpec << "', expected <canonical bone>=<source bone>[:qx:qy:qz:qw]");
+			success = false;
+			continue;
+		}
+
+		// a canonical bone pattern can select several bones, e.g., "Left*"
+		for (int bIdx : arrBones)
+		{
+			mapping.bone = bIdx;
+			arrMappings.push_back(mapping);
+		}
+	}
+
+	// Kinect names before the canonical names, because "Spine" and "Head" are different bones there,
+	// then the canonical names, then the Cortex/BVH table
+	for (const sBuiltinMapping& refBuiltin : KINECT_MAPPINGS)
+	{
+		const sMapping mapping = { refBuiltin.bone, refBuiltin.czPattern, identity, true };
+		arrMappings.push_back(mapping);
+	}
+	for (int bIdx = 0; bIdx < CANONICAL_BONE_COUNT; bIdx++)
+	{
+		const sMapping mapping = { bIdx, CANONICAL_BONES[bIdx].czName, identity, false };
+		arrMappings.push_back(mapping);
+	}
+	for (const sBuiltinMapping& refBuiltin : BUILTIN_MAPPINGS)
+	{
+		const sMapping mapping = { refBuiltin.bone, refBuiltin.czPattern, identity, false };
+		arrMappings.push_back(mapping);
+	}
+
+	if (isEnabled())
+	{
+		LOG_INFO("Retargeting skeletons '" << strSkeletons << "' to the canonical layout with "
+		         << CANONICAL_BONE_COUNT << " bones (" << arrUserMappings.size() << " user mappings)");
+	}
+
+	arrTargets.clear();
+	compiled        = false;
+	framesProcessed = 0;
+	return success;
+}
+
+
+bool Retargeter::isEnabled() const
+{
+	return !arrSkeletonPatterns.empty();
+}
+
+
+bool Retargeter::isSelected(const char* czName) const
+{
+	for (const std::string& strPattern : arrSkeletonPatterns)
+	{
+		if (matchesPattern(strPattern.c_str(), czName)) return true;
+	}
+	return false;
+}
+
+
+void Retargeter::compile(const MoCapData& refData)
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+	arrTargets.clear();
+
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		const sSkeletonDescription* pDescription = refData.findSkeletonDescription(refFrame.Skeletons[sIdx]);
+		if (!pDescription || !isSelected(pDescription->szName)) continue;
+		if (refFrame.nSkeletons + (int) arrTargets.size() >= MAX_SKELETONS)
+		{
+			LOG_WARNING("No space for the retargeted skeleton of '" << pDescription->szName << "'");
+			break;
+		}
+
+		sTarget target;
+		target.sourceIdx   = sIdx;
+		target.sourceID    = refFrame.Skeletons[sIdx].skeletonID;
+		target.sourceBones = refFrame.Skeletons[sIdx].nRigidBodies;
+		target.name        = std::string(pDescription->szName).substr(0, MAX_NAMELENGTH - sizeof(RETARGET_NAME_SUFFIX)) + RETARGET_NAME_SUFFIX;
+		target.mappedBones = 0;
+		target.arrBoneIdx.assign(CANONICAL_BONE_COUNT, -1);
+
+		// source hierarchy by index
+		const int boneCount = std::min(pDescription->nRigidBodies, target.sourceBones);
+		std::vector<int> arrSourceParent(boneCount, -1);
+		bool kinect = false;
+		for (int bIdx = 0; bIdx < boneCount; bIdx++)
+		{
+			const sRigidBodyDescription& refBone = pDescription->RigidBodies[bIdx];
+			for (int pIdx = 0; pIdx < boneCount; pIdx++)
+			{
+				if ((pIdx != bIdx) && (pDescription->RigidBodies[pIdx].ID == refBone.parentID)) arrSourceParent[bIdx] = pIdx;
+			}
+			kinect |= (strcmp(refBone.szName, RETARGET_KINECT_ROOT) == 0);
+		}
+
+		// assign the source bones, each source bone only once, the user mappings before all others
+		std::vector<bool> arrUsed(boneCount, false);
+		target.arrOffset.assign(CANONICAL_BONE_COUNT, { 0, 0, 0, 1 });
+		for (size_t mIdx = 0; mIdx < arrMappings.size(); mIdx++)
+		{
+			const sMapping& refMapping = arrMappings[mIdx];
+			const int       cIdx       = refMapping.bone;
+			if ((target.arrBoneIdx[cIdx] >= 0) || (refMapping.kinect && !kinect)) continue;
+			for (int bIdx = 0; bIdx < boneCount; bIdx++)
+			{
+				if (!arrUsed[bIdx] && matchesPattern(refMapping.pattern.c_str(), pDescription->RigidBodies[bIdx].szName))
+				{
+					arrUsed[bIdx]           = true;
+					target.arrBoneIdx[cIdx] = bIdx;
+					target.arrOffset[cIdx]  = refMapping.rest;
+					target.mappedBones++;
+					break;
+				}
+			}
+		}
+
+		// rotation chains of the mapped bones
+		target.arrChainStart.assign(CANONICAL_BONE_COUNT + 1, 0);
+		target.arrPreOffset.assign(CANONICAL_BONE_COUNT, { 0, 0, 0, 1 });
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			target.arrChainStart[cIdx] = (int) target.arrChain.size();
+			if (target.arrBoneIdx[cIdx] >= 0) compileChain(target, cIdx, arrSourceParent);
+		}
+		target.arrChainStart[CANONICAL_BONE_COUNT] = (int) target.arrChain.size();
+
+		// start and end of the mapped bones: Kinect bones end at the mapped joint, all others start there
+		std::vector<int> arrStartIdx(CANONICAL_BONE_COUNT, -1);
+		std::vector<int> arrEndIdx(CANONICAL_BONE_COUNT, -1);
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			const int bIdx = target.arrBoneIdx[cIdx];
+			if (bIdx < 0) continue;
+			arrStartIdx[cIdx] = (kinect && (arrSourceParent[bIdx] >= 0)) ? arrSourceParent[bIdx] : bIdx;
+			arrEndIdx[cIdx]   = kinect ? bIdx : -1;
+		}
+		target.arrPosition.resize(CANONICAL_BONE_COUNT);
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			compilePosition(target, cIdx, arrStartIdx, arrEndIdx);
+		}
+
+		// the retargeted bones are owned by this class, the frame only points at them
+		sRigidBodyData bone;
+		memset(&bone, 0, sizeof(bone));
+		target.arrBones.assign(CANONICAL_BONE_COUNT, bone);
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			target.arrBones[cIdx].ID = cIdx;
+		}
+
+		LOG_INFO("Retargeting skeleton '" << pDescription->szName << "': "
+		         << target.mappedBones << " of " << CANONICAL_BONE_COUNT << " bones mapped");
+		arrTargets.push_back(target);
+	}
+
+	compiledGeneration = refData.descriptionGeneration;
+	compiledSkeletons  = refFrame.nSkeletons;
+	compiled           = true;
+}
+
+
+void Retargeter::compileChain(sTarget& refTarget, int cIdx, const std::vector<int>& arrSourceParent) const
+{
+	const int boneCount = (int) arrSourceParent.size();
+
+	// the closest mapped canonical parent, bones in between have a neutral rotation
+	int parent = CANONICAL_BONES[cIdx].parent;
+	while ((parent >= 0) && (refTarget.arrBoneIdx[parent] < 0)) parent = CANONICAL_BONES[parent].parent;
+	const int parentIdx = (parent >= 0) ? refTarget.arrBoneIdx[parent] : -1;
+	if (parent >= 0)
+	{
+		refTarget.arrPreOffset[cIdx] = conjugate(refTarget.arrOffset[parent]);
+	}
+
+	// source path from the root to the mapped bone (bounded, in case the hierarchy has a loop)
+	std::vector<int> arrPath;
+	for (int bIdx = refTarget.arrBoneIdx[cIdx]; (bIdx >= 0) && ((int) arrPath.size() < boneCount); bIdx = arrSourceParent[bIdx])
+	{
+		arrPath.insert(arrPath.begin(), bIdx);
+	}
+
+	// undo the rotations from the parent's source bone up to the common ancestor...
+	size_t common = 0; // path entries up to the common ancestor
+	for (int bIdx = parentIdx, steps = 0; (bIdx >= 0) && (steps < boneCount); bIdx = arrSourceParent[bIdx], steps++)
+	{
+		const std::vector<int>::iterator iter = std::find(arrPath.begin(), arrPath.end(), bIdx);
+		if (iter != arrPath.end())
+		{
+			common = (iter - arrPath.begin()) + 1;
+			break;
+		}
+		const sLink link = { bIdx, true };
+		refTarget.arrChain.push_back(link);
+	}
+
+	// ...and apply the rotations from there down to the mapped bone, including skipped source joints
+	for (size_t pIdx = common; pIdx < arrPath.size(); pIdx++)
+	{
+		const sLink link = { arrPath[pIdx], false };
+		refTarget.arrChain.push_back(link);
+	}
+}
+
+
+void Retargeter::compilePosition(sTarget& refTarget, int cIdx, const std::vector<int>& arrStartIdx, const std::vector<int>& arrEndIdx) const
+{
+	sPosition& refPosition = refTarget.arrPosition[cIdx];
+	if (arrStartIdx[cIdx] >= 0)
+	{
+		refPosition.fromIdx = refPosition.toIdx = arrStartIdx[cIdx];
+		refPosition.weight  = 0;
+		return;
+	}
+
+	// closest mapped parent and the number of bones to get from there to this bone
+	int parent = CANONICAL_BONES[cIdx].parent;
+	int levelsUp = 1;
+	while ((parent >= 0) && (arrStartIdx[parent] < 0))
+	{
+		parent = CANONICAL_BONES[parent].parent;
+		levelsUp++;
+	}
+
+	// closest mapped child (children come after their parents)
+	int child = -1, levelsDown = 0;
+	for (int dIdx = cIdx + 1; dIdx < CANONICAL_BONE_COUNT; dIdx++)
+	{
+		if (arrStartIdx[dIdx] < 0) continue;
+		int levels = 0;
+		int bone   = dIdx;
+		while ((bone >= 0) && (bone != cIdx))
+		{
+			bone = CANONICAL_BONES[bone].parent;
+			levels++;
+		}
+		if ((bone == cIdx) && ((child < 0) || (levels < levelsDown)))
+		{
+			child      = dIdx;
+			levelsDown = levels;
+		}
+	}
+
+	// the chain starts at the end of the mapped parent if it is known, otherwise at its start
+	int anchorIdx = -1;
+	if (parent >= 0)
+	{
+		anchorIdx = (arrEndIdx[parent] >= 0) ? arrEndIdx[parent] : arrStartIdx[parent];
+		levelsUp -= (arrEndIdx[parent] >= 0) ? 1 : 0;
+	}
+
+	refPosition.fromIdx = (anchorIdx >= 0) ? anchorIdx : ((child >= 0) ? arrStartIdx[child] : -1);
+	refPosition.toIdx   = refPosition.fromIdx;
+	refPosition.weight  = 0;
+	if ((anchorIdx >= 0) && (levelsUp > 0) && (child >= 0))
+	{
+		// spread evenly between the mapped parent and child
+		refPosition.toIdx  = arrStartIdx[child];
+		refPosition.weight = (float) levelsUp / (levelsUp + levelsDown);
+	}
+}
+
+
+Retargeter::sRotation Retargeter::multiply(const sRotation& a, const sRotation& b)
+{
+	const sRotation q = {
+		a.qw * b.qx + a.qx * b.qw + a.qy * b.qz - a.qz * b.qy,
+		a.qw * b.qy - a.qx * b.qz + a.qy * b.qw + a.qz * b.qx,
+		a.qw * b.qz + a.qx * b.qy - a.qy * b.qx + a.qz * b.qw,
+		a.qw * b.qw - a.qx * b.qx - a.qy * b.qy - a.qz * b.qz };
+	return q;
+}
+
+
+Retargeter::sRotation Retargeter::conjugate(const sRotation& q)
+{
+	const sRotation c = { -q.qx, -q.qy, -q.qz, q.qw };
+	return c;
+}
+
+
+bool Retargeter::hasDescriptions(const MoCapData& refData) const
+{
+	for (const sTarget& refTarget : arrTargets)
+	{
+		sSkeletonData data;
+		data.skeletonID = RETARGET_SKELETON_ID + refTarget.sourceID;
+		if (refData.findSkeletonDescription(data) == nullptr) return false;
+	}
+	return true;
+}
+
+
+void Retargeter::addDescriptions(MoCapData& refData)
+{
+	if (!isEnabled()) return;
+
+	refData.removeDerivedSkeletons();
+	if (!compiled || (compiledGeneration != refData.descriptionGeneration) || (compiledSkeletons != refData.frame.nSkeletons))
+	{
+		compile(refData);
+	}
+	if (hasDescriptions(refData)) return;
+
+	const int maxDescriptions = sizeof(refData.description.arrDataDescriptions) / sizeof(refData.description.arrDataDescriptions[0]);
+	for (const sTarget& refTarget : arrTargets)
+	{
+		sSkeletonData data;
+		data.skeletonID = RETARGET_SKELETON_ID + refTarget.sourceID;
+		if (refData.findSkeletonDescription(data) != nullptr) continue;
+
+		if (refData.description.nDataDescriptions >= maxDescriptions)
+		{
+			LOG_WARNING("No space for the description of retargeted skeleton '" << refTarget.name << "'");
+			break;
+		}
+
+		sSkeletonDescription* pDescription = new sSkeletonDescription();
+		memset(pDescription, 0, sizeof(*pDescription));
+		strncpy(pDescription->szName, refTarget.name.c_str(), sizeof(pDescription->szName) - 1);
+		pDescription->skeletonID   = data.skeletonID;
+		pDescription->nRigidBodies = CANONICAL_BONE_COUNT;
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			sRigidBodyDescription& refBone = pDescription->RigidBodies[cIdx];
+			strncpy(refBone.szName, CANONICAL_BONES[cIdx].czName, sizeof(refBone.szName) - 1);
+			refBone.ID       = cIdx;
+			refBone.parentID = CANONICAL_BONES[cIdx].parent;
+		}
+
+		sDataDescription& refDescription = refData.description.arrDataDescriptions[refData.description.nDataDescriptions];
+		refDescription.type = Descriptor_Skeleton;
+		refDescription.Data.SkeletonDescription = pDescription;
+		refData.description.nDataDescriptions++;
+	}
+}
+
+
+void Retargeter::process(MoCapData& refData)
+{
+	if (!isEnabled()) return;
+
+	// strips the skeletons of the previous pass and updates the assignment when the description changed
+	addDescriptions(refData);
+	framesProcessed++;
+
+	sFrameOfMocapData& refFrame = refData.frame;
+	for (sTarget& refTarget : arrTargets)
+	{
+		const sSkeletonData& refSource = refFrame.Skeletons[refTarget.sourceIdx];
+		if ((refSource.nRigidBodies != refTarget.sourceBones) || (refFrame.nSkeletons >= MAX_SKELETONS)) continue;
+
+		// compose the rotation chains with the rest-pose corrections
+		const sRigidBodyData* pSource = refSource.RigidBodyData;
+		sRigidBodyData*       pBones  = refTarget.arrBones.data();
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			sRigidBodyData&  refBone = pBones[cIdx];
+			const int        boneIdx = refTarget.arrBoneIdx[cIdx];
+			const sPosition& p       = refTarget.arrPosition[cIdx];
+			if (boneIdx >= 0)
+			{
+				sRotation q = refTarget.arrPreOffset[cIdx];
+				for (int lIdx = refTarget.arrChainStart[cIdx]; lIdx < refTarget.arrChainStart[cIdx + 1]; lIdx++)
+				{
+					const sLink&          refLink = refTarget.arrChain[lIdx];
+					const sRigidBodyData& b       = pSource[refLink.boneIdx];
+					const sRotation       r       = { b.qx, b.qy, b.qz, b.qw };
+					q = multiply(q, refLink.inverse ? conjugate(r) : r);
+				}
+				q = multiply(q, refTarget.arrOffset[cIdx]);
+				refBone.qx = q.qx; refBone.qy = q.qy; refBone.qz = q.qz; refBone.qw = q.qw;
+				refBone.MeanError = pSource[boneIdx].MeanError;
+				refBone.params    = pSource[boneIdx].params;
+			}
+			else
+			{
+				// not mapped: neutral rotation, so it follows its parent
+				refBone.qx = 0; refBone.qy = 0; refBone.qz = 0; refBone.qw = 1;
+				refBone.MeanError = 0;
+				refBone.params    = STATUS_NOT_TRACKED;
+			}
+
+			if (p.fromIdx >= 0)
+			{
+				const sRigidBodyData& a = pSource[p.fromIdx];
+				const sRigidBodyData& b = pSource[p.toIdx];
+				refBone.x = a.x + p.weight * (b.x - a.x);
+				refBone.y = a.y + p.weight * (b.y - a.y);
+				refBone.z = a.z + p.weight * (b.z - a.z);
+			}
+			else
+			{
+				refBone.x = 0; refBone.y = 0; refBone.z = 0;
+			}
+		}
+
+		sSkeletonData& refSkeleton = refFrame.Skeletons[refFrame.nSkeletons++];
+		refSkeleton.skeletonID    = RETARGET_SKELETON_ID + refTarget.sourceID;
+		refSkeleton.nRigidBodies  = CANONICAL_BONE_COUNT;
+		refSkeleton.RigidBodyData = pBones;
+		refData.derivedSkeletons++;
+	}
+}
+
+
+std::string Retargeter::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "Retargeting: disabled";
+		return strm.str();
+	}
+
+	strm << "Skeletons      : " << arrTargets.size() << " retargeted" << std::endl
+	     << "Canonical bones: " << CANONICAL_BONE_COUNT << std::endl
+	     << "Frames         : " << framesProcessed;
+	for (const sTarget& refTarget : arrTargets)
+	{
+		strm << std::endl << refTarget.name << " (ID " << (RETARGET_SKELETON_ID + refTarget.sourceID) << "): "
+		     << refTarget.mappedBones << " of " << CANONICAL_BONE_COUNT << " bones mapped";
+		std::string strSeparator = ", missing ";
+		for (int cIdx = 0; cIdx < CANONICAL_BONE_COUNT; cIdx++)
+		{
+			if (refTarget.arrBoneIdx[cIdx] >= 0) continue;
+			strm << strSeparator << CANONICAL_BONES[cIdx].czName;
+			strSeparator = ", ";
+		}
+	}
+	return strm.str();
+}
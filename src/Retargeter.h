@@ -0,0 +1,162 @@
+/**
+ * Skeleton retargeting onto a canonical humanoid bone layout,
+ * so clients don't need mapping code for each MoCap system (Kinect joints, Cortex segments, ...).
+ *
+ * The bones of a source skeleton are assigned to the canonical bones by name, with the user mappings first,
+ * then the Kinect joint names for Kinect skeletons, then the canonical name itself,
+ * then a built-in table with common Cortex/BVH names.
+ * Each mapping can have a rest-pose correction, a rotation applied in the coordinate system of the bone,
+ * so the bone axes of the source match the canonical rest pose.
+ *
+ * Bone rotations are relative to the parent bone in the source and in the canonical layout. Source joints
+ * without a canonical bone (e.g., the Kinect hip joints) are composed into the rotation of the next mapped bone,
+ * so the canonical rotation is the rotation between the source bones of the canonical bone and its mapped parent,
+ * corrected by the rest poses of both. Kinect orientations belong to the bone that ends at a joint,
+ * so a Kinect bone starts at the position of the parent joint. Canonical bones without a source have
+ * a neutral rotation and are placed along the chain between the closest mapped parent and child.
+ *
+ * The assignment is resolved into rotation chains, offsets, and position indices whenever the description changes,
+ * so each frame only gathers the source bones and multiplies their rotations.
+ * The retargeted skeletons are appended to the frame as additional skeletons
+ * named "<source name> Humanoid" with the ID RETARGET_SKELETON_ID + the source ID.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <string>
+#include <vector>
+
+
+// skeleton ID offset of the retargeted skeletons
+#define RETARGET_SKELETON_ID 1000
+
+// suffix for the names of the retargeted skeletons
+#define RETARGET_NAME_SUFFIX " Humanoid"
+
+
+/**
+ * Class for the skeleton retargeting.
+ */
+class Retargeter
+{
+public:
+
+	Retargeter();
+
+	/**
+	 * Sets the skeletons to retarget and the user bone mappings.
+	 *
+	 * @param strSkeletons  name patterns of the source skeletons with '*' and '?', separated by ';' (empty: disabled)
+	 * @param arrMappings   user mappings as "<canonical bone>=<source bone pattern>[:qx:qy:qz:qw]"
+	 *
+	 * @return <code>true</code> if all mappings were valid
+	 */
+	bool configure(const std::string& strSkeletons, const std::vector<std::string>& arrMappings);
+
+	/**
+	 * Checks if retargeting is enabled.
+	 *
+	 * @return <code>true</code> if skeletons are retargeted
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Appends the descriptions of the retargeted skeletons to a scene description, unless they are already there.
+	 * The description generation is not changed.
+	 *
+	 * @param refData  the MoCap data with the description
+	 */
+	void addDescriptions(MoCapData& refData);
+
+	/**
+	 * Retargets the selected skeletons of a frame and appends them to the frame.
+	 *
+	 * @param refData  the MoCap data with the frame
+	 */
+	void process(MoCapData& refData);
+
+	/**
+	 * Gets a printable summary of the canonical layout and the bone assignment of each skeleton.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	struct sRotation
+	{
+		float qx, qy, qz, qw;
+	};
+
+	/**
+	 * Mapping of a canonical bone onto a source bone name.
+	 */
+	struct sMapping
+	{
+		int         bone;     // canonical bone index
+		std::string pattern;  // source bone name pattern
+		sRotation   rest;     // rest-pose correction
+		bool        kinect;   // only for Kinect skeletons
+	};
+
+	/**
+	 * Source rotation in the chain of a canonical bone.
+	 */
+	struct sLink
+	{
+		int  boneIdx;  // source bone index
+		bool inverse;  // the rotation is undone (walking up the source hierarchy)
+	};
+
+	/**
+	 * Position of a canonical bone, interpolated between two source bones.
+	 */
+	struct sPosition
+	{
+		int   fromIdx, toIdx;  // source bone indices (-1: origin)
+		float weight;          // 0: at the first bone, 1: at the second bone
+	};
+
+	/**
+	 * Precomputed assignment for one source skeleton.
+	 */
+	struct sTarget
+	{
+		int                         sourceIdx;      // skeleton index in the frame
+		int                         sourceID;       // skeleton ID of the source
+		int                         sourceBones;    // bone count of the source when the assignment was made
+		std::string                 name;
+		std::vector<int>            arrBoneIdx;     // per canonical bone: source bone index (-1: not mapped)
+		std::vector<int>            arrChainStart;  // per canonical bone: first link in arrChain (one more entry for the end)
+		std::vector<sLink>          arrChain;       // source rotations to compose, per canonical bone
+		std::vector<sRotation>      arrPreOffset;   // per canonical bone: inverse rest-pose correction of the mapped parent
+		std::vector<sRotation>      arrOffset;      // per canonical bone: rest-pose correction
+		std::vector<sPosition>      arrPosition;    // per canonical bone: where to take the position from
+		std::vector<sRigidBodyData> arrBones;       // retargeted bones of the current frame
+		int                         mappedBones;
+	};
+
+	void compile(const MoCapData& refData);
+	void compileChain(sTarget& refTarget, int cIdx, const std::vector<int>& arrSourceParent) const;
+	void compilePosition(sTarget& refTarget, int cIdx, const std::vector<int>& arrStartIdx, const std::vector<int>& arrEndIdx) const;
+
+	static sRotation multiply(const sRotation& a, const sRotation& b);
+	static sRotation conjugate(const sRotation& q);
+	bool isSelected(const char* czName) const;
+	bool hasDescriptions(const MoCapData& refData) const;
+
+private:
+
+	std::vector<std::string> arrSkeletonPatterns;
+	std::vector<sMapping>    arrMappings;  // user mappings, Kinect names, canonical names, and Cortex/BVH names
+
+	std::vector<sTarget>     arrTargets;
+	unsigned int             compiledGeneration;
+	int                      compiledSkeletons;
+	bool                     compiled;
+
+	unsigned long            framesProcessed;
+};
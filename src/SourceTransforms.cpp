@@ -0,0 +1,247 @@
+#include "SourceTransforms.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "SourceTransforms"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+
+// minimum portion of the sampled frames in which the reference body has to be tracked
+#define CALIBRATION_MIN_TRACKED 0.5f
+
+// names of the sources for options and status
+const char* SOURCE_NAMES[SOURCE_COUNT] = { "primary", "standby" };
+
+
+/******************************************************************************
+ * SourceTransforms class
+ */
+
+SourceTransforms::SourceTransforms() :
+	globalScale(1.0f),
+	calibrationSource(-1),
+	calibrationFrames(0),
+	framesSampled(0)
+{
+	for (int source = 0; source < SOURCE_COUNT; source++)
+	{
+		resetTransform(source);
+	}
+}
+
+
+bool SourceTransforms::configure(const std::vector<std::string>& arrSpecs, float _globalScale)
+{
+	bool success = true;
+	globalScale  = _globalScale;
+	calibrationSource = -1;
+	for (int source = 0; source < SOURCE_COUNT; source++)
+	{
+		resetTransform(source);
+	}
+
+	for (const std::string& strSpec : arrSpecs)
+	{
+		const size_t posEquals = strSpec.find('=');
+		const std::string strSource = strSpec.substr(0, posEquals);
+		int source = -1;
+		for (int idx = 0; idx < SOURCE_COUNT; idx++)
+		{
+			if (matchesPattern(SOURCE_NAMES[idx], strSource.c_str())) source = idx;
+		}
+
+		sSourceTransform t = { 0, 0, 0, 0, 0, 0, 1, 1 };
+		const int values = (posEquals == std::string::npos) ? 0 :
+			sscanf(strSpec.c_str() + posEquals + 1, "%f,%f,%f,%f,%f,%f,%f,%f", &t.x, &t.y, &t.z, &t.qx, &t.qy, &t.qz, &t.qw, &t.scale);
+		const float len = sqrtf(t.qx * t.qx + t.qy * t.qy + t.qz * t.qz + t.qw * t.qw);
+		if ((source < 0) || ((values != 3) && (values != 7) && (values != 8)) || (len <= 0) || (t.scale <= 0))
+		{
+			LOG_ERROR("Invalid source transform '" << strSpec << "', expected primary|standby=x,y,z[,qx,qy,qz,qw[,scale]]");
+			success = false;
+			continue;
+		}
+		t.qx /= len; t.qy /= len; t.qz /= len; t.qw /= len;
+		arrTransforms[source] = t;
+		updateFused(source);
+		LOG_INFO("Transform of the " << SOURCE_NAMES[source] << " source: " << toString(source));
+	}
+	return success;
+}
+
+
+void SourceTransforms::resetTransform(int source)
+{
+	const sSourceTransform identity = { 0, 0, 0, 0, 0, 0, 1, 1 };
+	arrTransforms[source] = identity;
+	updateFused(source);
+}
+
+
+void SourceTransforms::updateFused(int source)
+{
+	// p' = globalScale * (scale * R * p + t)
+	const sSourceTransform& t = arrTransforms[source];
+	sTransform&             f = arrFused[source];
+	const float s = globalScale * t.scale;
+	const float x = t.qx, y = t.qy, z = t.qz, w = t.qw;
+
+	f.matrix[0][0] = s * (1 - 2 * (y * y + z * z));
+	f.matrix[0][1] = s * (    2 * (x * y - z * w));
+	f.matrix[0][2] = s * (    2 * (x * z + y * w));
+	f.matrix[1][0] = s * (    2 * (x * y + z * w));
+	f.matrix[1][1] = s * (1 - 2 * (x * x + z * z));
+	f.matrix[1][2] = s * (    2 * (y * z - x * w));
+	f.matrix[2][0] = s * (    2 * (x * z - y * w));
+	f.matrix[2][1] = s * (    2 * (y * z + x * w));
+	f.matrix[2][2] = s * (1 - 2 * (x * x + y * y));
+	f.matrix[0][3] = globalScale * t.x;
+	f.matrix[1][3] = globalScale * t.y;
+	f.matrix[2][3] = globalScale * t.z;
+
+	f.qx = t.qx; f.qy = t.qy; f.qz = t.qz; f.qw = t.qw;
+	f.scale = s;
+}
+
+
+void SourceTransforms::process(MoCapData& refData, int source)
+{
+	if ((source < 0) || (source >= SOURCE_COUNT)) return;
+
+	// the reference body is sampled in the coordinates of the source
+	if (calibrationSource == source)
+	{
+		const sFrameOfMocapData& refFrame = refData.frame;
+		for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+		{
+			const sRigidBodyData&        refBody      = refFrame.RigidBodies[rbIdx];
+			const sRigidBodyDescription* pDescription = refData.findRigidBodyDescription(refBody);
+			if ((refBody.params & STATUS_TRACKED) && pDescription && matchesPattern(calibrationBody.c_str(), pDescription->szName))
+			{
+				const sSample sample = { refBody.x, refBody.y, refBody.z, refBody.qx, refBody.qy, refBody.qz, refBody.qw };
+				arrSamples.push_back(sample);
+				break;
+			}
+		}
+		framesSampled++;
+		if (framesSampled >= calibrationFrames)
+		{
+			solveCalibration();
+		}
+	}
+
+	refData.applyTransform(arrFused[source]);
+}
+
+
+const sTransform& SourceTransforms::getTransform(int source) const
+{
+	return arrFused[source];
+}
+
+
+bool SourceTransforms::startCalibration(int source, const std::string& strBody, float seconds, float updateRate)
+{
+	if ((source < 0) || (source >= SOURCE_COUNT) || strBody.empty() || (seconds <= 0) || (updateRate <= 0))
+	{
+		return false;
+	}
+
+	calibrationSource = source;
+	calibrationBody   = strBody;
+	calibrationFrames = std::max((size_t) 1, (size_t) (seconds * updateRate));
+	framesSampled     = 0;
+	arrSamples.clear();
+	arrSamples.reserve(calibrationFrames);
+	strLastResult = "running";
+	LOG_INFO("Calibrating the " << SOURCE_NAMES[source] << " source with '" << strBody << "' over " << calibrationFrames << " frames");
+	return true;
+}
+
+
+void SourceTransforms::solveCalibration()
+{
+	const int source = calibrationSource;
+	calibrationSource = -1;
+
+	const size_t count = arrSamples.size();
+	if (count < CALIBRATION_MIN_TRACKED * framesSampled)
+	{
+		std::stringstream strm;
+		strm << "failed, '" << calibrationBody << "' only tracked in " << count << " of " << framesSampled << " frames";
+		strLastResult = strm.str();
+		LOG_WARNING("Calibration of the " << SOURCE_NAMES[source] << " source " << strLastResult);
+		return;
+	}
+
+	// least-squares mean of the positions and the orientations (quaternions in the hemisphere of the first one)
+	double px = 0, py = 0, pz = 0, qx = 0, qy = 0, qz = 0, qw = 0;
+	const sSample& first = arrSamples[0];
+	for (const sSample& s : arrSamples)
+	{
+		const double sign = ((s.qx * first.qx + s.qy * first.qy + s.qz * first.qz + s.qw * first.qw) < 0) ? -1 : 1;
+		px += s.x; py += s.y; pz += s.z;
+		qx += sign * s.qx; qy += sign * s.qy; qz += sign * s.qz; qw += sign * s.qw;
+	}
+	px /= count; py /= count; pz /= count;
+	const double len = sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+	qx /= len; qy /= len; qz /= len; qw /= len;
+
+	// residual of the positions, indicates if the reference body moved
+	double residual = 0;
+	for (const sSample& s : arrSamples)
+	{
+		residual += (s.x - px) * (s.x - px) + (s.y - py) * (s.y - py) + (s.z - pz) * (s.z - pz);
+	}
+	residual = sqrt(residual / count);
+
+	// the averaged pose becomes the origin: R = inverse(q), t = -scale * R * p
+	sSourceTransform& t = arrTransforms[source];
+	t.qx = (float) -qx + 0.0f; t.qy = (float) -qy + 0.0f; t.qz = (float) -qz + 0.0f; t.qw = (float) qw; // no "-0" in the printed option
+	t.x = 0; t.y = 0; t.z = 0;
+	updateFused(source);
+	const float (&m)[3][4] = arrFused[source].matrix;
+	t.x = (float) -(m[0][0] * px + m[0][1] * py + m[0][2] * pz) / globalScale;
+	t.y = (float) -(m[1][0] * px + m[1][1] * py + m[1][2] * pz) / globalScale;
+	t.z = (float) -(m[2][0] * px + m[2][1] * py + m[2][2] * pz) / globalScale;
+	updateFused(source);
+
+	std::stringstream strm;
+	strm << "-transform " << SOURCE_NAMES[source] << "=" << toString(source)
+	     << " (" << count << " samples, residual " << residual << ")";
+	strLastResult = strm.str();
+	LOG_INFO("Calibrated the " << SOURCE_NAMES[source] << " source: " << strLastResult);
+}
+
+
+std::string SourceTransforms::toString(int source) const
+{
+	const sSourceTransform& t = arrTransforms[source];
+	std::stringstream strm;
+	strm << t.x << "," << t.y << "," << t.z << ","
+	     << t.qx << "," << t.qy << "," << t.qz << "," << t.qw << "," << t.scale;
+	return strm.str();
+}
+
+
+std::string SourceTransforms::getStatus() const
+{
+	std::stringstream strm;
+	strm << "Primary        : " << toString(SOURCE_PRIMARY) << std::endl
+	     << "Standby        : " << toString(SOURCE_STANDBY) << std::endl
+	     << "Global scale   : " << globalScale << std::endl
+	     << "Calibration    : ";
+	if (calibrationSource >= 0)
+	{
+		strm << SOURCE_NAMES[calibrationSource] << " with '" << calibrationBody << "', "
+		     << framesSampled << " of " << calibrationFrames << " frames, " << arrSamples.size() << " samples";
+	}
+	else
+	{
+		strm << (strLastResult.empty() ? "none" : strLastResult);
+	}
+	return strm.str();
+}
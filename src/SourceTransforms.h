@@ -0,0 +1,124 @@
+/**
+ * Calibration transforms for the primary and the standby MoCap system,
+ * so sources with different origins, axes, and units line up in one scene.
+ *
+ * Each source has a similarity transform (translation, rotation, scale) that is fused with the global scale
+ * into a single matrix, and applied to all positions and orientations of its frames in one pass.
+ *
+ * A source is calibrated with a reference rigid body: its poses are sampled for a few seconds
+ * and averaged in the least-squares sense, and the transform is solved so that the averaged pose
+ * becomes the origin of the scene with neutral orientation. Calibrating each source with the same
+ * reference body at the same place aligns the sources. The scale of a source is not changed by the calibration.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <string>
+#include <vector>
+
+
+// sources with their own transform
+#define SOURCE_PRIMARY  0
+#define SOURCE_STANDBY  1
+#define SOURCE_COUNT    2
+
+
+/**
+ * Class for the source transforms.
+ */
+class SourceTransforms
+{
+public:
+
+	SourceTransforms();
+
+	/**
+	 * Sets the transforms of the sources and the global scale.
+	 *
+	 * @param arrSpecs     the transforms as "<source>=x,y,z[,qx,qy,qz,qw[,scale]]" with the source "primary" or "standby"
+	 * @param globalScale  the scale applied after the transform of each source
+	 *
+	 * @return <code>true</code> if all transforms were valid
+	 */
+	bool configure(const std::vector<std::string>& arrSpecs, float globalScale);
+
+	/**
+	 * Samples the reference body if the source is being calibrated, then transforms the frame.
+	 *
+	 * @param refData  the MoCap data with the frame
+	 * @param source   the source of the frame (SOURCE_...)
+	 */
+	void process(MoCapData& refData, int source);
+
+	/**
+	 * Gets the transform of a source into the coordinates of the stream, including the global scale.
+	 *
+	 * @param source  the source (SOURCE_...)
+	 *
+	 * @return the fused transform
+	 */
+	const sTransform& getTransform(int source) const;
+
+	/**
+	 * Starts the calibration of a source with a reference rigid body.
+	 *
+	 * @param source      the source to calibrate (SOURCE_...)
+	 * @param strBody     name pattern of the reference rigid body
+	 * @param seconds     duration of the sampling
+	 * @param updateRate  frame rate of the source
+	 *
+	 * @return <code>true</code> if the calibration was started
+	 */
+	bool startCalibration(int source, const std::string& strBody, float seconds, float updateRate);
+
+	/**
+	 * Resets the transform of a source to the identity.
+	 *
+	 * @param source  the source (SOURCE_...)
+	 */
+	void resetTransform(int source);
+
+	/**
+	 * Gets a printable summary of the transforms and the calibration state.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	/**
+	 * Transform of a source as given by the user or the calibration.
+	 */
+	struct sSourceTransform
+	{
+		float x, y, z;
+		float qx, qy, qz, qw;
+		float scale;
+	};
+
+	struct sSample
+	{
+		float x, y, z;
+		float qx, qy, qz, qw;
+	};
+
+	void updateFused(int source);
+	void solveCalibration();
+	std::string toString(int source) const;
+
+private:
+
+	sSourceTransform arrTransforms[SOURCE_COUNT];
+	sTransform       arrFused[SOURCE_COUNT];     // including the global scale
+	float            globalScale;
+
+	// calibration
+	int                  calibrationSource;     // -1: not calibrating
+	std::string          calibrationBody;
+	size_t               calibrationFrames, framesSampled;
+	std::vector<sSample> arrSamples;
+	std::string          strLastResult;
+};
@@ -0,0 +1,141 @@
+#include "SourceWatchdog.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "SourceWatchdog"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+
+SourceWatchdog::SourceWatchdog() :
+	enabled(false),
+	onStandby(false),
+	stallFrames(10),
+	strStandbyName(""),
+	tLastPrimaryFrame(),
+	tLastStandbyFrame(),
+	tSwitched(),
+	failovers(0),
+	recoveries(0),
+	standbyFrames(0),
+	standbyTime(0),
+	longestStall(0)
+{
+	// nothing else to do
+}
+
+
+void SourceWatchdog::start(int stallFrames, const std::string& strStandbyName)
+{
+	this->stallFrames    = std::max(1, stallFrames);
+	this->strStandbyName = strStandbyName;
+	enabled           = true;
+	onStandby         = false;
+	tLastPrimaryFrame = tClock::now();
+	tLastStandbyFrame = tClock::time_point();
+	tSwitched         = tLastPrimaryFrame;
+
+	LOG_INFO("Switching to the standby source '" << strStandbyName << "' after "
+		<< this->stallFrames << " frame periods without new frames");
+}
+
+
+void SourceWatchdog::stop()
+{
+	enabled   = false;
+	onStandby = false;
+}
+
+
+bool SourceWatchdog::isEnabled() const
+{
+	return enabled;
+}
+
+
+bool SourceWatchdog::isOnStandby() const
+{
+	return onStandby;
+}
+
+
+void SourceWatchdog::primaryFrameReceived()
+{
+	const tClock::time_point now = tClock::now();
+	tLastPrimaryFrame = now;
+
+	if (onStandby)
+	{
+		const double stall = std::chrono::duration<double>(now - tSwitched).count();
+		standbyTime  += stall;
+		longestStall  = std::max(longestStall, stall);
+		recoveries++;
+		onStandby = false;
+		tSwitched = now;
+		LOG_INFO("Primary source recovered after " << std::fixed << std::setprecision(3) << stall << "s > switching back");
+	}
+}
+
+
+void SourceWatchdog::standbyFrameReceived()
+{
+	tLastStandbyFrame = tClock::now();
+	standbyFrames++;
+}
+
+
+bool SourceWatchdog::check(float updateRate, bool primaryRunning)
+{
+	if (!enabled) return false;
+
+	const tClock::time_point now = tClock::now();
+	if (!primaryRunning)
+	{
+		// paused on purpose > restart the timeout
+		tLastPrimaryFrame = now;
+	}
+	else if (!onStandby && (updateRate > 0))
+	{
+		const double silence = std::chrono::duration<double>(now - tLastPrimaryFrame).count();
+		if (silence * updateRate >= stallFrames)
+		{
+			failovers++;
+			onStandby = true;
+			tSwitched = now;
+			LOG_WARNING("No new frames from the primary source for " << std::fixed << std::setprecision(3) << silence
+				<< "s > switching to the standby source '" << strStandbyName << "'");
+		}
+	}
+	return onStandby;
+}
+
+
+std::string SourceWatchdog::getStatus() const
+{
+	std::stringstream strm;
+	if (!enabled)
+	{
+		strm << "Source failover: disabled";
+		return strm.str();
+	}
+
+	const tClock::time_point now = tClock::now();
+	double totalStandbyTime = standbyTime;
+	if (onStandby) totalStandbyTime += std::chrono::duration<double>(now - tSwitched).count();
+
+	strm << std::fixed << std::setprecision(3)
+	     << "Active source  : " << (onStandby ? "standby '" + strStandbyName + "'" : std::string("primary")) << std::endl
+	     << "Stall timeout  : " << stallFrames << " frame periods" << std::endl
+	     << "Last frame     : primary " << std::chrono::duration<double>(now - tLastPrimaryFrame).count() << "s ago";
+	if (standbyFrames > 0)
+	{
+		strm << ", standby " << std::chrono::duration<double>(now - tLastStandbyFrame).count() << "s ago";
+	}
+	strm << std::endl
+	     << "Switches       : " << failovers << " to the standby, " << recoveries << " back to the primary" << std::endl
+	     << "Standby frames : " << standbyFrames << std::endl
+	     << "Time on standby: " << totalStandbyTime << "s (longest " << std::max(longestStall, onStandby ? std::chrono::duration<double>(now - tSwitched).count() : 0.0) << "s)";
+	return strm.str();
+}
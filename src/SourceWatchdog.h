@@ -0,0 +1,97 @@
+/**
+ * Watchdog for switching from a stalled primary MoCap system to a standby source and back.
+ *
+ * A MoCap system that stops delivering frames (e.g., Cortex losing its cameras) simply stops signalling,
+ * so without the watchdog the clients would see a frozen stream without any indication.
+ * The primary counts as stalled when it hasn't delivered a new frame for a number of frame periods,
+ * frames that the MoCap system reports as unchanged don't count.
+ * It counts as recovered with its first new frame.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+
+/**
+ * Class for tracking the frames of the primary and the standby source.
+ */
+class SourceWatchdog
+{
+public:
+
+	typedef std::chrono::steady_clock tClock;
+
+	SourceWatchdog();
+
+	/**
+	 * Enables the watchdog and starts with the primary source.
+	 *
+	 * @param stallFrames     the number of frame periods without a new frame before switching to the standby
+	 * @param strStandbyName  the name of the standby source for the status
+	 */
+	void start(int stallFrames, const std::string& strStandbyName);
+
+	/**
+	 * Disables the watchdog.
+	 */
+	void stop();
+
+	/**
+	 * Checks if the watchdog is enabled.
+	 *
+	 * @return <code>true</code> if there is a standby source
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Checks if the standby source is used instead of the primary.
+	 *
+	 * @return <code>true</code> if the primary is stalled
+	 */
+	bool isOnStandby() const;
+
+	/**
+	 * Registers a new frame of the primary source and switches back to it when it was stalled.
+	 */
+	void primaryFrameReceived();
+
+	/**
+	 * Registers a frame of the standby source.
+	 */
+	void standbyFrameReceived();
+
+	/**
+	 * Checks if the primary source has stalled and switches to the standby if so.
+	 * Should be called once per frame period.
+	 *
+	 * @param updateRate      the update rate of the primary source in frames per second
+	 * @param primaryRunning  <code>false</code> if the primary is paused, which doesn't count as a stall
+	 *
+	 * @return <code>true</code> if the standby source is used
+	 */
+	bool check(float updateRate, bool primaryRunning);
+
+	/**
+	 * Gets a printable summary of the watchdog.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	bool               enabled;
+	bool               onStandby;
+	int                stallFrames;
+	std::string        strStandbyName;
+
+	tClock::time_point tLastPrimaryFrame, tLastStandbyFrame, tSwitched;
+
+	unsigned long      failovers;     // switches to the standby
+	unsigned long      recoveries;    // switches back to the primary
+	unsigned long      standbyFrames;
+	double             standbyTime;   // total time on the standby in s (without the current period)
+	double             longestStall;  // longest time on the standby in s
+};
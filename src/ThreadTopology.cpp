@@ -0,0 +1,362 @@
+#include "ThreadTopology.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "ThreadTopology"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef WIN32
+	#include <Windows.h>
+#else
+	#include <errno.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <string.h>
+	#include <sys/mman.h>
+#endif
+
+
+// Windows has no equivalent to mlockall > reserve a larger minimum working set instead
+#define WORKING_SET_MIN (256 * 1024 * 1024)
+#define WORKING_SET_MAX (1024 * 1024 * 1024)
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+static std::string toLowercase(const std::string& str)
+{
+	std::string strLower;
+	std::transform(str.begin(), str.end(), std::back_inserter(strLower), ::tolower);
+	return strLower;
+}
+
+
+// configured thread settings and registered threads
+static std::mutex                             mtxTopology;
+static std::map<std::string, sThreadSettings> mapSettings;
+static std::list<ThreadMetrics>               listMetrics;
+
+
+
+/******************************************************************************
+ * sThreadSettings structure
+ */
+
+sThreadSettings::sThreadSettings() :
+	name(""),
+	cpus(),
+	policy(""),
+	hasPriority(false),
+	priority(0)
+{
+	// nothing else to do
+}
+
+
+bool sThreadSettings::parse(const std::string& strSpec)
+{
+	bool success = true;
+	std::istringstream strmSpec(strSpec);
+	std::string strPair;
+	while (std::getline(strmSpec, strPair, ','))
+	{
+		size_t posEquals = strPair.find('=');
+		if (posEquals == std::string::npos)
+		{
+			LOG_ERROR("Invalid thread parameter '" << strPair << "'");
+			success = false;
+			continue;
+		}
+
+		std::string strKey   = toLowercase(strPair.substr(0, posEquals));
+		std::string strValue = toLowercase(strPair.substr(posEquals + 1));
+
+		if (strKey == "name")
+		{
+			name = strValue;
+		}
+		else if (strKey == "cpus")
+		{
+			// several cores separated by semicolons
+			std::istringstream strmCpus(strValue);
+			std::string strCpu;
+			while (std::getline(strmCpus, strCpu, ';'))
+			{
+				if (!strCpu.empty()) cpus.push_back(atoi(strCpu.c_str()));
+			}
+		}
+		else if (strKey == "policy")
+		{
+			if ((strValue == "fifo") || (strValue == "rr") || (strValue == "normal") || (strValue == "idle"))
+			{
+				policy = strValue;
+			}
+			else
+			{
+				LOG_ERROR("Invalid scheduling policy '" << strValue << "'");
+				success = false;
+			}
+		}
+		else if (strKey == "prio")
+		{
+			hasPriority = true;
+#ifdef WIN32
+			if      (strValue == "low")      priority = THREAD_PRIORITY_BELOW_NORMAL;
+			else if (strValue == "normal")   priority = THREAD_PRIORITY_NORMAL;
+			else if (strValue == "high")     priority = THREAD_PRIORITY_HIGHEST;
+			else if (strValue == "realtime") priority = THREAD_PRIORITY_TIME_CRITICAL;
+#else
+			// symbolic priorities select the policy as well, unless it is given explicitly
+			if      (strValue == "low")      { priority =  0; if (policy.empty()) policy = "idle";   }
+			else if (strValue == "normal")   { priority =  0; if (policy.empty()) policy = "normal"; }
+			else if (strValue == "high")     { priority = 40; if (policy.empty()) policy = "fifo";   }
+			else if (strValue == "realtime") { priority = 80; if (policy.empty()) policy = "fifo";   }
+#endif
+			else
+			{
+				priority = atoi(strValue.c_str());
+			}
+		}
+		else
+		{
+			LOG_ERROR("Unknown thread parameter '" << strKey << "'");
+			success = false;
+		}
+	}
+
+	if (name.empty())
+	{
+		LOG_ERROR("Thread specification '" << strSpec << "' has no name");
+		success = false;
+	}
+	return success;
+}
+
+
+
+/******************************************************************************
+ * ThreadMetrics class
+ */
+
+ThreadMetrics::ThreadMetrics(const std::string& name, bool timedWakeups) :
+	name(name),
+	timedWakeups(timedWakeups),
+	wakeups(0),
+	latencySum(0),
+	latencyMax(0),
+	latencyLast(0)
+{
+	// nothing else to do
+}
+
+
+void ThreadMetrics::recordWakeupMicroseconds(long latency)
+{
+	// only the measured thread writes > no compare-and-swap necessary
+	wakeups++;
+	latencySum  += latency;
+	latencyLast  = latency;
+	if (latency > latencyMax)
+	{
+		latencyMax = latency;
+	}
+}
+
+
+const std::string& ThreadMetrics::getName() const
+{
+	return name;
+}
+
+
+std::string ThreadMetrics::getStatus() const
+{
+	std::stringstream strm;
+	strm << std::left << std::setw(12) << name << " : ";
+	long count = wakeups;
+	if (!timedWakeups)
+	{
+		strm << "event driven, no timed wake-ups";
+	}
+	else if (count > 0)
+	{
+		strm << "wake-up latency avg " << (latencySum / count) << "us"
+		     << ", max " << latencyMax << "us"
+		     << ", last " << latencyLast << "us"
+		     << " (" << count << " wake-ups)";
+	}
+	else
+	{
+		strm << "no timed wake-ups yet";
+	}
+	return strm.str();
+}
+
+
+
+/******************************************************************************
+ * ThreadTopology class
+ */
+
+bool ThreadTopology::configure(const std::vector<std::string>& arrSpecs, bool lockMemory)
+{
+	bool success = true;
+
+	std::lock_guard<std::mutex> lock(mtxTopology);
+	mapSettings.clear();
+	for (auto strSpec : arrSpecs)
+	{
+		sThreadSettings settings;
+		if (settings.parse(strSpec))
+		{
+			mapSettings[settings.name] = settings;
+		}
+		else
+		{
+			success = false;
+		}
+	}
+
+	if (lockMemory)
+	{
+#ifdef WIN32
+		if (SetProcessWorkingSetSize(GetCurrentProcess(), WORKING_SET_MIN, WORKING_SET_MAX))
+		{
+			LOG_INFO("Minimum working set raised to " << (WORKING_SET_MIN / (1024 * 1024)) << "MB");
+		}
+		else
+		{
+			LOG_WARNING("Could not raise the minimum working set (Error " << GetLastError() << ")");
+		}
+#else
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+		{
+			LOG_INFO("Process memory locked");
+		}
+		else
+		{
+			LOG_WARNING("Could not lock process memory (" << strerror(errno) << ")");
+		}
+#endif
+	}
+
+	return success;
+}
+
+
+ThreadMetrics& ThreadTopology::applyToCurrentThread(const std::string& strName, bool timedWakeups)
+{
+	std::lock_guard<std::mutex> lock(mtxTopology);
+
+	auto iterSettings = mapSettings.find(toLowercase(strName));
+	if (iterSettings != mapSettings.end())
+	{
+		applySettings(iterSettings->second);
+	}
+
+#ifndef WIN32
+	// makes the threads easier to find in top/ps (names are limited to 15 characters)
+	pthread_setname_np(pthread_self(), strName.substr(0, 15).c_str());
+#endif
+
+	// threads that are restarted keep accumulating their metrics
+	for (auto& metrics : listMetrics)
+	{
+		if (metrics.getName() == strName) return metrics;
+	}
+	listMetrics.emplace_back(strName, timedWakeups);
+	return listMetrics.back();
+}
+
+
+std::string ThreadTopology::getStatus()
+{
+	std::lock_guard<std::mutex> lock(mtxTopology);
+
+	std::stringstream strm;
+	for (auto iter = listMetrics.cbegin(); iter != listMetrics.cend(); iter++)
+	{
+		if (iter != listMetrics.cbegin()) strm << std::endl;
+		strm << iter->getStatus();
+	}
+	return strm.str();
+}
+
+
+bool ThreadTopology::applySettings(const sThreadSettings& settings)
+{
+	bool success = true;
+
+	if (!settings.cpus.empty())
+	{
+#ifdef WIN32
+		DWORD_PTR mask = 0;
+		for (int cpu : settings.cpus) { mask |= ((DWORD_PTR) 1) << cpu; }
+		if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+		{
+			LOG_WARNING("Could not set CPU affinity of thread '" << settings.name << "' (Error " << GetLastError() << ")");
+			success = false;
+		}
+#else
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		for (int cpu : settings.cpus) { CPU_SET(cpu, &cpuSet); }
+		int result = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+		if (result != 0)
+		{
+			LOG_WARNING("Could not set CPU affinity of thread '" << settings.name << "' (" << strerror(result) << ")");
+			success = false;
+		}
+#endif
+	}
+
+#ifdef WIN32
+	// Windows has no scheduling policies > real-time policies map to the highest thread priority
+	if (settings.hasPriority || (settings.policy == "fifo") || (settings.policy == "rr"))
+	{
+		int priority = settings.hasPriority ? settings.priority : THREAD_PRIORITY_TIME_CRITICAL;
+		if (!SetThreadPriority(GetCurrentThread(), priority))
+		{
+			LOG_WARNING("Could not set priority of thread '" << settings.name << "' (Error " << GetLastError() << ")");
+			success = false;
+		}
+	}
+#else
+	if (!settings.policy.empty() || settings.hasPriority)
+	{
+		int policy = SCHED_OTHER;
+		if      (settings.policy == "fifo") policy = SCHED_FIFO;
+		else if (settings.policy == "rr")   policy = SCHED_RR;
+		else if (settings.policy == "idle") policy = SCHED_IDLE;
+
+		sched_param param;
+		memset(&param, 0, sizeof(param));
+		if ((policy == SCHED_FIFO) || (policy == SCHED_RR))
+		{
+			param.sched_priority = std::max(sched_get_priority_min(policy), std::min(sched_get_priority_max(policy),
+				settings.hasPriority ? settings.priority : sched_get_priority_max(policy) - 10));
+		}
+		int result = pthread_setschedparam(pthread_self(), policy, &param);
+		if (result != 0)
+		{
+			LOG_WARNING("Could not set scheduling of thread '" << settings.name << "' (" << strerror(result) << ")");
+			success = false;
+		}
+	}
+#endif
+
+	if (success)
+	{
+		LOG_INFO("Thread '" << settings.name << "' configured");
+	}
+	return success;
+}
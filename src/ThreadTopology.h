@@ -0,0 +1,130 @@
+/**
+ * Configuration of the server threads: CPU affinity, scheduling priority, and memory locking,
+ * as well as measurement of the achieved wake-up latency per thread.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+/**
+ * Settings for a single named thread.
+ */
+struct sThreadSettings
+{
+	std::string      name;        ///< name of the thread, e.g., "streaming"
+	std::vector<int> cpus;        ///< CPU cores to run on (empty: any core)
+	std::string      policy;      ///< scheduling policy ("fifo", "rr", "normal", empty: keep)
+	bool             hasPriority; ///< <code>true</code> if a priority was specified
+	int              priority;    ///< scheduling priority (platform specific, see parse())
+
+	sThreadSettings();
+
+	/**
+	 * Parses a thread specification of comma separated key=value pairs, e.g.,
+	 * "name=streaming,cpus=2;3,policy=fifo,prio=80".
+	 * Priorities can be given as a number or as "low", "normal", "high", or "realtime".
+	 *
+	 * @param strSpec  the specification to parse
+	 *
+	 * @return <code>true</code> if the specification was valid
+	 */
+	bool parse(const std::string& strSpec);
+};
+
+
+/**
+ * Wake-up latency measurements of a thread.
+ * Updated by the thread itself, read by any other thread.
+ * Only threads that wait for timeouts measure their latency, event driven threads have no measurements.
+ */
+class ThreadMetrics
+{
+public:
+
+	ThreadMetrics(const std::string& name, bool timedWakeups);
+
+	/**
+	 * Records the wake-up of the thread after a timed wait.
+	 *
+	 * @param latency  the time between the requested and the actual wake-up
+	 */
+	template<class Duration> void recordWakeup(Duration latency)
+	{
+		recordWakeupMicroseconds((long) std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+	}
+
+	/**
+	 * Gets the name of the measured thread.
+	 *
+	 * @return the thread name
+	 */
+	const std::string& getName() const;
+
+	/**
+	 * Gets a printable summary of the measurements.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	void recordWakeupMicroseconds(long latency);
+
+private:
+
+	std::string        name;
+	bool               timedWakeups;
+	std::atomic<long>  wakeups;
+	std::atomic<long>  latencySum;  // in us
+	std::atomic<long>  latencyMax;  // in us
+	std::atomic<long>  latencyLast; // in us
+};
+
+
+/**
+ * Class for configuring the server threads.
+ * Threads call applyToCurrentThread() with their name when they start.
+ */
+class ThreadTopology
+{
+public:
+
+	/**
+	 * Sets up the thread settings and locks the process memory if requested.
+	 *
+	 * @param arrSpecs    the thread specifications (see sThreadSettings::parse())
+	 * @param lockMemory  <code>true</code> to lock all current and future memory pages of the process
+	 *
+	 * @return <code>true</code> if all specifications were valid
+	 */
+	static bool configure(const std::vector<std::string>& arrSpecs, bool lockMemory);
+
+	/**
+	 * Applies the settings for a named thread to the calling thread
+	 * and registers the thread for the metrics.
+	 *
+	 * @param strName       the name of the thread
+	 * @param timedWakeups  <code>true</code> if the thread waits for timeouts and records its wake-up latency,
+	 *                      <code>false</code> if it only waits for events (data, signals, other threads)
+	 *
+	 * @return the metrics of the thread
+	 */
+	static ThreadMetrics& applyToCurrentThread(const std::string& strName, bool timedWakeups);
+
+	/**
+	 * Gets a printable summary of the registered threads and their wake-up latencies.
+	 *
+	 * @return the summary text
+	 */
+	static std::string getStatus();
+
+private:
+
+	static bool applySettings(const sThreadSettings& settings);
+};
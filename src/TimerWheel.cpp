@@ -0,0 +1,382 @@
+#include "TimerWheel.h"
+#include "ThreadTopology.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "TimerWheel"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+
+// mask for the slot index of a level
+#define TIMER_WHEEL_SLOT_MASK  ((1 << TIMER_WHEEL_SLOT_BITS) - 1)
+// longest time in ns to sleep when there are no tasks
+#define TIMER_WHEEL_IDLE_WAIT  1000000000ULL
+
+
+/******************************************************************************
+ * Fixed point time
+ */
+
+TimerWheel::sTime& TimerWheel::sTime::operator+=(const sTime& refOther)
+{
+	const uint64_t sumFraction = (uint64_t) fraction + refOther.fraction;
+	fraction = (uint32_t) sumFraction;
+	ns      += refOther.ns + (sumFraction >> 32);
+	return *this;
+}
+
+
+bool TimerWheel::sTime::operator<(const sTime& refOther) const
+{
+	return (ns < refOther.ns) || ((ns == refOther.ns) && (fraction < refOther.fraction));
+}
+
+
+bool TimerWheel::calculatePeriod(double rate, sTime& refPeriod)
+{
+	if (!(rate > 0) || (rate > 1e6)) return false;
+
+	if (rate == std::floor(rate))
+	{
+		// integer rates: 1e9 * 2^32 still fits into 64 bits > exact to the last bit of the fraction
+		const uint64_t fixedPeriod = (1000000000ULL << 32) / (uint64_t) rate;
+		refPeriod.ns       = fixedPeriod >> 32;
+		refPeriod.fraction = (uint32_t) fixedPeriod;
+	}
+	else
+	{
+		const double period = 1e9 / rate;
+		refPeriod.ns       = (uint64_t) period;
+		refPeriod.fraction = (uint32_t) ((period - std::floor(period)) * 4294967296.0);
+	}
+	return true;
+}
+
+
+TimerWheel::sTime TimerWheel::multiply(const sTime& refTime, uint64_t factor)
+{
+	// factor is limited to 32 bits, so the fraction product can't overflow
+	factor = std::min(factor, (uint64_t) 0xFFFFFFFFULL);
+	const uint64_t fractionProduct = (uint64_t) refTime.fraction * factor;
+	sTime result;
+	result.ns       = refTime.ns * factor + (fractionProduct >> 32);
+	result.fraction = (uint32_t) fractionProduct;
+	return result;
+}
+
+
+/******************************************************************************
+ * Task management
+ */
+
+TimerWheel::TimerWheel() :
+	nextTaskId(0)
+{
+	clear();
+}
+
+
+int TimerWheel::addTask(const std::string& strName, double rate, tCallback callback, double phase)
+{
+	sTask task;
+	if (!calculatePeriod(rate, task.period))
+	{
+		LOG_ERROR("Invalid rate " << rate << "Hz for task '" << strName << "'");
+		return -1;
+	}
+	task.name        = strName;
+	task.rate        = rate;
+	task.callback    = callback;
+	task.removed     = false;
+	task.calls       = 0;
+	task.skipped     = 0;
+	task.latenessSum = 0;
+	task.latenessMax = 0;
+	task.durationSum = 0;
+
+	std::lock_guard<std::mutex> lock(mtxTasks);
+
+	// first call on the period grid after now, so tasks with related rates are in phase
+	const double periodNs = 1e9 / rate;
+	const double offset   = std::max(0.0, std::min(phase, 1.0)) * periodNs;
+	const double elapsed  = (double) getElapsed();
+	const uint64_t periods = (uint64_t) std::max(0.0, std::ceil((elapsed - offset) / periodNs));
+	task.due = multiply(task.period, periods);
+	sTime phaseOffset;
+	phaseOffset.ns       = (uint64_t) offset;
+	phaseOffset.fraction = (uint32_t) ((offset - std::floor(offset)) * 4294967296.0);
+	task.due += phaseOffset;
+
+	task.id = nextTaskId++;
+	sTask* pTask = &(mapTasks[task.id] = task);
+	insert(pTask);
+	cvChanged.notify_all();
+
+	return task.id;
+}
+
+
+bool TimerWheel::setRate(int taskId, double rate)
+{
+	std::lock_guard<std::mutex> lock(mtxTasks);
+	std::map<int, sTask>::iterator iter = mapTasks.find(taskId);
+	if ((iter == mapTasks.end()) || iter->second.removed) return false;
+
+	sTime period;
+	if (!calculatePeriod(rate, period)) return false;
+	iter->second.rate   = rate;
+	iter->second.period = period;
+	return true;
+}
+
+
+bool TimerWheel::removeTask(int taskId)
+{
+	std::lock_guard<std::mutex> lock(mtxTasks);
+	std::map<int, sTask>::iterator iter = mapTasks.find(taskId);
+	if ((iter == mapTasks.end()) || iter->second.removed) return false;
+
+	// the task might be in a slot or running > only mark it, it is deleted when it is due
+	iter->second.removed = true;
+	return true;
+}
+
+
+void TimerWheel::clear()
+{
+	std::lock_guard<std::mutex> lock(mtxTasks);
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		for (int idx = 0; idx <= TIMER_WHEEL_SLOT_MASK; idx++)
+		{
+			arrSlots[level][idx].clear();
+		}
+	}
+	mapTasks.clear();
+	stopped      = false;
+	tEpoch       = tClock::now();
+	currentTick  = 0;
+	tickCascaded = false;
+}
+
+
+/******************************************************************************
+ * Wheel
+ */
+
+uint64_t TimerWheel::getElapsed() const
+{
+	const tClock::duration elapsed = tClock::now() - tEpoch;
+	return (elapsed.count() > 0) ? (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() : 0;
+}
+
+
+void TimerWheel::insert(sTask* pTask)
+{
+	const uint64_t dueTick = std::max(pTask->due.ns >> TIMER_WHEEL_TICK_BITS, currentTick);
+	const uint64_t delta   = dueTick - currentTick;
+
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		const int shift = TIMER_WHEEL_SLOT_BITS * level;
+		if (delta < (1ULL << (shift + TIMER_WHEEL_SLOT_BITS)))
+		{
+			arrSlots[level][(dueTick >> shift) & TIMER_WHEEL_SLOT_MASK].push_back(pTask);
+			return;
+		}
+	}
+
+	// beyond the last level > park in the slot that is cascaded last and insert again from there
+	const int shift = TIMER_WHEEL_SLOT_BITS * (TIMER_WHEEL_LEVELS - 1);
+	arrSlots[TIMER_WHEEL_LEVELS - 1][((currentTick >> shift) - 1) & TIMER_WHEEL_SLOT_MASK].push_back(pTask);
+}
+
+
+void TimerWheel::cascade(int level)
+{
+	std::vector<sTask*>& refSlot = arrSlots[level][(currentTick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK];
+	std::vector<sTask*>  arrTasks;
+	arrTasks.swap(refSlot);
+	for (sTask* pTask : arrTasks)
+	{
+		insert(pTask);
+	}
+}
+
+
+void TimerWheel::collectDue(uint64_t now, std::vector<sTask*>& arrDue)
+{
+	const uint64_t nowTick = now >> TIMER_WHEEL_TICK_BITS;
+	while (currentTick <= nowTick)
+	{
+		if (!tickCascaded)
+		{
+			// at the start of a block of the lower level, move the tasks of that block down
+			for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+			{
+				if ((currentTick & ((1ULL << (TIMER_WHEEL_SLOT_BITS * level)) - 1)) != 0) break;
+				cascade(level);
+			}
+			tickCascaded = true;
+		}
+
+		std::vector<sTask*>& refSlot = arrSlots[0][currentTick & TIMER_WHEEL_SLOT_MASK];
+		if (currentTick < nowTick)
+		{
+			// tick is over > all tasks are due
+			arrDue.insert(arrDue.end(), refSlot.begin(), refSlot.end());
+			refSlot.clear();
+			currentTick++;
+			tickCascaded = false;
+		}
+		else
+		{
+			// current tick > only the tasks that are due already
+			std::vector<sTask*>::iterator iterKeep = std::partition(refSlot.begin(), refSlot.end(),
+				[now](const sTask* pTask) { return pTask->due.ns > now; });
+			arrDue.insert(arrDue.end(), iterKeep, refSlot.end());
+			refSlot.erase(iterKeep, refSlot.end());
+			break;
+		}
+	}
+
+	std::sort(arrDue.begin(), arrDue.end(), [](const sTask* pTask1, const sTask* pTask2)
+		{
+			return (pTask1->due < pTask2->due) || (!(pTask2->due < pTask1->due) && (pTask1->id < pTask2->id));
+		});
+}
+
+
+uint64_t TimerWheel::getNextDue() const
+{
+	if (mapTasks.empty()) return getElapsed() + TIMER_WHEEL_IDLE_WAIT;
+
+	for (uint64_t tick = currentTick; tick <= currentTick + TIMER_WHEEL_SLOT_MASK; tick++)
+	{
+		if ((tick != currentTick) && ((tick & TIMER_WHEEL_SLOT_MASK) == 0))
+		{
+			// tasks of the next block have to be cascaded first
+			return tick << TIMER_WHEEL_TICK_BITS;
+		}
+		const std::vector<sTask*>& refSlot = arrSlots[0][tick & TIMER_WHEEL_SLOT_MASK];
+		if (!refSlot.empty())
+		{
+			uint64_t nextDue = UINT64_MAX;
+			for (const sTask* pTask : refSlot)
+			{
+				nextDue = std::min(nextDue, pTask->due.ns);
+			}
+			return nextDue;
+		}
+	}
+	return (currentTick + TIMER_WHEEL_SLOT_MASK + 1) << TIMER_WHEEL_TICK_BITS;
+}
+
+
+void TimerWheel::reschedule(sTask* pTask, uint64_t now)
+{
+	if (pTask->removed)
+	{
+		mapTasks.erase(pTask->id);
+		return;
+	}
+
+	pTask->due += pTask->period;
+	if (pTask->due.ns < now)
+	{
+		// more than a period late > stay on the grid and skip the periods that are over
+		const uint64_t periods = (uint64_t) ((double) (now - pTask->due.ns) * pTask->rate / 1e9);
+		pTask->due     += multiply(pTask->period, periods);
+		pTask->skipped += (unsigned long) periods;
+	}
+	insert(pTask);
+}
+
+
+void TimerWheel::run(ThreadMetrics* pMetrics)
+{
+	std::unique_lock<std::mutex> lock(mtxTasks);
+	std::vector<sTask*> arrDue;
+	while (!stopped)
+	{
+		arrDue.clear();
+		collectDue(getElapsed(), arrDue);
+		if (arrDue.empty())
+		{
+			const tClock::time_point tWake = tEpoch + std::chrono::nanoseconds(getNextDue());
+			if ((cvChanged.wait_until(lock, tWake) == std::cv_status::timeout) && pMetrics)
+			{
+				pMetrics->recordWakeup(tClock::now() - tWake);
+			}
+			continue;
+		}
+
+		for (size_t idx = 0; idx < arrDue.size(); idx++)
+		{
+			sTask* pTask = arrDue[idx];
+			if (stopped)
+			{
+				// keep the remaining tasks for the next run
+				insert(pTask);
+				continue;
+			}
+			if (pTask->removed)
+			{
+				mapTasks.erase(pTask->id);
+				continue;
+			}
+
+			const uint64_t start    = getElapsed();
+			const double   lateness = ((double) start - (double) pTask->due.ns) / 1e9;
+			tCallback&     callback = pTask->callback;
+
+			lock.unlock();
+			callback();
+			lock.lock();
+
+			const uint64_t end = getElapsed();
+			pTask->calls++;
+			pTask->latenessSum += std::max(0.0, lateness);
+			pTask->latenessMax  = std::max(pTask->latenessMax, lateness);
+			pTask->durationSum += (double) (end - start) / 1e9;
+			reschedule(pTask, end);
+		}
+	}
+}
+
+
+void TimerWheel::stop()
+{
+	std::lock_guard<std::mutex> lock(mtxTasks);
+	stopped = true;
+	cvChanged.notify_all();
+}
+
+
+std::string TimerWheel::getStatus() const
+{
+	std::lock_guard<std::mutex> lock(mtxTasks);
+
+	std::stringstream strm;
+	strm << std::fixed << std::setprecision(3)
+	     << "Wheel tick     : " << ((1 << TIMER_WHEEL_TICK_BITS) / 1e6) << "ms";
+	for (const std::pair<const int, sTask>& refEntry : mapTasks)
+	{
+		const sTask& refTask = refEntry.second;
+		if (refTask.removed) continue;
+
+		const double calls = (double) std::max(refTask.calls, 1UL);
+		strm << std::endl
+		     << std::left << std::setw(15) << refTask.name << std::right << ": "
+		     << std::setprecision(2) << refTask.rate << "Hz, " << refTask.calls << " calls, late "
+		     << std::setprecision(3) << (refTask.latenessSum / calls * 1000) << "ms on average, "
+		     << (refTask.latenessMax * 1000) << "ms max, busy "
+		     << (refTask.durationSum / calls * 1000) << "ms, "
+		     << refTask.skipped << " periods skipped";
+	}
+	return strm.str();
+}
@@ -0,0 +1,156 @@
+/**
+ * Scheduler for all periodic work of the server (polling MoCap systems, maintaining the stream, executing commands)
+ * on a single thread, so that only one thread has to be pinned and prioritised, regardless of the number of rates.
+ *
+ * The tasks are kept in a hierarchical timer wheel. Due times are counted from a common epoch
+ * with a fraction of a nanosecond, so periods like 1/90s don't drift and tasks with related rates
+ * (e.g., 30Hz and 90Hz) keep their phase relationship.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+class ThreadMetrics;
+
+
+// bits of a wheel tick in ns (2^18ns = 262us)
+#define TIMER_WHEEL_TICK_BITS  18
+// bits of the slot index per level (64 slots)
+#define TIMER_WHEEL_SLOT_BITS  6
+// number of levels (the last level reaches 2^(18+4*6)ns = 73 minutes ahead)
+#define TIMER_WHEEL_LEVELS     4
+
+
+/**
+ * Class for the timer wheel.
+ */
+class TimerWheel
+{
+public:
+
+	typedef std::chrono::steady_clock tClock;
+	typedef std::function<void()>     tCallback;
+
+	TimerWheel();
+
+	/**
+	 * Registers a periodic task.
+	 * The first call is aligned to the period grid of the wheel, shifted by the phase.
+	 * Can be called from any thread, also from within a task.
+	 *
+	 * @param strName   the name of the task for the status
+	 * @param rate      the rate of the task in Hz
+	 * @param callback  the function to call
+	 * @param phase     the offset within the period (0...1)
+	 *
+	 * @return the ID of the task (-1 if the rate is invalid)
+	 */
+	int addTask(const std::string& strName, double rate, tCallback callback, double phase = 0);
+
+	/**
+	 * Changes the rate of a task, e.g., when the playback speed of a file changes.
+	 * Takes effect after the next call of the task.
+	 *
+	 * @param taskId  the ID of the task
+	 * @param rate    the new rate in Hz
+	 *
+	 * @return <code>true</code> if the task exists and the rate is valid
+	 */
+	bool setRate(int taskId, double rate);
+
+	/**
+	 * Removes a task. If the task is currently running, it finishes, but isn't called again.
+	 *
+	 * @param taskId  the ID of the task
+	 *
+	 * @return <code>true</code> if the task existed
+	 */
+	bool removeTask(int taskId);
+
+	/**
+	 * Removes all tasks and resets the epoch.
+	 * Must not be called while the wheel is running.
+	 */
+	void clear();
+
+	/**
+	 * Calls the tasks when they are due until stop() is called.
+	 *
+	 * @param pMetrics  the metrics of the calling thread for recording the wake-up latency (can be nullptr)
+	 */
+	void run(ThreadMetrics* pMetrics);
+
+	/**
+	 * Makes run() return after the currently running task.
+	 */
+	void stop();
+
+	/**
+	 * Gets a printable summary of the tasks and their lateness.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	/**
+	 * Time since the epoch in ns with a 32 bit fraction of a ns.
+	 */
+	struct sTime
+	{
+		uint64_t ns;
+		uint32_t fraction;
+
+		sTime& operator+=(const sTime& refOther);
+		bool   operator< (const sTime& refOther) const;
+	};
+
+	struct sTask
+	{
+		int           id;
+		std::string   name;
+		double        rate;
+		sTime         period;
+		sTime         due;
+		tCallback     callback;
+		bool          removed;
+
+		unsigned long calls;
+		unsigned long skipped;      // periods skipped because the task was too late
+		double        latenessSum;  // in s
+		double        latenessMax;  // in s
+		double        durationSum;  // in s
+	};
+
+	static bool     calculatePeriod(double rate, sTime& refPeriod);
+	static sTime    multiply(const sTime& refTime, uint64_t factor);
+	uint64_t        getElapsed() const;
+	void            insert(sTask* pTask);
+	void            cascade(int level);
+	void            collectDue(uint64_t now, std::vector<sTask*>& arrDue);
+	uint64_t        getNextDue() const;
+	void            reschedule(sTask* pTask, uint64_t now);
+
+private:
+
+	mutable std::mutex      mtxTasks;
+	std::condition_variable cvChanged;  // signalled when tasks are added or the wheel is stopped
+	bool                    stopped;
+	tClock::time_point      tEpoch;
+	uint64_t                currentTick; // next tick of the wheel to process
+	bool                    tickCascaded; // the higher levels have been cascaded for the current tick
+
+	std::map<int, sTask>    mapTasks;
+	int                     nextTaskId;
+	std::vector<sTask*>     arrSlots[TIMER_WHEEL_LEVELS][1 << TIMER_WHEEL_SLOT_BITS];
+};
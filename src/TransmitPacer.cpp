@@ -0,0 +1,321 @@
+#include "TransmitPacer.h"
+#include "ThreadTopology.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "TransmitPacer"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__linux__) && defined(SO_TXTIME)
+	#include <linux/net_tstamp.h>
+	#include <string.h>
+	#include <time.h>
+	#define TXPACER_USE_TXTIME
+#endif
+
+
+// weight of a new measurement in the moving averages
+#define TXPACER_AVG_WEIGHT   0.05f
+// waiting is done by sleeping until this time before the slot, then by spinning
+#define TXPACER_SPIN_TIME    std::chrono::microseconds(200)
+// packets sent later than this after their slot are counted as missed
+#define TXPACER_TOLERANCE    std::chrono::microseconds(100)
+// buffers kept for reuse by queued packets
+#define TXPACER_FREE_BUFFERS 64
+
+
+TransmitPacer::TransmitPacer() :
+	window(0),
+	tWindowEnd(),
+	tNextSlot(),
+	slotInterval(tDuration::zero()),
+	packetsInFrame(0),
+	expectedPackets(1),
+	sending(false),
+	stopping(false),
+	tLastSend(),
+	avgSpacing(0),
+	minSpacing(0),
+	maxSpacing(0),
+	avgPackets(0),
+	packetsPaced(0),
+	packetsKernelPaced(0),
+	slotsMissed(0)
+{
+	// nothing else to do
+}
+
+
+TransmitPacer::~TransmitPacer()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtxQueue);
+			stopping = true;
+		}
+		cvQueue.notify_all();
+		thread.join();
+	}
+}
+
+
+void TransmitPacer::setWindow(float window)
+{
+	this->window = std::max(0.0f, std::min(window, 1.0f));
+	if (this->window > 0)
+	{
+		LOG_INFO("Spreading the packets of each frame over " << (int) (this->window * 100) << "% of the frame period");
+		if (!thread.joinable())
+		{
+			thread = std::thread(&TransmitPacer::senderThread, this);
+		}
+	}
+}
+
+
+bool TransmitPacer::isEnabled() const
+{
+	return window > 0;
+}
+
+
+void TransmitPacer::beginFrame(float framePeriod)
+{
+	packetsInFrame = 0;
+	if (!isEnabled() || (framePeriod <= 0)) return;
+
+	const tDuration windowDuration = std::chrono::duration_cast<tDuration>(
+		std::chrono::duration<double>(framePeriod * window));
+	tNextSlot    = tClock::now();
+	tWindowEnd   = tNextSlot + windowDuration;
+	slotInterval = windowDuration / std::max(1, expectedPackets);
+}
+
+
+void TransmitPacer::send(const char* pData, int size, const tSendFunction& fnSend)
+{
+	if (!isEnabled() || !thread.joinable())
+	{
+		fnSend(pData, size);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		const bool first = (packetsInFrame == 0);
+		queue.emplace_back();
+		sQueuedPacket& refPacket = queue.back();
+		refPacket.tSlot = reserveSlot();
+		refPacket.first = first;
+		if (!arrFreeBuffers.empty())
+		{
+			refPacket.data.swap(arrFreeBuffers.back());
+			arrFreeBuffers.pop_back();
+		}
+		refPacket.data.assign(pData, pData + size);
+		refPacket.fnSend = fnSend;
+	}
+	cvQueue.notify_all();
+}
+
+
+void TransmitPacer::flush()
+{
+	std::unique_lock<std::mutex> lock(mtxQueue);
+	cvQueue.wait(lock, [this] { return queue.empty() && !sending; });
+}
+
+
+bool TransmitPacer::enableKernelPacing(SOCKET s)
+{
+#ifdef TXPACER_USE_TXTIME
+	if (!isEnabled()) return false;
+
+	sock_txtime config;
+	config.clockid = CLOCK_MONOTONIC;
+	config.flags   = 0;
+	if (setsockopt(s, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) == 0)
+	{
+		LOG_INFO("Using launch times for pacing (requires the fq qdisc on the interface)");
+		return true;
+	}
+	LOG_WARNING("Launch times are not supported (" << strerror(errno) << "), pacing in user space");
+#else
+	(void) s;
+#endif
+	return false;
+}
+
+
+int TransmitPacer::sendTo(SOCKET s, const char* pData, int size, const sockaddr_in& refAddress, bool kernelPacing, WireCapture* pCapture)
+{
+#ifdef TXPACER_USE_TXTIME
+	if (kernelPacing && isEnabled())
+	{
+		// hand the slot time over to the kernel instead of waiting
+		const tClock::time_point tSlot = reserveSlot();
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const int64_t delay  = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(tSlot - tClock::now()).count());
+		uint64_t      txTime = (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec + (uint64_t) delay;
+
+		iovec iov;
+		iov.iov_base = (void*) pData;
+		iov.iov_len  = size;
+
+		char    control[CMSG_SPACE(sizeof(txTime))];
+		msghdr  msg;
+		memset(&msg,    0, sizeof(msg));
+		memset(control, 0, sizeof(control));
+		msg.msg_name       = (void*) &refAddress;
+		msg.msg_namelen    = sizeof(refAddress);
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+		pCmsg->cmsg_level = SOL_SOCKET;
+		pCmsg->cmsg_type  = SCM_TXTIME;
+		pCmsg->cmsg_len   = CMSG_LEN(sizeof(txTime));
+		memcpy(CMSG_DATA(pCmsg), &txTime, sizeof(txTime));
+
+		{
+			std::lock_guard<std::mutex> lock(mtxQueue);
+			packetsKernelPaced++;
+			recordSend(std::max(tSlot, tClock::now()), packetsInFrame == 1);
+		}
+		const int sent = (int) sendmsg(s, &msg, 0);
+		if ((sent >= 0) && pCapture)
+		{
+			pCapture->record(pData, size, refAddress);
+		}
+		return sent;
+	}
+#else
+	(void) kernelPacing;
+#endif
+
+	const sockaddr_in address = refAddress;
+	send(pData, size, [s, address, pCapture](const char* pPacket, int packetSize)
+	{
+		if ((sendto(s, pPacket, packetSize, 0, (const sockaddr*) &address, sizeof(address)) >= 0) && pCapture)
+		{
+			pCapture->record(pPacket, packetSize, address);
+		}
+	});
+	return size;
+}
+
+
+void TransmitPacer::endFrame()
+{
+	if (!isEnabled()) return;
+
+	std::lock_guard<std::mutex> lock(mtxQueue);
+	expectedPackets = std::max(1, packetsInFrame);
+	avgPackets      = (avgPackets == 0) ? (float) packetsInFrame :
+		(avgPackets * (1 - TXPACER_AVG_WEIGHT) + packetsInFrame * TXPACER_AVG_WEIGHT);
+}
+
+
+std::string TransmitPacer::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "Transmit pacing: disabled";
+		return strm.str();
+	}
+	std::lock_guard<std::mutex> lock(mtxQueue);
+	strm << std::fixed << std::setprecision(3)
+	     << "Transmit pacing: " << (int) (window * 100) << "% of the frame period" << std::endl
+	     << "Packets/frame  : " << std::setprecision(1) << avgPackets << std::endl
+	     << "Target spacing : " << std::setprecision(3) << (std::chrono::duration<float>(slotInterval).count() * 1000) << "ms" << std::endl
+	     << "Spacing        : " << (avgSpacing * 1000) << "ms (min " << (minSpacing * 1000) << "ms, max " << (maxSpacing * 1000) << "ms)" << std::endl
+	     << "Paced packets  : " << packetsPaced << " by the sender thread, " << packetsKernelPaced << " by the kernel" << std::endl
+	     << "Queued packets : " << queue.size() << std::endl
+	     << "Missed slots   : " << slotsMissed;
+	return strm.str();
+}
+
+
+TransmitPacer::tClock::time_point TransmitPacer::reserveSlot()
+{
+	// more packets than expected > don't exceed the window, send the rest as they come
+	const tClock::time_point now   = tClock::now();
+	const tClock::time_point tSlot = std::max(now, std::min(tNextSlot, tWindowEnd));
+	tNextSlot = tSlot + slotInterval;
+	packetsInFrame++;
+	return tSlot;
+}
+
+
+void TransmitPacer::recordSend(tClock::time_point tSent, bool first)
+{
+	if (!first)
+	{
+		const float spacing = std::chrono::duration<float>(tSent - tLastSend).count();
+		if (avgSpacing == 0)
+		{
+			avgSpacing = minSpacing = maxSpacing = spacing;
+		}
+		else
+		{
+			avgSpacing = avgSpacing * (1 - TXPACER_AVG_WEIGHT) + spacing * TXPACER_AVG_WEIGHT;
+			minSpacing = std::min(minSpacing, spacing);
+			maxSpacing = std::max(maxSpacing, spacing);
+		}
+	}
+	tLastSend = tSent;
+}
+
+
+void TransmitPacer::senderThread()
+{
+	ThreadMetrics& refMetrics = ThreadTopology::applyToCurrentThread("pacing", true);
+
+	std::unique_lock<std::mutex> lock(mtxQueue);
+	while (true)
+	{
+		cvQueue.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) break; // stopping, but only after all queued packets are sent
+
+		sQueuedPacket packet = std::move(queue.front());
+		queue.pop_front();
+		sending = true;
+		lock.unlock();
+
+		// sleep until shortly before the slot, then spin
+		tClock::time_point now = tClock::now();
+		if (packet.tSlot - now > TXPACER_SPIN_TIME)
+		{
+			const tClock::time_point tWakeup = packet.tSlot - TXPACER_SPIN_TIME;
+			std::this_thread::sleep_until(tWakeup);
+			refMetrics.recordWakeup(tClock::now() - tWakeup);
+		}
+		while ((now = tClock::now()) < packet.tSlot)
+		{
+			std::this_thread::yield();
+		}
+		packet.fnSend(packet.data.data(), (int) packet.data.size());
+
+		lock.lock();
+		if (now - packet.tSlot > TXPACER_TOLERANCE)
+		{
+			slotsMissed++;
+		}
+		packetsPaced++;
+		recordSend(now, packet.first);
+		if (arrFreeBuffers.size() < TXPACER_FREE_BUFFERS)
+		{
+			arrFreeBuffers.push_back(std::move(packet.data));
+		}
+		sending = false;
+		cvQueue.notify_all();
+	}
+}
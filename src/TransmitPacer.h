@@ -0,0 +1,179 @@
+/**
+ * Pacing of the packets of a frame, so that the fan-out to several endpoints, clients, and fragments
+ * doesn't leave the network interface in a single burst that cheap access points can't handle.
+ *
+ * The packets of a frame are spread evenly across a configurable portion of the frame period.
+ * The number of packets per frame is taken from the previous frame.
+ * Sockets that support launch times (SO_TXTIME with the fq qdisc on Linux) are paced by the kernel,
+ * all other packets are copied into a queue and sent in their time slot by a dedicated sender thread,
+ * so the frame pipeline neither waits for the slots nor holds its locks while the packets trickle out.
+ */
+
+#pragma once
+
+#include "Network.h"
+#include "WireCapture.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Class for spreading the packets of a frame over time.
+ *
+ * Usage in the frame handler:
+ *   beginFrame() > for each packet: send() or sendTo() > endFrame()
+ * Before the objects used by the send functions are destroyed, flush() has to be called.
+ */
+class TransmitPacer
+{
+public:
+
+	typedef std::chrono::steady_clock           tClock;
+	typedef std::chrono::steady_clock::duration tDuration;
+
+	/**
+	 * Function that sends a datagram, called by the sender thread in the time slot of the datagram.
+	 */
+	typedef std::function<void(const char* pData, int size)> tSendFunction;
+
+	TransmitPacer();
+	~TransmitPacer();
+
+	/**
+	 * Sets the portion of the frame period to spread the packets of a frame over
+	 * and starts the sender thread if pacing is enabled.
+	 *
+	 * @param window  the portion of the frame period (0: no pacing, 1: whole period)
+	 */
+	void setWindow(float window);
+
+	/**
+	 * Checks if pacing is enabled.
+	 *
+	 * @return <code>true</code> if packets are paced
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Starts pacing the packets of a new frame.
+	 *
+	 * @param framePeriod  the frame period in s
+	 */
+	void beginFrame(float framePeriod);
+
+	/**
+	 * Sends a paced datagram through a send function.
+	 * Without pacing, the datagram is sent right away,
+	 * otherwise it is copied and sent by the sender thread in its time slot.
+	 *
+	 * @param pData   the data to send
+	 * @param size    the size of the data
+	 * @param fnSend  the function that sends the data
+	 */
+	void send(const char* pData, int size, const tSendFunction& fnSend);
+
+	/**
+	 * Waits until the sender thread has sent all queued datagrams.
+	 */
+	void flush();
+
+	/**
+	 * Enables launch times on a socket, so the kernel paces the packets instead of the sending thread.
+	 *
+	 * @param s  the socket
+	 *
+	 * @return <code>true</code> if the socket supports launch times
+	 */
+	bool enableKernelPacing(SOCKET s);
+
+	/**
+	 * Sends a paced datagram.
+	 *
+	 * @param s             the socket to send through
+	 * @param pData         the data to send
+	 * @param size          the size of the data
+	 * @param refAddress    the address to send to
+	 * @param kernelPacing  <code>true</code> if launch times were enabled on the socket
+	 * @param pCapture      the capture to record the datagram into when it is actually sent (can be <code>nullptr</code>)
+	 *
+	 * @return the number of bytes sent or queued, or SOCKET_ERROR
+	 */
+	int sendTo(SOCKET s, const char* pData, int size, const sockaddr_in& refAddress, bool kernelPacing, WireCapture* pCapture);
+
+	/**
+	 * Finishes the current frame and updates the measurements.
+	 */
+	void endFrame();
+
+	/**
+	 * Gets a printable summary of the measurements.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	/**
+	 * Reserves the time slot for the next packet of the frame.
+	 *
+	 * @return the time the packet should be sent at
+	 */
+	tClock::time_point reserveSlot();
+
+	/**
+	 * Registers the actual send time of a packet for the spacing measurement.
+	 * Must be called with the queue locked.
+	 *
+	 * @param tSent  the time the packet was (or will be) sent
+	 * @param first  <code>true</code> if the packet is the first of its frame
+	 */
+	void recordSend(tClock::time_point tSent, bool first);
+
+	void senderThread();
+
+private:
+
+	/**
+	 * Datagram waiting for its time slot.
+	 */
+	struct sQueuedPacket
+	{
+		tClock::time_point tSlot;
+		bool               first;  // first packet of the frame
+		std::vector<char>  data;
+		tSendFunction      fnSend;
+	};
+
+	float              window;
+	tClock::time_point tWindowEnd;     // slots are never reserved after this time
+	tClock::time_point tNextSlot;
+	tDuration          slotInterval;
+	int                packetsInFrame;
+	int                expectedPackets; // packets of the previous frame
+
+	// sender thread
+	std::thread                    thread;
+	mutable std::mutex             mtxQueue;
+	std::condition_variable        cvQueue;      // signalled when packets are queued, sent, or the thread is stopped
+	std::deque<sQueuedPacket>      queue;
+	std::vector<std::vector<char>> arrFreeBuffers; // buffers of sent packets for reuse
+	bool                           sending;      // the sender thread is sending a packet outside of the queue
+	bool                           stopping;
+
+	// measurements, updated with the queue locked
+	tClock::time_point tLastSend;
+	float              avgSpacing;     // moving average of the achieved spacing in s
+	float              minSpacing, maxSpacing;
+	float              avgPackets;     // moving average of the packets per frame
+	unsigned long      packetsPaced;
+	unsigned long      packetsKernelPaced;
+	unsigned long      slotsMissed;    // packets that were sent later than their slot
+};
@@ -0,0 +1,642 @@
+#include "VirtualBodies.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "VirtualBodies"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+#include <string.h>
+
+
+// maximum nesting depth of an expression
+#define VIRTUAL_MAX_DEPTH      16
+
+// maximum number of arguments of a function
+#define VIRTUAL_MAX_ARGUMENTS  64
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+static std::string trim(const std::string& strText)
+{
+	const size_t first = strText.find_first_not_of(" \t");
+	const size_t last  = strText.find_last_not_of(" \t");
+	return (first == std::string::npos) ? "" : strText.substr(first, last - first + 1);
+}
+
+
+static void multiply(float ax, float ay, float az, float aw, float bx, float by, float bz, float bw,
+                     float& rx, float& ry, float& rz, float& rw)
+{
+	rx = aw * bx + ax * bw + ay * bz - az * by;
+	ry = aw * by - ax * bz + ay * bw + az * bx;
+	rz = aw * bz + ax * by - ay * bx + az * bw;
+	rw = aw * bw - ax * bx - ay * by - az * bz;
+}
+
+
+static void rotate(float qx, float qy, float qz, float qw, float& x, float& y, float& z)
+{
+	// v' = v + 2w (q x v) + 2 q x (q x v)
+	const float tx = 2 * (qy * z - qz * y);
+	const float ty = 2 * (qz * x - qx * z);
+	const float tz = 2 * (qx * y - qy * x);
+	const float rx = x + qw * tx + (qy * tz - qz * ty);
+	const float ry = y + qw * ty + (qz * tx - qx * tz);
+	const float rz = z + qw * tz + (qx * ty - qy * tx);
+	x = rx; y = ry; z = rz;
+}
+
+
+/******************************************************************************
+ * VirtualBodies class
+ */
+
+VirtualBodies::VirtualBodies() :
+	compiledGeneration(0),
+	compiledRigidBodies(-1),
+	compiled(false),
+	stackDepth(0),
+	maxStackDepth(0),
+	framesProcessed(0)
+{
+	// nothing else to do
+}
+
+
+bool VirtualBodies::configure(const std::vector<std::string>& arrSpecs)
+{
+	bool success = true;
+	arrBodies.clear();
+
+	for (const std::string& strSpec : arrSpecs)
+	{
+		const size_t posEquals = strSpec.find('=');
+		sVirtualBody body;
+		body.name       = trim(strSpec.substr(0, posEquals));
+		body.expression = (posEquals != std::string::npos) ? trim(strSpec.substr(posEquals + 1)) : "";
+
+		size_t      pos = 0;
+		std::string strError;
+		if (body.name.empty() || (body.name.size() >= MAX_NAMELENGTH) || body.expression.empty())
+		{
+			strError = "expected <name>=<expression>";
+		}
+		else if (parseExpression(body.expression, pos, body.root, 0, strError) && (pos < body.expression.size()))
+		{
+			strError = "unexpected '" + body.expression.substr(pos) + "'";
+		}
+		else if (!strError.empty())
+		{
+			// error of the parser
+		}
+		else if ((body.root.function == FN_NUMBER) || (body.root.function == FN_POSE))
+		{
+			strError = "constant pose";
+		}
+
+		if (!strError.empty())
+		{
+			LOG_ERROR("Invalid virtual rigid body '" << strSpec << "': " << strError);
+			success = false;
+			continue;
+		}
+		arrBodies.push_back(body);
+		LOG_INFO("Virtual rigid body '" << body.name << "' (ID " << (VIRTUAL_RIGIDBODY_ID + arrBodies.size() - 1) << "): " << body.expression);
+	}
+
+	compiled        = false;
+	framesProcessed = 0;
+	return success;
+}
+
+
+bool VirtualBodies::parseExpression(const std::string& strText, size_t& refPos, sNode& refNode, int depth, std::string& refError) const
+{
+	if (depth >= VIRTUAL_MAX_DEPTH)
+	{
+		refError = "nested deeper than " + std::to_string(VIRTUAL_MAX_DEPTH) + " levels";
+		return false;
+	}
+
+	// name, number, or function call
+	const size_t posEnd = strText.find_first_of("(),", refPos);
+	const std::string strToken = trim(strText.substr(refPos, posEnd - refPos));
+	refPos = (posEnd == std::string::npos) ? strText.size() : posEnd;
+	if (strToken.empty())
+	{
+		refError = "missing name or value";
+		return false;
+	}
+
+	refNode.args.clear();
+	refNode.value = 0;
+	if ((refPos < strText.size()) && (strText[refPos] == '('))
+	{
+		std::string strFunction(strToken);
+		std::transform(strFunction.begin(), strFunction.end(), strFunction.begin(), ::tolower);
+		if      (strFunction == "pose")     refNode.function = FN_POSE;
+		else if (strFunction == "offset")   refNode.function = FN_OFFSET;
+		else if (strFunction == "compose")  refNode.function = FN_COMPOSE;
+		else if (strFunction == "midpoint") refNode.function = FN_MIDPOINT;
+		else if (strFunction == "average")  refNode.function = FN_AVERAGE;
+		else if (strFunction == "lookat")   refNode.function = FN_LOOKAT;
+		else
+		{
+			refError = "unknown function '" + strToken + "'";
+			return false;
+		}
+
+		// arguments
+		do
+		{
+			refPos++; // '(' or ','
+			if (refNode.args.size() >= VIRTUAL_MAX_ARGUMENTS)
+			{
+				refError = "too many arguments";
+				return false;
+			}
+			refNode.args.push_back(sNode());
+			if (!parseExpression(strText, refPos, refNode.args.back(), depth + 1, refError)) return false;
+		}
+		while ((refPos < strText.size()) && (strText[refPos] == ','));
+
+		if ((refPos >= strText.size()) || (strText[refPos] != ')'))
+		{
+			refError = "missing ')'";
+			return false;
+		}
+		refPos++;
+		while ((refPos < strText.size()) && isspace((unsigned char) strText[refPos])) refPos++;
+
+		// check the arguments: numbers are only allowed for constant poses and offsets
+		const size_t count = refNode.args.size();
+		size_t numbers = 0;
+		for (const sNode& refArg : refNode.args) numbers += (refArg.function == FN_NUMBER) ? 1 : 0;
+		bool valid;
+		switch (refNode.function)
+		{
+			case FN_POSE:     valid = ((count == 3) || (count == 7)) && (numbers == count); break;
+			case FN_OFFSET:   valid = (count == 4) && (numbers == 3) && (refNode.args[0].function != FN_NUMBER); break;
+			case FN_COMPOSE:
+			case FN_MIDPOINT:
+			case FN_LOOKAT:   valid = (count == 2) && (numbers == 0); break;
+			case FN_AVERAGE:  valid = (count >= 1) && (numbers == 0); break;
+			default:          valid = false; break;
+		}
+		if (!valid)
+		{
+			refError = "invalid arguments for '" + strToken + "'";
+			return false;
+		}
+		return true;
+	}
+
+	char* pEnd = nullptr;
+	const float value = strtof(strToken.c_str(), &pEnd);
+	if ((*pEnd == '\0') && std::isfinite(value))
+	{
+		refNode.function = FN_NUMBER;
+		refNode.value    = value;
+	}
+	else
+	{
+		refNode.function = FN_ENTITY;
+		refNode.name     = strToken;
+	}
+	return true;
+}
+
+
+bool VirtualBodies::isEnabled() const
+{
+	return !arrBodies.empty();
+}
+
+
+bool VirtualBodies::hasDescriptions(const MoCapData& refData) const
+{
+	size_t found = 0;
+	for (int dataBlockIdx = 0; dataBlockIdx < refData.description.nDataDescriptions; dataBlockIdx++)
+	{
+		const sDataDescription& descr = refData.description.arrDataDescriptions[dataBlockIdx];
+		if ((descr.type == Descriptor_RigidBody) &&
+		    (descr.Data.RigidBodyDescription->ID >= VIRTUAL_RIGIDBODY_ID) &&
+		    (descr.Data.RigidBodyDescription->ID <  VIRTUAL_RIGIDBODY_ID + (int) arrBodies.size()))
+		{
+			found++;
+		}
+	}
+	return found == arrBodies.size();
+}
+
+
+void VirtualBodies::addDescriptions(MoCapData& refData) const
+{
+	if (!isEnabled() || hasDescriptions(refData)) return;
+
+	const int maxDescriptions = sizeof(refData.description.arrDataDescriptions) / sizeof(refData.description.arrDataDescriptions[0]);
+	for (size_t bodyIdx = 0; bodyIdx < arrBodies.size(); bodyIdx++)
+	{
+		sRigidBodyData data;
+		data.ID = VIRTUAL_RIGIDBODY_ID + (int) bodyIdx;
+		if (refData.findRigidBodyDescription(data) != nullptr) continue;
+
+		if (refData.description.nDataDescriptions >= maxDescriptions)
+		{
+			LOG_WARNING("No space for the description of virtual rigid body '" << arrBodies[bodyIdx].name << "'");
+			break;
+		}
+
+		sRigidBodyDescription* pDescription = new sRigidBodyDescription();
+		memset(pDescription, 0, sizeof(*pDescription));
+		strncpy(pDescription->szName, arrBodies[bodyIdx].name.c_str(), sizeof(pDescription->szName) - 1);
+		pDescription->ID       = data.ID;
+		pDescription->parentID = -1;
+
+		sDataDescription& refDescription = refData.description.arrDataDescriptions[refData.description.nDataDescriptions];
+		refDescription.type = Descriptor_RigidBody;
+		refDescription.Data.RigidBodyDescription = pDescription;
+		refData.description.nDataDescriptions++;
+	}
+}
+
+
+int VirtualBodies::findRigidBody(const MoCapData& refData, const std::string& strName, size_t bodyIdx) const
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+
+	// earlier virtual bodies
+	for (size_t idx = 0; (idx < bodyIdx) && (refFrame.nRigidBodies + (int) idx < MAX_RIGIDBODIES); idx++)
+	{
+		if (matchesPattern(strName.c_str(), arrBodies[idx].name.c_str())) return refFrame.nRigidBodies + (int) idx;
+	}
+
+	// rigid bodies of the MoCap system
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		const sRigidBodyDescription* pDescription = refData.findRigidBodyDescription(refFrame.RigidBodies[rbIdx]);
+		if (pDescription && matchesPattern(strName.c_str(), pDescription->szName)) return rbIdx;
+	}
+	return -1;
+}
+
+
+bool VirtualBodies::findBone(const MoCapData& refData, const std::string& strName, int& refSkeletonIdx, int& refBoneIdx) const
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+	const size_t posSlash = strName.find('/');
+	if (posSlash == std::string::npos) return false;
+
+	const std::string strSkeleton = strName.substr(0, posSlash);
+	const std::string strBone     = strName.substr(posSlash + 1);
+	for (int sIdx = 0; sIdx < refFrame.nSkeletons; sIdx++)
+	{
+		const sSkeletonDescription* pDescription = refData.findSkeletonDescription(refFrame.Skeletons[sIdx]);
+		if (!pDescription || !matchesPattern(strSkeleton.c_str(), pDescription->szName)) continue;
+
+		const int boneCount = std::min(pDescription->nRigidBodies, refFrame.Skeletons[sIdx].nRigidBodies);
+		for (int bIdx = 0; bIdx < boneCount; bIdx++)
+		{
+			if (matchesPattern(strBone.c_str(), pDescription->RigidBodies[bIdx].szName))
+			{
+				refSkeletonIdx = sIdx;
+				refBoneIdx     = bIdx;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+void VirtualBodies::emit(const sNode& refNode, const MoCapData& refData, size_t bodyIdx)
+{
+	switch (refNode.function)
+	{
+		case FN_ENTITY:
+		{
+			int rbIdx = findRigidBody(refData, refNode.name, bodyIdx);
+			int sIdx, bIdx;
+			if (rbIdx >= 0)
+			{
+				arrProgram.push_back(OP_LOAD_RIGIDBODY);
+				arrProgram.push_back(rbIdx);
+			}
+			else if (findBone(refData, refNode.name, sIdx, bIdx))
+			{
+				arrProgram.push_back(OP_LOAD_BONE);
+				arrProgram.push_back(sIdx);
+				arrProgram.push_back(bIdx);
+			}
+			else
+			{
+				arrProgram.push_back(OP_LOAD_MISSING);
+				arrMissing.push_back(refNode.name);
+			}
+			stackDepth++;
+			break;
+		}
+
+		case FN_POSE:
+		{
+			const std::vector<sNode>& args = refNode.args;
+			sPose pose = { args[0].value, args[1].value, args[2].value, 0, 0, 0, 1, true };
+			if (args.size() == 7)
+			{
+				const float len = sqrtf(args[3].value * args[3].value + args[4].value * args[4].value +
+				                        args[5].value * args[5].value + args[6].value * args[6].value);
+				if (len > 0)
+				{
+					pose.qx = args[3].value / len; pose.qy = args[4].value / len;
+					pose.qz = args[5].value / len; pose.qw = args[6].value / len;
+				}
+			}
+			arrProgram.push_back(OP_CONST);
+			arrProgram.push_back((int32_t) arrConstants.size());
+			arrConstants.push_back(pose);
+			stackDepth++;
+			break;
+		}
+
+		case FN_OFFSET:
+		{
+			// compose(a, pose(x, y, z))
+			emit(refNode.args[0], refData, bodyIdx);
+			const sPose pose = { refNode.args[1].value, refNode.args[2].value, refNode.args[3].value, 0, 0, 0, 1, true };
+			arrProgram.push_back(OP_CONST);
+			arrProgram.push_back((int32_t) arrConstants.size());
+			arrConstants.push_back(pose);
+			stackDepth++;
+			maxStackDepth = std::max(maxStackDepth, stackDepth);
+			arrProgram.push_back(OP_COMPOSE);
+			stackDepth--;
+			break;
+		}
+
+		case FN_COMPOSE:
+		case FN_LOOKAT:
+			emit(refNode.args[0], refData, bodyIdx);
+			emit(refNode.args[1], refData, bodyIdx);
+			arrProgram.push_back((refNode.function == FN_COMPOSE) ? OP_COMPOSE : OP_LOOKAT);
+			stackDepth--;
+			break;
+
+		case FN_MIDPOINT:
+		case FN_AVERAGE:
+			for (const sNode& refArg : refNode.args)
+			{
+				emit(refArg, refData, bodyIdx);
+			}
+			arrProgram.push_back(OP_AVERAGE);
+			arrProgram.push_back((int32_t) refNode.args.size());
+			stackDepth -= (int) refNode.args.size() - 1;
+			break;
+
+		default:
+			break;
+	}
+	maxStackDepth = std::max(maxStackDepth, stackDepth);
+}
+
+
+bool VirtualBodies::compile(const MoCapData& refData)
+{
+	arrProgram.clear();
+	arrConstants.clear();
+	arrMissing.clear();
+	stackDepth    = 0;
+	maxStackDepth = 0;
+
+	for (size_t bodyIdx = 0; bodyIdx < arrBodies.size(); bodyIdx++)
+	{
+		emit(arrBodies[bodyIdx].root, refData, bodyIdx);
+		arrProgram.push_back(OP_STORE);
+		arrProgram.push_back((int32_t) bodyIdx);
+		stackDepth--;
+	}
+	arrStack.resize(maxStackDepth);
+
+	for (const std::string& strName : arrMissing)
+	{
+		LOG_WARNING("Virtual rigid bodies: '" << strName << "' not found");
+	}
+
+	compiledGeneration  = refData.descriptionGeneration;
+	compiledRigidBodies = refData.frame.nRigidBodies;
+	compiled            = true;
+	return arrMissing.empty();
+}
+
+
+void VirtualBodies::process(MoCapData& refData)
+{
+	if (!isEnabled()) return;
+
+	// the bodies are appended to the rigid bodies of the MoCap system
+	refData.removeDerivedRigidBodies();
+	addDescriptions(refData);
+	sFrameOfMocapData& refFrame = refData.frame;
+	const int sourceCount = refFrame.nRigidBodies;
+	const int bodyCount   = std::min((int) arrBodies.size(), MAX_RIGIDBODIES - sourceCount);
+	if (bodyCount <= 0) return;
+
+	if (!compiled || (compiledGeneration != refData.descriptionGeneration) || (compiledRigidBodies != sourceCount))
+	{
+		compile(refData);
+	}
+	framesProcessed++;
+
+	const sPose missing = { 0, 0, 0, 0, 0, 0, 1, false };
+	sPose* pStack = arrStack.data();
+	int    top    = 0; // number of poses on the stack
+	const int32_t* pCode = arrProgram.data();
+	const int32_t* pEnd  = pCode + arrProgram.size();
+	while (pCode < pEnd)
+	{
+		switch (*pCode++)
+		{
+			case OP_LOAD_RIGIDBODY:
+			case OP_LOAD_BONE:
+			{
+				const sRigidBodyData* pRB = nullptr;
+				if (pCode[-1] == OP_LOAD_RIGIDBODY)
+				{
+					pRB    = &refFrame.RigidBodies[pCode[0]];
+					pCode += 1;
+				}
+				else
+				{
+					// the skeleton structure is only checked for changes with the description
+					const sSkeletonData& refSkeleton = refFrame.Skeletons[pCode[0]];
+					pRB    = (pCode[0] < refFrame.nSkeletons) && (pCode[1] < refSkeleton.nRigidBodies) ? &refSkeleton.RigidBodyData[pCode[1]] : nullptr;
+					pCode += 2;
+				}
+				sPose& p = pStack[top++];
+				if (pRB)
+				{
+					p.x  = pRB->x;  p.y  = pRB->y;  p.z  = pRB->z;
+					p.qx = pRB->qx; p.qy = pRB->qy; p.qz = pRB->qz; p.qw = pRB->qw;
+					p.tracked = (pRB->params & STATUS_TRACKED) != 0;
+				}
+				else
+				{
+					p = missing;
+				}
+				break;
+			}
+
+			case OP_LOAD_MISSING:
+				pStack[top++] = missing;
+				break;
+
+			case OP_CONST:
+				pStack[top++] = arrConstants[*pCode++];
+				break;
+
+			case OP_COMPOSE:
+			{
+				const sPose  b = pStack[--top];
+				sPose&       a = pStack[top - 1];
+				float x = b.x, y = b.y, z = b.z;
+				rotate(a.qx, a.qy, a.qz, a.qw, x, y, z);
+				a.x += x; a.y += y; a.z += z;
+				multiply(a.qx, a.qy, a.qz, a.qw, b.qx, b.qy, b.qz, b.qw, a.qx, a.qy, a.qz, a.qw);
+				a.tracked &= b.tracked;
+				break;
+			}
+
+			case OP_AVERAGE:
+			{
+				const int count = *pCode++;
+				sPose* pFirst = pStack + top - count;
+				sPose  sum    = *pFirst;
+				for (int idx = 1; idx < count; idx++)
+				{
+					const sPose& p = pFirst[idx];
+					// quaternions in the same hemisphere as the first one
+					const float sign = ((p.qx * sum.qx + p.qy * sum.qy + p.qz * sum.qz + p.qw * sum.qw) < 0) ? -1.0f : 1.0f;
+					sum.x  += p.x;         sum.y  += p.y;         sum.z  += p.z;
+					sum.qx += sign * p.qx; sum.qy += sign * p.qy; sum.qz += sign * p.qz; sum.qw += sign * p.qw;
+					sum.tracked &= p.tracked;
+				}
+				const float len = sqrtf(sum.qx * sum.qx + sum.qy * sum.qy + sum.qz * sum.qz + sum.qw * sum.qw);
+				sum.x /= count; sum.y /= count; sum.z /= count;
+				if (len > 0)
+				{
+					sum.qx /= len; sum.qy /= len; sum.qz /= len; sum.qw /= len;
+				}
+				top -= count - 1;
+				*pFirst = sum;
+				break;
+			}
+
+			case OP_LOOKAT:
+			{
+				const sPose  b = pStack[--top];
+				sPose&       a = pStack[top - 1];
+				a.tracked &= b.tracked;
+
+				// -Z towards the target, X horizontal
+				float zx = a.x - b.x, zy = a.y - b.y, zz = a.z - b.z;
+				const float lenZ = sqrtf(zx * zx + zy * zy + zz * zz);
+				float xx = zz, xz = -zx; // (0, 1, 0) x z
+				const float lenX = sqrtf(xx * xx + xz * xz);
+				if ((lenZ <= 0) || (lenX <= 1e-6f * lenZ)) break; // target on top or below: keep the orientation
+				zx /= lenZ; zy /= lenZ; zz /= lenZ;
+				xx /= lenX; xz /= lenX;
+				const float yx = zy * xz, yy = zz * xx - zx * xz, yz = -zy * xx; // z x x
+
+				// rotation matrix with the columns x, y, z > quaternion
+				const float trace = xx + yy + zz;
+				if (trace > 0)
+				{
+					const float s = 0.5f / sqrtf(trace + 1.0f);
+					a.qw = 0.25f / s;
+					a.qx = (yz - zy) * s;
+					a.qy = (zx - xz) * s;
+					a.qz = (0  - yx) * s;
+				}
+				else if ((xx > yy) && (xx > zz))
+				{
+					const float s = 2.0f * sqrtf(1.0f + xx - yy - zz);
+					a.qw = (yz - zy) / s;
+					a.qx = 0.25f * s;
+					a.qy = (yx + 0) / s;
+					a.qz = (zx + xz) / s;
+				}
+				else if (yy > zz)
+				{
+					const float s = 2.0f * sqrtf(1.0f + yy - xx - zz);
+					a.qw = (zx - xz) / s;
+					a.qx = (yx + 0) / s;
+					a.qy = 0.25f * s;
+					a.qz = (zy + yz) / s;
+				}
+				else
+				{
+					const float s = 2.0f * sqrtf(1.0f + zz - xx - yy);
+					a.qw = (0 - yx) / s;
+					a.qx = (zx + xz) / s;
+					a.qy = (zy + yz) / s;
+					a.qz = 0.25f * s;
+				}
+				break;
+			}
+
+			case OP_STORE:
+			{
+				const int bodyIdx = *pCode++;
+				const sPose& p = pStack[--top];
+				if (bodyIdx >= bodyCount) break;
+
+				sRigidBodyData& rb = refFrame.RigidBodies[sourceCount + bodyIdx];
+				rb.ID = VIRTUAL_RIGIDBODY_ID + bodyIdx;
+				rb.x  = p.x;  rb.y  = p.y;  rb.z  = p.z;
+				rb.qx = p.qx; rb.qy = p.qy; rb.qz = p.qz; rb.qw = p.qw;
+				rb.nMarkers  = 0;
+				rb.MeanError = 0;
+				rb.params    = p.tracked ? STATUS_TRACKED : STATUS_NOT_TRACKED;
+				refFrame.nRigidBodies++;
+				refData.derivedRigidBodies++;
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+}
+
+
+std::string VirtualBodies::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "Virtual rigid bodies: none";
+		return strm.str();
+	}
+
+	strm << "Virtual bodies : " << arrBodies.size() << " (IDs from " << VIRTUAL_RIGIDBODY_ID << ")" << std::endl
+	     << "Program        : " << arrProgram.size() << " words, " << arrConstants.size() << " constants, stack depth " << maxStackDepth << std::endl
+	     << "Frames         : " << framesProcessed;
+	if (!arrMissing.empty())
+	{
+		strm << std::endl << "Not found      : ";
+		for (size_t idx = 0; idx < arrMissing.size(); idx++)
+		{
+			strm << ((idx > 0) ? ", " : "") << arrMissing[idx];
+		}
+	}
+	for (size_t bodyIdx = 0; bodyIdx < arrBodies.size(); bodyIdx++)
+	{
+		strm << std::endl << (VIRTUAL_RIGIDBODY_ID + bodyIdx) << " " << arrBodies[bodyIdx].name << " = " << arrBodies[bodyIdx].expression;
+	}
+	return strm.str();
+}
@@ -0,0 +1,149 @@
+/**
+ * Virtual rigid bodies, derived from the poses of other rigid bodies and skeleton bones,
+ * so clients don't need to compute the same derived poses independently.
+ *
+ * Each virtual body is defined by an expression, e.g., "HandsMid=midpoint(Skeleton1/LeftHand, Skeleton1/RightHand)":
+ *   <name>                       rigid body, skeleton bone as "<skeleton>/<bone>", or earlier virtual body
+ *   pose(x, y, z[, qx, qy, qz, qw])  constant pose
+ *   offset(a, x, y, z)           a moved by (x, y, z) in its own coordinate system
+ *   compose(a, b)                b applied in the coordinate system of a (e.g., a calibration offset given as pose(...))
+ *   midpoint(a, b)               position and orientation halfway between a and b
+ *   average(a, b, ...)           mean position and orientation
+ *   lookAt(a, b)                 position of a, oriented so that its -Z axis points at b (Y up)
+ * A virtual body is tracked when all bodies it depends on are tracked.
+ *
+ * The expressions are parsed once, and compiled into a flat bytecode for a pose stack whenever the description changes,
+ * with all names resolved to frame indices. Each frame, the bytecode is evaluated once and the results are
+ * appended to the frame as regular rigid bodies, with their descriptions at the end of the scene description.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// rigid body ID of the first virtual body, the others follow in the order of their definition
+#define VIRTUAL_RIGIDBODY_ID 10000
+
+
+/**
+ * Class for the virtual rigid bodies.
+ */
+class VirtualBodies
+{
+public:
+
+	VirtualBodies();
+
+	/**
+	 * Parses the definitions of the virtual bodies.
+	 *
+	 * @param arrSpecs  the definitions as "<name>=<expression>"
+	 *
+	 * @return <code>true</code> if all definitions were valid
+	 */
+	bool configure(const std::vector<std::string>& arrSpecs);
+
+	/**
+	 * Checks if any virtual bodies are defined.
+	 *
+	 * @return <code>true</code> if there are virtual bodies
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Appends the descriptions of the virtual bodies to a scene description, unless they are already there.
+	 * The description generation is not changed.
+	 *
+	 * @param refData  the MoCap data with the description
+	 */
+	void addDescriptions(MoCapData& refData) const;
+
+	/**
+	 * Evaluates the virtual bodies and appends them to the frame.
+	 *
+	 * @param refData  the MoCap data with the frame
+	 */
+	void process(MoCapData& refData);
+
+	/**
+	 * Gets a printable summary of the virtual bodies and their compiled programs.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	enum eFunction : uint8_t
+	{
+		FN_ENTITY, FN_NUMBER, FN_POSE, FN_OFFSET, FN_COMPOSE, FN_MIDPOINT, FN_AVERAGE, FN_LOOKAT
+	};
+
+	/**
+	 * Node of a parsed expression.
+	 */
+	struct sNode
+	{
+		eFunction          function;
+		std::string        name;   // entity name
+		float              value;  // number
+		std::vector<sNode> args;
+	};
+
+	/**
+	 * Pose on the evaluation stack.
+	 */
+	struct sPose
+	{
+		float x, y, z;
+		float qx, qy, qz, qw;
+		bool  tracked;
+	};
+
+	enum eOpCode : int32_t
+	{
+		OP_LOAD_RIGIDBODY,  // <frame index>: push a rigid body
+		OP_LOAD_BONE,       // <skeleton index> <bone index>: push a skeleton bone
+		OP_LOAD_MISSING,    // push an untracked identity pose
+		OP_CONST,           // <constant index>: push a constant pose
+		OP_COMPOSE,         // pop b, a, push a * b
+		OP_AVERAGE,         // <count>: pop count poses, push their mean
+		OP_LOOKAT,          // pop b, a, push a oriented towards b
+		OP_STORE            // <virtual body index>: pop the result into the frame
+	};
+
+	struct sVirtualBody
+	{
+		std::string name;
+		std::string expression;
+		sNode       root;
+	};
+
+	bool parseExpression(const std::string& strText, size_t& refPos, sNode& refNode, int depth, std::string& refError) const;
+	bool compile(const MoCapData& refData);
+	void emit(const sNode& refNode, const MoCapData& refData, size_t bodyIdx);
+	int  findRigidBody(const MoCapData& refData, const std::string& strName, size_t bodyIdx) const;
+	bool findBone(const MoCapData& refData, const std::string& strName, int& refSkeletonIdx, int& refBoneIdx) const;
+	bool hasDescriptions(const MoCapData& refData) const;
+
+private:
+
+	std::vector<sVirtualBody> arrBodies;
+
+	// compiled program of all bodies, valid for one description generation and rigid body count
+	std::vector<int32_t>     arrProgram;
+	std::vector<sPose>       arrConstants;
+	std::vector<sPose>       arrStack;
+	std::vector<std::string> arrMissing;   // names that could not be resolved
+	unsigned int             compiledGeneration;
+	int                      compiledRigidBodies;
+	bool                     compiled;
+	int                      stackDepth, maxStackDepth;
+
+	unsigned long            framesProcessed;
+};
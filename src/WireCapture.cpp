@@ -0,0 +1,304 @@
+#include "WireCapture.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "WireCapture"
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+
+
+// identification of the file and the index
+#define WIRE_CAPTURE_MAGIC       "MSWIRE01"
+#define WIRE_CAPTURE_INDEX_MAGIC "MSINDEX1"
+// size of the header of a record: time, address, port, size
+#define WIRE_RECORD_HEADER_SIZE  16
+// size of the trailer: index offset, index entries, records, magic
+#define WIRE_TRAILER_SIZE        24
+// records are dropped instead of blocking the sender when the writer falls this far behind
+#define WIRE_MAX_PENDING_BYTES   (64 * 1024 * 1024)
+
+
+/******************************************************************************
+ * WireCapture class
+ */
+
+WireCapture::WireCapture() :
+	active(false),
+	fileOffset(0),
+	records(0),
+	recordsDropped(0),
+	stopping(false)
+{
+	// nothing else to do
+}
+
+
+WireCapture::~WireCapture()
+{
+	stop();
+}
+
+
+bool WireCapture::start(const std::string& strFilename)
+{
+	stop();
+
+	file.open(strFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not create capture file '" << strFilename << "'");
+		return false;
+	}
+	file.write(WIRE_CAPTURE_MAGIC, 8);
+
+	{
+		std::lock_guard<std::mutex> lock(mtxBuffer);
+		filename       = strFilename;
+		fileOffset     = 8;
+		records        = 0;
+		recordsDropped = 0;
+		stopping       = false;
+		pendingBuffer.clear();
+		arrIndex.clear();
+		tStart = std::chrono::steady_clock::now();
+	}
+
+	thread = std::thread(&WireCapture::writerThread, this);
+	active = true;
+	LOG_INFO("Capturing outgoing datagrams into '" << strFilename << "'");
+	return true;
+}
+
+
+void WireCapture::stop()
+{
+	if (!active) return;
+	active = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mtxBuffer);
+		stopping = true;
+	}
+	cvBuffer.notify_one();
+	thread.join();
+
+	// the index and trailer allow seeking without reading the whole file
+	const uint64_t indexOffset = fileOffset;
+	const uint32_t indexCount  = (uint32_t) (arrIndex.size() / 2);
+	file.write((const char*) arrIndex.data(), arrIndex.size() * sizeof(uint64_t));
+	file.write((const char*) &indexOffset, sizeof(indexOffset));
+	file.write((const char*) &indexCount,  sizeof(indexCount));
+	file.write((const char*) &records,     sizeof(records));
+	file.write(WIRE_CAPTURE_INDEX_MAGIC, 8);
+	file.close();
+
+	LOG_INFO("Capture '" << filename << "' closed (" << records << " datagrams"
+		<< ((recordsDropped > 0) ? (", " + std::to_string(recordsDropped) + " dropped") : std::string()) << ")");
+}
+
+
+bool WireCapture::isActive() const
+{
+	return active;
+}
+
+
+void WireCapture::record(const void* pData, int size, const sockaddr_in& refDestination)
+{
+	if (!active) return;
+
+	std::lock_guard<std::mutex> lock(mtxBuffer);
+	if (stopping) return;
+	if ((size > 0xFFFF) || (pendingBuffer.size() + WIRE_RECORD_HEADER_SIZE + size > WIRE_MAX_PENDING_BYTES))
+	{
+		recordsDropped++;
+		return;
+	}
+
+	const uint64_t time = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart).count();
+	if (records % WIRE_CAPTURE_INDEX_INTERVAL == 0)
+	{
+		arrIndex.push_back(time);
+		arrIndex.push_back(fileOffset);
+	}
+
+	uint8_t header[WIRE_RECORD_HEADER_SIZE];
+	const uint32_t address  = refDestination.sin_addr.s_addr;
+	const uint16_t port     = refDestination.sin_port;
+	const uint16_t dataSize = (uint16_t) size;
+	memcpy(header,      &time,     sizeof(time));
+	memcpy(header + 8,  &address,  sizeof(address));
+	memcpy(header + 12, &port,     sizeof(port));
+	memcpy(header + 14, &dataSize, sizeof(dataSize));
+	pendingBuffer.insert(pendingBuffer.end(), header, header + sizeof(header));
+	pendingBuffer.insert(pendingBuffer.end(), (const uint8_t*) pData, (const uint8_t*) pData + dataSize);
+
+	fileOffset += WIRE_RECORD_HEADER_SIZE + dataSize;
+	records++;
+	cvBuffer.notify_one();
+}
+
+
+std::string WireCapture::getStatus() const
+{
+	std::lock_guard<std::mutex> lock(mtxBuffer);
+	std::stringstream strm;
+	if (!active)
+	{
+		strm << "Capture: inactive";
+	}
+	else
+	{
+		strm << "Capture: '" << filename << "', " << records << " datagrams, "
+		     << (fileOffset / 1024) << "kB, " << recordsDropped << " dropped";
+	}
+	return strm.str();
+}
+
+
+void WireCapture::writerThread()
+{
+	std::vector<uint8_t> writeBuffer;
+	bool done = false;
+	while (!done)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtxBuffer);
+			cvBuffer.wait(lock, [this] { return stopping || !pendingBuffer.empty(); });
+			writeBuffer.swap(pendingBuffer);
+			done = stopping;
+		}
+		if (!writeBuffer.empty())
+		{
+			file.write((const char*) writeBuffer.data(), writeBuffer.size());
+			writeBuffer.clear();
+		}
+	}
+}
+
+
+
+/******************************************************************************
+ * WireReplayer class
+ */
+
+bool WireReplayer::replay(const std::string& strFilename, const std::string& strAddress, int port, float speed, float startTime)
+{
+	std::ifstream file(strFilename, std::ios::in | std::ios::binary);
+	char magic[8];
+	if (!file.is_open() || !file.read(magic, sizeof(magic)) || (memcmp(magic, WIRE_CAPTURE_MAGIC, 8) != 0))
+	{
+		LOG_ERROR("Could not open capture file '" << strFilename << "'");
+		return false;
+	}
+
+	// read the index, if there is one
+	file.seekg(0, std::ios::end);
+	uint64_t dataEnd = (uint64_t) file.tellg();
+	std::vector<uint64_t> arrIndex;
+	if (dataEnd >= 8 + WIRE_TRAILER_SIZE)
+	{
+		uint64_t indexOffset;
+		uint32_t indexCount, records;
+		file.seekg(dataEnd - WIRE_TRAILER_SIZE);
+		file.read((char*) &indexOffset, sizeof(indexOffset));
+		file.read((char*) &indexCount,  sizeof(indexCount));
+		file.read((char*) &records,     sizeof(records));
+		file.read(magic, sizeof(magic));
+		if (file && (memcmp(magic, WIRE_CAPTURE_INDEX_MAGIC, 8) == 0) &&
+		    (indexOffset + indexCount * 16 + WIRE_TRAILER_SIZE == dataEnd))
+		{
+			arrIndex.resize(indexCount * 2);
+			file.seekg(indexOffset);
+			file.read((char*) arrIndex.data(), arrIndex.size() * sizeof(uint64_t));
+			dataEnd = indexOffset;
+			LOG_INFO("Capture '" << strFilename << "': " << records << " datagrams");
+		}
+		else
+		{
+			LOG_WARNING("Capture '" << strFilename << "' has no index (incomplete?), reading sequentially");
+		}
+	}
+	file.clear();
+
+	// seek to the start time
+	const uint64_t startNs = (uint64_t) (std::max(0.0f, startTime) * 1e9);
+	uint64_t offset = 8;
+	for (size_t idx = 0; idx + 1 < arrIndex.size(); idx += 2)
+	{
+		if (arrIndex[idx] > startNs) break;
+		offset = arrIndex[idx + 1];
+	}
+	file.seekg(offset);
+
+	sockaddr_in target;
+	if (!networkResolveAddress(strAddress, port, target))
+	{
+		LOG_ERROR("Invalid replay address '" << strAddress << "'");
+		return false;
+	}
+	if (!networkInitialise()) return false;
+	SOCKET replaySocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (replaySocket == INVALID_SOCKET)
+	{
+		LOG_ERROR("Could not create replay socket");
+		networkDeinitialise();
+		return false;
+	}
+
+	LOG_INFO("Replaying '" << strFilename << "' to " << strAddress << ":" << ((port > 0) ? std::to_string(port) : std::string("<original port>"))
+		<< ((speed > 0) ? (" at " + std::to_string(speed) + "x speed") : std::string(" as fast as possible")));
+
+	typedef std::chrono::steady_clock tClock;
+	std::vector<uint8_t> datagram(0xFFFF);
+	tClock::time_point tReplayStart;
+	uint64_t           firstTime = 0;
+	unsigned long      sent      = 0;
+	double             maxLate   = 0;
+	while ((uint64_t) file.tellg() + WIRE_RECORD_HEADER_SIZE <= dataEnd)
+	{
+		uint8_t header[WIRE_RECORD_HEADER_SIZE];
+		if (!file.read((char*) header, sizeof(header))) break;
+		uint64_t time;
+		uint16_t originalPort, size;
+		memcpy(&time,         header,      sizeof(time));
+		memcpy(&originalPort, header + 12, sizeof(originalPort));
+		memcpy(&size,         header + 14, sizeof(size));
+		if (!file.read((char*) datagram.data(), size)) break;
+		if (time < startNs) continue;
+
+		if (sent == 0)
+		{
+			tReplayStart = tClock::now();
+			firstTime    = time;
+		}
+		else if (speed > 0)
+		{
+			// original (scaled) timing: sleep most of the time, then spin
+			const tClock::time_point tSend = tReplayStart + std::chrono::nanoseconds((int64_t) ((time - firstTime) / speed));
+			tClock::time_point now = tClock::now();
+			if (tSend - now > std::chrono::microseconds(200))
+			{
+				std::this_thread::sleep_for(tSend - now - std::chrono::microseconds(200));
+			}
+			while ((now = tClock::now()) < tSend)
+			{
+				std::this_thread::yield();
+			}
+			maxLate = std::max(maxLate, std::chrono::duration<double>(now - tSend).count());
+		}
+
+		target.sin_port = (port > 0) ? htons((uint16_t) port) : originalPort;
+		sendto(replaySocket, (const char*) datagram.data(), size, 0, (const sockaddr*) &target, sizeof(target));
+		sent++;
+	}
+
+	closesocket(replaySocket);
+	networkDeinitialise();
+
+	const double duration = (sent > 0) ? std::chrono::duration<double>(tClock::now() - tReplayStart).count() : 0;
+	LOG_INFO("Replayed " << sent << " datagrams in " << duration << "s (max. " << (maxLate * 1000) << "ms late)");
+	return true;
+}
@@ -0,0 +1,133 @@
+/**
+ * Recording of the datagrams exactly as they are sent to the clients, and replaying of such recordings.
+ *
+ * File format (little endian):
+ *   header:  char[8] "MSWIRE01"
+ *   records: uint64 send time in ns since the start of the capture,
+ *            uint32 IPv4 destination address, uint16 destination port (network byte order),
+ *            uint16 size, followed by the datagram
+ *   index:   for every 256th record: uint64 send time, uint64 file offset of the record
+ *   trailer: uint64 file offset of the index, uint32 number of index entries, uint32 number of records, char[8] "MSINDEX1"
+ * Files without index and trailer (e.g., after a crash) can still be read sequentially.
+ *
+ * Each datagram is recorded when it is actually handed to the socket, so paced datagrams carry the time of their slot,
+ * and datagrams the SDK or the socket refused are not recorded.
+ * Datagrams of the NatNet server instances are recorded with the multicast address of the endpoint,
+ * or with the address 0.0.0.0 and the data port for unicast endpoints, because the SDK doesn't report the client addresses.
+ */
+
+#pragma once
+
+#include "Network.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// number of records between two index entries
+#define WIRE_CAPTURE_INDEX_INTERVAL 256
+
+
+/**
+ * Class for recording outgoing datagrams into a file.
+ * Recording only copies the datagram into a buffer, the file is written by a background thread.
+ */
+class WireCapture
+{
+public:
+
+	WireCapture();
+
+	/**
+	 * Stops the capture and destroys the object.
+	 */
+	~WireCapture();
+
+	/**
+	 * Starts recording into a new file.
+	 * A running capture is stopped first.
+	 *
+	 * @param strFilename  the name of the file to write
+	 *
+	 * @return <code>true</code> if the file was created
+	 */
+	bool start(const std::string& strFilename);
+
+	/**
+	 * Stops recording, writes the index, and closes the file.
+	 */
+	void stop();
+
+	/**
+	 * Checks if datagrams are being recorded.
+	 *
+	 * @return <code>true</code> if the capture is running
+	 */
+	bool isActive() const;
+
+	/**
+	 * Records a datagram that has just been sent.
+	 *
+	 * @param pData           the datagram
+	 * @param size            the size of the datagram
+	 * @param refDestination  the address the datagram was sent to
+	 */
+	void record(const void* pData, int size, const sockaddr_in& refDestination);
+
+	/**
+	 * Gets a printable summary of the capture.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	void writerThread();
+
+private:
+
+	std::string               filename;
+	std::ofstream             file;
+	std::thread               thread;
+	std::atomic<bool>         active;
+
+	mutable std::mutex        mtxBuffer;
+	std::condition_variable   cvBuffer;
+	std::vector<uint8_t>      pendingBuffer; // records waiting for the writer
+	std::vector<uint64_t>     arrIndex;      // pairs of send time and file offset
+	std::chrono::steady_clock::time_point tStart;
+	uint64_t                  fileOffset;    // offset of the next record
+	uint32_t                  records;
+	unsigned long             recordsDropped;
+	bool                      stopping;
+};
+
+
+/**
+ * Class for replaying a capture file.
+ */
+class WireReplayer
+{
+public:
+
+	/**
+	 * Sends the datagrams of a capture file again.
+	 *
+	 * @param strFilename  the capture file
+	 * @param strAddress   the address to send to
+	 * @param port         the port to send to (0: the original port of each datagram)
+	 * @param speed        the speed factor for the timing (1: original timing, 0: as fast as possible)
+	 * @param startTime    the time in s within the capture to start at
+	 *
+	 * @return <code>true</code> if the file could be replayed
+	 */
+	static bool replay(const std::string& strFilename, const std::string& strAddress, int port, float speed, float startTime);
+};
@@ -0,0 +1,646 @@
+#include "ZoneEngine.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "ZoneEngine"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+
+// grid cell size in units when there are no proximity rules
+#define ZONE_DEFAULT_CELL_SIZE  1.0f
+// zones covering more grid cells than this are checked for every body instead of being stored per cell
+#define ZONE_MAX_CELLS          4096
+// bodies count as apart again when their distance exceeds the rule distance by this factor
+#define ZONE_NEAR_HYSTERESIS    1.1f
+// marks bodies that are not in the grid
+#define ZONE_NOT_TRACKED        0xFFFFFFFFu
+
+
+/******************************************************************************
+ * Helper functions
+ */
+
+/**
+ * Parses a list of numbers separated by a character.
+ *
+ * @param strValue   the text to parse
+ * @param separator  the separator
+ * @param arrValues  the vector to fill
+ *
+ * @return <code>true</code> if all numbers were valid
+ */
+static bool parseNumbers(const std::string& strValue, char separator, std::vector<float>& arrValues)
+{
+	arrValues.clear();
+	std::istringstream strm(strValue);
+	std::string strNumber;
+	while (std::getline(strm, strNumber, separator))
+	{
+		char* pEnd = nullptr;
+		const float value = strtof(strNumber.c_str(), &pEnd);
+		if (strNumber.empty() || (*pEnd != '\0') || !std::isfinite(value)) return false;
+		arrValues.push_back(value);
+	}
+	return true;
+}
+
+
+/**
+ * Splits a list of name patterns separated by semicolons.
+ *
+ * @param strValue     the text to split
+ * @param arrPatterns  the vector to fill
+ */
+static void parsePatterns(const std::string& strValue, std::vector<std::string>& arrPatterns)
+{
+	std::istringstream strm(strValue);
+	std::string strPattern;
+	while (std::getline(strm, strPattern, ';'))
+	{
+		if (!strPattern.empty()) arrPatterns.push_back(strPattern);
+	}
+}
+
+
+/**
+ * Checks if a name matches any of a list of patterns.
+ *
+ * @param arrPatterns  the patterns (empty: everything matches)
+ * @param strName      the name to check
+ *
+ * @return <code>true</code> if the name matches
+ */
+static bool matchesAny(const std::vector<std::string>& arrPatterns, const std::string& strName)
+{
+	bool matches = arrPatterns.empty();
+	for (auto iter = arrPatterns.cbegin(); !matches && (iter != arrPatterns.cend()); iter++)
+	{
+		matches = matchesPattern(iter->c_str(), strName.c_str());
+	}
+	return matches;
+}
+
+
+/******************************************************************************
+ * ZoneEngine class
+ */
+
+ZoneEngine::ZoneEngine() :
+	cellSize(ZONE_DEFAULT_CELL_SIZE),
+	descriptionGeneration(0),
+	bucketMask(0),
+	framesProcessed(0),
+	eventCount(0)
+{
+	// nothing else to do
+}
+
+
+bool ZoneEngine::configure(const std::vector<std::string>& arrSpecs)
+{
+	bool success = true;
+	arrZones.clear();
+	arrRules.clear();
+	cellSize = 0;
+
+	for (const std::string& strSpec : arrSpecs)
+	{
+		sZone zone;
+		if (!parseZone(strSpec, zone))
+		{
+			LOG_ERROR("Invalid zone specification '" << strSpec << "'");
+			success = false;
+			continue;
+		}
+		if (zone.name.empty())
+		{
+			zone.name = "Zone" + std::to_string(arrZones.size() + 1);
+		}
+		if (zone.shape == SHAPE_NEAR)
+		{
+			// the neighbouring cells have to cover the largest distance
+			arrRules.push_back((uint16_t) arrZones.size());
+			cellSize = std::max(cellSize, zone.distance * ZONE_NEAR_HYSTERESIS);
+		}
+		arrZones.push_back(zone);
+	}
+	if (cellSize <= 0)
+	{
+		cellSize = ZONE_DEFAULT_CELL_SIZE;
+	}
+
+	buildZoneGrid();
+
+	// start again
+	descriptionGeneration = 0;
+	arrBodyNames.clear();
+	arrBodyZones.clear();
+	arrEvents.clear();
+	framesProcessed = 0;
+	eventCount      = 0;
+
+	if (isEnabled())
+	{
+		LOG_INFO(arrZones.size() - arrRules.size() << " zone(s) and " << arrRules.size() << " proximity rule(s), grid cell size " << cellSize);
+	}
+	return success;
+}
+
+
+bool ZoneEngine::parseZone(const std::string& strSpec, sZone& refZone)
+{
+	refZone.shape    = SHAPE_NEAR;
+	refZone.radius   = 0;
+	refZone.distance = 0;
+	refZone.enterCount = 0;
+	refZone.exitCount  = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		refZone.arrMin[axis] = -INFINITY;
+		refZone.arrMax[axis] =  INFINITY;
+		refZone.center[axis] = 0;
+	}
+
+	int  shapes = 0;
+	bool success = true;
+	std::vector<float> arrValues;
+	std::istringstream strmSpec(strSpec);
+	std::string strPair;
+	while (success && std::getline(strmSpec, strPair, ','))
+	{
+		size_t posEquals = strPair.find('=');
+		if (posEquals == std::string::npos) return false;
+
+		std::string strKey;
+		std::string strValue = strPair.substr(posEquals + 1);
+		std::transform(strPair.begin(), strPair.begin() + posEquals, std::back_inserter(strKey), ::tolower);
+
+		if (strKey == "name")
+		{
+			refZone.name = strValue;
+		}
+		else if (strKey == "box")
+		{
+			success = parseNumbers(strValue, ':', arrValues) && (arrValues.size() == 6);
+			for (int axis = 0; success && (axis < 3); axis++)
+			{
+				refZone.arrMin[axis] = std::min(arrValues[axis], arrValues[axis + 3]);
+				refZone.arrMax[axis] = std::max(arrValues[axis], arrValues[axis + 3]);
+			}
+			refZone.shape = SHAPE_BOX;
+			shapes++;
+		}
+		else if (strKey == "sphere")
+		{
+			success = parseNumbers(strValue, ':', arrValues) && (arrValues.size() == 4) && (arrValues[3] > 0);
+			for (int axis = 0; success && (axis < 3); axis++)
+			{
+				refZone.center[axis] = arrValues[axis];
+				refZone.arrMin[axis] = arrValues[axis] - arrValues[3];
+				refZone.arrMax[axis] = arrValues[axis] + arrValues[3];
+			}
+			if (success) refZone.radius = arrValues[3];
+			refZone.shape = SHAPE_SPHERE;
+			shapes++;
+		}
+		else if (strKey == "polygon")
+		{
+			// "x:z;x:z;..."
+			std::string strPoints(strValue);
+			std::replace(strPoints.begin(), strPoints.end(), ';', ':');
+			success = parseNumbers(strPoints, ':', refZone.arrPolygon) &&
+			          (refZone.arrPolygon.size() >= 6) && ((refZone.arrPolygon.size() % 2) == 0);
+			for (size_t idx = 0; success && (idx < refZone.arrPolygon.size()); idx += 2)
+			{
+				refZone.arrMin[0] = (idx == 0) ? refZone.arrPolygon[idx]     : std::min(refZone.arrMin[0], refZone.arrPolygon[idx]);
+				refZone.arrMax[0] = (idx == 0) ? refZone.arrPolygon[idx]     : std::max(refZone.arrMax[0], refZone.arrPolygon[idx]);
+				refZone.arrMin[2] = (idx == 0) ? refZone.arrPolygon[idx + 1] : std::min(refZone.arrMin[2], refZone.arrPolygon[idx + 1]);
+				refZone.arrMax[2] = (idx == 0) ? refZone.arrPolygon[idx + 1] : std::max(refZone.arrMax[2], refZone.arrPolygon[idx + 1]);
+			}
+			refZone.shape = SHAPE_POLYGON;
+			shapes++;
+		}
+		else if (strKey == "height")
+		{
+			success = parseNumbers(strValue, ':', arrValues) && (arrValues.size() == 2);
+			if (success)
+			{
+				refZone.arrMin[1] = std::min(arrValues[0], arrValues[1]);
+				refZone.arrMax[1] = std::max(arrValues[0], arrValues[1]);
+			}
+		}
+		else if (strKey == "near")
+		{
+			success = parseNumbers(strValue, ':', arrValues) && (arrValues.size() == 1) && (arrValues[0] > 0);
+			if (success) refZone.distance = arrValues[0];
+			refZone.shape = SHAPE_NEAR;
+			shapes++;
+		}
+		else if (strKey == "bodies")
+		{
+			parsePatterns(strValue, refZone.arrBodies);
+		}
+		else if (strKey == "targets")
+		{
+			parsePatterns(strValue, refZone.arrTargets);
+		}
+		else
+		{
+			success = false;
+		}
+	}
+
+	// exactly one shape or rule per specification
+	return success && (shapes == 1);
+}
+
+
+bool ZoneEngine::isEnabled() const
+{
+	return !arrZones.empty();
+}
+
+
+void ZoneEngine::buildZoneGrid()
+{
+	mapZoneCells.clear();
+	arrLargeZones.clear();
+
+	for (size_t zoneIdx = 0; zoneIdx < arrZones.size(); zoneIdx++)
+	{
+		const sZone& refZone = arrZones[zoneIdx];
+		if (refZone.shape == SHAPE_NEAR) continue;
+
+		// number of cells covered by the bounding box
+		double cells = 1;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float range = refZone.arrMax[axis] - refZone.arrMin[axis];
+			cells *= std::isfinite(range) ? (floor(refZone.arrMax[axis] / cellSize) - floor(refZone.arrMin[axis] / cellSize) + 1) : INFINITY;
+		}
+		if (cells > ZONE_MAX_CELLS)
+		{
+			arrLargeZones.push_back((uint16_t) zoneIdx);
+			continue;
+		}
+
+		for (int64_t cx = getCell(refZone.arrMin[0]); cx <= getCell(refZone.arrMax[0]); cx++)
+		{
+			for (int64_t cy = getCell(refZone.arrMin[1]); cy <= getCell(refZone.arrMax[1]); cy++)
+			{
+				for (int64_t cz = getCell(refZone.arrMin[2]); cz <= getCell(refZone.arrMax[2]); cz++)
+				{
+					mapZoneCells[getCellKey(cx, cy, cz)].push_back((uint16_t) zoneIdx);
+				}
+			}
+		}
+	}
+}
+
+
+void ZoneEngine::reset(const MoCapData& refData)
+{
+	const sFrameOfMocapData& refFrame = refData.frame;
+
+	// names of the rigid bodies for the patterns and the status
+	arrBodyNames.clear();
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		const sRigidBodyDescription* pDescription = refData.findRigidBodyDescription(refFrame.RigidBodies[rbIdx]);
+		arrBodyNames.push_back(pDescription ? pDescription->szName : ("Rigid body " + std::to_string(refFrame.RigidBodies[rbIdx].ID)));
+	}
+
+	for (sZone& refZone : arrZones)
+	{
+		refZone.arrSelected.resize(arrBodyNames.size());
+		refZone.arrTarget.resize(arrBodyNames.size());
+		for (size_t rbIdx = 0; rbIdx < arrBodyNames.size(); rbIdx++)
+		{
+			refZone.arrSelected[rbIdx] = matchesAny(refZone.arrBodies,  arrBodyNames[rbIdx]) ? 1 : 0;
+			refZone.arrTarget[rbIdx]   = matchesAny(refZone.arrTargets, arrBodyNames[rbIdx]) ? 1 : 0;
+		}
+		refZone.setNear.clear();
+	}
+
+	// bodies start outside of all zones, so the ones already inside get an enter event
+	arrBodyZones.assign(arrBodyNames.size(), std::vector<uint16_t>());
+
+	descriptionGeneration = refData.descriptionGeneration;
+}
+
+
+void ZoneEngine::process(const MoCapData& refData)
+{
+	arrEvents.clear();
+	if (!isEnabled()) return;
+
+	const sFrameOfMocapData& refFrame = refData.frame;
+	if ((refData.descriptionGeneration != descriptionGeneration) || ((size_t) refFrame.nRigidBodies != arrBodyNames.size()))
+	{
+		reset(refData);
+	}
+	framesProcessed++;
+
+	buildBodyGrid(refFrame);
+
+	// zones: only the zones of the cell of each body are checked
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		if (arrBodyBucket[rbIdx] == ZONE_NOT_TRACKED) continue;
+
+		const sRigidBodyData& refBody = refFrame.RigidBodies[rbIdx];
+		arrCandidates.assign(arrLargeZones.begin(), arrLargeZones.end());
+		auto iterCell = mapZoneCells.find(getCellKey(arrCellX[rbIdx], arrCellY[rbIdx], arrCellZ[rbIdx]));
+		if (iterCell != mapZoneCells.end())
+		{
+			arrCandidates.insert(arrCandidates.end(), iterCell->second.begin(), iterCell->second.end());
+		}
+		std::sort(arrCandidates.begin(), arrCandidates.end());
+
+		arrInside.clear();
+		for (uint16_t zoneIdx : arrCandidates)
+		{
+			if (arrZones[zoneIdx].arrSelected[rbIdx] && isInside(arrZones[zoneIdx], refBody))
+			{
+				arrInside.push_back(zoneIdx);
+			}
+		}
+
+		// compare with the zones of the previous frame (both sorted)
+		std::vector<uint16_t>& refPrevious = arrBodyZones[rbIdx];
+		if (arrInside == refPrevious) continue;
+		auto iterNew = arrInside.cbegin();
+		auto iterOld = refPrevious.cbegin();
+		while ((iterNew != arrInside.cend()) || (iterOld != refPrevious.cend()))
+		{
+			if ((iterOld == refPrevious.cend()) || ((iterNew != arrInside.cend()) && (*iterNew < *iterOld)))
+			{
+				addEvent(ZONE_EVENT_ENTER, *iterNew, refBody.ID, -1);
+				arrZones[*iterNew].enterCount++;
+				iterNew++;
+			}
+			else if ((iterNew == arrInside.cend()) || (*iterOld < *iterNew))
+			{
+				addEvent(ZONE_EVENT_EXIT, *iterOld, refBody.ID, -1);
+				arrZones[*iterOld].exitCount++;
+				iterOld++;
+			}
+			else
+			{
+				iterNew++;
+				iterOld++;
+			}
+		}
+		refPrevious = arrInside;
+	}
+
+	// proximity rules: only the bodies in the neighbouring cells are checked
+	for (uint16_t zoneIdx : arrRules)
+	{
+		checkProximity(zoneIdx, refFrame);
+	}
+
+	eventCount += arrEvents.size();
+}
+
+
+void ZoneEngine::buildBodyGrid(const sFrameOfMocapData& refFrame)
+{
+	const size_t bodyCount = std::max(0, refFrame.nRigidBodies);
+
+	// about two buckets per body
+	uint32_t bucketCount = 1;
+	while (bucketCount < 2 * bodyCount) bucketCount <<= 1;
+	bucketMask = bucketCount - 1;
+
+	arrCellX.resize(bodyCount);
+	arrCellY.resize(bodyCount);
+	arrCellZ.resize(bodyCount);
+	arrBodyBucket.resize(bodyCount);
+	arrBucketStart.assign(bucketCount + 1, 0);
+	for (size_t rbIdx = 0; rbIdx < bodyCount; rbIdx++)
+	{
+		const sRigidBodyData& refBody = refFrame.RigidBodies[rbIdx];
+		if (((refBody.params & STATUS_TRACKED) == 0) ||
+		    !std::isfinite(refBody.x) || !std::isfinite(refBody.y) || !std::isfinite(refBody.z))
+		{
+			arrBodyBucket[rbIdx] = ZONE_NOT_TRACKED;
+			continue;
+		}
+		arrCellX[rbIdx] = getCell(refBody.x);
+		arrCellY[rbIdx] = getCell(refBody.y);
+		arrCellZ[rbIdx] = getCell(refBody.z);
+		arrBodyBucket[rbIdx] = getCellHash(arrCellX[rbIdx], arrCellY[rbIdx], arrCellZ[rbIdx]) & bucketMask;
+		arrBucketStart[arrBodyBucket[rbIdx] + 1]++;
+	}
+
+	// counting sort of the bodies by bucket
+	for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		arrBucketStart[bucket + 1] += arrBucketStart[bucket];
+	}
+	arrBucketEntries.resize(arrBucketStart[bucketCount]);
+	std::vector<uint32_t> arrFill(arrBucketStart.begin(), arrBucketStart.end() - 1);
+	for (size_t rbIdx = 0; rbIdx < bodyCount; rbIdx++)
+	{
+		if (arrBodyBucket[rbIdx] != ZONE_NOT_TRACKED)
+		{
+			arrBucketEntries[arrFill[arrBodyBucket[rbIdx]]++] = (int) rbIdx;
+		}
+	}
+}
+
+
+bool ZoneEngine::isInside(const sZone& refZone, const sRigidBodyData& refBody) const
+{
+	const float x = refBody.x, y = refBody.y, z = refBody.z;
+	switch (refZone.shape)
+	{
+		case SHAPE_BOX:
+			return (x >= refZone.arrMin[0]) && (x <= refZone.arrMax[0]) &&
+			       (y >= refZone.arrMin[1]) && (y <= refZone.arrMax[1]) &&
+			       (z >= refZone.arrMin[2]) && (z <= refZone.arrMax[2]);
+
+		case SHAPE_SPHERE:
+		{
+			const float dx = x - refZone.center[0], dy = y - refZone.center[1], dz = z - refZone.center[2];
+			return (dx * dx + dy * dy + dz * dz) <= (refZone.radius * refZone.radius);
+		}
+
+		case SHAPE_POLYGON:
+		{
+			if ((y < refZone.arrMin[1]) || (y > refZone.arrMax[1])) return false;
+			// even-odd rule on the X/Z plane
+			const std::vector<float>& arrPoly = refZone.arrPolygon;
+			const size_t pointCount = arrPoly.size() / 2;
+			bool inside = false;
+			for (size_t idx = 0, prev = pointCount - 1; idx < pointCount; prev = idx++)
+			{
+				const float x1 = arrPoly[idx  * 2], z1 = arrPoly[idx  * 2 + 1];
+				const float x2 = arrPoly[prev * 2], z2 = arrPoly[prev * 2 + 1];
+				if (((z1 > z) != (z2 > z)) && (x < (x2 - x1) * (z - z1) / (z2 - z1) + x1))
+				{
+					inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		default:
+			return false;
+	}
+}
+
+
+void ZoneEngine::checkProximity(size_t zoneIdx, const sFrameOfMocapData& refFrame)
+{
+	sZone& refRule = arrZones[zoneIdx];
+	const float nearLimit2  = refRule.distance * refRule.distance;
+	const float apartLimit2 = nearLimit2 * ZONE_NEAR_HYSTERESIS * ZONE_NEAR_HYSTERESIS;
+
+	refRule.setNearNext.clear();
+	for (int idx1 = 0; idx1 < refFrame.nRigidBodies; idx1++)
+	{
+		if ((arrBodyBucket[idx1] == ZONE_NOT_TRACKED) || !(refRule.arrSelected[idx1] || refRule.arrTarget[idx1])) continue;
+		const sRigidBodyData& refBody1 = refFrame.RigidBodies[idx1];
+
+		for (int64_t cx = arrCellX[idx1] - 1; cx <= arrCellX[idx1] + 1; cx++)
+		for (int64_t cy = arrCellY[idx1] - 1; cy <= arrCellY[idx1] + 1; cy++)
+		for (int64_t cz = arrCellZ[idx1] - 1; cz <= arrCellZ[idx1] + 1; cz++)
+		{
+			const uint32_t bucket = getCellHash(cx, cy, cz) & bucketMask;
+			for (uint32_t entry = arrBucketStart[bucket]; entry < arrBucketStart[bucket + 1]; entry++)
+			{
+				// each pair once, and only bodies really in this cell (the bucket might be shared)
+				const int idx2 = arrBucketEntries[entry];
+				if ((idx2 <= idx1) || (arrCellX[idx2] != cx) || (arrCellY[idx2] != cy) || (arrCellZ[idx2] != cz)) continue;
+				if (!((refRule.arrSelected[idx1] && refRule.arrTarget[idx2]) ||
+				      (refRule.arrSelected[idx2] && refRule.arrTarget[idx1]))) continue;
+
+				const sRigidBodyData& refBody2 = refFrame.RigidBodies[idx2];
+				const float dx = refBody1.x - refBody2.x, dy = refBody1.y - refBody2.y, dz = refBody1.z - refBody2.z;
+				const float dist2 = dx * dx + dy * dy + dz * dz;
+				const uint64_t key     = ((uint64_t) idx1 << 32) | (uint32_t) idx2;
+				const bool     wasNear = refRule.setNear.count(key) > 0;
+				if (dist2 <= (wasNear ? apartLimit2 : nearLimit2))
+				{
+					refRule.setNearNext.insert(key);
+					if (!wasNear)
+					{
+						const bool forward = refRule.arrSelected[idx1] && refRule.arrTarget[idx2];
+						addEvent(ZONE_EVENT_NEAR, zoneIdx, forward ? refBody1.ID : refBody2.ID, forward ? refBody2.ID : refBody1.ID);
+						refRule.enterCount++;
+					}
+				}
+			}
+		}
+	}
+
+	// pairs that are not near anymore, unless one of the bodies lost tracking
+	for (uint64_t key : refRule.setNear)
+	{
+		if (refRule.setNearNext.count(key) > 0) continue;
+		const int idx1 = (int) (key >> 32), idx2 = (int) (key & 0xFFFFFFFF);
+		if ((arrBodyBucket[idx1] == ZONE_NOT_TRACKED) || (arrBodyBucket[idx2] == ZONE_NOT_TRACKED))
+		{
+			refRule.setNearNext.insert(key);
+			continue;
+		}
+		const bool forward = refRule.arrSelected[idx1] && refRule.arrTarget[idx2];
+		const int32_t id1 = refFrame.RigidBodies[idx1].ID, id2 = refFrame.RigidBodies[idx2].ID;
+		addEvent(ZONE_EVENT_APART, zoneIdx, forward ? id1 : id2, forward ? id2 : id1);
+		refRule.exitCount++;
+	}
+	refRule.setNear.swap(refRule.setNearNext);
+}
+
+
+void ZoneEngine::addEvent(uint8_t type, size_t zoneIdx, int32_t bodyID, int32_t otherID)
+{
+	sZoneEvent event;
+	event.type     = type;
+	event.reserved = 0;
+	event.zone     = (uint16_t) zoneIdx;
+	event.bodyID   = bodyID;
+	event.otherID  = otherID;
+	arrEvents.push_back(event);
+}
+
+
+const std::vector<sZoneEvent>& ZoneEngine::getEvents() const
+{
+	return arrEvents;
+}
+
+
+int64_t ZoneEngine::getCell(float value) const
+{
+	return (int64_t) floor(value / cellSize);
+}
+
+
+uint64_t ZoneEngine::getCellKey(int64_t cx, int64_t cy, int64_t cz) const
+{
+	return (((uint64_t) cx & 0x1FFFFF) << 42) | (((uint64_t) cy & 0x1FFFFF) << 21) | ((uint64_t) cz & 0x1FFFFF);
+}
+
+
+uint32_t ZoneEngine::getCellHash(int64_t cx, int64_t cy, int64_t cz) const
+{
+	return (uint32_t) ((cx * 73856093) ^ (cy * 19349663) ^ (cz * 83492791));
+}
+
+
+std::string ZoneEngine::getStatus() const
+{
+	std::stringstream strm;
+	if (!isEnabled())
+	{
+		strm << "Zones: none";
+		return strm.str();
+	}
+
+	strm << "Zones          : " << (arrZones.size() - arrRules.size()) << " (" << arrLargeZones.size() << " checked for every body)" << std::endl
+	     << "Proximity rules: " << arrRules.size() << std::endl
+	     << "Grid cell size : " << cellSize << std::endl
+	     << "Events         : " << eventCount << " in " << framesProcessed << " frames";
+
+	for (size_t zoneIdx = 0; zoneIdx < arrZones.size(); zoneIdx++)
+	{
+		const sZone& refZone = arrZones[zoneIdx];
+		strm << std::endl << zoneIdx << " " << refZone.name << ": ";
+		std::string strBodies;
+		if (refZone.shape == SHAPE_NEAR)
+		{
+			strm << "near " << refZone.distance << ", " << refZone.enterCount << " near, " << refZone.exitCount << " apart";
+			for (uint64_t key : refZone.setNear)
+			{
+				const size_t idx1 = (size_t) (key >> 32), idx2 = (size_t) (key & 0xFFFFFFFF);
+				if ((idx1 < arrBodyNames.size()) && (idx2 < arrBodyNames.size()))
+				{
+					strBodies += (strBodies.empty() ? "" : ", ") + arrBodyNames[idx1] + "/" + arrBodyNames[idx2];
+				}
+			}
+		}
+		else
+		{
+			static const char* arrShapeNames[] = { "box", "sphere", "polygon" };
+			strm << arrShapeNames[refZone.shape] << ", " << refZone.enterCount << " enter, " << refZone.exitCount << " exit";
+			for (size_t rbIdx = 0; rbIdx < arrBodyZones.size(); rbIdx++)
+			{
+				const std::vector<uint16_t>& refZones = arrBodyZones[rbIdx];
+				if (std::binary_search(refZones.begin(), refZones.end(), (uint16_t) zoneIdx))
+				{
+					strBodies += (strBodies.empty() ? "" : ", ") + arrBodyNames[rbIdx];
+				}
+			}
+		}
+		if (!strBodies.empty()) strm << " (" << strBodies << ")";
+	}
+	return strm.str();
+}
@@ -0,0 +1,179 @@
+/**
+ * Server-side spatial zones and proximity rules for rigid bodies,
+ * so clients that only react to triggers don't need to receive and check every pose.
+ *
+ * Zones are boxes, spheres, or polygons on the floor (X/Z plane) with an optional height range.
+ * Proximity rules fire when a selected rigid body comes near a target rigid body.
+ * Each frame, the tracked rigid bodies are sorted into a uniform grid (spatial hash),
+ * so each body is only tested against the zones and bodies of the neighbouring cells.
+ * Untracked bodies keep their state until they are tracked again.
+ *
+ * The events of a frame are sent to the client channel clients that requested them with "events",
+ * in datagrams with message ID NAT_ZONE_EVENTS:
+ *   uint16 message ID, uint16 number of following bytes,
+ *   int32  frame number, double frame timestamp, uint16 number of events, uint16 reserved,
+ *   per event: sZoneEvent (12 bytes, see below)
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// message ID of zone and proximity events (outside of the range used by NatNet)
+#define NAT_ZONE_EVENTS   208
+
+// event types
+#define ZONE_EVENT_ENTER  1   // body entered a zone
+#define ZONE_EVENT_EXIT   2   // body left a zone
+#define ZONE_EVENT_NEAR   3   // body came near a target body
+#define ZONE_EVENT_APART  4   // body moved away from a target body
+
+
+#pragma pack(push, 1)
+/**
+ * A zone or proximity event as sent to the clients.
+ */
+struct sZoneEvent
+{
+	uint8_t  type;     ///< ZONE_EVENT_...
+	uint8_t  reserved;
+	uint16_t zone;     ///< index of the zone or rule in the order of the -zone options
+	int32_t  bodyID;   ///< ID of the rigid body
+	int32_t  otherID;  ///< ID of the target rigid body of a proximity rule (-1 for zones)
+};
+
+/**
+ * Header of an event datagram.
+ */
+struct sZoneEventHeader
+{
+	uint16_t iMessage;    ///< NAT_ZONE_EVENTS
+	uint16_t nDataBytes;  ///< number of following bytes
+	int32_t  iFrame;      ///< frame number
+	double   fTimestamp;  ///< frame timestamp
+	uint16_t eventCount;
+	uint16_t reserved;
+};
+#pragma pack(pop)
+
+
+/**
+ * Class for the zone engine.
+ */
+class ZoneEngine
+{
+public:
+
+	ZoneEngine();
+
+	/**
+	 * Parses the zone and rule specifications and clears all states.
+	 * Each specification has comma separated key=value pairs, with exactly one of box, sphere, polygon, or near:
+	 *   "name=stage,box=minX:minY:minZ:maxX:maxY:maxZ,bodies=Visitor*"
+	 *   "name=altar,sphere=x:y:z:radius"
+	 *   "name=room,polygon=x:z;x:z;x:z,height=minY:maxY"
+	 *   "name=handshake,near=distance,bodies=Visitor*,targets=Prop*;Wand"
+	 * bodies and targets are name patterns with '*' and '?', separated by ';' (default: all rigid bodies).
+	 *
+	 * @param arrSpecs  the specifications, in the order of the zone indices
+	 *
+	 * @return <code>true</code> if all specifications were valid
+	 */
+	bool configure(const std::vector<std::string>& arrSpecs);
+
+	/**
+	 * Checks if any zones or rules are configured.
+	 *
+	 * @return <code>true</code> if there are zones or rules
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Evaluates the rigid bodies of a frame and collects the events.
+	 *
+	 * @param refData  the MoCap data with the frame
+	 */
+	void process(const MoCapData& refData);
+
+	/**
+	 * Gets the events of the last processed frame.
+	 *
+	 * @return the events
+	 */
+	const std::vector<sZoneEvent>& getEvents() const;
+
+	/**
+	 * Gets a printable summary of the zones and rules with the bodies that are currently inside or near.
+	 *
+	 * @return the summary text
+	 */
+	std::string getStatus() const;
+
+private:
+
+	enum eShape { SHAPE_BOX, SHAPE_SPHERE, SHAPE_POLYGON, SHAPE_NEAR };
+
+	struct sZone
+	{
+		std::string              name;
+		eShape                   shape;
+		float                    arrMin[3], arrMax[3];  // bounding box (box, polygon with height range)
+		float                    center[3], radius;     // sphere
+		std::vector<float>       arrPolygon;            // x, z pairs
+		float                    distance;              // proximity rule
+		std::vector<std::string> arrBodies, arrTargets; // name patterns (empty: all)
+
+		// state, rebuilt when the description changes
+		std::vector<uint8_t>         arrSelected;  // per rigid body: matches the body patterns
+		std::vector<uint8_t>         arrTarget;    // per rigid body: matches the target patterns
+		std::unordered_set<uint64_t> setNear, setNearNext; // pairs of rigid body indices
+
+		unsigned long                enterCount, exitCount; // or near and apart for proximity rules
+	};
+
+	bool parseZone(const std::string& strSpec, sZone& refZone);
+	void reset(const MoCapData& refData);
+	void buildZoneGrid();
+	void buildBodyGrid(const sFrameOfMocapData& refFrame);
+	bool isInside(const sZone& refZone, const sRigidBodyData& refBody) const;
+	void checkProximity(size_t zoneIdx, const sFrameOfMocapData& refFrame);
+	void addEvent(uint8_t type, size_t zoneIdx, int32_t bodyID, int32_t otherID);
+
+	int64_t  getCell(float value) const;
+	uint64_t getCellKey(int64_t cx, int64_t cy, int64_t cz) const;
+	uint32_t getCellHash(int64_t cx, int64_t cy, int64_t cz) const;
+
+private:
+
+	std::vector<sZone> arrZones;
+	float              cellSize;
+
+	unsigned int       descriptionGeneration; // the states are reset when the description changes
+	std::vector<std::string> arrBodyNames;
+	std::vector<std::vector<uint16_t>> arrBodyZones; // per rigid body: the zones it is inside, sorted
+
+	// zones per grid cell (static), zones that cover too many cells are always checked
+	std::unordered_map<uint64_t, std::vector<uint16_t>> mapZoneCells;
+	std::vector<uint16_t> arrLargeZones;
+	std::vector<uint16_t> arrRules;
+
+	// tracked rigid bodies per hash bucket, rebuilt each frame (counting sort)
+	std::vector<int64_t>  arrCellX, arrCellY, arrCellZ;  // cell of each rigid body
+	std::vector<uint32_t> arrBucketStart;                // first entry of each bucket (bucket count + 1)
+	std::vector<int>      arrBucketEntries;              // rigid body indices, sorted by bucket
+	std::vector<uint32_t> arrBodyBucket;                 // bucket of each rigid body (~0: not tracked)
+	uint32_t              bucketMask;
+
+	std::vector<uint16_t> arrCandidates, arrInside; // zones to check for one body, zones it is inside
+	std::vector<sZoneEvent> arrEvents;
+
+	unsigned long framesProcessed;
+	unsigned long eventCount;
+};